@@ -0,0 +1,94 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.cdoapps.gpio;
+
+import android.os.Build;
+
+import androidx.benchmark.BenchmarkState;
+import androidx.benchmark.junit4.BenchmarkRule;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+
+import org.junit.After;
+import org.junit.Before;
+import org.junit.Rule;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+import static org.junit.Assume.assumeTrue;
+
+/**
+ * Compares the cost of the regular JNI calls of the library with the read of a pin handle, bound
+ * as {@code @CriticalNative} from Android 8.0.
+ *
+ * {@code getValue} and {@code pinGetValue} read the same pin from the registers, once through the
+ * regular {@code GPIO.getValue}, which looks the pin up, and once through {@code GPIO.Pin}: the
+ * difference between them is the cost of the thread state transitions and of the lookup. The
+ * benchmarks are skipped when the registers are not mapped.
+ */
+@RunWith(AndroidJUnit4.class)
+public class NativeCallBenchmark {
+    private static final int PIN = 7;
+
+    @Rule
+    public BenchmarkRule benchmarkRule = new BenchmarkRule();
+
+    private GPIO mGpio;
+    private GPIO.Pin mPin;
+
+    @Before
+    public void setUp() {
+        assumeTrue("critical natives require Android 8.0",
+                Build.VERSION.SDK_INT >= Build.VERSION_CODES.O);
+
+        mGpio = GPIO.getInstance();
+        mGpio.onResume();
+        mGpio.export(PIN);
+        mGpio.setMode(PIN, GPIO.MODE_INPUT);
+
+        // a pin is only handed out in register mode ('mmap') with unshadowed registers
+        mPin = mGpio.getPin(PIN);
+        assumeTrue("the registers are not mapped", mPin != null);
+    }
+
+    @After
+    public void tearDown() {
+        if (mGpio == null)
+            return;
+
+        mGpio.unexport(PIN);
+        mGpio.onPause();
+    }
+
+    @Test
+    public void getValue() {
+        BenchmarkState state = benchmarkRule.getState();
+        while (state.keepRunning())
+            mGpio.getValue(PIN);
+    }
+
+    @Test
+    public void readPins() {
+        BenchmarkState state = benchmarkRule.getState();
+        while (state.keepRunning())
+            mGpio.readPins(1L << PIN);
+    }
+
+    @Test
+    public void pinGetValue() {
+        BenchmarkState state = benchmarkRule.getState();
+        while (state.keepRunning())
+            mPin.getValue();
+    }
+}
@@ -0,0 +1,9 @@
+# The native library resolves these classes, fields and methods by name in JNI_OnLoad.
+-keep class com.cdoapps.gpio.** { *; }
+
+# From Android 8.0, the native library registers functions without JNIEnv for the methods annotated
+# with @CriticalNative, which ART only calls that way while it finds the annotation. The same holds
+# for the faster transitions of the methods annotated with @FastNative.
+-keepattributes RuntimeInvisibleAnnotations
+# The annotations are hidden from the SDK: the device provides them.
+-dontwarn dalvik.annotation.optimization.**
@@ -0,0 +1,37 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <android/log.h>
+#include <sys/system_properties.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+
+int __android_log_print(int priority, const char *tag, const char *format, ...) {
+    static const char LEVELS[] = "??VDIWEF";
+
+    va_list arguments;
+    va_start(arguments, format);
+    fprintf(stderr, "%c/%s: ", priority < ANDROID_LOG_SILENT ? LEVELS[priority] : '?', tag);
+    int length = vfprintf(stderr, format, arguments);
+    fputc('\n', stderr);
+    va_end(arguments);
+
+    return length;
+}
+
+int __system_property_get(const char *name, char *value) {
+    *value = '\0';
+    return 0;
+}
@@ -0,0 +1,575 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the 1-Wire slots of the library, the throughput of a DS18B20 and the one of the pins
+// on the simulated registers, so that the timings can be checked on any Linux host.
+//
+// The simulated bus has a pull-up: it is low while the pin drives it low or while the simulated
+// thermometer, if any, holds it low. Without the thermometer, the reads return ones and the resets
+// find no device. The edges are timed by the callback called after each register write.
+
+#include "common.h"
+#include "delay.h"
+#include "gpio.h"
+#include "onewire.h"
+#include "stack.h"
+#include "thermometer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCHMARK_PIN 7
+#define BENCHMARK_BYTES 200
+#define BENCHMARK_READINGS 50
+// the readings which may fail although their slots were released in time
+#define BENCHMARK_READING_ERRORS 1
+// the readings which may fail because their slots were released too late in every attempt, e.g.
+// on a busy host, as a fraction of all of them
+#define BENCHMARK_LATE_READINGS 0.5
+#define BENCHMARK_WRITES 1000000
+
+// a low state of the bus this long is a reset, a shorter one is a slot
+#define BENCHMARK_RESET_LOW 400000
+// the thermometer samples the bits it receives this long after the fall of their slot
+#define BENCHMARK_SAMPLE_DELAY 30000
+
+// the temperature of the simulated DS18B20, in 1/16 degrees Celsius
+#define BENCHMARK_TEMPERATURE 345
+#define BENCHMARK_ROM 0x00000a1b2c3d4e28ull
+
+typedef enum {
+    BenchmarkThermometerIdle,     // ignores the slots, which read ones
+    BenchmarkThermometerCommand,  // receives a ROM command
+    BenchmarkThermometerMatch,    // receives the ROM selected by the master
+    BenchmarkThermometerSearch,   // sends a bit of its ROM and its complement, then receives one
+    BenchmarkThermometerFunction, // receives a function command
+    BenchmarkThermometerSend      // sends the scratchpad
+} BenchmarkThermometerState;
+
+static const char *const BENCHMARK_THERMOMETER_STATES[] = {
+        "idle state", "ROM command", "matched ROM", "ROM search", "function command", "scratchpad"
+};
+
+struct BenchmarkCommand {
+    unsigned char value;
+    BenchmarkThermometerState next;
+};
+
+static const struct BenchmarkCommand BENCHMARK_ROM_COMMANDS[] = {
+        { 0xCC, BenchmarkThermometerFunction }, // skip ROM
+        { 0x55, BenchmarkThermometerMatch },    // match ROM
+        { 0xF0, BenchmarkThermometerSearch }    // search ROM
+};
+
+// the conversion is done at once and the power supply is external, thus the read slots following
+// the other commands return ones like when the thermometer is idle
+static const struct BenchmarkCommand BENCHMARK_FUNCTION_COMMANDS[] = {
+        { 0xBE, BenchmarkThermometerSend }, // read scratchpad
+        { 0x44, BenchmarkThermometerIdle }, // convert T
+        { 0xB4, BenchmarkThermometerIdle }  // read power supply
+};
+
+struct BenchmarkThermometer {
+    uint64_t rom;
+    unsigned char scratchpad[9];
+
+    BenchmarkThermometerState state;
+    uint64_t bits;  // the bits received in the current state
+    int position;   // the number of bits received or sent in the current state
+    int searchStep; // 0 and 1 while the bit and its complement are sent, 2 while one is received
+    BOOL hold;      // the thermometer pulls the bus down
+    int resets;
+
+    long long lows[8]; // the low states of the slots of the current command
+    // the first slot of the transaction which the thermometer did not expect, if failedLow is set
+    BenchmarkThermometerState failedState;
+    int failedPosition;
+    long long failedLow;
+};
+
+struct BenchmarkDuration {
+    long long minimum;
+    long long maximum;
+    long long total;
+    int count;
+};
+
+struct BenchmarkBus {
+    volatile uint32_t *input;
+    uint32_t mask;
+    int index; // the index of the input word
+    struct BenchmarkThermometer *thermometer; // the device on the bus, or NULL
+
+    BOOL low;
+    long long fall;
+    long long previousFall;
+    BOOL slot; // the falls are slots rather than resets
+
+    struct BenchmarkDuration resetLows;
+    struct BenchmarkDuration slots;
+    // the low states of the slots of the current transaction, sorted once its bits are known
+    long long slotLows[16];
+    int slotCount;
+};
+
+static void BenchmarkDurationAdd(struct BenchmarkDuration *duration, long long value) {
+    if (!duration->count || value < duration->minimum)
+        duration->minimum = value;
+    if (!duration->count || value > duration->maximum)
+        duration->maximum = value;
+    duration->total += value;
+    duration->count++;
+}
+
+static void BenchmarkDurationPrint(const char *name, const struct BenchmarkDuration *duration) {
+    if (!duration->count)
+        return;
+
+    printf("%-16s %8.2f %8.2f %8.2f us (%d)\n", name, duration->minimum / 1e3,
+           (double)duration->total / duration->count / 1e3, duration->maximum / 1e3,
+           duration->count);
+}
+
+static unsigned char BenchmarkCRC(const unsigned char *data, int size) {
+    unsigned char crc = 0x0;
+
+    for (int index = 0 ; index < size ; index++) {
+        crc ^= data[index];
+        for (int bit = 0 ; bit < 8 ; bit++)
+            crc = (crc & 0x1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+    }
+
+    return crc;
+}
+
+static void BenchmarkThermometerInit(struct BenchmarkThermometer *thermometer) {
+    const unsigned char scratchpad[] = {
+            BENCHMARK_TEMPERATURE & 0xFF, BENCHMARK_TEMPERATURE >> 8,
+            0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10
+    };
+
+    memset(thermometer, 0x0, sizeof(struct BenchmarkThermometer));
+    thermometer->rom = BENCHMARK_ROM;
+    thermometer->rom |= (uint64_t)BenchmarkCRC((const unsigned char *)&thermometer->rom, 7) << 56;
+
+    memcpy(thermometer->scratchpad, scratchpad, 8);
+    thermometer->scratchpad[8] = BenchmarkCRC(scratchpad, 8);
+    thermometer->state = BenchmarkThermometerIdle;
+}
+
+static void BenchmarkThermometerEnter(struct BenchmarkThermometer *thermometer,
+                                      BenchmarkThermometerState state) {
+    thermometer->state = state;
+    thermometer->bits = 0x0;
+    thermometer->position = 0;
+    thermometer->searchStep = 0;
+}
+
+static void BenchmarkThermometerFail(struct BenchmarkThermometer *thermometer, int position,
+                                     long long duration) {
+    if (!thermometer->failedLow) {
+        thermometer->failedState = thermometer->state;
+        thermometer->failedPosition = position;
+        thermometer->failedLow = duration;
+    }
+
+    BenchmarkThermometerEnter(thermometer, BenchmarkThermometerIdle);
+}
+
+// Enters the state following the command received, or fails at the first bit which differs from
+// the closest known command.
+static void BenchmarkThermometerReceive(struct BenchmarkThermometer *thermometer,
+                                        const struct BenchmarkCommand *commands, int count) {
+    int closest = 0;
+    for (int index = 1 ; index < count ; index++) {
+        if (__builtin_popcount(thermometer->bits ^ commands[index].value) <
+            __builtin_popcount(thermometer->bits ^ commands[closest].value))
+            closest = index;
+    }
+
+    unsigned int wrong = (unsigned int)thermometer->bits ^ commands[closest].value;
+    if (!wrong) {
+        BenchmarkThermometerEnter(thermometer, commands[closest].next);
+    } else {
+        int position = __builtin_ctz(wrong);
+        BenchmarkThermometerFail(thermometer, position, thermometer->lows[position]);
+    }
+}
+
+// Called when the master pulls the bus down: the thermometer holds it down for the whole slot when
+// it sends a zero, and releases it otherwise.
+static void BenchmarkThermometerFall(struct BenchmarkThermometer *thermometer) {
+    int position = thermometer->position;
+    BOOL bit = TRUE;
+
+    if (BenchmarkThermometerSend == thermometer->state) {
+        bit = (thermometer->scratchpad[position / 8] >> (position % 8)) & 0x1;
+    } else if (BenchmarkThermometerSearch == thermometer->state && thermometer->searchStep < 2) {
+        bit = (thermometer->rom >> position) & 0x1;
+        if (thermometer->searchStep)
+            bit = !bit;
+    }
+
+    thermometer->hold = !bit;
+}
+
+// Called when the master releases the bus, after a low state of 'duration' nanoseconds.
+static void BenchmarkThermometerRelease(struct BenchmarkThermometer *thermometer,
+                                        long long duration) {
+    // the presence pulse lasts until the first slot, and a transaction which is not over was cut
+    // by a zero held too long
+    if (duration >= BENCHMARK_RESET_LOW) {
+        if (BenchmarkThermometerIdle == thermometer->state)
+            thermometer->failedLow = 0;
+        else
+            BenchmarkThermometerFail(thermometer, thermometer->position, duration);
+
+        BenchmarkThermometerEnter(thermometer, BenchmarkThermometerCommand);
+        thermometer->hold = TRUE;
+        thermometer->resets++;
+        return;
+    }
+
+    BOOL bit = (duration < BENCHMARK_SAMPLE_DELAY) ? TRUE : FALSE;
+    int position = thermometer->position;
+
+    switch (thermometer->state) {
+        case BenchmarkThermometerCommand:
+        case BenchmarkThermometerFunction:
+            thermometer->lows[position] = duration;
+            thermometer->bits |= (uint64_t)bit << thermometer->position++;
+            if (thermometer->position < 8)
+                break;
+
+            if (BenchmarkThermometerCommand == thermometer->state)
+                BenchmarkThermometerReceive(thermometer, BENCHMARK_ROM_COMMANDS, 3);
+            else
+                BenchmarkThermometerReceive(thermometer, BENCHMARK_FUNCTION_COMMANDS, 3);
+            break;
+
+        case BenchmarkThermometerMatch:
+            // the thermometer stops listening at the first bit which differs from its ROM
+            if (bit != ((thermometer->rom >> position) & 0x1)) {
+                BenchmarkThermometerFail(thermometer, position, duration);
+                break;
+            }
+
+            if (++thermometer->position == 64)
+                BenchmarkThermometerEnter(thermometer, BenchmarkThermometerFunction);
+            break;
+
+        case BenchmarkThermometerSearch:
+            if (thermometer->searchStep < 2) {
+                thermometer->searchStep++;
+                break;
+            }
+
+            thermometer->searchStep = 0;
+            if (bit != ((thermometer->rom >> position) & 0x1))
+                BenchmarkThermometerEnter(thermometer, BenchmarkThermometerIdle);
+            else if (++thermometer->position == 64)
+                BenchmarkThermometerEnter(thermometer, BenchmarkThermometerIdle);
+            break;
+
+        case BenchmarkThermometerSend:
+            if (++thermometer->position == 72)
+                BenchmarkThermometerEnter(thermometer, BenchmarkThermometerIdle);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// The banks of the Odroid-N2 lay out their direction, output and input words in a row. An
+// open-drain pin pulls the bus down while it is an output, which always drives low.
+static void BenchmarkBusWrite(GPIOInfoRef info, int index, uint32_t value, void *context) {
+    struct BenchmarkBus *bus = context;
+    if (!bus->input || (index != bus->index - 2 && index != bus->index - 1))
+        return;
+
+    volatile uint32_t *registers = GPIOInfoGetRegisters(info);
+    BOOL low = !(registers[bus->index - 2] & bus->mask) && !(registers[bus->index - 1] & bus->mask);
+    if (low == bus->low)
+        return;
+
+    long long now = DelayGetTime();
+    bus->low = low;
+
+    if (low) {
+        if (bus->thermometer)
+            BenchmarkThermometerFall(bus->thermometer);
+
+        *bus->input &= ~bus->mask;
+        if (bus->slot && bus->previousFall)
+            BenchmarkDurationAdd(&bus->slots, now - bus->previousFall);
+        bus->fall = now;
+        bus->previousFall = now;
+        return;
+    }
+
+    long long duration = now - bus->fall;
+    if (bus->thermometer)
+        BenchmarkThermometerRelease(bus->thermometer, duration);
+
+    // a zero sent by the thermometer lasts until the next slot, once the master has sampled it
+    if (!bus->thermometer || !bus->thermometer->hold)
+        *bus->input |= bus->mask;
+    if (!bus->slot)
+        BenchmarkDurationAdd(&bus->resetLows, duration);
+    else if (bus->slotCount < 16)
+        bus->slotLows[bus->slotCount++] = duration;
+}
+
+// Configures the bus on the simulated registers, its pin being driven through a handle.
+static OneWireInfoRef BenchmarkBusCreate(struct BenchmarkBus *bus, GPIOInfoRef *gpioInfo) {
+    *gpioInfo = GPIOInfoAllocWithBackend(GPIOBackendSimulated);
+    GPIOInfoSetSimulatorCallback(*gpioInfo, BenchmarkBusWrite, bus);
+
+    OneWireInfoRef info = OneWireInfoCreate(*gpioInfo, BENCHMARK_PIN);
+    bus->input = GPIOInfoGetPinInput(*gpioInfo, BENCHMARK_PIN, &bus->mask);
+    if (!bus->input || !GPIOInfoGetPinHandle(*gpioInfo, BENCHMARK_PIN)) {
+        fprintf(stderr, "The simulated pin %d is not in register mode\n", BENCHMARK_PIN);
+        OneWireInfoFree(info);
+        GPIOInfoFree(*gpioInfo);
+        return NULL;
+    }
+    bus->index = (int)(bus->input - GPIOInfoGetRegisters(*gpioInfo));
+    *bus->input |= bus->mask;
+
+    return info;
+}
+
+static BOOL BenchmarkOneWire(int count) {
+    struct BenchmarkBus bus = { .input = NULL, .thermometer = NULL };
+
+    GPIOInfoRef gpioInfo;
+    OneWireInfoRef info = BenchmarkBusCreate(&bus, &gpioInfo);
+    if (!info)
+        return FALSE;
+
+    // the low states of the zeros, and of the ones and the reads
+    struct BenchmarkDuration lows[2] = {{0}};
+    int ones = 0;
+    long long start = DelayGetTime();
+    for (int byte = 0 ; byte < count ; byte++) {
+        bus.slot = FALSE;
+        bus.previousFall = 0;
+        OneWireInfoReset(info);
+
+        bus.slot = TRUE;
+        bus.slotCount = 0;
+        OneWireInfoWriteByte(info, (unsigned char)byte);
+        if (OneWireInfoReadByte(info) == 0xFF)
+            ones++;
+
+        for (int slot = 0 ; slot < bus.slotCount ; slot++) {
+            int bit = (slot >= 8 || (byte & (0x1 << slot))) ? 1 : 0;
+            BenchmarkDurationAdd(&lows[bit], bus.slotLows[slot]);
+        }
+    }
+    long long duration = DelayGetTime() - start;
+
+    OneWireInfoFree(info);
+    GPIOInfoFree(gpioInfo);
+
+    printf("1-Wire           minimum     mean  maximum\n");
+    BenchmarkDurationPrint("reset low", &bus.resetLows);
+    BenchmarkDurationPrint("write 0 low", &lows[0]);
+    BenchmarkDurationPrint("write 1/read low", &lows[1]);
+    BenchmarkDurationPrint("slot", &bus.slots);
+    printf("%d transactions of 2 bytes in %.1f ms, %.0f bytes/s\n", count, duration / 1e6,
+           2e9 * count / duration);
+
+    // a preempted thread lengthens the slots, which is reported, but nothing shortens them
+    BOOL passed = TRUE;
+    if (ones != count) {
+        fprintf(stderr, "%d of %d bytes were not read back\n", count - ones, count);
+        passed = FALSE;
+    }
+    if (bus.resetLows.minimum < 480000) {
+        fprintf(stderr, "A reset is shorter than 480 us\n");
+        passed = FALSE;
+    }
+    if (lows[0].minimum < 60000) {
+        fprintf(stderr, "A zero is shorter than 60 us\n");
+        passed = FALSE;
+    }
+    if (lows[1].minimum < 1000) {
+        fprintf(stderr, "A one or a read is shorter than 1 us\n");
+        passed = FALSE;
+    }
+    if (bus.slots.minimum < 61000) {
+        fprintf(stderr, "A slot and its recovery are shorter than 61 us\n");
+        passed = FALSE;
+    }
+
+    return passed;
+}
+
+static BOOL BenchmarkThermometer(int count) {
+    struct BenchmarkThermometer thermometer;
+    BenchmarkThermometerInit(&thermometer);
+    struct BenchmarkBus bus = { .input = NULL, .thermometer = &thermometer };
+
+    GPIOInfoRef gpioInfo;
+    OneWireInfoRef oneWireInfo = BenchmarkBusCreate(&bus, &gpioInfo);
+    if (!oneWireInfo)
+        return FALSE;
+
+    StackRef stack = StackCreate(FALSE);
+    long long start = DelayGetTime();
+    ThermometerInfoList(oneWireInfo, stack);
+    long long listing = DelayGetTime() - start;
+
+    char rom[17];
+    sprintf(rom, "%016llx", (unsigned long long)thermometer.rom);
+
+    ThermometerInfoRef info = (StackLength(stack) == 1) ? StackPeek(stack) : NULL;
+    if (info && (strcmp(ThermometerInfoGetRom(info), rom) != 0 ||
+                 ThermometerInfoGetFamily(info) != ThermometerFamilyDS18B20 ||
+                 ThermometerInfoUsesParasiticPowerMode(info)))
+        info = NULL;
+
+    // the readings whose slots were released too late are read again, which may fail again on a
+    // busy host, but the others may not fail and no value may be wrong
+    int errors = 0;
+    int lateErrors = 0;
+    int wrong = 0;
+    int resets = thermometer.resets;
+    start = DelayGetTime();
+    for (int reading = 0 ; info && reading < count ; reading++) {
+        float value = ThermometerInfoGetTemperature(info);
+        if (value != HUGE_VALF) {
+            if (value != BENCHMARK_TEMPERATURE / 16.f)
+                wrong++;
+            continue;
+        }
+
+        const char *failure = "failed";
+        if (OneWireInfoIsLate(oneWireInfo)) {
+            failure = "failed late";
+            lateErrors++;
+        } else {
+            errors++;
+        }
+
+        if (thermometer.failedLow)
+            fprintf(stderr, "Reading %d %s at the bit %d of the %s, low for %.2f us\n", reading,
+                    failure, thermometer.failedPosition,
+                    BENCHMARK_THERMOMETER_STATES[thermometer.failedState],
+                    thermometer.failedLow / 1e3);
+        else
+            fprintf(stderr, "Reading %d %s in a read slot\n", reading, failure);
+    }
+    long long duration = DelayGetTime() - start;
+    int retries = thermometer.resets - resets - (info ? count : 0);
+
+    while (StackLength(stack) > 0)
+        ThermometerInfoFree(StackPop(stack));
+    StackFree(stack);
+    OneWireInfoFree(oneWireInfo);
+    GPIOInfoFree(gpioInfo);
+
+    if (!info) {
+        fprintf(stderr, "The DS18B20 %s was not listed\n", rom);
+        return FALSE;
+    }
+
+    printf("DS18B20 listed in %.1f ms\n", listing / 1e6);
+    printf("%d readings in %.1f ms, %.1f readings/s, %d errors, %d late, %d read again\n",
+           count, duration / 1e6, 1e9 * count / duration, errors, lateErrors, retries);
+
+    BOOL passed = TRUE;
+    if (wrong) {
+        fprintf(stderr, "%d of %d readings are wrong\n", wrong, count);
+        passed = FALSE;
+    }
+    if (errors > BENCHMARK_READING_ERRORS) {
+        fprintf(stderr, "%d of %d readings failed with their slots in time\n", errors, count);
+        passed = FALSE;
+    }
+    if (lateErrors > BENCHMARK_LATE_READINGS * count) {
+        fprintf(stderr, "%d of %d readings failed with slots released too late\n", lateErrors,
+                count);
+        passed = FALSE;
+    }
+
+    return passed;
+}
+
+static void BenchmarkWrites(int count) {
+    GPIOInfoRef info = GPIOInfoAllocWithBackend(GPIOBackendSimulated);
+    GPIOInfoExport(info, BENCHMARK_PIN);
+    GPIOInfoSetPinMode(info, BENCHMARK_PIN, GPIOPinModeOutput);
+    GPIOPinHandleRef handle = GPIOInfoGetPinHandle(info, BENCHMARK_PIN);
+
+    long long start = DelayGetTime();
+    for (int write = 0 ; write < count ; write++)
+        GPIOInfoSetValue(info, BENCHMARK_PIN, write & 0x1);
+    long long values = DelayGetTime() - start;
+
+    start = DelayGetTime();
+    for (int write = 0 ; write < count ; write++)
+        GPIOPinHandleSetValue(handle, write & 0x1);
+    long long handles = DelayGetTime() - start;
+
+    // the bare store the handles would make without the lock of the register
+    const struct GPIORegisterWord *word = GPIOPinHandleGetWord(handle);
+    uint32_t value = *word->set;
+    start = DelayGetTime();
+    for (int write = 0 ; write < count ; write++)
+        *word->set = value ^ (-(uint32_t)(write & 0x1) & handle->mask);
+    long long stores = DelayGetTime() - start;
+
+    // the open-drain pins are driven through their direction
+    GPIOInfoSetPinMode(info, BENCHMARK_PIN, GPIOPinModeOpenDrain);
+    start = DelayGetTime();
+    for (int write = 0 ; write < count ; write++)
+        GPIOPinHandleSetValue(handle, write & 0x1);
+    long long openDrains = DelayGetTime() - start;
+
+    GPIOInfoSetPinMode(info, BENCHMARK_PIN, GPIOPinModeOutput);
+    start = DelayGetTime();
+    for (int write = 0 ; write < count ; write++)
+        GPIOInfoWriteMask(info, 0x1ull << BENCHMARK_PIN, (uint64_t)(write & 0x1) << BENCHMARK_PIN);
+    long long masks = DelayGetTime() - start;
+
+    GPIOInfoUnexport(info, BENCHMARK_PIN);
+    GPIOInfoFree(info);
+
+    printf("GPIOInfoSetValue       %8.1f ns\n", (double)values / count);
+    printf("GPIOPinHandleSetValue  %8.1f ns\n", (double)handles / count);
+    printf("  without the lock     %8.1f ns\n", (double)stores / count);
+    printf("  on an open-drain pin %8.1f ns\n", (double)openDrains / count);
+    printf("GPIOInfoWriteMask      %8.1f ns\n", (double)masks / count);
+}
+
+int main(int argc, char **argv) {
+    int count = (argc > 1) ? atoi(argv[1]) : BENCHMARK_BYTES;
+    if (count <= 0)
+        count = BENCHMARK_BYTES;
+
+    DelayInitialize();
+
+    BenchmarkWrites(BENCHMARK_WRITES);
+
+    BOOL passed = BenchmarkOneWire(count);
+    if (!BenchmarkThermometer(BENCHMARK_READINGS))
+        passed = FALSE;
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,479 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Reads and changes pins through the GPIO character device, and checks that the group requests
+// used by the masks agree with the pins when the pins are reconfigured, grouped again or
+// unexported.
+//
+// Without the 'GPIO_CDEV_CHIP' variable, the test stands in for a chip whose lines are named like
+// the ones of the Odroid-N2 ("GPIOX_3"): its ioctl and close calls answer the requests of the
+// library, and also check that no line is ever requested twice, or left without a request while
+// its pin is exported. A 'gpio-sim' chip named the same way runs the same steps:
+//
+//     GPIO_CDEV_CHIP=/dev/gpiochip1 ctest --test-dir build -R cdevtest -V
+//
+// The test is skipped when the registers of the board are mapped instead.
+
+#include "common.h"
+#include "gpio.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define CDEV_TEST_SKIPPED 77
+
+// WiringPi pins of both banks, driven as outputs, and the lines of the stand-in chip
+static const int CDEV_TEST_PINS[] = { 0, 2, 3, 7, 12, 13 };
+static const int CDEV_TEST_LINES[] = { 3, 4, 7, 33, 8, 9 };
+#define CDEV_TEST_PIN_COUNT (int)(sizeof(CDEV_TEST_PINS) / sizeof(CDEV_TEST_PINS[0]))
+
+// GPIOX_0 to GPIOX_19, then GPIOA_0 to GPIOA_15
+#define CDEV_TEST_GPIOX_COUNT 20
+#define CDEV_TEST_LINE_COUNT 36
+#define CDEV_TEST_REQUEST_COUNT 64
+
+static int failures = 0;
+
+#define CDEV_TEST_CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        fprintf(stderr, __VA_ARGS__); \
+        fputc('\n', stderr); \
+        failures++; \
+    } \
+} while (0)
+
+static struct CdevTestChip {
+    BOOL enabled;
+
+    struct CdevTestLine {
+        int owner; // the file of the request holding the line, -1 if not requested
+        uint64_t flags;
+        int value;
+    } lines[CDEV_TEST_LINE_COUNT];
+
+    struct CdevTestRequest {
+        int file; // -1 for a free request
+        unsigned int count;
+        uint32_t offsets[GPIO_V2_LINES_MAX];
+    } requests[CDEV_TEST_REQUEST_COUNT];
+
+    // the calls made by the library
+    struct CdevTestCalls {
+        int requests;
+        int closes;
+        int configs;
+        int busy;
+    } calls;
+} chip;
+
+static struct CdevTestRequest *CdevTestFindRequest(int file) {
+    for (int index = 0 ; index < CDEV_TEST_REQUEST_COUNT ; index++) {
+        if (chip.requests[index].file == file)
+            return &chip.requests[index];
+    }
+
+    return NULL;
+}
+
+// the output values missing from the configuration are low, as they are for the kernel
+static void CdevTestApplyConfig(const struct CdevTestRequest *request,
+                                const struct gpio_v2_line_config *config) {
+    for (unsigned int index = 0 ; index < request->count ; index++) {
+        struct CdevTestLine *line = &chip.lines[request->offsets[index]];
+        uint64_t flags = config->flags;
+        int value = 0;
+
+        for (unsigned int attribute = 0 ; attribute < config->num_attrs ; attribute++) {
+            const struct gpio_v2_line_config_attribute *lineAttribute = &config->attrs[attribute];
+            if (!(lineAttribute->mask & (0x1ull << index)))
+                continue;
+
+            if (GPIO_V2_LINE_ATTR_ID_FLAGS == lineAttribute->attr.id)
+                flags = lineAttribute->attr.flags;
+            else if (GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES == lineAttribute->attr.id)
+                value = (lineAttribute->attr.values & (0x1ull << index)) ? 1 : 0;
+        }
+
+        line->flags = flags;
+        if (flags & GPIO_V2_LINE_FLAG_OUTPUT)
+            line->value = value;
+    }
+}
+
+static int CdevTestRequestLines(struct gpio_v2_line_request *lineRequest) {
+    if (!lineRequest->num_lines || lineRequest->num_lines > GPIO_V2_LINES_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (unsigned int index = 0 ; index < lineRequest->num_lines ; index++) {
+        if (lineRequest->offsets[index] >= CDEV_TEST_LINE_COUNT) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        if (chip.lines[lineRequest->offsets[index]].owner != -1) {
+            chip.calls.busy++;
+            errno = EBUSY;
+            return -1;
+        }
+    }
+
+    struct CdevTestRequest *request = CdevTestFindRequest(-1);
+    int file = request ? open("/dev/null", O_RDONLY | O_CLOEXEC) : -1;
+    if (file == -1) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    request->file = file;
+    request->count = lineRequest->num_lines;
+    memcpy(request->offsets, lineRequest->offsets, sizeof(request->offsets));
+
+    for (unsigned int index = 0 ; index < request->count ; index++)
+        chip.lines[request->offsets[index]].owner = file;
+
+    CdevTestApplyConfig(request, &lineRequest->config);
+    lineRequest->fd = file;
+    chip.calls.requests++;
+    return 0;
+}
+
+static int CdevTestSetValues(const struct CdevTestRequest *request,
+                             const struct gpio_v2_line_values *values) {
+    for (unsigned int index = 0 ; index < request->count ; index++) {
+        if ((values->mask & (0x1ull << index)) &&
+            !(chip.lines[request->offsets[index]].flags & GPIO_V2_LINE_FLAG_OUTPUT)) {
+            errno = EPERM;
+            return -1;
+        }
+    }
+
+    for (unsigned int index = 0 ; index < request->count ; index++) {
+        if (values->mask & (0x1ull << index))
+            chip.lines[request->offsets[index]].value = (values->bits & (0x1ull << index)) ? 1 : 0;
+    }
+
+    return 0;
+}
+
+static int CdevTestGetValues(const struct CdevTestRequest *request,
+                             struct gpio_v2_line_values *values) {
+    values->bits = 0x0;
+
+    for (unsigned int index = 0 ; index < request->count ; index++) {
+        if ((values->mask & (0x1ull << index)) && chip.lines[request->offsets[index]].value)
+            values->bits |= (0x1ull << index);
+    }
+
+    return 0;
+}
+
+static int CdevTestGetLineInfo(struct gpio_v2_line_info *lineInfo) {
+    if (lineInfo->offset >= CDEV_TEST_LINE_COUNT) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (lineInfo->offset < CDEV_TEST_GPIOX_COUNT)
+        snprintf(lineInfo->name, sizeof(lineInfo->name), "GPIOX_%u", lineInfo->offset);
+    else
+        snprintf(lineInfo->name, sizeof(lineInfo->name), "GPIOA_%u",
+                 lineInfo->offset - CDEV_TEST_GPIOX_COUNT);
+
+    return 0;
+}
+
+int ioctl(int file, unsigned long command, ...) {
+    va_list arguments;
+    va_start(arguments, command);
+    void *argument = va_arg(arguments, void *);
+    va_end(arguments);
+
+    if (!chip.enabled || _IOC_TYPE(command) != _IOC_TYPE(GPIO_GET_CHIPINFO_IOCTL))
+        return (int)syscall(SYS_ioctl, file, command, argument);
+
+    struct CdevTestRequest *request = CdevTestFindRequest(file);
+
+    switch (command) {
+        case GPIO_GET_CHIPINFO_IOCTL: {
+            struct gpiochip_info *chipInfo = argument;
+            strcpy(chipInfo->name, "gpiochip0");
+            strcpy(chipInfo->label, "periphs-banks");
+            chipInfo->lines = CDEV_TEST_LINE_COUNT;
+            return 0;
+        }
+
+        case GPIO_V2_GET_LINEINFO_IOCTL:
+            return CdevTestGetLineInfo(argument);
+
+        case GPIO_V2_GET_LINE_IOCTL:
+            return CdevTestRequestLines(argument);
+
+        case GPIO_V2_LINE_SET_CONFIG_IOCTL:
+            if (!request)
+                break;
+
+            CdevTestApplyConfig(request, argument);
+            chip.calls.configs++;
+            return 0;
+
+        case GPIO_V2_LINE_SET_VALUES_IOCTL:
+            if (!request)
+                break;
+
+            return CdevTestSetValues(request, argument);
+
+        case GPIO_V2_LINE_GET_VALUES_IOCTL:
+            if (!request)
+                break;
+
+            return CdevTestGetValues(request, argument);
+
+        default:
+            break;
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
+int close(int file) {
+    struct CdevTestRequest *request = (file != -1) ? CdevTestFindRequest(file) : NULL;
+
+    if (request) {
+        for (unsigned int index = 0 ; index < request->count ; index++)
+            chip.lines[request->offsets[index]].owner = -1;
+
+        request->file = -1;
+        chip.calls.closes++;
+    }
+
+    return (int)syscall(SYS_close, file);
+}
+
+static uint64_t CdevTestGetMask(uint32_t pattern) {
+    uint64_t values = 0x0;
+
+    for (int index = 0 ; index < CDEV_TEST_PIN_COUNT ; index++) {
+        if (pattern & (0x1 << index))
+            values |= (0x1ull << CDEV_TEST_PINS[index]);
+    }
+
+    return values;
+}
+
+static void CdevTestCheckValues(GPIOInfoRef info, uint64_t mask, uint64_t values,
+                                const char *step) {
+    uint64_t read = GPIOInfoReadMask(info, mask);
+    CDEV_TEST_CHECK(read == values, "%s: the mask reads 0x%016llx instead of 0x%016llx", step,
+                    (unsigned long long)read, (unsigned long long)values);
+
+    for (int index = 0 ; index < CDEV_TEST_PIN_COUNT ; index++) {
+        int pin = CDEV_TEST_PINS[index];
+        if (!(mask & (0x1ull << pin)))
+            continue;
+
+        int value = (values & (0x1ull << pin)) ? GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW;
+        CDEV_TEST_CHECK(GPIOInfoGetValue(info, pin) == value, "%s: pin %d does not read %d", step,
+                        pin, value);
+
+        if (chip.enabled)
+            CDEV_TEST_CHECK(chip.lines[CDEV_TEST_LINES[index]].value == value,
+                            "%s: the line of pin %d is not at %d", step, pin, value);
+    }
+}
+
+// every line of an exported pin has a single request, which the other lines do not share
+static void CdevTestCheckLines(uint64_t exported, const char *step) {
+    if (!chip.enabled)
+        return;
+
+    int owned = 0;
+    for (int line = 0 ; line < CDEV_TEST_LINE_COUNT ; line++) {
+        if (chip.lines[line].owner != -1)
+            owned++;
+    }
+
+    int expected = 0;
+    for (int index = 0 ; index < CDEV_TEST_PIN_COUNT ; index++) {
+        if (!(exported & (0x1ull << CDEV_TEST_PINS[index])))
+            continue;
+
+        expected++;
+        CDEV_TEST_CHECK(chip.lines[CDEV_TEST_LINES[index]].owner != -1,
+                        "%s: the line of pin %d is not requested", step, CDEV_TEST_PINS[index]);
+    }
+
+    CDEV_TEST_CHECK(owned == expected, "%s: %d lines are requested instead of %d", step, owned,
+                    expected);
+    CDEV_TEST_CHECK(!chip.calls.busy, "%s: %d lines were requested twice", step,
+                    chip.calls.busy);
+}
+
+static void CdevTestCheckCalls(const struct CdevTestCalls *previous, int requests, int closes,
+                               int configs, const char *step) {
+    if (!chip.enabled)
+        return;
+
+    CDEV_TEST_CHECK(chip.calls.requests - previous->requests == requests,
+                    "%s: %d requests instead of %d", step,
+                    chip.calls.requests - previous->requests, requests);
+    CDEV_TEST_CHECK(chip.calls.closes - previous->closes == closes,
+                    "%s: %d requests closed instead of %d", step,
+                    chip.calls.closes - previous->closes, closes);
+    CDEV_TEST_CHECK(chip.calls.configs - previous->configs == configs,
+                    "%s: %d configurations instead of %d", step,
+                    chip.calls.configs - previous->configs, configs);
+}
+
+int main(void) {
+    for (int index = 0 ; index < CDEV_TEST_LINE_COUNT ; index++)
+        chip.lines[index] = (struct CdevTestLine){ .owner = -1, .flags = 0x0, .value = 0 };
+    for (int index = 0 ; index < CDEV_TEST_REQUEST_COUNT ; index++)
+        chip.requests[index].file = -1;
+
+    // any file stands for the chip, whose ioctl calls are answered by the test
+    const char *path = getenv("GPIO_CDEV_CHIP");
+    if (!path || !*path) {
+        chip.enabled = TRUE;
+        setenv("GPIO_CDEV_CHIP", "/dev/null", 1);
+        path = "the stand-in chip";
+    }
+
+    GPIOInfoRef info = GPIOInfoAllocWithBackend(GPIOBackendDevice);
+    if (GPIOInfoGetRegisters(info)) {
+        printf("The registers are mapped instead of %s, skipping\n", path);
+        GPIOInfoFree(info);
+        return CDEV_TEST_SKIPPED;
+    }
+
+    // the first four pins start alone
+    uint64_t mask = CdevTestGetMask(0xf);
+    for (int index = 0 ; index < 4 ; index++) {
+        int pin = CDEV_TEST_PINS[index];
+        GPIOInfoExport(info, pin);
+        GPIOInfoSetPinMode(info, pin, GPIOPinModeOutput);
+
+        if (GPIOInfoGetValue(info, pin) < 0) {
+            fprintf(stderr, "The line of pin %d can not be requested from %s\n", pin, path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    CdevTestCheckLines(mask, "export");
+
+    // the first mask moves the lines to a group
+    struct CdevTestCalls calls = chip.calls;
+    for (uint32_t pattern = 0 ; pattern < 0x10 ; pattern++) {
+        GPIOInfoWriteMask(info, mask, CdevTestGetMask(pattern));
+        CdevTestCheckValues(info, mask, CdevTestGetMask(pattern), "mask");
+    }
+
+    CdevTestCheckCalls(&calls, 1, 4, 0, "mask");
+    CdevTestCheckLines(mask, "mask");
+
+    // a single pin is changed through the group
+    uint64_t values = CdevTestGetMask(0x5);
+    GPIOInfoWriteMask(info, mask, values);
+    GPIOInfoSetValue(info, CDEV_TEST_PINS[1], GPIO_PIN_VALUE_HIGH);
+    values |= (0x1ull << CDEV_TEST_PINS[1]);
+    CdevTestCheckValues(info, mask, values, "value");
+
+    // the group is reconfigured in place, and keeps the values of its lines
+    calls = chip.calls;
+    GPIOInfoSetPinMode(info, CDEV_TEST_PINS[2], GPIOPinModeOpenDrain);
+    values |= (0x1ull << CDEV_TEST_PINS[2]);
+    GPIOInfoSetPinPull(info, CDEV_TEST_PINS[0], GPIOPinPullUp);
+    CdevTestCheckCalls(&calls, 0, 0, 2, "mode");
+    CdevTestCheckLines(mask, "mode");
+    CdevTestCheckValues(info, mask, values, "mode");
+
+    if (chip.enabled) {
+        CDEV_TEST_CHECK(chip.lines[CDEV_TEST_LINES[2]].flags & GPIO_V2_LINE_FLAG_OPEN_DRAIN,
+                        "mode: the line of pin %d is not open-drain", CDEV_TEST_PINS[2]);
+        CDEV_TEST_CHECK(chip.lines[CDEV_TEST_LINES[0]].flags & GPIO_V2_LINE_FLAG_BIAS_PULL_UP,
+                        "mode: the line of pin %d is not pulled up", CDEV_TEST_PINS[0]);
+        CDEV_TEST_CHECK(!(chip.lines[CDEV_TEST_LINES[1]].flags &
+                          (GPIO_V2_LINE_FLAG_OPEN_DRAIN | GPIO_V2_LINE_FLAG_BIAS_PULL_UP)),
+                        "mode: the line of pin %d changed with the other ones",
+                        CDEV_TEST_PINS[1]);
+    }
+
+    // the lines reached later form a second group, the first one keeping its request
+    int group = chip.lines[CDEV_TEST_LINES[0]].owner;
+    for (int index = 4 ; index < CDEV_TEST_PIN_COUNT ; index++) {
+        GPIOInfoExport(info, CDEV_TEST_PINS[index]);
+        GPIOInfoSetPinMode(info, CDEV_TEST_PINS[index], GPIOPinModeOutput);
+    }
+
+    mask = CdevTestGetMask(0x3f);
+    values = CdevTestGetMask(0x2a);
+    calls = chip.calls;
+    GPIOInfoWriteMask(info, mask, values);
+    CdevTestCheckCalls(&calls, 1, 2, 0, "growth");
+    CdevTestCheckLines(mask, "growth");
+    CdevTestCheckValues(info, mask, values, "growth");
+
+    if (chip.enabled)
+        CDEV_TEST_CHECK(chip.lines[CDEV_TEST_LINES[0]].owner == group,
+                        "growth: the first group was requested again");
+
+    // a line reporting edges leaves its group, whose other lines get their own requests back
+    calls = chip.calls;
+    GPIOInfoSetPinMode(info, CDEV_TEST_PINS[3], GPIOPinModeInput);
+    CdevTestCheckCalls(&calls, 0, 0, 1, "edge");
+
+    CDEV_TEST_CHECK(GPIOInfoSetPinEdge(info, CDEV_TEST_PINS[3], GPIOEdgeRising),
+                    "edge: the edge of pin %d can not be set", CDEV_TEST_PINS[3]);
+    CdevTestCheckLines(mask, "edge");
+
+    if (chip.enabled) {
+        CdevTestCheckCalls(&calls, 4, 1, 2, "edge");
+        CDEV_TEST_CHECK(chip.lines[CDEV_TEST_LINES[3]].flags & GPIO_V2_LINE_FLAG_EDGE_RISING,
+                        "edge: the line of pin %d does not report rising edges",
+                        CDEV_TEST_PINS[3]);
+    }
+
+    mask &= ~(0x1ull << CDEV_TEST_PINS[3]);
+    values &= mask;
+    CdevTestCheckValues(info, mask, values, "edge");
+
+    // the lines left after an unexport keep their values
+    GPIOInfoUnexport(info, CDEV_TEST_PINS[4]);
+    mask &= ~(0x1ull << CDEV_TEST_PINS[4]);
+    values &= mask;
+    CDEV_TEST_CHECK(GPIOInfoGetValue(info, CDEV_TEST_PINS[4]) < 0,
+                    "unexport: pin %d still reads a value", CDEV_TEST_PINS[4]);
+    CdevTestCheckLines(mask | (0x1ull << CDEV_TEST_PINS[3]), "unexport");
+    CdevTestCheckValues(info, mask, values, "unexport");
+
+    GPIOInfoWriteMask(info, mask, ~values & mask);
+    CdevTestCheckValues(info, mask, ~values & mask, "unexport");
+
+    GPIOInfoUnexportAll(info);
+    CdevTestCheckLines(0x0, "unexport all");
+    GPIOInfoFree(info);
+
+    printf("%d failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,35 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The subset of the NDK logging API used by the library, printed on the standard error of the host.
+
+#ifndef GPIO_HOST_ANDROID_LOG_H
+#define GPIO_HOST_ANDROID_LOG_H
+
+typedef enum android_LogPriority {
+    ANDROID_LOG_UNKNOWN = 0,
+    ANDROID_LOG_DEFAULT,
+    ANDROID_LOG_VERBOSE,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR,
+    ANDROID_LOG_FATAL,
+    ANDROID_LOG_SILENT
+} android_LogPriority;
+
+int __android_log_print(int priority, const char *tag, const char *format, ...)
+        __attribute__((format(printf, 3, 4)));
+
+#endif //GPIO_HOST_ANDROID_LOG_H
@@ -0,0 +1,24 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The subset of the bionic system properties API used by the library: a host has no property.
+
+#ifndef GPIO_HOST_SYSTEM_PROPERTIES_H
+#define GPIO_HOST_SYSTEM_PROPERTIES_H
+
+#define PROP_VALUE_MAX 92
+
+int __system_property_get(const char *name, char *value);
+
+#endif //GPIO_HOST_SYSTEM_PROPERTIES_H
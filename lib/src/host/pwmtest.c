@@ -0,0 +1,139 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Drives the PWM_C channel of GPIOX_5 (WiringPi 23) on the simulated registers and checks the
+// words written to the PWM and GPIO blocks: the duty cycle and misc words of the channel, the mux
+// of the pin, and the switch back to the GPIO function for the constant levels and the stop.
+
+#include "common.h"
+#include "gpio.h"
+#include "pwm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PWM_TEST_PIN 23
+
+// PWM_CD block, PWM_C being its first channel
+#define PWM_TEST_BLOCK (0x1000 / 4)
+#define PWM_TEST_DUTY_CYCLE (PWM_TEST_BLOCK + 0)
+#define PWM_TEST_MISC (PWM_TEST_BLOCK + 2)
+
+#define PWM_TEST_MISC_ENABLE 0x1
+#define PWM_TEST_MISC_CLOCK_SELECT (0x3 << 4)
+#define PWM_TEST_MISC_CLOCK_DIVIDER (0x7F << 8)
+#define PWM_TEST_MISC_CLOCK_ENABLE (0x1 << 15)
+
+// PERIPHS_PIN_MUX_3 holds the functions of GPIOX_0 to GPIOX_7, one nibble each
+#define PWM_TEST_MUX 435
+#define PWM_TEST_MUX_SHIFT 20
+#define PWM_TEST_FUNCTION 4
+
+static int failures = 0;
+
+#define PWM_TEST_CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        fprintf(stderr, __VA_ARGS__); \
+        fputc('\n', stderr); \
+        failures++; \
+    } \
+} while (0)
+
+static int PwmTestGetFunction(GPIOInfoRef gpioInfo) {
+    return (int)(GPIOInfoGetRegisters(gpioInfo)[PWM_TEST_MUX] >> PWM_TEST_MUX_SHIFT) & 0xF;
+}
+
+static int PwmTestGetOutput(GPIOInfoRef gpioInfo, BOOL *output) {
+    uint32_t mask;
+    volatile uint32_t *input = GPIOInfoGetPinInput(gpioInfo, PWM_TEST_PIN, &mask);
+
+    // the direction and output words of a bank of the Odroid-N2 precede its input word
+    *output = (input[-2] & mask) ? FALSE : TRUE;
+    return (input[-1] & mask) ? GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW;
+}
+
+static void PwmTestCheckGPIO(GPIOInfoRef gpioInfo, volatile uint32_t *registers, int value,
+                             const char *step) {
+    BOOL output;
+    int level = PwmTestGetOutput(gpioInfo, &output);
+
+    PWM_TEST_CHECK(PwmTestGetFunction(gpioInfo) == 0,
+                   "%s: the mux selects function %d instead of the GPIO", step,
+                   PwmTestGetFunction(gpioInfo));
+    PWM_TEST_CHECK(output && level == value, "%s: the pin is not a %s output", step,
+                   value ? "high" : "low");
+    PWM_TEST_CHECK(!(registers[PWM_TEST_MISC] & (PWM_TEST_MISC_ENABLE |
+                                                 PWM_TEST_MISC_CLOCK_ENABLE)),
+                   "%s: the channel is still enabled (misc 0x%08x)", step,
+                   registers[PWM_TEST_MISC]);
+}
+
+static void PwmTestCheckChannel(GPIOInfoRef gpioInfo, volatile uint32_t *registers,
+                                uint32_t duty, const char *step) {
+    uint32_t misc = registers[PWM_TEST_MISC];
+
+    PWM_TEST_CHECK(registers[PWM_TEST_DUTY_CYCLE] == duty,
+                   "%s: the duty cycle word is 0x%08x instead of 0x%08x", step,
+                   registers[PWM_TEST_DUTY_CYCLE], duty);
+    PWM_TEST_CHECK(misc & PWM_TEST_MISC_ENABLE, "%s: the channel is not enabled", step);
+    PWM_TEST_CHECK(misc & PWM_TEST_MISC_CLOCK_ENABLE, "%s: the clock is not enabled", step);
+    PWM_TEST_CHECK(!(misc & PWM_TEST_MISC_CLOCK_SELECT), "%s: the crystal is not selected", step);
+    PWM_TEST_CHECK(!(misc & PWM_TEST_MISC_CLOCK_DIVIDER), "%s: the clock is divided", step);
+    PWM_TEST_CHECK(PwmTestGetFunction(gpioInfo) == PWM_TEST_FUNCTION,
+                   "%s: the mux selects function %d instead of %d", step,
+                   PwmTestGetFunction(gpioInfo), PWM_TEST_FUNCTION);
+}
+
+int main(void) {
+    GPIOInfoRef gpioInfo = GPIOInfoAllocWithBackend(GPIOBackendSimulated);
+    GPIOInfoExport(gpioInfo, PWM_TEST_PIN);
+    GPIOInfoSetPinMode(gpioInfo, PWM_TEST_PIN, GPIOPinModeOutput);
+
+    if (!GPIOInfoGetPinInput(gpioInfo, PWM_TEST_PIN, NULL)) {
+        fprintf(stderr, "The simulated pin %d is not in register mode\n", PWM_TEST_PIN);
+        return EXIT_FAILURE;
+    }
+
+    PwmInfoRef info = PwmInfoCreate(gpioInfo);
+    if (!info) {
+        fprintf(stderr, "The simulated PWM registers can not be mapped\n");
+        return EXIT_FAILURE;
+    }
+
+    volatile uint32_t *registers = PwmInfoGetRegisters(info);
+
+    // 1 ms at 24 MHz is 24000 ticks without dividing the clock, 6000 of them high
+    PWM_TEST_CHECK(PwmInfoSet(info, PWM_TEST_PIN, 1000000, 250000), "25%%: the signal is refused");
+    PwmTestCheckChannel(gpioInfo, registers, (6000 - 1) << 16 | (18000 - 1), "25%");
+
+    PWM_TEST_CHECK(PwmInfoSet(info, PWM_TEST_PIN, 1000000, 0), "0%%: the signal is refused");
+    PwmTestCheckGPIO(gpioInfo, registers, GPIO_PIN_VALUE_LOW, "0%");
+
+    PWM_TEST_CHECK(PwmInfoSet(info, PWM_TEST_PIN, 1000000, 250000), "25%%: the signal is refused");
+    PWM_TEST_CHECK(PwmInfoSet(info, PWM_TEST_PIN, 1000000, 1000000),
+                   "100%%: the signal is refused");
+    PwmTestCheckGPIO(gpioInfo, registers, GPIO_PIN_VALUE_HIGH, "100%");
+
+    PWM_TEST_CHECK(PwmInfoSet(info, PWM_TEST_PIN, 1000000, 250000), "25%%: the signal is refused");
+    PwmTestCheckChannel(gpioInfo, registers, (6000 - 1) << 16 | (18000 - 1), "25% again");
+    PwmInfoStop(info, PWM_TEST_PIN);
+    PwmTestCheckGPIO(gpioInfo, registers, GPIO_PIN_VALUE_LOW, "stop");
+
+    PwmInfoFree(info);
+    GPIOInfoUnexportAll(gpioInfo);
+    GPIOInfoFree(gpioInfo);
+
+    printf("%d failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Changes pins of the same register word from many threads at once, through each of the write
+// paths of the library, on the simulated registers. Each thread checks after each write that the
+// bit of its pin holds the value it wrote: a read-modify-write of the word racing with another
+// one would lose it.
+
+#include "common.h"
+#include "gpio.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STRESS_WRITES 200000
+
+// WiringPi pins of the same bank, whose outputs share one register word
+static const int STRESS_PINS[] = { 0, 2, 3, 4, 5, 6, 12, 13 };
+#define STRESS_THREADS (int)(sizeof(STRESS_PINS) / sizeof(STRESS_PINS[0]))
+
+typedef enum {
+    StressPathValue,
+    StressPathHandle,
+    StressPathMask
+} StressPath;
+
+struct StressThread {
+    GPIOInfoRef info;
+    int pin;
+    StressPath path;
+    int writes;
+    int lost;
+    pthread_t thread;
+};
+
+static void *StressRun(void *argument) {
+    struct StressThread *thread = argument;
+    GPIOPinHandleRef handle = GPIOInfoGetPinHandle(thread->info, thread->pin);
+
+    uint32_t mask;
+    volatile uint32_t *input = GPIOInfoGetPinInput(thread->info, thread->pin, &mask);
+    // the output word of a bank of the Odroid-N2 precedes its input word
+    volatile uint32_t *output = input - 1;
+
+    for (int write = 0 ; write < thread->writes ; write++) {
+        int value = write & 0x1;
+
+        switch (thread->path) {
+            case StressPathHandle:
+                GPIOPinHandleSetValue(handle, value);
+                break;
+
+            case StressPathMask:
+                GPIOInfoWriteMask(thread->info, 0x1ull << thread->pin,
+                                  (uint64_t)value << thread->pin);
+                break;
+
+            default:
+                GPIOInfoSetValue(thread->info, thread->pin, value);
+                break;
+        }
+
+        if (((*output & mask) ? 1 : 0) != value)
+            thread->lost++;
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    int writes = (argc > 1) ? atoi(argv[1]) : STRESS_WRITES;
+    if (writes <= 0)
+        writes = STRESS_WRITES;
+
+    GPIOInfoRef info = GPIOInfoAllocWithBackend(GPIOBackendSimulated);
+    struct StressThread threads[STRESS_THREADS];
+
+    for (int index = 0 ; index < STRESS_THREADS ; index++) {
+        int pin = STRESS_PINS[index];
+        GPIOInfoExport(info, pin);
+        GPIOInfoSetPinMode(info, pin, GPIOPinModeOutput);
+
+        threads[index] = (struct StressThread){
+            .info = info,
+            .pin = pin,
+            .path = (StressPath)(index % 3),
+            .writes = writes
+        };
+
+        if (!GPIOInfoGetPinInput(info, pin, NULL) || !GPIOInfoGetPinHandle(info, pin)) {
+            fprintf(stderr, "The simulated pin %d is not in register mode\n", pin);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (int index = 0 ; index < STRESS_THREADS ; index++)
+        pthread_create(&threads[index].thread, NULL, StressRun, &threads[index]);
+
+    int lost = 0;
+    for (int index = 0 ; index < STRESS_THREADS ; index++) {
+        pthread_join(threads[index].thread, NULL);
+        lost += threads[index].lost;
+    }
+
+    GPIOInfoUnexportAll(info);
+    GPIOInfoFree(info);
+
+    printf("%d threads, %d writes each, %d lost\n", STRESS_THREADS, writes, lost);
+    return lost ? EXIT_FAILURE : EXIT_SUCCESS;
+}
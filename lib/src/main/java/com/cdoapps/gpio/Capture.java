@@ -0,0 +1,178 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.cdoapps.gpio;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+/**
+ * The {@code Capture} class samples input pins of a {@code GPIO} instance from a native thread,
+ * like a logic analyzer, and stores their transitions in a ring buffer shared with Java.
+ *
+ * The pins must be exported in register mode ('mmap'). Each record of the buffer is
+ * {@code RECORD_SIZE} bytes long: the delay in nanoseconds since the previous record, followed by
+ * the values of the pins (bit {@code n} is WiringPi pin {@code n}), both as unsigned 32-bit ints in
+ * native byte order. A record is only written when the values change, or when the delay would not
+ * fit in 32 bits.
+ *
+ * The positions are byte counts since the start of the capture which never wrap; the record at
+ * position {@code p} is at index {@code p % getBuffer().capacity()} of the buffer.
+ */
+public class Capture {
+    static {
+        System.loadLibrary("gpio");
+    }
+
+    /**
+     * The size in bytes of one record.
+     */
+    public static final int RECORD_SIZE = 8;
+
+    private long mReserved;
+    private ByteBuffer mBuffer;
+    private long mReadPosition;
+    private long mTime;
+
+    Capture() {
+    }
+
+    /**
+     * Starts the sampler thread.
+     *
+     * @param gpio the {@code GPIO} instance of the pins.
+     * @param mask the WiringPi addresses of the pins to sample, as a bit mask.
+     * @param rateHz the sampling rate, or {@code 0} to sample as fast as possible.
+     * @param bufferBytes the size of the ring buffer, rounded down to a multiple of
+     *                    {@code RECORD_SIZE}.
+     * @return the ring buffer, or {@code null} on error.
+     */
+    native ByteBuffer start(GPIO gpio, long mask, int rateHz, int bufferBytes);
+
+    boolean open(GPIO gpio, long mask, int rateHz, int bufferBytes) {
+        ByteBuffer buffer = start(gpio, mask, rateHz, bufferBytes);
+        if (buffer == null)
+            return false;
+
+        mBuffer = buffer.order(ByteOrder.nativeOrder());
+        mReadPosition = 0;
+        mTime = getStartTime();
+        return true;
+    }
+
+    /**
+     * Stops the sampler thread and frees the ring buffer. The buffer must not be used afterwards.
+     */
+    public void stop() {
+        nativeStop();
+        mBuffer = null;
+    }
+
+    private native void nativeStop();
+
+    /**
+     * Returns the ring buffer filled by the sampler thread, without copy.
+     *
+     * @return the ring buffer in native byte order.
+     */
+    public ByteBuffer getBuffer() {
+        return mBuffer;
+    }
+
+    /**
+     * Returns the time at which the sampling started.
+     *
+     * @return the time in nanoseconds of {@code CLOCK_MONOTONIC}, the first delay being relative to
+     *         it.
+     */
+    public native long getStartTime();
+
+    /**
+     * Returns the position following the last record written by the sampler thread.
+     *
+     * @return a position in bytes since the start of the capture.
+     */
+    public native long getWritePosition();
+
+    /**
+     * Returns the position following the last record released by {@code release} or
+     * {@code drain}.
+     *
+     * @return a position in bytes since the start of the capture.
+     */
+    public long getReadPosition() {
+        return mReadPosition;
+    }
+
+    /**
+     * Gives back the records before a position to the sampler thread, which may then overwrite
+     * them.
+     *
+     * @param position a position in bytes since the start of the capture, between the read and
+     *                 the write positions.
+     */
+    public void release(long position) {
+        mReadPosition = position;
+        setReadPosition(position);
+    }
+
+    private native void setReadPosition(long position);
+
+    /**
+     * Returns the number of transitions lost because the ring buffer was full. The values of the
+     * pins are still recorded once space is available.
+     *
+     * @return the number of records which could not be written.
+     */
+    public native long getOverruns();
+
+    /**
+     * The {@code Listener} interface receives the records decoded by {@code drain}.
+     */
+    public interface Listener {
+        /**
+         * Called for each record.
+         *
+         * @param timestamp the time of the sample in nanoseconds of {@code CLOCK_MONOTONIC}.
+         * @param values the values of the pins, bit {@code n} being WiringPi pin {@code n}.
+         */
+        void onSample(long timestamp, int values);
+    }
+
+    /**
+     * Decodes the records written since the last call, then releases them.
+     *
+     * {@code drain} and {@code release} must not be mixed, as the absolute timestamps are only
+     * tracked by {@code drain}.
+     *
+     * @param listener the listener receiving the records, oldest first.
+     * @return the number of records decoded.
+     */
+    public int drain(Listener listener) {
+        long writePosition = getWritePosition();
+        int capacity = mBuffer.capacity();
+        int count = 0;
+
+        for (long position = mReadPosition ; position < writePosition ;
+             position += RECORD_SIZE) {
+            int index = (int)(position % capacity);
+            mTime += mBuffer.getInt(index) & 0xFFFFFFFFL;
+            listener.onSample(mTime, mBuffer.getInt(index + 4));
+            count++;
+        }
+
+        release(writePosition);
+        return count;
+    }
+}
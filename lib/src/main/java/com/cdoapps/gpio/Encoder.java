@@ -0,0 +1,179 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.cdoapps.gpio;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+import dalvik.annotation.optimization.CriticalNative;
+import dalvik.annotation.optimization.FastNative;
+
+/**
+ * The {@code Encoder} class decodes quadrature encoders wired to pairs of input pins of a
+ * {@code GPIO} instance, from a native thread sampling the input registers.
+ *
+ * The counts live in a block of native memory. Each encoder has {@code COUNTERS_SIZE} bytes: a
+ * sequence number, then its position, its error count and the time of its last transition as
+ * 64-bit values. The getters read them natively, with the memory barriers which a
+ * {@code ByteBuffer} does not provide. Each of them reads a single counter, while
+ * {@code getCounts} reads all the counters of an encoder at once.
+ *
+ * The reads stay native at every API level: the fences of {@code VarHandle} need API 33, and
+ * the dexer refuses its calls in a library supporting API 16, even behind a version check.
+ */
+public class Encoder {
+    static {
+        System.loadLibrary("gpio");
+    }
+
+    /**
+     * The maximum number of encoders of one {@code Encoder} instance.
+     */
+    public static final int MAXIMUM_COUNT = 16;
+    /**
+     * The size in bytes of the counters of one encoder.
+     */
+    public static final int COUNTERS_SIZE = 32;
+
+    private static final int POSITION_OFFSET = 8;
+    private static final int ERRORS_OFFSET = 16;
+    private static final int TIMESTAMP_OFFSET = 24;
+
+    private long mReserved;
+    private ByteBuffer mCounters;
+    private final long[] mValues = new long[3];
+
+    private native ByteBuffer start(GPIO gpio, int[] pins, int rateHz, int cpu, int priority);
+
+    private native void nativeStop();
+
+    /**
+     * Starts decoding encoders. The pins must be exported in register mode ('mmap') and
+     * configured as inputs.
+     *
+     * @param gpio the {@code GPIO} instance of the pins.
+     * @param pins the WiringPi addresses of the A and B pins of each encoder, A first.
+     * @param rateHz the sampling rate, or {@code 0} to sample as fast as possible.
+     * @param cpu the index of the CPU running the thread, {@code Realtime.CPU_ISOLATED}, or
+     *            {@code -1} to let the scheduler choose.
+     * @param priority the {@code SCHED_FIFO} priority of the thread, or {@code 0} to use the
+     *                 default policy.
+     * @return {@code true} on success.
+     */
+    public boolean configure(GPIO gpio, int[] pins, int rateHz, int cpu, int priority) {
+        ByteBuffer counters = start(gpio, pins, rateHz, cpu, priority);
+        mCounters = (counters != null) ? counters.order(ByteOrder.nativeOrder()) : null;
+
+        return mCounters != null;
+    }
+
+    /**
+     * Stops decoding and frees the resources which were associated to the encoders.
+     */
+    public void destroy() {
+        nativeStop();
+        mCounters = null;
+    }
+
+    // a single critical call, the seqlock read of the block being done natively
+    private long readCounter(int encoder, int offset) {
+        return nativeReadCounter(mReserved, encoder, offset);
+    }
+
+    /**
+     * Returns the position of one encoder.
+     *
+     * @param encoder the index of the encoder, in the order of the pins.
+     * @return the number of steps forward (A leading B) minus the number of steps backward.
+     */
+    public long getPosition(int encoder) {
+        return readCounter(encoder, POSITION_OFFSET);
+    }
+    /**
+     * Returns the number of invalid transitions of one encoder, where both A and B changed
+     * between two samples, which means that the sampling rate is too low.
+     *
+     * @param encoder the index of the encoder, in the order of the pins.
+     * @return the number of invalid transitions.
+     */
+    public long getErrors(int encoder) {
+        return readCounter(encoder, ERRORS_OFFSET);
+    }
+    /**
+     * Returns the time of the last transition of one encoder.
+     *
+     * @param encoder the index of the encoder, in the order of the pins.
+     * @return the time in nanoseconds of {@code CLOCK_MONOTONIC}, or {@code 0} if the encoder did
+     *         not move.
+     */
+    public long getTimestamp(int encoder) {
+        return readCounter(encoder, TIMESTAMP_OFFSET);
+    }
+
+    /**
+     * The {@code Counts} class holds the counters of one encoder, read at once so that they are
+     * consistent with each other.
+     */
+    public static class Counts {
+        /**
+         * The number of steps forward (A leading B) minus the number of steps backward.
+         */
+        public final long position;
+        /**
+         * The number of invalid transitions, where both A and B changed between two samples.
+         */
+        public final long errors;
+        /**
+         * The time in nanoseconds of {@code CLOCK_MONOTONIC} of the last transition, or {@code 0}
+         * if the encoder did not move.
+         */
+        public final long timestamp;
+
+        Counts(long[] values) {
+            position = values[0];
+            errors = values[1];
+            timestamp = values[2];
+        }
+    }
+
+    /**
+     * Returns the counters of one encoder, all of them being read between the same two
+     * transitions.
+     *
+     * @param encoder the index of the encoder, in the order of the pins.
+     * @return the counters of the encoder.
+     */
+    public synchronized Counts getCounts(int encoder) {
+        nativeReadCounters(mReserved, encoder, mValues);
+        return new Counts(mValues);
+    }
+
+    /**
+     * Returns the counter block shared with the native thread, without copy. The native thread
+     * makes the sequence number of an encoder odd while it changes its counters, and the plain
+     * reads of a {@code ByteBuffer} are not ordered, thus the getters of this class should be
+     * preferred.
+     *
+     * @return the counters of the encoders in native byte order.
+     */
+    public ByteBuffer getCounters() {
+        return mCounters;
+    }
+
+    @CriticalNative
+    private static native long nativeReadCounter(long info, int encoder, int offset);
+    @FastNative
+    private static native void nativeReadCounters(long info, int encoder, long[] values);
+}
@@ -14,6 +14,8 @@
 
 package com.cdoapps.gpio;
 
+import dalvik.annotation.optimization.CriticalNative;
+
 /**
  * The {@code GPIO} class provides control over Odroid-N2 gpio pins.
  *
@@ -36,17 +38,64 @@ public class GPIO {
     }
 
     private long mReserved;
+    private final EdgeThread[] mEdgeThreads = new EdgeThread[64];
+    private final Pin[] mPins = new Pin[64];
+
     private GPIO() {
     }
 
     /**
      * Initializes the {@code GPIO} instance.
+     *
+     * An instance which was not paused is paused first, thus its {@code Pin} objects and edge
+     * listeners are released like with {@code onPause}.
      */
-    public native void onResume();
+    public void onResume() {
+        onPause();
+
+        synchronized (this) {
+            nativeResume();
+        }
+    }
     /**
      * Terminates the {@code GPIO} instance and free the resources which were associated to it.
+     *
+     * The engines created from this instance (e.g. {@code SoftPwm}, {@code Capture} or
+     * {@code OneWire}) keep using the pins until they are destroyed, thus the resources are only
+     * freed once the last of them is destroyed, and once the {@code Pin} objects handed out are
+     * garbage collected. The edge listeners are removed.
      */
-    public native void onPause();
+    public void onPause() {
+        // the threads wait for the edges through the native instance, which is about to be freed,
+        // and their listeners may call back into this instance, thus they are detached under the
+        // monitor but joined outside of it, until none is left
+        EdgeThread[] threads = new EdgeThread[mEdgeThreads.length];
+        while (true) {
+            int count = 0;
+            synchronized (this) {
+                for (int pin = 0 ; pin < mEdgeThreads.length ; pin++) {
+                    if (mEdgeThreads[pin] != null) {
+                        threads[count++] = mEdgeThreads[pin];
+                        mEdgeThreads[pin] = null;
+                    }
+                }
+
+                if (count == 0) {
+                    for (int pin = 0 ; pin < mPins.length ; pin++)
+                        invalidatePin(pin);
+
+                    nativePause();
+                    return;
+                }
+            }
+
+            for (int index = 0 ; index < count ; index++)
+                threads[index].quit();
+        }
+    }
+
+    private native void nativeResume();
+    private native void nativePause();
 
     /**
      * Creates the interface with one pin.
@@ -59,11 +108,24 @@ public class GPIO {
      *
      * @param pin the WiringPi address of the pin to unexport.
      */
-    public native void unexport(int pin);
+    public synchronized void unexport(int pin) {
+        if (pin >= 0 && pin < mPins.length)
+            invalidatePin(pin);
+
+        nativeUnexport(pin);
+    }
     /**
      * Destroys all the interfaces previously bound to one pin.
      */
-    public native void unexportAll();
+    public synchronized void unexportAll() {
+        for (int pin = 0 ; pin < mPins.length ; pin++)
+            invalidatePin(pin);
+
+        nativeUnexportAll();
+    }
+
+    private native void nativeUnexport(int pin);
+    private native void nativeUnexportAll();
 
     /**
      * Checks how the software interfaces with GPIO pins.
@@ -79,6 +141,32 @@ public class GPIO {
      */
     public native void setUsesLegacyLibrary(boolean legacy);
 
+    /**
+     * Checks whether a shadow copy of the registers is used.
+     *
+     * @return {@code true} if the output, direction, pull and mux registers are shadowed.
+     */
+    public native boolean usesShadowRegisters();
+
+    /**
+     * Sets whether a shadow copy of the registers is used ('mmap' only).
+     *
+     * With a shadow copy, changing one pin does not read the uncached registers first, and writes
+     * which would not change anything are skipped. While it is used, {@code getPin} returns
+     * {@code null}. Since the {@code Pin} objects and the engines driving pins directly (e.g.
+     * {@code OneWire}) would bypass it, it can not be enabled until their pins are unexported.
+     *
+     * @param shadow if {@code true}, will use a shadow copy of the registers.
+     * @return {@code true} on success.
+     */
+    public native boolean setUsesShadowRegisters(boolean shadow);
+
+    /**
+     * Reloads the shadow copy of the registers. This must be called after another process changed
+     * the pins.
+     */
+    public native void syncShadowRegisters();
+
     /**
      * One may call {@code setMode} with this value to use one pin as an input.
      */
@@ -96,6 +184,31 @@ public class GPIO {
      */
     public native void setMode(int pin, String mode);
 
+    /**
+     * One may call {@code setMode} with this value to use one pin as an input.
+     */
+    public static final int PIN_MODE_INPUT = 0;
+    /**
+     * One may call {@code setMode} with this value to use one pin as an output.
+     */
+    public static final int PIN_MODE_OUTPUT = 1;
+    /**
+     * One may call {@code setMode} with this value to use one pin as an open-drain output: a
+     * {@code VALUE_LOW} drives the line low, a {@code VALUE_HIGH} releases it.
+     */
+    public static final int PIN_MODE_OPEN_DRAIN = 2;
+
+    /**
+     * Changes the communication mode of one pin.
+     *
+     * Unlike {@code setMode(int, String)}, this does not convert any string on each call.
+     *
+     * @param pin the WiringPi address of the pin.
+     * @param mode should be either {@code PIN_MODE_INPUT}, {@code PIN_MODE_OUTPUT} or
+     *             {@code PIN_MODE_OPEN_DRAIN}.
+     */
+    public native void setMode(int pin, int mode);
+
     /**
      * One may call {@code setPullState} with this value to use one input pin with an internal pull
      * down resistor.
@@ -119,6 +232,32 @@ public class GPIO {
      */
     public native void setPullState(int pin, String state);
 
+    /**
+     * One may call {@code setPullState} with this value to use one input pin with a floating state.
+     */
+    public static final int PIN_PULL_OFF = 0;
+    /**
+     * One may call {@code setPullState} with this value to use one input pin with an internal pull
+     * down resistor.
+     */
+    public static final int PIN_PULL_DOWN = 1;
+    /**
+     * One may call {@code setPullState} with this value to use one input pin with an internal pull
+     * up resistor.
+     */
+    public static final int PIN_PULL_UP = 2;
+
+    /**
+     * Changes the internal resistor state of one pin.
+     *
+     * Unlike {@code setPullState(int, String)}, this does not convert any string on each call.
+     *
+     * @param pin the WiringPi address of the pin.
+     * @param state should be either {@code PIN_PULL_DOWN}, {@code PIN_PULL_UP} or
+     *              {@code PIN_PULL_OFF}.
+     */
+    public native void setPullState(int pin, int state);
+
     /**
      * The value returned for a pin connected to GND.
      */
@@ -134,12 +273,373 @@ public class GPIO {
      * @param pin the WiringPi address of the pin.
      * @param value should be either {@code VALUE_LOW} or {@code VALUE_HIGH}.
      */
-    public native void setValue(int pin, int value);
+    public void setValue(int pin, int value) {
+        nativeSetValue(mReserved, pin, value);
+    }
     /**
      * Returns the value of one pin.
      *
      * @param pin the WiringPi address of the pin.
      * @return the value of {@code pin}
      */
-    public native int getValue(int pin);
+    public int getValue(int pin) {
+        return nativeGetValue(mReserved, pin);
+    }
+
+    /**
+     * Changes the values of many pins at once.
+     *
+     * The pins sharing the same register word are updated with a single access, thus they switch
+     * in the same cycle. With the GPIO character device, the lines are changed with a single
+     * ioctl.
+     *
+     * @param mask a bit mask of the WiringPi addresses of the pins to change.
+     * @param values a bit mask of the new values, bit {@code n} being the value of pin {@code n}.
+     */
+    public void writePins(long mask, long values) {
+        nativeWritePins(mReserved, mask, values);
+    }
+    /**
+     * Returns the values of many pins at once.
+     *
+     * @param mask a bit mask of the WiringPi addresses of the pins to read.
+     * @return a bit mask of the values, bit {@code n} being the value of pin {@code n}.
+     */
+    public long readPins(long mask) {
+        return nativeReadPins(mReserved, mask);
+    }
+
+    // the character device, 'sysfs' and a contended register lock may block, thus these natives
+    // leave the runtime free to suspend the thread for the garbage collector
+    private static native void nativeSetValue(long info, int pin, int value);
+    private static native int nativeGetValue(long info, int pin);
+    private static native void nativeWritePins(long info, long mask, long values);
+    private static native long nativeReadPins(long info, long mask);
+
+    /**
+     * One may call {@code setEdge} with this value to stop reporting the transitions of one pin.
+     */
+    public static final int EDGE_NONE = 0;
+    /**
+     * One may call {@code setEdge} with this value to report the transitions of one pin from
+     * {@code VALUE_LOW} to {@code VALUE_HIGH}.
+     */
+    public static final int EDGE_RISING = 1;
+    /**
+     * One may call {@code setEdge} with this value to report the transitions of one pin from
+     * {@code VALUE_HIGH} to {@code VALUE_LOW}.
+     */
+    public static final int EDGE_FALLING = 2;
+    /**
+     * One may call {@code setEdge} with this value to report all the transitions of one pin.
+     */
+    public static final int EDGE_BOTH = 3;
+
+    /**
+     * Changes the transitions of one input pin which are reported.
+     *
+     * Edges are detected by the kernel, thus they are not available when the registers are
+     * accessed directly ('mmap'), see {@code setUsesLegacyLibrary}.
+     *
+     * @param pin the WiringPi address of the pin.
+     * @param edge should be either {@code EDGE_NONE}, {@code EDGE_RISING}, {@code EDGE_FALLING}
+     *             or {@code EDGE_BOTH}.
+     * @return {@code true} on success.
+     */
+    public native boolean setEdge(int pin, int edge);
+
+    /**
+     * Blocks until one input pin changes, without polling its value.
+     *
+     * @param pin the WiringPi address of the pin.
+     * @param edge should be either {@code EDGE_RISING}, {@code EDGE_FALLING} or
+     *             {@code EDGE_BOTH}.
+     * @param timeoutNs the maximum time to wait in nanoseconds, or a negative value to wait
+     *                  forever.
+     * @return the time of the transition in nanoseconds, on the time base of
+     *         {@code System.nanoTime} ({@code CLOCK_MONOTONIC}), or {@code -1} on timeout or
+     *         error.
+     */
+    public native long waitForEdge(int pin, int edge, long timeoutNs);
+
+    /**
+     * Blocks until one input pin reports transitions, then returns as many of them as possible.
+     *
+     * {@code setEdge} must have been called first. The edges must not be changed while a thread
+     * is waiting.
+     *
+     * @param pin the WiringPi address of the pin.
+     * @param timestamps receives the times of the transitions in nanoseconds of
+     *                   {@code CLOCK_MONOTONIC}, oldest first.
+     * @param values receives the values of the pin after each transition.
+     * @param timeoutNs the maximum time to wait in nanoseconds, or a negative value to wait
+     *                  forever.
+     * @return the number of transitions returned, {@code 0} on timeout or {@code -1} on error.
+     */
+    public native int waitForEdges(int pin, long[] timestamps, int[] values, long timeoutNs);
+
+    /**
+     * The {@code EdgeListener} interface is notified of the transitions of one input pin.
+     */
+    public interface EdgeListener {
+        /**
+         * Called on a background thread for each transition of one pin.
+         *
+         * @param pin the WiringPi address of the pin.
+         * @param value the value of the pin after the transition.
+         * @param timestamp the time of the transition in nanoseconds of {@code CLOCK_MONOTONIC}.
+         */
+        void onEdge(int pin, int value, long timestamp);
+    }
+
+    private static final long EDGE_LISTENER_TIMEOUT_NS = 100000000L;
+    private static final int EDGE_LISTENER_BATCH_SIZE = 16;
+
+    private class EdgeThread extends Thread {
+        private final int mPin;
+        private final EdgeListener mListener;
+        private volatile boolean mRunning = true;
+
+        EdgeThread(int pin, EdgeListener listener) {
+            super("GPIO edges " + pin);
+            mPin = pin;
+            mListener = listener;
+        }
+
+        @Override
+        public void run() {
+            long[] timestamps = new long[EDGE_LISTENER_BATCH_SIZE];
+            int[] values = new int[EDGE_LISTENER_BATCH_SIZE];
+
+            // the wait is bounded so that the thread notices when it is stopped
+            while (mRunning) {
+                int count = waitForEdges(mPin, timestamps, values, EDGE_LISTENER_TIMEOUT_NS);
+                if (count < 0)
+                    break;
+
+                for (int index = 0 ; index < count && mRunning ; index++)
+                    mListener.onEdge(mPin, values[index], timestamps[index]);
+            }
+        }
+
+        void quit() {
+            mRunning = false;
+
+            boolean interrupted = false;
+            while (isAlive() && Thread.currentThread() != this) {
+                try {
+                    join();
+                } catch (InterruptedException e) {
+                    interrupted = true;
+                }
+            }
+
+            if (interrupted)
+                Thread.currentThread().interrupt();
+        }
+    }
+
+    /**
+     * Notifies a listener of the transitions of one input pin, from a background thread which
+     * blocks until the kernel reports them.
+     *
+     * The listener must be removed before the pin is unexported. It is removed when the
+     * {@code GPIO} instance is paused.
+     *
+     * @param pin the WiringPi address of the pin.
+     * @param edge should be either {@code EDGE_RISING}, {@code EDGE_FALLING} or
+     *             {@code EDGE_BOTH}.
+     * @param listener the listener to notify, or {@code null} to remove the current one.
+     * @return {@code true} on success.
+     */
+    public boolean setEdgeListener(int pin, int edge, EdgeListener listener) {
+        if (pin < 0 || pin >= mEdgeThreads.length)
+            return false;
+
+        while (true) {
+            EdgeThread previous;
+            synchronized (this) {
+                previous = mEdgeThreads[pin];
+                if (previous == null) {
+                    if (listener == null || edge == EDGE_NONE)
+                        return setEdge(pin, EDGE_NONE);
+
+                    if (!setEdge(pin, edge))
+                        return false;
+
+                    mEdgeThreads[pin] = new EdgeThread(pin, listener);
+                    mEdgeThreads[pin].start();
+                    return true;
+                }
+
+                mEdgeThreads[pin] = null;
+            }
+
+            // the listener may call back into this instance, thus the thread is joined outside of
+            // the monitor
+            previous.quit();
+        }
+    }
+
+    /**
+     * Starts sampling input pins from a native thread into a ring buffer, like a logic analyzer.
+     *
+     * The pins must be exported in register mode ('mmap') and configured as inputs.
+     *
+     * @param mask the WiringPi addresses of the pins to sample, as a bit mask.
+     * @param rateHz the sampling rate, or {@code 0} to sample as fast as possible.
+     * @param bufferBytes the size of the ring buffer in bytes.
+     * @return the running {@code Capture}, or {@code null} if none of the pins can be sampled.
+     */
+    public Capture startCapture(long mask, int rateHz, int bufferBytes) {
+        Capture capture = new Capture();
+        if (!capture.open(this, mask, rateHz, bufferBytes))
+            return null;
+
+        return capture;
+    }
+
+    /**
+     * Notifies a listener of the debounced changes of input pins exported in register mode
+     * ('mmap'), polled by a native thread instead of calling {@code getValue} from Java.
+     *
+     * @param mask the WiringPi addresses of the pins to watch, as a bit mask.
+     * @param rateHz the polling rate.
+     * @param debounceNs the duration in nanoseconds during which a new value must be stable before
+     *                   it is reported, or {@code 0} to report every change.
+     * @param listener the listener notified on a background thread.
+     * @return the running {@code Watcher}, or {@code null} if none of the pins can be watched.
+     */
+    public Watcher watch(long mask, int rateHz, long debounceNs, Watcher.Listener listener) {
+        Watcher watcher = new Watcher();
+        if (!watcher.open(this, mask, rateHz, debounceNs, listener))
+            return null;
+
+        return watcher;
+    }
+
+    /**
+     * The edges of a measured pin are timestamped by polling its input register, which requires
+     * the register mode ('mmap').
+     */
+    public static final int MEASURE_MODE_POLLING = 0;
+    /**
+     * The edges of a measured pin are reported by the kernel, which requires the legacy library
+     * or the GPIO character device. The pin must not have an edge set with {@code setEdge} or an
+     * edge listener.
+     */
+    public static final int MEASURE_MODE_EDGES = 1;
+
+    private static final int MEASURE_POLLING_RATE = 20000;
+
+    /**
+     * Starts measuring the signal of one input pin.
+     *
+     * @param pin the WiringPi address of the pin.
+     * @param mode should be either {@code MEASURE_MODE_POLLING} or {@code MEASURE_MODE_EDGES}.
+     * @return the running {@code Measurement}, or {@code null} if {@code mode} is not available
+     *         for {@code pin}.
+     */
+    public Measurement measure(int pin, int mode) {
+        return measure(pin, mode, MEASURE_POLLING_RATE);
+    }
+
+    /**
+     * Starts measuring the signal of one input pin.
+     *
+     * @param pin the WiringPi address of the pin.
+     * @param mode should be either {@code MEASURE_MODE_POLLING} or {@code MEASURE_MODE_EDGES}.
+     * @param rateHz the polling rate with {@code MEASURE_MODE_POLLING}, which bounds the
+     *               resolution of the measures.
+     * @return the running {@code Measurement}, or {@code null} if {@code mode} is not available
+     *         for {@code pin}.
+     */
+    public Measurement measure(int pin, int mode, int rateHz) {
+        Measurement measurement = new Measurement();
+        if (!measurement.start(this, pin, mode, rateHz))
+            return null;
+
+        return measurement;
+    }
+
+    /**
+     * The {@code Pin} class gives a direct access to one pin exported in register mode ('mmap'),
+     * without any lookup on each call.
+     *
+     * A {@code Pin} object does nothing once its pin has been unexported or the {@code GPIO}
+     * instance has been paused: its value reads as {@code -1}.
+     */
+    public static class Pin {
+        private volatile long mReserved;
+        // the native instance holding the handle, retained until this object is collected so
+        // that the calls in flight when the pin is invalidated never reach freed memory
+        private final long mInfo;
+
+        private Pin(long info) {
+            mInfo = info;
+        }
+
+        @Override
+        protected void finalize() throws Throwable {
+            try {
+                nativeRelease(mInfo);
+            } finally {
+                super.finalize();
+            }
+        }
+
+        /**
+         * Changes the value of this pin.
+         *
+         * @param value should be either {@code VALUE_LOW} or {@code VALUE_HIGH}.
+         */
+        public void setValue(int value) {
+            nativeSetValue(mReserved, value);
+        }
+        /**
+         * Returns the value of this pin.
+         *
+         * @return the value of this pin.
+         */
+        public int getValue() {
+            return nativeGetValue(mReserved);
+        }
+
+        // a value is changed under the lock of its register word, which may sleep, while it is read
+        // with a single load which never blocks
+        private static native void nativeSetValue(long handle, int value);
+        @CriticalNative
+        private static native int nativeGetValue(long handle);
+        private static native void nativeRelease(long info);
+    }
+
+    /**
+     * Returns a {@code Pin} object giving a direct access to one exported pin. The same object is
+     * returned until the pin is unexported.
+     *
+     * @param pin the WiringPi address of the pin.
+     * @return a {@code Pin} object, or {@code null} if {@code pin} is not exported in register
+     *         mode or if the registers are shadowed.
+     */
+    public synchronized Pin getPin(int pin) {
+        if (pin < 0 || pin >= mPins.length)
+            return null;
+
+        if (mPins[pin] == null)
+            mPins[pin] = nativeGetPin(pin);
+
+        return mPins[pin];
+    }
+
+    // the handle of a Pin points into the native instance, thus it is cleared before the pin is
+    // unexported or the instance is released, the calls already in flight completing on the
+    // instance retained by the Pin
+    private void invalidatePin(int pin) {
+        if (mPins[pin] != null) {
+            mPins[pin].mReserved = 0;
+            mPins[pin] = null;
+        }
+    }
+
+    private native Pin nativeGetPin(int pin);
 }
@@ -0,0 +1,147 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.cdoapps.gpio;
+
+/**
+ * The {@code I2C} class represents an I2C bus mastered over two pins of a {@code GPIO} instance,
+ * SDA and SCL, which need not be wired to a hardware I2C controller.
+ *
+ * Both pins are driven as open-drain outputs, thus the bus needs pull-up resistors. The pins
+ * should be exported in register mode ('mmap') to reach the standard (100 kHz) and fast (400 kHz)
+ * modes. Whole transactions run natively, and clock stretching by the slaves is honored.
+ *
+ * This implementation of the I2C bus uses bit banging and spinning, thus it may produce high CPU
+ * load.
+ *
+ * Specification:
+ * <a href="https://www.nxp.com/docs/en/user-guide/UM10204.pdf">I2C-bus specification</a>
+ */
+public class I2C {
+    static {
+        System.loadLibrary("gpio");
+    }
+
+    private long mReserved;
+
+    /**
+     * The value returned when all the bytes were transferred.
+     */
+    public static final int STATUS_OK = 0;
+    /**
+     * The value returned when SDA was held low before the transfer and could not be released.
+     */
+    public static final int STATUS_BUSY = 1;
+    /**
+     * The value returned when no slave acknowledged the address.
+     */
+    public static final int STATUS_ADDRESS_NACK = 2;
+    /**
+     * The value returned when the slave did not acknowledge one of the written bytes.
+     */
+    public static final int STATUS_DATA_NACK = 3;
+    /**
+     * The value returned when a slave stretched the clock for more than 25 ms.
+     */
+    public static final int STATUS_TIMEOUT = 4;
+
+    /**
+     * Initializes the I2C communications over two pins.
+     *
+     * @param gpio a {@code GPIO} instance used to initialize and communicate with the I2C bus.
+     * @param sdaPin the WiringPi address of the pin which will be exported for the data line.
+     * @param sclPin the WiringPi address of the pin which will be exported for the clock line.
+     * @param frequencyHz the target frequency of the clock, usually {@code 100000} or
+     *                    {@code 400000}.
+     */
+    public native void configure(GPIO gpio, int sdaPin, int sclPin, int frequencyHz);
+    /**
+     * Terminates the communications with this I2C bus and free the resources which were
+     * associated to it.
+     */
+    public native void destroy();
+
+    /**
+     * Sets the real-time session entered by the calling thread during each transfer, so that the
+     * clock is not stretched by preemptions. Each change which is not permitted is skipped.
+     *
+     * @param cpu the index of the CPU running the transfers, {@code Realtime.CPU_ISOLATED}, or
+     *            {@code -1} to keep the affinity of the thread.
+     * @param priority the {@code SCHED_FIFO} priority from 1 to 99, or {@code 0} to keep the
+     *                 policy of the thread.
+     * @param lockMemory if {@code true}, the memory of the process is locked, which is costly for
+     *                   short transfers.
+     * @param holdLatency if {@code true}, the CPUs are kept out of deep idle states.
+     */
+    public native void setRealtime(int cpu, int priority, boolean lockMemory, boolean holdLatency);
+
+    /**
+     * Writes bytes to one slave, then reads bytes from it after a repeated start, in a single
+     * transaction.
+     *
+     * @param address the 7-bit address of the slave.
+     * @param write the bytes to write, or {@code null} to only read.
+     * @param read receives the bytes read, or {@code null} to only write.
+     * @return {@code STATUS_OK} on success, otherwise either {@code STATUS_BUSY},
+     *         {@code STATUS_ADDRESS_NACK}, {@code STATUS_DATA_NACK} or {@code STATUS_TIMEOUT}.
+     */
+    public native int transfer(int address, byte[] write, byte[] read);
+
+    /**
+     * Writes bytes to one slave.
+     *
+     * @param address the 7-bit address of the slave.
+     * @param write the bytes to write.
+     * @return {@code STATUS_OK} on success.
+     */
+    public int write(int address, byte[] write) {
+        return transfer(address, write, null);
+    }
+    /**
+     * Reads bytes from one slave.
+     *
+     * @param address the 7-bit address of the slave.
+     * @param read receives the bytes read.
+     * @return {@code STATUS_OK} on success.
+     */
+    public int read(int address, byte[] read) {
+        return transfer(address, null, read);
+    }
+    /**
+     * Reads consecutive registers of one slave.
+     *
+     * @param address the 7-bit address of the slave.
+     * @param register the address of the first register.
+     * @param read receives the values of the registers.
+     * @return {@code STATUS_OK} on success.
+     */
+    public int readRegisters(int address, int register, byte[] read) {
+        return transfer(address, new byte[] { (byte)register }, read);
+    }
+
+    /**
+     * Returns the frequency achieved by the clock during the last transfer, including the start
+     * and stop conditions.
+     *
+     * @return the average frequency of the clock in Hz, or {@code 0} if nothing was transferred.
+     */
+    public native double getFrequency();
+    /**
+     * Returns the number of clock pulses which were stretched by the slaves since the bus was
+     * configured.
+     *
+     * @return the number of clock pulses which were stretched.
+     */
+    public native long getStretchCount();
+}
@@ -0,0 +1,96 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.cdoapps.gpio;
+
+/**
+ * The {@code Measurement} class measures the period, pulse width, frequency and duty cycle of the
+ * signal of one input pin, from a native thread timestamping its edges.
+ *
+ * A period starts with a rising edge, and its pulse width is the duration of its high state. The
+ * periods are aggregated over a sliding window when the statistics are requested.
+ */
+public class Measurement {
+    static {
+        System.loadLibrary("gpio");
+    }
+
+    private long mReserved;
+    private final long[] mValues = new long[7];
+
+    Measurement() {
+    }
+
+    native boolean start(GPIO gpio, int pin, int mode, int rateHz);
+
+    /**
+     * Stops the measurement. It must be called before the pin is unexported or the {@code GPIO}
+     * instance is paused.
+     */
+    public native void stop();
+
+    private native void nativeGetStatistics(long windowNs, long[] values);
+
+    /**
+     * The {@code Statistics} class aggregates the periods which ended within a window. The
+     * durations are in nanoseconds, and all the values are {@code 0} when {@code count} is
+     * {@code 0}.
+     */
+    public static class Statistics {
+        public final int count;
+
+        public final long minimumPeriod;
+        public final long maximumPeriod;
+        public final long meanPeriod;
+
+        public final long minimumWidth;
+        public final long maximumWidth;
+        public final long meanWidth;
+
+        /**
+         * The mean frequency in Hz.
+         */
+        public final double frequency;
+        /**
+         * The ratio of the high state over all the periods, between {@code 0} and {@code 1}.
+         */
+        public final double dutyCycle;
+
+        Statistics(long[] values) {
+            count = (int)values[0];
+            minimumPeriod = values[1];
+            maximumPeriod = values[2];
+            minimumWidth = values[4];
+            maximumWidth = values[5];
+
+            long periodSum = values[3];
+            long widthSum = values[6];
+            meanPeriod = (count > 0) ? periodSum / count : 0;
+            meanWidth = (count > 0) ? widthSum / count : 0;
+            frequency = (periodSum > 0) ? 1e9 * count / periodSum : 0;
+            dutyCycle = (periodSum > 0) ? (double)widthSum / periodSum : 0;
+        }
+    }
+
+    /**
+     * Aggregates the periods of the signal which ended recently.
+     *
+     * @param windowNs the duration in nanoseconds of the window, ending now.
+     * @return the statistics of the periods of the window.
+     */
+    public synchronized Statistics getStatistics(long windowNs) {
+        nativeGetStatistics(windowNs, mValues);
+        return new Statistics(mValues);
+    }
+}
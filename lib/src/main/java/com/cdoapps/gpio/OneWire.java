@@ -54,36 +54,78 @@ public class OneWire {
      */
     public native void destroy();
 
+    /**
+     * Sets the real-time session entered by the calling thread during each transaction, so that it
+     * is not preempted in the middle of a slot. Each change which is not permitted is skipped.
+     *
+     * @param cpu the index of the CPU running the transactions, {@code Realtime.CPU_ISOLATED}, or
+     *            {@code -1} to keep the affinity of the thread.
+     * @param priority the {@code SCHED_FIFO} priority from 1 to 99, or {@code 0} to keep the
+     *                 policy of the thread.
+     * @param lockMemory if {@code true}, the memory of the process is locked, which is costly for
+     *                   short transactions.
+     * @param holdLatency if {@code true}, the CPUs are kept out of deep idle states.
+     */
+    public native void setRealtime(int cpu, int priority, boolean lockMemory, boolean holdLatency);
+
+    /**
+     * Marks the start of a time critical transaction, e.g. from a reset to the last slot, which
+     * enters the real-time session set by {@code setRealtime}. Transactions may be nested, and
+     * must end on the thread which started them.
+     */
+    public native void beginTransaction();
+    /**
+     * Marks the end of a transaction started by {@code beginTransaction}, restoring the thread
+     * once the outermost transaction is over.
+     */
+    public native void endTransaction();
+
     /**
      * Resets the 1-Wire bus slave devices and gets them ready for a command.
      *
      * @return {@code true} on success.
      */
-    public native boolean reset();
+    public boolean reset() {
+        return nativeReset(mReserved);
+    }
 
     /**
      * Sends one bit to the 1-Wire slaves.
      *
      * @param bit if {@code true}, will send '1', otherwise will send '0'.
      */
-    public native void writeBit(boolean bit);
+    public void writeBit(boolean bit) {
+        nativeWriteBit(mReserved, bit);
+    }
     /**
      * Transmits a byte of data to the 1-Wire slaves.
      *
      * @param value the data which is sent to the slave devices.
      */
-    public native void writeByte(byte value);
+    public void writeByte(byte value) {
+        nativeWriteByte(mReserved, value);
+    }
 
     /**
      * Reads one bit from the 1-Wire slaves.
      *
      * @return {@code true} if '1' was read, otherwise {@code false}.
      */
-    public native boolean readBit();
+    public boolean readBit() {
+        return nativeReadBit(mReserved);
+    }
     /**
      * Reads a complete byte from the slave devices.
      *
      * @return the data which was read from the slave devices.
      */
-    public native byte readByte();
+    public byte readByte() {
+        return nativeReadByte(mReserved);
+    }
+
+    private static native boolean nativeReset(long info);
+    private static native void nativeWriteBit(long info, boolean bit);
+    private static native void nativeWriteByte(long info, byte value);
+    private static native boolean nativeReadBit(long info);
+    private static native byte nativeReadByte(long info);
 }
@@ -0,0 +1,92 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.cdoapps.gpio;
+
+/**
+ * The {@code ParallelBus} class represents a parallel bus of up to 16 data pins sharing one
+ * register word of a {@code GPIO} instance exported in register mode ('mmap'), plus a strobe
+ * pulsed after each value and an optional latch pulsed after each block, e.g. the E line of a
+ * character LCD or the WR and LDAC lines of a parallel DAC.
+ *
+ * Each value is written with a single store of the data word, whatever the order of the pins.
+ */
+public class ParallelBus {
+    static {
+        System.loadLibrary("gpio");
+    }
+
+    private long mReserved;
+
+    /**
+     * Initializes the parallel bus.
+     *
+     * @param gpio a {@code GPIO} instance used to initialize and drive the bus.
+     * @param dataPins the WiringPi addresses of up to 16 pins sharing a register word (e.g. pins
+     *                 0 to 7), the pin at index {@code n} carrying the bit {@code n} of each
+     *                 value.
+     * @param strobePin the WiringPi address of the strobe pin.
+     * @param latchPin the WiringPi address of the latch pin, or {@code -1}.
+     * @param activeHigh if {@code true}, the strobe and latch pulses are high, otherwise they are
+     *                   low.
+     * @return {@code true} on success, {@code false} if one of the pins is not available in
+     *         register mode or if the data pins do not share a register word.
+     */
+    public native boolean configure(GPIO gpio, int[] dataPins, int strobePin, int latchPin,
+                                    boolean activeHigh);
+    /**
+     * Terminates the bus and free the resources which were associated to it.
+     */
+    public native void destroy();
+
+    /**
+     * Changes the durations around each strobe pulse. They default to 200 ns, 500 ns and 100 ns.
+     *
+     * @param setupNs the duration from the data change to the strobe assertion.
+     * @param pulseNs the width of the strobe and latch pulses.
+     * @param holdNs the duration from the strobe release to the next data change, which also
+     *               leaves the device time to process each value.
+     */
+    public native void setTimings(long setupNs, long pulseNs, long holdNs);
+
+    /**
+     * Writes a block of bytes, strobing each of them, then pulses the latch.
+     *
+     * @param values the bytes to write, the bits above the width of the bus being ignored.
+     */
+    public void writeBlock(byte[] values) {
+        nativeWriteBytes(values, 0, values.length);
+    }
+    /**
+     * Writes a part of a block of bytes, strobing each of them, then pulses the latch.
+     *
+     * @param values the bytes to write, the bits above the width of the bus being ignored.
+     * @param offset the index of the first byte to write.
+     * @param count the number of bytes to write.
+     */
+    public void writeBlock(byte[] values, int offset, int count) {
+        nativeWriteBytes(values, offset, count);
+    }
+    /**
+     * Writes a block of values wider than a byte, strobing each of them, then pulses the latch.
+     *
+     * @param values the values to write, the bits above the width of the bus being ignored.
+     */
+    public void writeBlock(short[] values) {
+        nativeWriteWords(values, 0, values.length);
+    }
+
+    private native void nativeWriteBytes(byte[] values, int offset, int count);
+    private native void nativeWriteWords(short[] values, int offset, int count);
+}
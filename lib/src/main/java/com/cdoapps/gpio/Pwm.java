@@ -0,0 +1,86 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.cdoapps.gpio;
+
+/**
+ * The {@code Pwm} class provides control over the hardware PWM controllers of the Odroid-N2, which
+ * generate the signals without any CPU load.
+ *
+ * Only WiringPi pins 1, 3, 23 and 24 can be routed to a PWM channel; the other pins can use
+ * {@code SoftPwm}. The registers are mapped from '/dev/mem', thus root access is required on the
+ * device.
+ */
+public class Pwm {
+    static {
+        System.loadLibrary("gpio");
+    }
+
+    private long mReserved;
+
+    /**
+     * Maps the registers of the PWM controllers.
+     *
+     * @param gpio the {@code GPIO} instance of the pins, whose backend is also used for the PWM
+     *             registers.
+     */
+    public native void configure(GPIO gpio);
+    /**
+     * Stops the channels which were started and frees the resources which were associated to the
+     * PWM controllers.
+     */
+    public native void destroy();
+
+    /**
+     * Checks whether one pin can be routed to a hardware PWM channel.
+     *
+     * @param pin the WiringPi address of the pin.
+     * @return {@code true} if {@code pin} has a PWM function.
+     */
+    public static native boolean isSupported(int pin);
+
+    /**
+     * Generates a signal on one pin, which must be exported in register mode ('mmap').
+     *
+     * @param pin the WiringPi address of the pin.
+     * @param periodNs the period of the signal in nanoseconds, from 84 ns to about 349 ms.
+     * @param highNs the duration of the high state in each period in nanoseconds.
+     * @return {@code true} on success.
+     */
+    public native boolean set(int pin, long periodNs, long highNs);
+
+    /**
+     * Generates a signal on one pin, which must be exported in register mode ('mmap').
+     *
+     * @param pin the WiringPi address of the pin.
+     * @param frequency the frequency of the signal in Hz.
+     * @param dutyCycle the ratio of the high state in each period, between {@code 0} and
+     *                  {@code 1}.
+     * @return {@code true} on success.
+     */
+    public boolean set(int pin, double frequency, double dutyCycle) {
+        if (frequency <= 0)
+            return false;
+
+        long periodNs = Math.round(1e9 / frequency);
+        return set(pin, periodNs, Math.round(periodNs * dutyCycle));
+    }
+
+    /**
+     * Stops the signal of one pin, which is switched back to a low GPIO output.
+     *
+     * @param pin the WiringPi address of the pin.
+     */
+    public native void stop(int pin);
+}
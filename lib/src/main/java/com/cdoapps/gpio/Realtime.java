@@ -0,0 +1,36 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.cdoapps.gpio;
+
+/**
+ * The {@code Realtime} class holds the values shared by the engines which run time critical code
+ * in a real-time session: pinned to one CPU, with the {@code SCHED_FIFO} policy, the memory of the
+ * process locked and the CPUs kept out of deep idle states.
+ *
+ * Each of these changes requires privileges, e.g. the {@code CAP_SYS_NICE} and
+ * {@code CAP_IPC_LOCK} capabilities or root access. Without them, the change is skipped and a
+ * warning is logged once.
+ */
+public final class Realtime {
+    /**
+     * One may use this value as a CPU index to pin the thread to the first CPU isolated from the
+     * scheduler ({@code isolcpus}), or else to the last CPU it may run on, which is a big core on
+     * the Odroid-N2.
+     */
+    public static final int CPU_ISOLATED = -2;
+
+    private Realtime() {
+    }
+}
@@ -0,0 +1,118 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.cdoapps.gpio;
+
+import java.nio.ByteBuffer;
+
+/**
+ * The {@code SPI} class represents an SPI bus mastered over pins of a {@code GPIO} instance
+ * exported in register mode ('mmap'): SCLK, one to four data output lanes (MOSI), an optional MISO
+ * and an optional CS.
+ *
+ * With two or four output lanes (dual or quad output), each clock cycle shifts out several bits
+ * with a single store, thus the lanes must share one register word (e.g. WiringPi pins 0 to 7).
+ * Such a bus is write only: MISO requires a single lane.
+ *
+ * This implementation of the SPI bus uses bit banging and spinning, thus it may produce high CPU
+ * load.
+ */
+public class SPI {
+    static {
+        System.loadLibrary("gpio");
+    }
+
+    private long mReserved;
+
+    /**
+     * The clock idles low and the data is sampled on its rising edges.
+     */
+    public static final int MODE_0 = 0;
+    /**
+     * The clock idles low and the data is sampled on its falling edges.
+     */
+    public static final int MODE_1 = 1;
+    /**
+     * The clock idles high and the data is sampled on its falling edges.
+     */
+    public static final int MODE_2 = 2;
+    /**
+     * The clock idles high and the data is sampled on its rising edges.
+     */
+    public static final int MODE_3 = 3;
+
+    /**
+     * Initializes the SPI communications.
+     *
+     * @param gpio a {@code GPIO} instance used to initialize and communicate with the SPI bus.
+     * @param clockPin the WiringPi address of the pin which will be exported for SCLK.
+     * @param dataPins the WiringPi addresses of the 1, 2 or 4 pins which will be exported for the
+     *                 output lanes, the lane {@code n} shifting out the bit {@code n} of each
+     *                 group of bits.
+     * @param inputPin the WiringPi address of the pin which will be exported for MISO, or
+     *                 {@code -1}.
+     * @param selectPin the WiringPi address of the pin which will be exported for the active low
+     *                  CS, or {@code -1}.
+     * @param mode should be either {@code MODE_0}, {@code MODE_1}, {@code MODE_2} or
+     *             {@code MODE_3}.
+     * @param frequencyHz the target frequency of the clock, or {@code 0} to run as fast as
+     *                    possible.
+     * @return {@code true} on success, {@code false} if one of the pins is not available in
+     *         register mode, if the lanes do not share a register word or if there are several
+     *         lanes and a MISO.
+     */
+    public native boolean configure(GPIO gpio, int clockPin, int[] dataPins, int inputPin,
+                                    int selectPin, int mode, int frequencyHz);
+    /**
+     * Terminates the communications with this SPI bus and free the resources which were
+     * associated to it.
+     */
+    public native void destroy();
+
+    /**
+     * Shifts out a block of bytes, most significant bit first, while shifting in as many bytes.
+     * CS is asserted during the whole block.
+     *
+     * The positions of the buffers are advanced by {@code count} on success.
+     *
+     * @param write a direct buffer holding the bytes to write from its position, or {@code null}
+     *              to write zeros.
+     * @param read a direct buffer receiving the bytes read at its position, or {@code null}.
+     * @param count the number of bytes to transfer.
+     * @return {@code true} on success, {@code false} if a buffer is not direct or too small, or if
+     *         {@code read} is set while the bus has no MISO.
+     */
+    public boolean transfer(ByteBuffer write, ByteBuffer read, int count) {
+        int writeOffset = (write != null) ? write.position() : 0;
+        int readOffset = (read != null) ? read.position() : 0;
+        if (!nativeTransfer(write, writeOffset, read, readOffset, count))
+            return false;
+
+        if (write != null)
+            write.position(writeOffset + count);
+        if (read != null)
+            read.position(readOffset + count);
+        return true;
+    }
+
+    /**
+     * Returns the frequency achieved by the clock during the last transfer.
+     *
+     * @return the average frequency of the clock in Hz, or {@code 0} if nothing was transferred.
+     */
+    public native double getFrequency();
+
+    private native boolean nativeTransfer(ByteBuffer write, int writeOffset, ByteBuffer read,
+                                          int readOffset, int count);
+}
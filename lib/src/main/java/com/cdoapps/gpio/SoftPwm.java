@@ -0,0 +1,116 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.cdoapps.gpio;
+
+import dalvik.annotation.optimization.CriticalNative;
+
+/**
+ * The {@code SoftPwm} class generates software PWM on many output pins of a {@code GPIO} instance
+ * from a single native thread.
+ *
+ * The edges of the channels are scheduled by deadline, and the edges which fall together are
+ * written at once. The signals can be changed from any thread without any lock, a new signal
+ * starting with the next period of its channel.
+ */
+public class SoftPwm {
+    static {
+        System.loadLibrary("gpio");
+    }
+
+    /**
+     * The longest supported period in nanoseconds.
+     */
+    public static final long MAXIMUM_PERIOD_NS = 0xFFFFFFFFL;
+
+    private long mReserved;
+
+    /**
+     * Starts the thread generating the signals, without any channel.
+     *
+     * @param gpio a {@code GPIO} instance used to change the pins.
+     * @param cpu the index of the CPU running the thread, {@code Realtime.CPU_ISOLATED}, or
+     *            {@code -1} to let the scheduler choose.
+     * @param priority the {@code SCHED_FIFO} priority of the thread, or {@code 0} to use the
+     *                 default policy.
+     */
+    public void configure(GPIO gpio, int cpu, int priority) {
+        configure(gpio, cpu, priority, false, false);
+    }
+    /**
+     * Starts the thread generating the signals, without any channel.
+     *
+     * @param gpio a {@code GPIO} instance used to change the pins.
+     * @param cpu the index of the CPU running the thread, {@code Realtime.CPU_ISOLATED}, or
+     *            {@code -1} to let the scheduler choose.
+     * @param priority the {@code SCHED_FIFO} priority of the thread, or {@code 0} to use the
+     *                 default policy.
+     * @param lockMemory if {@code true}, locks the memory of the process while the thread runs, so
+     *                   that no page fault delays an edge.
+     * @param holdLatency if {@code true}, holds {@code /dev/cpu_dma_latency} at {@code 0} while
+     *                    the thread runs.
+     */
+    public native void configure(GPIO gpio, int cpu, int priority, boolean lockMemory,
+                                 boolean holdLatency);
+    /**
+     * Stops the thread, drives the channels low and frees the resources which were associated to
+     * it.
+     */
+    public native void destroy();
+
+    /**
+     * Changes the signal of one pin, which must be exported as an output.
+     *
+     * @param pin the WiringPi address of the pin.
+     * @param periodNs the period of the signal in nanoseconds, up to {@code MAXIMUM_PERIOD_NS}, or
+     *                 {@code 0} to stop the channel and drive it low.
+     * @param highNs the duration of the high state in each period in nanoseconds.
+     */
+    public void setChannel(int pin, long periodNs, long highNs) {
+        periodNs = Math.max(0, Math.min(periodNs, MAXIMUM_PERIOD_NS));
+        highNs = Math.max(0, Math.min(highNs, periodNs));
+
+        nativeSetChannel(mReserved, pin, (int)periodNs, (int)highNs);
+    }
+
+    /**
+     * Changes the signal of one pin, which must be exported as an output.
+     *
+     * @param pin the WiringPi address of the pin.
+     * @param frequency the frequency of the signal in Hz, or {@code 0} to stop the channel.
+     * @param dutyCycle the ratio of the high state in each period, between {@code 0} and
+     *                  {@code 1}.
+     */
+    public void setChannel(int pin, double frequency, double dutyCycle) {
+        if (frequency <= 0) {
+            setChannel(pin, 0, 0);
+            return;
+        }
+
+        long periodNs = Math.round(1e9 / frequency);
+        setChannel(pin, periodNs, Math.round(periodNs * dutyCycle));
+    }
+
+    /**
+     * Stops the signal of one pin and drives it low.
+     *
+     * @param pin the WiringPi address of the pin.
+     */
+    public void stopChannel(int pin) {
+        setChannel(pin, 0, 0);
+    }
+
+    @CriticalNative
+    private static native void nativeSetChannel(long info, int pin, int period, int high);
+}
@@ -0,0 +1,101 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.cdoapps.gpio;
+
+/**
+ * The {@code Stepper} class drives up to {@code AXIS_COUNT} stepper motor drivers through their
+ * STEP and DIR inputs, from a native real-time thread.
+ *
+ * The moves of each axis are queued and follow a trapezoidal velocity profile which is computed
+ * when they are queued. A move starts as soon as the previous one of its axis ends, and the STEP
+ * pulses of the axes which are due together are written at once.
+ */
+public class Stepper {
+    static {
+        System.loadLibrary("gpio");
+    }
+
+    /**
+     * The number of axes of one {@code Stepper} instance.
+     */
+    public static final int AXIS_COUNT = 8;
+
+    private long mReserved;
+
+    /**
+     * Starts the thread generating the STEP pulses, without any axis.
+     *
+     * @param gpio a {@code GPIO} instance used to change the pins.
+     * @param cpu the index of the CPU running the thread, {@code Realtime.CPU_ISOLATED}, or
+     *            {@code -1} to let the scheduler choose.
+     * @param priority the {@code SCHED_FIFO} priority of the thread, or {@code 0} to use the
+     *                 default policy.
+     */
+    public native void configure(GPIO gpio, int cpu, int priority);
+    /**
+     * Stops the thread, drops the queued moves and frees the resources which were associated to
+     * it.
+     */
+    public native void destroy();
+
+    /**
+     * Binds one axis to the pins of its driver, which must be exported as outputs.
+     *
+     * @param axis the index of the axis, lower than {@code AXIS_COUNT}.
+     * @param stepPin the WiringPi address of the STEP pin.
+     * @param directionPin the WiringPi address of the DIR pin.
+     * @param pulseWidthNs the duration of the STEP pulses in nanoseconds.
+     * @return {@code true} on success, {@code false} if moves of the axis are pending.
+     */
+    public native boolean setAxis(int axis, int stepPin, int directionPin, long pulseWidthNs);
+
+    /**
+     * Queues a move of one axis, which accelerates from rest up to a maximum velocity, cruises,
+     * then decelerates back to rest.
+     *
+     * When the last queued move of the axis goes in the same direction, the move rather starts at
+     * the highest velocity both moves allow, and that move is planned again to end at it. The
+     * running move is never planned again, thus it always ends at rest.
+     *
+     * @param axis the index of the axis.
+     * @param steps the number of steps, negative to move backward (DIR low), at most 4194304 in
+     *              absolute value. Longer distances are queued as several moves.
+     * @param velocity the maximum velocity in steps per second.
+     * @param acceleration the acceleration and deceleration in steps per second squared.
+     * @return {@code true} if the move was queued.
+     */
+    public native boolean move(int axis, int steps, double velocity, double acceleration);
+    /**
+     * Stops one axis at once, without deceleration, and drops its queued moves.
+     *
+     * @param axis the index of the axis.
+     */
+    public native void stop(int axis);
+
+    /**
+     * Returns the position of one axis.
+     *
+     * @param axis the index of the axis.
+     * @return the number of steps emitted forward minus the ones emitted backward.
+     */
+    public native long getPosition(int axis);
+    /**
+     * Returns the number of moves of one axis which are queued or running.
+     *
+     * @param axis the index of the axis.
+     * @return {@code 0} once the axis is idle.
+     */
+    public native int getPendingMoves(int axis);
+}
@@ -0,0 +1,121 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.cdoapps.gpio;
+
+/**
+ * The {@code Watcher} class polls input pins of a {@code GPIO} instance exported in register mode
+ * ('mmap'), which have no kernel interrupts, and notifies a listener of their debounced changes.
+ *
+ * The polling and the debouncing are done by a native thread, a Java thread only being woken up
+ * when pins actually change.
+ */
+public class Watcher {
+    static {
+        System.loadLibrary("gpio");
+    }
+
+    /**
+     * The {@code Listener} interface is notified of the changes of the watched pins.
+     */
+    public interface Listener {
+        /**
+         * Called on a background thread for each debounced change of one pin.
+         *
+         * @param pin the WiringPi address of the pin.
+         * @param value the new value of the pin.
+         * @param timestamp the time at which the new value was first sampled, in nanoseconds of
+         *                  {@code CLOCK_MONOTONIC}.
+         */
+        void onChange(int pin, int value, long timestamp);
+    }
+
+    private static final long TIMEOUT_NS = 100000000L;
+    private static final int BATCH_SIZE = 32;
+
+    private long mReserved;
+    private Thread mThread;
+    private volatile boolean mRunning;
+
+    Watcher() {
+    }
+
+    native boolean start(GPIO gpio, long mask, int rateHz, long debounceNs);
+
+    private native void nativeStop();
+
+    private native int waitForChanges(long[] timestamps, int[] pins, int[] values, long timeoutNs);
+
+    boolean open(GPIO gpio, long mask, int rateHz, long debounceNs, final Listener listener) {
+        if (!start(gpio, mask, rateHz, debounceNs))
+            return false;
+
+        mRunning = true;
+        mThread = new Thread("GPIO watcher") {
+            @Override
+            public void run() {
+                long[] timestamps = new long[BATCH_SIZE];
+                int[] pins = new int[BATCH_SIZE];
+                int[] values = new int[BATCH_SIZE];
+
+                // the wait is bounded so that the thread notices when it is stopped
+                while (mRunning) {
+                    int count = waitForChanges(timestamps, pins, values, TIMEOUT_NS);
+                    if (count < 0)
+                        break;
+
+                    for (int index = 0 ; index < count && mRunning ; index++)
+                        listener.onChange(pins[index], values[index], timestamps[index]);
+                }
+            }
+        };
+        mThread.start();
+        return true;
+    }
+
+    /**
+     * Changes the debounce window of one watched pin.
+     *
+     * @param pin the WiringPi address of the pin.
+     * @param debounceNs the duration in nanoseconds during which a new value must be stable
+     *                   before it is reported, or {@code 0} to report every change.
+     */
+    public native void setDebounce(int pin, long debounceNs);
+
+    /**
+     * Stops watching the pins. It must be called before the pins are unexported or the
+     * {@code GPIO} instance is paused, but not from the listener.
+     */
+    public synchronized void stop() {
+        mRunning = false;
+
+        if (mThread != null) {
+            boolean interrupted = false;
+            while (mThread.isAlive()) {
+                try {
+                    mThread.join();
+                } catch (InterruptedException e) {
+                    interrupted = true;
+                }
+            }
+
+            if (interrupted)
+                Thread.currentThread().interrupt();
+
+            mThread = null;
+        }
+
+        nativeStop();
+    }
+}
@@ -0,0 +1,134 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.cdoapps.gpio;
+
+import java.util.Arrays;
+
+/**
+ * The {@code Waveform} class represents a timeline of pin transitions which is compiled ahead of
+ * time, then replayed by a native thread with absolute deadlines, without any JNI call between the
+ * transitions.
+ *
+ * The playback thread can be pinned to one CPU and use the {@code SCHED_FIFO} policy, which
+ * requires the {@code CAP_SYS_NICE} capability. The pins exported in register mode ('mmap') are
+ * written directly, thus the shadow copy of the registers should be disabled.
+ */
+public class Waveform {
+    static {
+        System.loadLibrary("gpio");
+    }
+
+    private long mReserved;
+    private long[] mTimeline = new long[3 * 16];
+    private int mCount;
+    private long[] mLateness = new long[0];
+    private final long[] mStatistics = new long[4];
+
+    /**
+     * Appends one transition to the timeline.
+     *
+     * @param offsetNs the time of the transition in nanoseconds since the start of the playback,
+     *                 which must not be lower than the one of the previous transition.
+     * @param mask the WiringPi addresses of the pins to change, as a bit mask.
+     * @param values the new values of the pins, bit {@code n} being WiringPi pin {@code n}.
+     */
+    public void add(long offsetNs, long mask, long values) {
+        if (3 * mCount == mTimeline.length)
+            mTimeline = Arrays.copyOf(mTimeline, 2 * mTimeline.length);
+
+        mTimeline[3 * mCount] = offsetNs;
+        mTimeline[3 * mCount + 1] = mask;
+        mTimeline[3 * mCount + 2] = values;
+        mCount++;
+    }
+
+    /**
+     * Removes all the transitions of the timeline. {@code compile} must be called again before the
+     * next playback.
+     */
+    public void clear() {
+        mCount = 0;
+    }
+
+    /**
+     * Resolves the registers of the pins of the timeline. The pins must be exported and
+     * configured before, and must remain exported until the timeline is destroyed.
+     *
+     * @param gpio the {@code GPIO} instance of the pins.
+     * @return {@code true} on success, {@code false} if the offsets are not sorted.
+     */
+    public boolean compile(GPIO gpio) {
+        return compile(gpio, mTimeline, mCount);
+    }
+
+    private native boolean compile(GPIO gpio, long[] timeline, int count);
+
+    /**
+     * Replays the compiled timeline and blocks until its last transition.
+     *
+     * @param cpu the index of the CPU running the playback, {@code Realtime.CPU_ISOLATED}, or
+     *            {@code -1} to let the scheduler choose.
+     * @param priority the {@code SCHED_FIFO} priority from 1 to 99, or {@code 0} to use the default
+     *                 policy.
+     * @return {@code true} if the timeline was replayed.
+     */
+    public boolean play(int cpu, int priority) {
+        if (mLateness.length != mCount)
+            mLateness = new long[mCount];
+
+        return nativePlay(cpu, priority, mLateness, mStatistics);
+    }
+
+    private native boolean nativePlay(int cpu, int priority, long[] lateness, long[] statistics);
+
+    /**
+     * Returns the lateness of each transition of the last playback, i.e. the durations between
+     * their deadlines and the ends of their register writes.
+     *
+     * @return the lateness in nanoseconds, in the order of the timeline.
+     */
+    public long[] getLateness() {
+        return mLateness;
+    }
+    /**
+     * Returns the lowest lateness of the last playback.
+     *
+     * @return the lowest lateness in nanoseconds.
+     */
+    public long getMinimumLateness() {
+        return mStatistics[1];
+    }
+    /**
+     * Returns the highest lateness of the last playback.
+     *
+     * @return the highest lateness in nanoseconds.
+     */
+    public long getMaximumLateness() {
+        return mStatistics[2];
+    }
+    /**
+     * Returns the mean lateness of the last playback.
+     *
+     * @return the mean lateness in nanoseconds.
+     */
+    public long getMeanLateness() {
+        return mStatistics[3];
+    }
+
+    /**
+     * Frees the resources of the compiled timeline.
+     */
+    public native void destroy();
+}
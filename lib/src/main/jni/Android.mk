@@ -8,11 +8,24 @@ LOCAL_MODULE    := gpio
 LOCAL_SRC_FILES := gpio.c \
                    serial.c \
                    onewire.c \
+                   i2c.c \
+                   spi.c \
+                   parallel.c \
                    thermometer.c \
+                   watcher.c \
+                   waveform.c \
+                   softpwm.c \
+                   pwm.c \
+                   stepper.c \
+                   encoder.c \
+                   measure.c \
+                   bindings.c \
+                   capture.c \
                    delay.c \
+                   realtime.c \
                    stack.c
 
-LOCAL_CFLAGS    += -UNDEBUG -DANDROID
+LOCAL_CFLAGS    += -UNDEBUG -DANDROID -D_GNU_SOURCE
 
-LOCAL_LDLIBS    := -ldl -llog
+LOCAL_LDLIBS    := -ldl -llog -lm
 include $(BUILD_SHARED_LIBRARY)
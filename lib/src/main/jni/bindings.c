@@ -0,0 +1,272 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common.h"
+#include "bindings.h"
+#include "delay.h"
+
+#include <stdlib.h>
+#include <sys/system_properties.h>
+
+struct JavaBindings JAVA_BINDINGS;
+
+static jclass JavaBindingsFindClass(JNIEnv *env, const char *name) {
+    jclass clazz = (*env)->FindClass(env, name);
+    if (!clazz) {
+        LOG_ERROR("Unable to find class %s", name);
+        return NULL;
+    }
+
+    jclass globalClazz = (*env)->NewGlobalRef(env, clazz);
+    (*env)->DeleteLocalRef(env, clazz);
+
+    return globalClazz;
+}
+
+static jobject JavaBindingsGetConstant(JNIEnv *env, jclass clazz, const char *name,
+                                       const char *signature) {
+    jfieldID fieldID = (*env)->GetStaticFieldID(env, clazz, name, signature);
+    if (!fieldID) {
+        LOG_ERROR("Unable to find constant %s", name);
+        return NULL;
+    }
+
+    jobject constant = (*env)->GetStaticObjectField(env, clazz, fieldID);
+    jobject globalConstant = (*env)->NewGlobalRef(env, constant);
+    (*env)->DeleteLocalRef(env, constant);
+
+    return globalConstant;
+}
+
+static BOOL JavaBindingsLoadReserved(JNIEnv *env) {
+    static const struct {
+        const char *name;
+        jfieldID *reserved;
+    } classes[] = {
+#define JAVA_BINDINGS_RESERVED_CLASS(member, name, path) { path, &JAVA_BINDINGS.reserved.member },
+        JAVA_BINDINGS_CLASSES(JAVA_BINDINGS_RESERVED_CLASS)
+#undef JAVA_BINDINGS_RESERVED_CLASS
+    };
+
+    for (int index = 0 ; index < (int)(sizeof(classes) / sizeof(classes[0])) ; index++) {
+        jclass clazz = (*env)->FindClass(env, classes[index].name);
+        if (!clazz) {
+            LOG_ERROR("Unable to find class %s", classes[index].name);
+            return FALSE;
+        }
+
+        *classes[index].reserved = (*env)->GetFieldID(env, clazz, "mReserved", "J");
+        (*env)->DeleteLocalRef(env, clazz);
+
+        if (!*classes[index].reserved)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static BOOL JavaBindingsLoadGPIOPin(JNIEnv *env) {
+    jclass clazz = JavaBindingsFindClass(env, "com/cdoapps/gpio/GPIO$Pin");
+    if (!clazz)
+        return FALSE;
+
+    JAVA_BINDINGS.gpioPin.clazz = clazz;
+    JAVA_BINDINGS.gpioPin.constructor = (*env)->GetMethodID(env, clazz, "<init>", "(J)V");
+
+    return JAVA_BINDINGS.gpioPin.constructor ? TRUE : FALSE;
+}
+
+static BOOL JavaBindingsLoadSerial(JNIEnv *env) {
+    jclass clazz = (*env)->FindClass(env, "com/cdoapps/gpio/Serial");
+    if (!clazz)
+        return FALSE;
+
+    struct JavaSerialBindings *serial = &JAVA_BINDINGS.serial;
+    serial->path = (*env)->GetFieldID(env, clazz, "path", "Ljava/lang/String;");
+    serial->inputStream = (*env)->GetFieldID(env, clazz, "inputStream", "Ljava/io/InputStream;");
+    serial->outputStream = (*env)->GetFieldID(env,
+                                              clazz,
+                                              "outputStream",
+                                              "Ljava/io/OutputStream;");
+    (*env)->DeleteLocalRef(env, clazz);
+
+    if (!serial->path || !serial->inputStream || !serial->outputStream)
+        return FALSE;
+
+    // the constants are stored in the order of the SerialDataBits, SerialParity and
+    // SerialStopBits enums
+    static const char *dataBits[] = { "Five", "Six", "Seven", "Height" };
+    clazz = (*env)->FindClass(env, "com/cdoapps/gpio/Serial$DataBits");
+    if (!clazz)
+        return FALSE;
+
+    for (int index = 0 ; index < 4 ; index++) {
+        serial->dataBits[index] = JavaBindingsGetConstant(env,
+                                                          clazz,
+                                                          dataBits[index],
+                                                          "Lcom/cdoapps/gpio/Serial$DataBits;");
+        if (!serial->dataBits[index])
+            return FALSE;
+    }
+    (*env)->DeleteLocalRef(env, clazz);
+
+    static const char *parities[] = { "None", "Odd", "Even" };
+    clazz = (*env)->FindClass(env, "com/cdoapps/gpio/Serial$Parity");
+    if (!clazz)
+        return FALSE;
+
+    for (int index = 0 ; index < 3 ; index++) {
+        serial->parities[index] = JavaBindingsGetConstant(env,
+                                                          clazz,
+                                                          parities[index],
+                                                          "Lcom/cdoapps/gpio/Serial$Parity;");
+        if (!serial->parities[index])
+            return FALSE;
+    }
+    (*env)->DeleteLocalRef(env, clazz);
+
+    static const char *stopBits[] = { "One", "Two" };
+    clazz = (*env)->FindClass(env, "com/cdoapps/gpio/Serial$StopBits");
+    if (!clazz)
+        return FALSE;
+
+    for (int index = 0 ; index < 2 ; index++) {
+        serial->stopBits[index] = JavaBindingsGetConstant(env,
+                                                          clazz,
+                                                          stopBits[index],
+                                                          "Lcom/cdoapps/gpio/Serial$StopBits;");
+        if (!serial->stopBits[index])
+            return FALSE;
+    }
+    (*env)->DeleteLocalRef(env, clazz);
+
+    struct JavaFileDescriptorBindings *fileDescriptor = &JAVA_BINDINGS.fileDescriptor;
+    fileDescriptor->clazz = JavaBindingsFindClass(env, "java/io/FileDescriptor");
+    if (!fileDescriptor->clazz)
+        return FALSE;
+
+    fileDescriptor->constructor = (*env)->GetMethodID(env, fileDescriptor->clazz, "<init>", "()V");
+    fileDescriptor->descriptor = (*env)->GetFieldID(env, fileDescriptor->clazz, "descriptor", "I");
+    if (!fileDescriptor->descriptor) {
+        (*env)->ExceptionClear(env);
+        fileDescriptor->descriptor = (*env)->GetFieldID(env, fileDescriptor->clazz, "fd", "I");
+    }
+
+    struct JavaStreamBindings *inputStream = &JAVA_BINDINGS.fileInputStream;
+    inputStream->clazz = JavaBindingsFindClass(env, "java/io/FileInputStream");
+    if (!inputStream->clazz)
+        return FALSE;
+
+    inputStream->constructor = (*env)->GetMethodID(env,
+                                                   inputStream->clazz,
+                                                   "<init>",
+                                                   "(Ljava/io/FileDescriptor;)V");
+
+    struct JavaStreamBindings *outputStream = &JAVA_BINDINGS.fileOutputStream;
+    outputStream->clazz = JavaBindingsFindClass(env, "java/io/FileOutputStream");
+    if (!outputStream->clazz)
+        return FALSE;
+
+    outputStream->constructor = (*env)->GetMethodID(env,
+                                                    outputStream->clazz,
+                                                    "<init>",
+                                                    "(Ljava/io/FileDescriptor;)V");
+
+    return (fileDescriptor->constructor &&
+            fileDescriptor->descriptor &&
+            inputStream->constructor &&
+            outputStream->constructor) ? TRUE : FALSE;
+}
+
+static BOOL JavaBindingsLoadThermometer(JNIEnv *env) {
+    jclass clazz = (*env)->FindClass(env, "com/cdoapps/gpio/Thermometer");
+    if (!clazz)
+        return FALSE;
+
+    struct JavaThermometerBindings *thermometer = &JAVA_BINDINGS.thermometer;
+    thermometer->constructor = (*env)->GetMethodID(env, clazz, "<init>", "()V");
+    (*env)->DeleteLocalRef(env, clazz);
+
+    if (!thermometer->constructor)
+        return FALSE;
+
+    // the constants are stored in the order of the ThermometerFamily enum
+    static const char *families[] = { "DS18S20", "DS18B20" };
+    clazz = (*env)->FindClass(env, "com/cdoapps/gpio/Thermometer$Family");
+    if (!clazz)
+        return FALSE;
+
+    for (int index = 0 ; index < 2 ; index++) {
+        thermometer->families[index] = JavaBindingsGetConstant(
+                env,
+                clazz,
+                families[index],
+                "Lcom/cdoapps/gpio/Thermometer$Family;");
+        if (!thermometer->families[index])
+            return FALSE;
+    }
+    (*env)->DeleteLocalRef(env, clazz);
+
+    struct JavaArrayListBindings *arrayList = &JAVA_BINDINGS.arrayList;
+    arrayList->clazz = JavaBindingsFindClass(env, "java/util/ArrayList");
+    if (!arrayList->clazz)
+        return FALSE;
+
+    arrayList->constructor = (*env)->GetMethodID(env, arrayList->clazz, "<init>", "()V");
+    arrayList->add = (*env)->GetMethodID(env, arrayList->clazz, "add", "(Ljava/lang/Object;)Z");
+
+    return (arrayList->constructor && arrayList->add) ? TRUE : FALSE;
+}
+
+// @CriticalNative is honored by ART since Android 8.0 (API 26). Older runtimes ignore the
+// annotation and call the methods with the regular JNI calling convention.
+#define JAVA_BINDINGS_CRITICAL_NATIVE_SDK 26
+
+static int JavaBindingsGetSdkVersion(void) {
+    char value[PROP_VALUE_MAX] = "";
+    if (__system_property_get("ro.build.version.sdk", value) <= 0)
+        return 0;
+
+    return atoi(value);
+}
+
+JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM *vm, void *reserved) {
+    JNIEnv *env = NULL;
+    if ((*vm)->GetEnv(vm, (void **)&env, JNI_VERSION_1_6) != JNI_OK)
+        return JNI_ERR;
+
+    if (!JavaBindingsLoadReserved(env) ||
+        !JavaBindingsLoadGPIOPin(env) ||
+        !JavaBindingsLoadSerial(env) ||
+        !JavaBindingsLoadThermometer(env)) {
+        LOG_ERROR("Unable to resolve the Java bindings");
+        return JNI_ERR;
+    }
+
+    // the counter of the busy waits is calibrated before any transfer needs it
+    DelayInitialize();
+
+    int sdkVersion = JavaBindingsGetSdkVersion();
+    BOOL critical = (sdkVersion >= JAVA_BINDINGS_CRITICAL_NATIVE_SDK) ? TRUE : FALSE;
+    if (!Java_com_cdoapps_gpio_GPIO_registerNatives(env, critical) ||
+        !Java_com_cdoapps_gpio_OneWire_registerNatives(env) ||
+        !Java_com_cdoapps_gpio_SoftPwm_registerNatives(env, critical) ||
+        !Java_com_cdoapps_gpio_Encoder_registerNatives(env, critical)) {
+        LOG_ERROR("Unable to register the native methods");
+        return JNI_ERR;
+    }
+
+    return JNI_VERSION_1_6;
+}
@@ -0,0 +1,153 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GPIO_BINDINGS_H
+#define GPIO_BINDINGS_H
+
+#include <jni.h>
+
+/**
+ * The {@code JAVA_BINDINGS_CLASSES} table lists the classes which keep the address of their native
+ * object in a {@code long mReserved} field, as {@code X(member, JNI name, class name)} entries.
+ *
+ * It generates the {@code reserved} field IDs of {@code JavaBindings}, their lookup in
+ * {@code JNI_OnLoad} and the {@code getReserved} and {@code setReserved} accessors of each class.
+ */
+#define JAVA_BINDINGS_CLASSES(X)                                                \
+    X(gpio, GPIO, "com/cdoapps/gpio/GPIO")                                      \
+    X(gpioPin, GPIO_00024Pin, "com/cdoapps/gpio/GPIO$Pin")                      \
+    X(oneWire, OneWire, "com/cdoapps/gpio/OneWire")                             \
+    X(capture, Capture, "com/cdoapps/gpio/Capture")                             \
+    X(watcher, Watcher, "com/cdoapps/gpio/Watcher")                             \
+    X(waveform, Waveform, "com/cdoapps/gpio/Waveform")                          \
+    X(softPwm, SoftPwm, "com/cdoapps/gpio/SoftPwm")                             \
+    X(pwm, Pwm, "com/cdoapps/gpio/Pwm")                                         \
+    X(stepper, Stepper, "com/cdoapps/gpio/Stepper")                             \
+    X(encoder, Encoder, "com/cdoapps/gpio/Encoder")                             \
+    X(measurement, Measurement, "com/cdoapps/gpio/Measurement")                 \
+    X(i2c, I2C, "com/cdoapps/gpio/I2C")                                         \
+    X(spi, SPI, "com/cdoapps/gpio/SPI")                                         \
+    X(parallelBus, ParallelBus, "com/cdoapps/gpio/ParallelBus")                 \
+    X(serial, Serial, "com/cdoapps/gpio/Serial")                                \
+    X(thermometer, Thermometer, "com/cdoapps/gpio/Thermometer")
+
+/**
+ * The {@code JavaBindings} struct holds the classes, field IDs, method IDs and enum constants used
+ * by the native methods of the library.
+ *
+ * They are resolved once by {@code JNI_OnLoad}, the classes and enum constants being kept as global
+ * references.
+ */
+struct JavaBindings {
+    struct JavaReservedBindings {
+#define JAVA_BINDINGS_RESERVED_FIELD(member, name, path) jfieldID member;
+        JAVA_BINDINGS_CLASSES(JAVA_BINDINGS_RESERVED_FIELD)
+#undef JAVA_BINDINGS_RESERVED_FIELD
+    } reserved;
+
+    struct JavaGPIOPinBindings {
+        jclass clazz;
+        jmethodID constructor;
+    } gpioPin;
+
+    struct JavaSerialBindings {
+        jfieldID path;
+        jfieldID inputStream;
+        jfieldID outputStream;
+
+        jobject dataBits[4];
+        jobject parities[3];
+        jobject stopBits[2];
+    } serial;
+
+    struct JavaThermometerBindings {
+        jmethodID constructor;
+
+        jobject families[2];
+    } thermometer;
+
+    struct JavaArrayListBindings {
+        jclass clazz;
+        jmethodID constructor;
+        jmethodID add;
+    } arrayList;
+
+    struct JavaFileDescriptorBindings {
+        jclass clazz;
+        jmethodID constructor;
+        jfieldID descriptor;
+    } fileDescriptor;
+
+    struct JavaStreamBindings {
+        jclass clazz;
+        jmethodID constructor;
+    } fileInputStream, fileOutputStream;
+};
+
+/**
+ * The bindings resolved by {@code JNI_OnLoad}.
+ */
+extern struct JavaBindings JAVA_BINDINGS;
+
+/**
+ * Registers the native methods of {@code GPIO} and {@code GPIO.Pin} which are not found by name.
+ *
+ * @param env the JNI environment of {@code JNI_OnLoad}.
+ * @param critical if {@code TRUE}, the methods annotated with {@code @CriticalNative} are bound to
+ *                 implementations which receive neither a {@code JNIEnv} nor a {@code jclass}.
+ * @return {@code TRUE} on success.
+ */
+BOOL Java_com_cdoapps_gpio_GPIO_registerNatives(JNIEnv *env, BOOL critical);
+/**
+ * Registers the native methods of {@code OneWire} which are not found by name.
+ *
+ * @param env the JNI environment of {@code JNI_OnLoad}.
+ * @return {@code TRUE} on success.
+ */
+BOOL Java_com_cdoapps_gpio_OneWire_registerNatives(JNIEnv *env);
+/**
+ * Registers the native methods of {@code SoftPwm} which are not found by name.
+ *
+ * @param env the JNI environment of {@code JNI_OnLoad}.
+ * @param critical if {@code TRUE}, the methods annotated with {@code @CriticalNative} are bound to
+ *                 implementations which receive neither a {@code JNIEnv} nor a {@code jclass}.
+ * @return {@code TRUE} on success.
+ */
+BOOL Java_com_cdoapps_gpio_SoftPwm_registerNatives(JNIEnv *env, BOOL critical);
+/**
+ * Registers the native methods of {@code Encoder} which are not found by name.
+ *
+ * @param env the JNI environment of {@code JNI_OnLoad}.
+ * @param critical if {@code TRUE}, the methods annotated with {@code @CriticalNative} are bound to
+ *                 implementations which receive neither a {@code JNIEnv} nor a {@code jclass}.
+ * @return {@code TRUE} on success.
+ */
+BOOL Java_com_cdoapps_gpio_Encoder_registerNatives(JNIEnv *env, BOOL critical);
+
+#define JAVA_BINDINGS_RESERVED_ACCESSORS(member, name, path)                    \
+static inline jlong                                                             \
+Java_com_cdoapps_gpio_##name##_getReserved(JNIEnv * env, jobject thiz) {        \
+    return (*env)->GetLongField(env, thiz, JAVA_BINDINGS.reserved.member);      \
+}                                                                               \
+                                                                                \
+static inline void                                                              \
+Java_com_cdoapps_gpio_##name##_setReserved(JNIEnv * env, jobject thiz, jlong value) { \
+    (*env)->SetLongField(env, thiz, JAVA_BINDINGS.reserved.member, value);      \
+}
+
+JAVA_BINDINGS_CLASSES(JAVA_BINDINGS_RESERVED_ACCESSORS)
+
+#undef JAVA_BINDINGS_RESERVED_ACCESSORS
+
+#endif //GPIO_BINDINGS_H
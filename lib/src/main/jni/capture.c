@@ -0,0 +1,277 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common.h"
+#include "bindings.h"
+#include "capture.h"
+#include "delay.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#define CAPTURE_RECORD_SIZE 8
+#define CAPTURE_MINIMUM_SIZE 64
+#define CAPTURE_MAXIMUM_DELAY 0xFFFFFFFFll
+
+struct CapturePin {
+    int bank;
+    uint32_t mask;
+    uint32_t value;
+};
+
+struct CaptureInfo {
+    GPIOInfoRef gpioInfo;
+    struct GPIOInputWord banks[32];
+    int bankCount;
+    struct CapturePin pins[32];
+    int pinCount;
+
+    long long period;
+    long long startTime;
+
+    uint8_t *buffer;
+    size_t capacity;
+
+    // written by the thread, read by the consumer
+    uint64_t writePosition;
+    uint64_t overruns;
+    // written by the consumer, read by the thread
+    uint64_t readPosition;
+
+    BOOL running;
+    pthread_t thread;
+};
+
+static BOOL CaptureInfoPush(CaptureInfoRef info, uint32_t delay, uint32_t values) {
+    uint64_t position = info->writePosition;
+    uint64_t readPosition = __atomic_load_n(&info->readPosition, __ATOMIC_ACQUIRE);
+
+    if (position + CAPTURE_RECORD_SIZE - readPosition > info->capacity) {
+        __atomic_fetch_add(&info->overruns, 1, __ATOMIC_RELAXED);
+        return FALSE;
+    }
+
+    uint32_t *record = (uint32_t *)&info->buffer[position % info->capacity];
+    record[0] = delay;
+    record[1] = values;
+
+    __atomic_store_n(&info->writePosition, position + CAPTURE_RECORD_SIZE, __ATOMIC_RELEASE);
+    return TRUE;
+}
+
+static void *CaptureInfoRun(void *argument) {
+    CaptureInfoRef info = argument;
+
+    uint32_t words[32];
+    uint32_t previousWords[32];
+    BOOL recorded = FALSE;
+    uint32_t values = 0x0;
+
+    long long time = info->startTime;
+    long long deadline = info->startTime;
+
+    while (__atomic_load_n(&info->running, __ATOMIC_ACQUIRE)) {
+        DelayUntilNextSample(&deadline, info->period);
+
+        // all the banks are read first, so that they are sampled as close as possible
+        GPIOInputWordRead(info->banks, info->bankCount, words);
+
+        long long now = DelayGetTime();
+
+        BOOL changed = !recorded;
+        for (int bank = 0 ; bank < info->bankCount && !changed ; bank++)
+            changed = (words[bank] != previousWords[bank]) ? TRUE : FALSE;
+
+        // a record repeating the values is needed when the delay would not fit in 32 bits
+        while (recorded && now - time > CAPTURE_MAXIMUM_DELAY &&
+               CaptureInfoPush(info, (uint32_t)CAPTURE_MAXIMUM_DELAY, values))
+            time += CAPTURE_MAXIMUM_DELAY;
+
+        if (!changed || now - time > CAPTURE_MAXIMUM_DELAY)
+            continue;
+
+        uint32_t newValues = 0x0;
+        for (int pin = 0 ; pin < info->pinCount ; pin++) {
+            const struct CapturePin *pinInfo = &info->pins[pin];
+            if (words[pinInfo->bank] & pinInfo->mask)
+                newValues |= pinInfo->value;
+        }
+
+        // on overrun, the change is recorded by a later sample
+        if (!CaptureInfoPush(info, (uint32_t)(now - time), newValues))
+            continue;
+
+        for (int bank = 0 ; bank < info->bankCount ; bank++)
+            previousWords[bank] = words[bank];
+
+        values = newValues;
+        time = now;
+        recorded = TRUE;
+    }
+
+    return NULL;
+}
+
+CaptureInfoRef CaptureInfoCreate(GPIOInfoRef gpioInfo, uint64_t mask, int rate, size_t size) {
+    CaptureInfoRef info = malloc(sizeof(struct CaptureInfo));
+
+    info->bankCount = 0;
+    info->pinCount = 0;
+
+    // the records hold 32 pins
+    for (int pin = 0 ; pin < 32 ; pin++) {
+        if (!(mask & (0x1ull << pin)))
+            continue;
+
+        uint32_t pinMask = 0x0;
+        int bank = GPIOInfoAddInputWord(gpioInfo, info->banks, &info->bankCount, pin, &pinMask);
+        if (bank < 0)
+            continue;
+
+        info->pins[info->pinCount++] = (struct CapturePin){
+            .bank = bank,
+            .mask = pinMask,
+            .value = (0x1u << pin)
+        };
+    }
+
+    size -= size % CAPTURE_RECORD_SIZE;
+    if (size < CAPTURE_MINIMUM_SIZE)
+        size = CAPTURE_MINIMUM_SIZE;
+
+    info->capacity = size;
+    info->buffer = NULL;
+    if (!info->pinCount || posix_memalign((void **)&info->buffer, 64, size) != 0) {
+        LOG_ERROR("Unable to start a capture of %d pins", info->pinCount);
+        free(info);
+        return NULL;
+    }
+
+    info->period = (rate > 0) ? 1000000000ll / rate : 0;
+    info->writePosition = 0;
+    info->overruns = 0;
+    info->readPosition = 0;
+    info->running = TRUE;
+    info->startTime = DelayGetTime();
+    info->gpioInfo = GPIOInfoRetain(gpioInfo);
+
+    if (pthread_create(&info->thread, NULL, CaptureInfoRun, info) != 0) {
+        LOG_ERROR("Unable to start the capture thread");
+        GPIOInfoFree(gpioInfo);
+        free(info->buffer);
+        free(info);
+        return NULL;
+    }
+
+    return info;
+}
+
+void CaptureInfoFree(CaptureInfoRef info) {
+    __atomic_store_n(&info->running, FALSE, __ATOMIC_RELEASE);
+    pthread_join(info->thread, NULL);
+
+    GPIOInfoFree(info->gpioInfo);
+    free(info->buffer);
+    free(info);
+}
+
+void *CaptureInfoGetBuffer(CaptureInfoRef info, size_t *capacity) {
+    if (capacity)
+        *capacity = info->capacity;
+
+    return info->buffer;
+}
+
+long long CaptureInfoGetStartTime(CaptureInfoRef info) {
+    return info->startTime;
+}
+
+uint64_t CaptureInfoGetWritePosition(CaptureInfoRef info) {
+    return __atomic_load_n(&info->writePosition, __ATOMIC_ACQUIRE);
+}
+
+void CaptureInfoSetReadPosition(CaptureInfoRef info, uint64_t position) {
+    __atomic_store_n(&info->readPosition, position, __ATOMIC_RELEASE);
+}
+
+uint64_t CaptureInfoGetOverruns(CaptureInfoRef info) {
+    return __atomic_load_n(&info->overruns, __ATOMIC_RELAXED);
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_cdoapps_gpio_Capture_start(JNIEnv *env, jobject thiz, jobject gpio, jlong mask,
+                                    jint rate, jint size) {
+    CaptureInfoRef info = (CaptureInfoRef)Java_com_cdoapps_gpio_Capture_getReserved(env, thiz);
+    if (info)
+        CaptureInfoFree(info);
+
+    Java_com_cdoapps_gpio_Capture_setReserved(env, thiz, 0l);
+
+    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, gpio);
+    if (!gpioInfo || size <= 0)
+        return NULL;
+
+    info = CaptureInfoCreate(gpioInfo, (uint64_t)mask, rate, (size_t)size);
+    if (!info)
+        return NULL;
+
+    Java_com_cdoapps_gpio_Capture_setReserved(env, thiz, (jlong)info);
+
+    size_t capacity = 0;
+    void *buffer = CaptureInfoGetBuffer(info, &capacity);
+    return (*env)->NewDirectByteBuffer(env, buffer, (jlong)capacity);
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Capture_nativeStop(JNIEnv *env, jobject thiz) {
+    CaptureInfoRef info = (CaptureInfoRef)Java_com_cdoapps_gpio_Capture_getReserved(env, thiz);
+    if (info) {
+        CaptureInfoFree(info);
+        Java_com_cdoapps_gpio_Capture_setReserved(env, thiz, 0l);
+    }
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_cdoapps_gpio_Capture_getStartTime(JNIEnv *env, jobject thiz) {
+    CaptureInfoRef info = (CaptureInfoRef)Java_com_cdoapps_gpio_Capture_getReserved(env, thiz);
+    if (info)
+        return CaptureInfoGetStartTime(info);
+
+    return 0l;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_cdoapps_gpio_Capture_getWritePosition(JNIEnv *env, jobject thiz) {
+    CaptureInfoRef info = (CaptureInfoRef)Java_com_cdoapps_gpio_Capture_getReserved(env, thiz);
+    if (info)
+        return (jlong)CaptureInfoGetWritePosition(info);
+
+    return 0l;
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Capture_setReadPosition(JNIEnv *env, jobject thiz, jlong position) {
+    CaptureInfoRef info = (CaptureInfoRef)Java_com_cdoapps_gpio_Capture_getReserved(env, thiz);
+    if (info)
+        CaptureInfoSetReadPosition(info, (uint64_t)position);
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_cdoapps_gpio_Capture_getOverruns(JNIEnv *env, jobject thiz) {
+    CaptureInfoRef info = (CaptureInfoRef)Java_com_cdoapps_gpio_Capture_getReserved(env, thiz);
+    if (info)
+        return (jlong)CaptureInfoGetOverruns(info);
+
+    return 0l;
+}
@@ -0,0 +1,97 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GPIO_CAPTURE_H
+#define GPIO_CAPTURE_H
+
+#include "gpio.h"
+
+#include <stddef.h>
+
+/**
+ * The {@code CaptureInfo} struct represents a logic analyzer sampling the input registers of many
+ * pins from a native thread.
+ *
+ * The samples are stored in a single-producer/single-consumer ring buffer of 8-byte records, a
+ * record being written only when the sampled values change:
+ * <ul><li>a 32-bit unsigned duration in nanoseconds since the previous record (or since the start
+ * of the capture for the first one),</li>
+ * <li>32-bit values, bit {@code n} being the value of WiringPi pin {@code n}.</li></ul>
+ * A record repeating the same values is written when a duration would not fit in 32 bits.
+ * Both fields are in the native byte order.
+ */
+typedef struct CaptureInfo *CaptureInfoRef;
+
+/**
+ * Returns a {@code CaptureInfo} object sampling many pins, and starts its thread.
+ *
+ * The pins must be exported in register mode, the other ones read as {@code GPIO_PIN_VALUE_LOW}.
+ * The input words are read as a whole, thus the pins sharing one bank are sampled at once.
+ *
+ * @param gpioInfo a {@code GPIOInfo} object representing the GPIO controller.
+ * @param mask a bit mask of the WiringPi addresses of the pins to sample.
+ * @param rate the sampling rate in Hz, or {@code 0} to sample as fast as possible.
+ * @param size the size of the ring buffer in bytes.
+ * @return a {@code CaptureInfo} object, or {@code NULL} on error.
+ */
+CaptureInfoRef CaptureInfoCreate(GPIOInfoRef gpioInfo, uint64_t mask, int rate, size_t size);
+/**
+ * Stops the thread of a capture and destroys the resources associated to it.
+ *
+ * @param info a {@code CaptureInfo} object representing the capture to destroy.
+ */
+void CaptureInfoFree(CaptureInfoRef info);
+
+/**
+ * Returns the records of a capture.
+ *
+ * @param info a {@code CaptureInfo} object representing the capture.
+ * @param capacity if not {@code NULL}, set the size of the ring buffer in bytes on return.
+ * @return the ring buffer of the capture.
+ */
+void *CaptureInfoGetBuffer(CaptureInfoRef info, size_t *capacity);
+/**
+ * Returns the time of the start of a capture.
+ *
+ * @param info a {@code CaptureInfo} object representing the capture.
+ * @return the time of the start of the capture in nanoseconds of {@code CLOCK_MONOTONIC}.
+ */
+long long CaptureInfoGetStartTime(CaptureInfoRef info);
+
+/**
+ * Returns the number of bytes written since the start of a capture. The records before this
+ * position are complete.
+ *
+ * The position of a record in the buffer is its position modulo the capacity.
+ *
+ * @param info a {@code CaptureInfo} object representing the capture.
+ * @return the number of bytes written since the start of the capture.
+ */
+uint64_t CaptureInfoGetWritePosition(CaptureInfoRef info);
+/**
+ * Releases the records read by the consumer, letting the thread overwrite them.
+ *
+ * @param info a {@code CaptureInfo} object representing the capture.
+ * @param position the number of bytes read since the start of the capture.
+ */
+void CaptureInfoSetReadPosition(CaptureInfoRef info, uint64_t position);
+/**
+ * Returns the number of records which were dropped because the ring buffer was full.
+ *
+ * @param info a {@code CaptureInfo} object representing the capture.
+ * @return the number of records which were dropped.
+ */
+uint64_t CaptureInfoGetOverruns(CaptureInfoRef info);
+
+#endif //GPIO_CAPTURE_H
@@ -15,43 +15,184 @@
 #include "common.h"
 #include "delay.h"
 
-void DelayNanoFrom(struct timespec *date, long delay) {
-    if (0 == delay)
-        return;
+#include <pthread.h>
+
+// the thread spins for the last part of a wait, to absorb the wake up latency of the scheduler
+#define DELAY_SPIN_DURATION 100000ll
+// the duration over which the counter is compared to CLOCK_MONOTONIC_RAW
+#define DELAY_CALIBRATION_DURATION 2000000l
 
+static pthread_once_t DELAY_ONCE = PTHREAD_ONCE_INIT;
+static double DELAY_FREQUENCY;
+static double DELAY_TICKS_PER_NANO;
+
+static long long DelayGetRawTime(void) {
     struct timespec now;
-    long t;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+
+    return now.tv_sec * 1000000000ll + now.tv_nsec;
+}
+
+uint64_t DelayGetTicks(void) {
+#if defined(__aarch64__)
+    // the barrier keeps the counter from being read ahead of the preceding instructions
+    uint64_t ticks;
+    __asm__ volatile("isb; mrs %0, cntvct_el0" : "=r"(ticks) :: "memory");
+    return ticks;
+#else
+    return (uint64_t)DelayGetRawTime();
+#endif
+}
 
-    if (date) {
-        t = date->tv_nsec;
-    } else {
-        clock_gettime(CLOCK_REALTIME, &now);
-        t = now.tv_nsec;
+static void DelayCalibrate(void) {
+#if defined(__aarch64__)
+    uint64_t reported;
+    __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(reported));
+
+    long long start = DelayGetRawTime();
+    uint64_t startTicks = DelayGetTicks();
+
+    struct timespec duration = { .tv_sec = 0, .tv_nsec = DELAY_CALIBRATION_DURATION };
+    nanosleep(&duration, NULL);
+
+    long long elapsed = DelayGetRawTime() - start;
+    double measured = (double)(DelayGetTicks() - startTicks) * 1e9 / (double)elapsed;
+
+    // some firmwares do not program cntfrq_el0, the measure is used when they disagree
+    DELAY_FREQUENCY = (double)reported;
+    if (!reported || measured < 0.99 * reported || measured > 1.01 * reported) {
+        LOG_WARN("The counter runs at %.0f Hz instead of %llu Hz",
+                 measured,
+                 (unsigned long long)reported);
+        DELAY_FREQUENCY = measured;
     }
+#else
+    DELAY_FREQUENCY = 1e9;
+#endif
 
-    if (delay > 999999999)
-        delay = 999999999;
+    DELAY_TICKS_PER_NANO = DELAY_FREQUENCY / 1e9;
+}
+
+void DelayInitialize(void) {
+    pthread_once(&DELAY_ONCE, DelayCalibrate);
+}
 
-    while (TRUE) {
-        clock_gettime(CLOCK_REALTIME, &now);
+double DelayGetFrequency(void) {
+    DelayInitialize();
 
-        long dt = now.tv_nsec - t;
-        if (dt < 0)
-            dt += 1000000000;
+    return DELAY_FREQUENCY;
+}
+
+long long DelayGetTime(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000000000ll + now.tv_nsec;
+}
+
+// Spins on the counter only, which is much cheaper to read than the clocks of the kernel.
+static void DelaySpinFrom(uint64_t start, long long delay) {
+    if (delay <= 0)
+        return;
+
+    DelayInitialize();
+
+    uint64_t duration = (uint64_t)((double)delay * DELAY_TICKS_PER_NANO);
+
+    while (DelayGetTicks() - start < duration)
+        DELAY_CPU_RELAX();
+}
+
+static inline void DelaySpin(long long delay) {
+    DelaySpinFrom(DelayGetTicks(), delay);
+}
 
-        if (dt > delay)
-            break;
+struct timespec DelayGetTimespec(long long time) {
+    return (struct timespec){ .tv_sec = time / 1000000000ll, .tv_nsec = time % 1000000000ll };
+}
+
+void DelaySleepUntil(long long wakeUp) {
+    struct timespec date = DelayGetTimespec(wakeUp);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &date, NULL);
+}
+
+void DelaySleep(long long duration) {
+    struct timespec date = DelayGetTimespec(duration);
+    nanosleep(&date, NULL);
+}
+
+void DelayUntil(long long deadline) {
+    long long now = DelayGetTime();
+    if (deadline - now > DELAY_SPIN_DURATION) {
+        DelaySleepUntil(deadline - DELAY_SPIN_DURATION);
+        now = DelayGetTime();
+    }
+
+    if (deadline > now)
+        DelaySpin(deadline - now);
+}
+
+// The edges of a transfer are scheduled on absolute deadlines rather than waited for as durations,
+// so that the time spent accessing the registers between two waits overlaps the next wait instead
+// of adding up over the transfer.
+void DelayUntilNext(long long *deadline, long long duration) {
+    *deadline += duration;
+    if (duration > 0)
+        DelayUntil(*deadline);
+}
+
+void DelayUntilNextSample(long long *deadline, long long period) {
+    if (!period)
+        return;
+
+    *deadline += period;
+    if (period >= DELAY_SPIN_PERIOD)
+        DelaySleepUntil(*deadline);
+    else
+        DelayUntil(*deadline);
+}
+
+void DelayUntilFlagged(long long deadline, long long interval, const uint64_t *flags) {
+    while (DelayGetTime() < deadline - interval) {
+        if (__atomic_load_n(flags, __ATOMIC_RELAXED))
+            return;
+
+        DelaySleep(interval);
     }
+
+    DelayUntil(deadline);
 }
 
-void DelayMicroFrom(struct timespec *date, int delay) {
-    DelayNanoFrom(date, 1000 * delay);
+void DelayTimelineStart(struct DelayTimeline *timeline) {
+    DelayInitialize();
+
+    timeline->ticks = DelayGetTicks();
+    timeline->time = DelayGetTime();
 }
 
-void DelayNano(long delay) {
-    DelayNanoFrom(NULL, delay);
+long long DelayTimelineGetOffset(const struct DelayTimeline *timeline) {
+    return (long long)((double)(DelayGetTicks() - timeline->ticks) / DELAY_TICKS_PER_NANO);
+}
+
+void DelayTimelineWaitUntil(const struct DelayTimeline *timeline, long long offset) {
+    if (offset - DelayTimelineGetOffset(timeline) > DELAY_SPIN_DURATION)
+        DelaySleepUntil(timeline->time + offset - DELAY_SPIN_DURATION);
+
+    // the end is measured from the origin, thus the spin absorbs any late return of the sleep
+    DelaySpinFrom(timeline->ticks, offset);
+}
+
+void DelayNano(long long delay) {
+    if (delay <= 0)
+        return;
+
+    // short waits never read the clocks of the kernel
+    if (delay <= DELAY_SPIN_DURATION)
+        DelaySpin(delay);
+    else
+        DelayUntil(DelayGetTime() + delay);
 }
 
 void DelayMicro(int delay) {
-    DelayNanoFrom(NULL, 1000 * delay);
+    DelayNano(1000ll * delay);
 }
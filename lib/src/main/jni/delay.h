@@ -15,31 +15,149 @@
 #ifndef GPIO_DELAY_H
 #define GPIO_DELAY_H
 
+#include <stdint.h>
 #include <time.h>
 
+// hints the CPU that the thread is spinning
+#if defined(__aarch64__)
+#define DELAY_CPU_RELAX() __asm__ volatile("yield" ::: "memory")
+#elif defined(__arm__)
+#define DELAY_CPU_RELAX() __asm__ volatile("yield" ::: "memory")
+#elif defined(__i386__) || defined(__x86_64__)
+#define DELAY_CPU_RELAX() __asm__ volatile("pause" ::: "memory")
+#else
+#define DELAY_CPU_RELAX() __asm__ volatile("" ::: "memory")
+#endif
+
+// below this sampling period in nanoseconds, the sampling threads spin instead of sleeping
+#define DELAY_SPIN_PERIOD 200000
+
+/**
+ * Calibrates the counter used by the busy waits. It is done once, on the first call, which takes
+ * a few milliseconds: the library calls it when it is loaded.
+ */
+void DelayInitialize(void);
+
 /**
- * Busy waits for a specific duration.
+ * Returns the current value of the counter used by the busy waits: the ARM generic timer
+ * ({@code cntvct_el0}) on aarch64, or {@code CLOCK_MONOTONIC_RAW} in nanoseconds elsewhere. It is
+ * never stepped, and reading it does not enter the kernel.
  *
- * @param date if not {@code NULL}, set the start date of the spinning.
- * @param delay a duration in nanoseconds.
+ * @return the current value of the counter, in ticks of {@code DelayGetFrequency}.
  */
-void DelayNanoFrom(struct timespec *date, long delay);
+uint64_t DelayGetTicks(void);
 /**
- * Busy waits for a specific duration.
+ * Returns the frequency of the counter, measured against {@code CLOCK_MONOTONIC_RAW}.
  *
- * @param date if not {@code NULL}, set the start date of the spinning.
- * @param delay a duration in microseconds.
+ * @return the number of ticks of {@code DelayGetTicks} per second.
+ */
+double DelayGetFrequency(void);
+
+/**
+ * Returns the current time of the monotonic clock.
+ *
+ * @return the current time of {@code CLOCK_MONOTONIC} in nanoseconds.
+ */
+long long DelayGetTime(void);
+
+/**
+ * Converts a time or a duration in nanoseconds.
+ *
+ * @param time a time or a duration in nanoseconds.
+ * @return {@code time} as a {@code timespec}.
+ */
+struct timespec DelayGetTimespec(long long time);
+
+/**
+ * Sleeps until an absolute time of the monotonic clock, without spinning. It suits the periodic
+ * threads for which a late wake up only delays a sample.
+ *
+ * @param wakeUp a time of {@code CLOCK_MONOTONIC} in nanoseconds.
+ */
+void DelaySleepUntil(long long wakeUp);
+/**
+ * Sleeps for a specific duration, without spinning.
+ *
+ * @param duration a duration in nanoseconds.
+ */
+void DelaySleep(long long duration);
+
+/**
+ * Waits until an absolute time of the monotonic clock. The thread sleeps until shortly before the
+ * deadline, then spins, so that a late wake up of the scheduler does not delay it.
+ *
+ * @param deadline a time of {@code CLOCK_MONOTONIC} in nanoseconds.
+ */
+void DelayUntil(long long deadline);
+/**
+ * Advances a deadline by a duration, then waits until it with {@code DelayUntil}. The deadline
+ * follows the schedule even if the caller was late, thus the work done between two waits does not
+ * add up.
+ *
+ * @param deadline a time of {@code CLOCK_MONOTONIC} in nanoseconds, advanced on return.
+ * @param duration the time to the next deadline in nanoseconds, or {@code 0} not to wait.
+ */
+void DelayUntilNext(long long *deadline, long long duration);
+/**
+ * Advances the deadline of a sampling thread by its period, then waits until it. The thread
+ * sleeps when the period is at least {@code DELAY_SPIN_PERIOD}, and waits like {@code DelayUntil}
+ * otherwise.
+ *
+ * @param deadline a time of {@code CLOCK_MONOTONIC} in nanoseconds, advanced on return.
+ * @param period the sampling period in nanoseconds, or {@code 0} to sample continuously.
+ */
+void DelayUntilNextSample(long long *deadline, long long period);
+/**
+ * Waits until an absolute time of the monotonic clock like {@code DelayUntil}, unless some flags
+ * are set before. Until the last {@code interval}, the thread sleeps for {@code interval} at a
+ * time and checks the flags when it wakes up.
+ *
+ * @param deadline a time of {@code CLOCK_MONOTONIC} in nanoseconds.
+ * @param interval the longest delay in nanoseconds before the flags are noticed.
+ * @param flags the flags, which end the wait early when they are not {@code 0}.
+ */
+void DelayUntilFlagged(long long deadline, long long interval, const uint64_t *flags);
+
+/**
+ * The {@code DelayTimeline} struct is the clock of a transaction: the edges of its slots are
+ * scheduled at offsets from its origin, so that the time spent driving the pins between two waits
+ * does not add up over the transaction.
+ */
+struct DelayTimeline {
+    long long time; // the origin on CLOCK_MONOTONIC, in nanoseconds
+    uint64_t ticks; // the origin on the counter of DelayGetTicks
+};
+
+/**
+ * Sets the origin of a timeline to now.
+ *
+ * @param timeline the timeline to start.
+ */
+void DelayTimelineStart(struct DelayTimeline *timeline);
+/**
+ * Returns the time elapsed since the origin of a timeline.
+ *
+ * @param timeline a started timeline.
+ * @return the time elapsed since the origin of {@code timeline} in nanoseconds.
+ */
+long long DelayTimelineGetOffset(const struct DelayTimeline *timeline);
+/**
+ * Waits until an offset from the origin of a timeline. It returns at once if the offset is
+ * already past. Like {@code DelayUntil}, only the end of a long wait is spent spinning.
+ *
+ * @param timeline a started timeline.
+ * @param offset the offset from the origin of {@code timeline} in nanoseconds.
  */
-void DelayMicroFrom(struct timespec *date, int delay);
+void DelayTimelineWaitUntil(const struct DelayTimeline *timeline, long long offset);
 
 /**
- * Busy waits for a specific duration.
+ * Waits for a specific duration. Short waits spin on the counter, long waits sleep first.
  *
  * @param delay a duration in nanoseconds.
  */
-void DelayNano(long delay);
+void DelayNano(long long delay);
 /**
- * Busy waits for a specific duration.
+ * Waits for a specific duration. Short waits spin on the counter, long waits sleep first.
  *
  * @param delay a duration in microseconds.
  */
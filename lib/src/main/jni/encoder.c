@@ -0,0 +1,292 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common.h"
+#include "bindings.h"
+#include "encoder.h"
+#include "delay.h"
+#include "realtime.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+
+// the steps of a transition from the (A, B) state in the high bits to the one in the low bits, 2
+// being an invalid transition where both inputs changed. A leading B (00, 10, 11, 01) counts up.
+static const int8_t ENCODER_TRANSITIONS[16] = {
+        0, -1, 1, 2,
+        1, 0, 2, -1,
+        -1, 2, 0, 1,
+        2, 1, -1, 0
+};
+
+struct EncoderChannel {
+    int bankA;
+    uint32_t maskA;
+    int bankB;
+    uint32_t maskB;
+    int state;
+};
+
+struct EncoderInfo {
+    GPIOInfoRef gpioInfo;
+    struct GPIOInputWord banks[2 * ENCODER_COUNT];
+    int bankCount;
+    struct EncoderChannel channels[ENCODER_COUNT];
+    int count;
+
+    long long period;
+    struct RealtimeOptions realtimeOptions;
+
+    struct EncoderCounters *counters;
+
+    BOOL running;
+    pthread_t thread;
+};
+
+static inline int EncoderChannelGetState(const struct EncoderChannel *channel,
+                                         const uint32_t *words) {
+    return ((words[channel->bankA] & channel->maskA) ? 0x2 : 0x0) |
+           ((words[channel->bankB] & channel->maskB) ? 0x1 : 0x0);
+}
+
+static void EncoderInfoDecode(EncoderInfoRef info, const uint32_t *words, long long now) {
+    for (int index = 0 ; index < info->count ; index++) {
+        struct EncoderChannel *channel = &info->channels[index];
+        int state = EncoderChannelGetState(channel, words);
+        if (state == channel->state)
+            continue;
+
+        int step = ENCODER_TRANSITIONS[(channel->state << 2) | state];
+        channel->state = state;
+
+        // the sequence is odd while the counters change
+        struct EncoderCounters *counters = &info->counters[index];
+        __atomic_store_n(&counters->sequence, counters->sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        if (2 == step)
+            __atomic_store_n(&counters->errors, counters->errors + 1, __ATOMIC_RELAXED);
+        else
+            __atomic_store_n(&counters->position, counters->position + step, __ATOMIC_RELAXED);
+        __atomic_store_n(&counters->timestamp, now, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&counters->sequence, counters->sequence + 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void *EncoderInfoRun(void *argument) {
+    EncoderInfoRef info = argument;
+    uint32_t words[2 * ENCODER_COUNT];
+    long long deadline = DelayGetTime();
+
+    struct RealtimeSession session;
+    RealtimeSessionEnter(&session, &info->realtimeOptions);
+
+    while (__atomic_load_n(&info->running, __ATOMIC_ACQUIRE)) {
+        DelayUntilNextSample(&deadline, info->period);
+
+        // the channels are only decoded when one of the words changed
+        if (GPIOInputWordSample(info->banks, info->bankCount, words))
+            EncoderInfoDecode(info, words, DelayGetTime());
+    }
+
+    RealtimeSessionExit(&session);
+    return NULL;
+}
+
+EncoderInfoRef EncoderInfoCreate(GPIOInfoRef gpioInfo, const int *pins, int count, int rate,
+                                 int cpu, int priority) {
+    if (count <= 0 || count > ENCODER_COUNT)
+        return NULL;
+
+    EncoderInfoRef info = calloc(1, sizeof(struct EncoderInfo));
+
+    for (int index = 0 ; index < count ; index++) {
+        struct EncoderChannel *channel = &info->channels[index];
+        channel->bankA = (pins[2 * index] >= 0 && pins[2 * index] < 64) ?
+                GPIOInfoAddInputWord(gpioInfo, info->banks, &info->bankCount, pins[2 * index],
+                                     &channel->maskA) : -1;
+        channel->bankB = (pins[2 * index + 1] >= 0 && pins[2 * index + 1] < 64) ?
+                GPIOInfoAddInputWord(gpioInfo, info->banks, &info->bankCount, pins[2 * index + 1],
+                                     &channel->maskB) : -1;
+
+        if (channel->bankA < 0 || channel->bankB < 0) {
+            LOG_ERROR("The pins of encoder %d are not exported in register mode", index);
+            free(info);
+            return NULL;
+        }
+    }
+
+    info->count = count;
+    info->period = (rate > 0) ? 1000000000ll / rate : 0;
+    info->realtimeOptions = (struct RealtimeOptions){ .cpu = cpu, .priority = priority };
+
+    if (posix_memalign((void **)&info->counters, 64, ENCODER_COUNTERS_SIZE * count) != 0) {
+        free(info);
+        return NULL;
+    }
+    memset(info->counters, 0x0, ENCODER_COUNTERS_SIZE * count);
+
+    // the states before the thread starts are the references of the first transitions
+    uint32_t words[2 * ENCODER_COUNT];
+    GPIOInputWordSample(info->banks, info->bankCount, words);
+
+    for (int index = 0 ; index < count ; index++)
+        info->channels[index].state = EncoderChannelGetState(&info->channels[index], words);
+
+    info->gpioInfo = GPIOInfoRetain(gpioInfo);
+
+    info->running = TRUE;
+    if (pthread_create(&info->thread, NULL, EncoderInfoRun, info) != 0) {
+        LOG_ERROR("Unable to start the encoder thread");
+        GPIOInfoFree(gpioInfo);
+        free(info->counters);
+        free(info);
+        return NULL;
+    }
+
+    return info;
+}
+
+void EncoderInfoFree(EncoderInfoRef info) {
+    __atomic_store_n(&info->running, FALSE, __ATOMIC_RELEASE);
+    pthread_join(info->thread, NULL);
+
+    GPIOInfoFree(info->gpioInfo);
+    free(info->counters);
+    free(info);
+}
+
+struct EncoderCounters *EncoderInfoGetCounters(EncoderInfoRef info, size_t *size) {
+    if (size)
+        *size = ENCODER_COUNTERS_SIZE * info->count;
+
+    return info->counters;
+}
+
+void EncoderInfoReadCounters(EncoderInfoRef info, int encoder, struct EncoderCounters *counters) {
+    const struct EncoderCounters *source = &info->counters[encoder];
+
+    while (TRUE) {
+        uint32_t sequence = __atomic_load_n(&source->sequence, __ATOMIC_ACQUIRE);
+        if (sequence & 0x1)
+            continue;
+
+        counters->position = __atomic_load_n(&source->position, __ATOMIC_RELAXED);
+        counters->errors = __atomic_load_n(&source->errors, __ATOMIC_RELAXED);
+        counters->timestamp = __atomic_load_n(&source->timestamp, __ATOMIC_RELAXED);
+
+        // the loads of the counters may not move after the second load of the sequence
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&source->sequence, __ATOMIC_RELAXED) == sequence) {
+            counters->sequence = sequence;
+            counters->reserved = 0;
+            return;
+        }
+    }
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_cdoapps_gpio_Encoder_start(JNIEnv *env, jobject thiz, jobject gpio, jintArray pins,
+                                    jint rate, jint cpu, jint priority) {
+    EncoderInfoRef info = (EncoderInfoRef)Java_com_cdoapps_gpio_Encoder_getReserved(env, thiz);
+    if (info)
+        EncoderInfoFree(info);
+
+    Java_com_cdoapps_gpio_Encoder_setReserved(env, thiz, 0l);
+
+    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, gpio);
+    int count = (*env)->GetArrayLength(env, pins) / 2;
+    if (!gpioInfo || count <= 0 || count > ENCODER_COUNT)
+        return NULL;
+
+    jint values[2 * ENCODER_COUNT];
+    (*env)->GetIntArrayRegion(env, pins, 0, 2 * count, values);
+
+    info = EncoderInfoCreate(gpioInfo, (const int *)values, count, rate, cpu, priority);
+    if (!info)
+        return NULL;
+
+    Java_com_cdoapps_gpio_Encoder_setReserved(env, thiz, (jlong)info);
+
+    size_t size = 0;
+    void *counters = EncoderInfoGetCounters(info, &size);
+    return (*env)->NewDirectByteBuffer(env, counters, (jlong)size);
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Encoder_nativeStop(JNIEnv *env, jobject thiz) {
+    EncoderInfoRef info = (EncoderInfoRef)Java_com_cdoapps_gpio_Encoder_getReserved(env, thiz);
+    if (info) {
+        EncoderInfoFree(info);
+        Java_com_cdoapps_gpio_Encoder_setReserved(env, thiz, 0l);
+    }
+}
+
+// The following methods are registered by JNI_OnLoad.
+
+static jlong
+Java_com_cdoapps_gpio_Encoder_criticalReadCounter(jlong info, jint encoder, jint offset) {
+    if (!info || encoder < 0 || encoder >= ((EncoderInfoRef)info)->count)
+        return 0l;
+
+    struct EncoderCounters counters;
+    EncoderInfoReadCounters((EncoderInfoRef)info, encoder, &counters);
+
+    switch (offset) {
+        case offsetof(struct EncoderCounters, position):
+            return counters.position;
+        case offsetof(struct EncoderCounters, errors):
+            return counters.errors;
+        case offsetof(struct EncoderCounters, timestamp):
+            return counters.timestamp;
+        default:
+            return 0l;
+    }
+}
+
+static jlong
+Java_com_cdoapps_gpio_Encoder_nativeReadCounter(JNIEnv * env, jclass clazz, jlong info,
+                                                jint encoder, jint offset) {
+    return Java_com_cdoapps_gpio_Encoder_criticalReadCounter(info, encoder, offset);
+}
+
+static void
+Java_com_cdoapps_gpio_Encoder_nativeReadCounters(JNIEnv * env, jclass clazz, jlong info,
+                                                 jint encoder, jlongArray values) {
+    struct EncoderCounters counters = { .position = 0, .errors = 0, .timestamp = 0 };
+    if (info && encoder >= 0 && encoder < ((EncoderInfoRef)info)->count)
+        EncoderInfoReadCounters((EncoderInfoRef)info, encoder, &counters);
+
+    jlong result[] = { counters.position, counters.errors, counters.timestamp };
+    (*env)->SetLongArrayRegion(env, values, 0, 3, result);
+}
+
+BOOL Java_com_cdoapps_gpio_Encoder_registerNatives(JNIEnv *env, BOOL critical) {
+    const JNINativeMethod methods[] = {
+            {"nativeReadCounter", "(JII)J", critical ?
+                    (void *)Java_com_cdoapps_gpio_Encoder_criticalReadCounter :
+                    (void *)Java_com_cdoapps_gpio_Encoder_nativeReadCounter},
+            {"nativeReadCounters", "(JI[J)V",
+                    (void *)Java_com_cdoapps_gpio_Encoder_nativeReadCounters}
+    };
+
+    jclass clazz = (*env)->FindClass(env, "com/cdoapps/gpio/Encoder");
+    if (!clazz || (*env)->RegisterNatives(env, clazz, methods, 2) != JNI_OK)
+        return FALSE;
+    (*env)->DeleteLocalRef(env, clazz);
+
+    return TRUE;
+}
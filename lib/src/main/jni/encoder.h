@@ -0,0 +1,104 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GPIO_ENCODER_H
+#define GPIO_ENCODER_H
+
+#include "gpio.h"
+
+#include <stddef.h>
+
+/**
+ * The maximum number of encoders of an {@code EncoderInfo} object.
+ */
+#define ENCODER_COUNT 16
+
+/**
+ * The size in bytes of the counters of one encoder in the counter block.
+ */
+#define ENCODER_COUNTERS_SIZE 32
+
+/**
+ * The {@code EncoderCounters} struct holds the counts of one encoder. The counter block is an
+ * array of them, shared with the readers without any lock.
+ *
+ * The writer makes {@code sequence} odd while it changes the other fields, thus a reader retries
+ * until it reads the same even sequence before and after them (a 64-bit value may otherwise tear
+ * on 32-bit CPUs). The first load of the sequence needs acquire semantics, and the loads of the
+ * fields must be ordered before the second one, see {@code EncoderInfoReadCounters}.
+ */
+struct EncoderCounters {
+    uint32_t sequence;
+    uint32_t reserved;
+    /**
+     * The number of steps forward minus the number of steps backward.
+     */
+    int64_t position;
+    /**
+     * The number of transitions where both A and B changed, which means that a step was missed.
+     */
+    int64_t errors;
+    /**
+     * The time of the last transition in nanoseconds of {@code CLOCK_MONOTONIC}.
+     */
+    int64_t timestamp;
+};
+
+/**
+ * The {@code EncoderInfo} struct represents a thread sampling the A/B inputs of quadrature
+ * encoders through the input registers, and decoding their transitions with a lookup table.
+ */
+typedef struct EncoderInfo *EncoderInfoRef;
+
+/**
+ * Returns an {@code EncoderInfo} object decoding many encoders, and starts its thread.
+ *
+ * @param gpioInfo a {@code GPIOInfo} object representing the GPIO controller.
+ * @param pins the WiringPi addresses of the A and B pins of each encoder, which must be exported
+ *             in register mode.
+ * @param count the number of encoders, up to {@code ENCODER_COUNT}.
+ * @param rate the sampling rate in Hz, or {@code 0} to sample as fast as possible.
+ * @param cpu the index of the CPU running the thread, {@code REALTIME_CPU_ISOLATED}, or {@code -1}
+ *            to let the scheduler choose.
+ * @param priority the {@code SCHED_FIFO} priority of the thread, or {@code 0} to use the default
+ *                 policy.
+ * @return an {@code EncoderInfo} object, or {@code NULL} on error.
+ */
+EncoderInfoRef EncoderInfoCreate(GPIOInfoRef gpioInfo, const int *pins, int count, int rate,
+                                 int cpu, int priority);
+/**
+ * Stops the thread of a decoder and destroys the resources associated to it.
+ *
+ * @param info an {@code EncoderInfo} object representing the decoder to destroy.
+ */
+void EncoderInfoFree(EncoderInfoRef info);
+
+/**
+ * Returns the counter block of a decoder, {@code ENCODER_COUNTERS_SIZE} bytes per encoder.
+ *
+ * @param info an {@code EncoderInfo} object representing the decoder.
+ * @param size if not {@code NULL}, set the size of the counter block in bytes on return.
+ * @return the counters of the encoders, in the order of their pins.
+ */
+struct EncoderCounters *EncoderInfoGetCounters(EncoderInfoRef info, size_t *size);
+/**
+ * Reads a consistent copy of the counters of one encoder, retrying while the thread changes them.
+ *
+ * @param info an {@code EncoderInfo} object representing the decoder.
+ * @param encoder the index of the encoder, in the order of the pins.
+ * @param counters set to the counters of the encoder on return.
+ */
+void EncoderInfoReadCounters(EncoderInfoRef info, int encoder, struct EncoderCounters *counters);
+
+#endif //GPIO_ENCODER_H
@@ -13,33 +13,68 @@
 // limitations under the License.
 
 #include "common.h"
+#include "bindings.h"
 #include "gpio.h"
+#include "delay.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
 #include <sys/mman.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <linux/futex.h>
+#include <linux/gpio.h>
+
 #define GPIO_REGISTERS_N2_BASE 0xff634000
 #define GPIO_REGISTERS_N2_MEMORY_SIZE 4096
 #define GPIO_REGISTERS_MEMORY "/dev/mem"
 #define GPIO_REGISTERS_GPIO_MEMORY "/dev/gpiomem"
 
+// the number of times a thread checks a contended register lock before sleeping on it
+#define GPIO_REGISTER_LOCK_SPINS 100
+
 #define GPIO_SYSFS_ROOT "/sys/class/gpio"
 
+#define GPIO_CDEV_CHIP "/dev/gpiochip%d"
+#define GPIO_CDEV_CHIP_COUNT 16
+#define GPIO_CDEV_CHIP_LABEL "periphs"
+#define GPIO_CDEV_CHIP_VARIABLE "GPIO_CDEV_CHIP"
+#define GPIO_CDEV_CONSUMER "com.cdoapps.gpio"
+// The sysfs number of the first line of the periphs chip, used when the lines have no name.
+#define GPIO_CDEV_N2_BASE 410
+#define GPIO_CDEV_GROUP_COUNT 8
+// The output register word of the GPIOX bank, the other pins belong to the GPIOA bank.
+#define GPIO_REGISTERS_N2_GPIOX_SET 279
+
+// The header pins belong to the GPIOX and GPIOA banks.
+#define GPIO_REGISTERS_N2_BANK_COUNT 2
+
+#define GPIO_EDGE_QUEUE_SIZE 16
+
+#define GPIO_BACKEND_VARIABLE "GPIO_BACKEND"
+#define GPIO_BACKEND_SIMULATED "simulated"
+#define GPIO_SIMULATED_REGISTERS_VARIABLE "GPIO_SIMULATED_REGISTERS"
+
 typedef enum {
     GPIOAccessNone,
     GPIOAccessRegisters,
-    GPIOAccessSysfs
+    GPIOAccessSysfs,
+    GPIOAccessCdev
 } GPIOAccess;
 
 struct GPIOPin {
     GPIOAccess access;
+    GPIOPinMode mode;
     int number;
 
     struct GPIOPinRegisters {
@@ -59,43 +94,64 @@ struct GPIOPin {
         int pull;
         int value;
     } sysfs;
+
+    struct GPIOPinCdev {
+        int line;
+        int request; // the request of the line, -1 if not requested or grouped
+        int group; // the index of the group holding the line, -1 if not grouped
+        uint64_t bias;
+        int value;
+    } cdev;
+
+    int bank; // the index of the bank in the GPIOInfo, -1 for the pins without registers
+
+    struct GPIOPinHandle handle;
+    BOOL handed; // the handle was returned since the pin was exported
+
+    GPIOEdge edge;
+    struct GPIOPinEvents {
+        struct GPIOEdgeEvent queue[GPIO_EDGE_QUEUE_SIZE];
+        int first;
+        int count;
+        BOOL reading;
+    } events;
 };
 
 // This wiringPi gpio map was found here:
 // https://github.com/hardkernel/wiringPi/blob/master/wiringPi/odroidn2.c
 static const struct GPIOPin GPIO_N2_PINS[] = {
         {.access = GPIOAccessNone, .number = 479, .registers = {.offset = 3, .target = 12, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 435}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 492, .registers = {.offset = 16, .target = 64, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 437}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 492, .registers = {.offset = 16, .target = 0, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 437}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = 480, .registers = {.offset = 4, .target = 16, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 435}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = 483, .registers = {.offset = 7, .target = 28, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 435}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = 476, .registers = {.offset = 0, .target = 0, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 435}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = 477, .registers = {.offset = 1, .target = 4, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 435}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = 478, .registers = {.offset = 2, .target = 8, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 435}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 473, .registers = {.offset = 13, .target = 52, .set = 289, .input = 290, .pullUpDownEnable = 333, .pullUpDown = 319, .function = 288, .mux = 446}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 493, .registers = {.offset = 17, .target = 68, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 437}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 494, .registers = {.offset = 18, .target = 72, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 437}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 486, .registers = {.offset = 10, .target = 40, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 473, .registers = {.offset = 13, .target = 20, .set = 289, .input = 290, .pullUpDownEnable = 333, .pullUpDown = 319, .function = 288, .mux = 446}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 493, .registers = {.offset = 17, .target = 4, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 437}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 494, .registers = {.offset = 18, .target = 8, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 437}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 486, .registers = {.offset = 10, .target = 8, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = 464, .registers = {.offset = 4, .target = 16, .set = 289, .input = 290, .pullUpDownEnable = 333, .pullUpDown = 319, .function = 288, .mux = 445}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 484, .registers = {.offset = 8, .target = 32, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 485, .registers = {.offset = 9, .target = 36, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 487, .registers = {.offset = 11, .target = 44, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 488, .registers = {.offset = 12, .target = 48, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 489, .registers = {.offset = 13, .target = 52, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 484, .registers = {.offset = 8, .target = 0, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 485, .registers = {.offset = 9, .target = 4, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 487, .registers = {.offset = 11, .target = 12, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 488, .registers = {.offset = 12, .target = 16, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 489, .registers = {.offset = 13, .target = 20, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = -1, .registers = {.offset = -1, .target = -1, .set = -1, .input = -1, .pullUpDownEnable = -1, .pullUpDown = -1, .function = -1, .mux = -1}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = -1, .registers = {.offset = -1, .target = -1, .set = -1, .input = -1, .pullUpDownEnable = -1, .pullUpDown = -1, .function = -1, .mux = -1}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = -1, .registers = {.offset = -1, .target = -1, .set = -1, .input = -1, .pullUpDownEnable = -1, .pullUpDown = -1, .function = -1, .mux = -1}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = -1, .registers = {.offset = -1, .target = -1, .set = -1, .input = -1, .pullUpDownEnable = -1, .pullUpDown = -1, .function = -1, .mux = -1}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 490, .registers = {.offset = 14, .target = 56, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 491, .registers = {.offset = 15, .target = 60, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 490, .registers = {.offset = 14, .target = 24, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 491, .registers = {.offset = 15, .target = 28, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 436}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = 481, .registers = {.offset = 5, .target = 20, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 435}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = 482, .registers = {.offset = 6, .target = 24, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 435}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = -1, .registers = {.offset = -1, .target = -1, .set = -1, .input = -1, .pullUpDownEnable = -1, .pullUpDown = -1, .function = -1, .mux = -1}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 472, .registers = {.offset = 12, .target = 48, .set = 289, .input = 290, .pullUpDownEnable = 333, .pullUpDown = 319, .function = 288, .mux = 446}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 495, .registers = {.offset = 19, .target = 76, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 437}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 472, .registers = {.offset = 12, .target = 16, .set = 289, .input = 290, .pullUpDownEnable = 333, .pullUpDown = 319, .function = 288, .mux = 446}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 495, .registers = {.offset = 19, .target = 12, .set = 279, .input = 280, .pullUpDownEnable = 330, .pullUpDown = 316, .function = 278, .mux = 437}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = -1, .registers = {.offset = -1, .target = -1, .set = -1, .input = -1, .pullUpDownEnable = -1, .pullUpDown = -1, .function = -1, .mux = -1}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = -1, .registers = {.offset = -1, .target = -1, .set = -1, .input = -1, .pullUpDownEnable = -1, .pullUpDown = -1, .function = -1, .mux = -1}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 474, .registers = {.offset = 14, .target = 56, .set = 289, .input = 290, .pullUpDownEnable = 333, .pullUpDown = 319, .function = 288, .mux = 446}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
-        {.access = GPIOAccessNone, .number = 475, .registers = {.offset = 15, .target = 60, .set = 289, .input = 290, .pullUpDownEnable = 333, .pullUpDown = 319, .function = 288, .mux = 446}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 474, .registers = {.offset = 14, .target = 24, .set = 289, .input = 290, .pullUpDownEnable = 333, .pullUpDown = 319, .function = 288, .mux = 446}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
+        {.access = GPIOAccessNone, .number = 475, .registers = {.offset = 15, .target = 28, .set = 289, .input = 290, .pullUpDownEnable = 333, .pullUpDown = 319, .function = 288, .mux = 446}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = -1, .registers = {.offset = -1, .target = -1, .set = -1, .input = -1, .pullUpDownEnable = -1, .pullUpDown = -1, .function = -1, .mux = -1}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = -1, .registers = {.offset = -1, .target = -1, .set = -1, .input = -1, .pullUpDownEnable = -1, .pullUpDown = -1, .function = -1, .mux = -1}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
         {.access = GPIOAccessNone, .number = -1, .registers = {.offset = -1, .target = -1, .set = -1, .input = -1, .pullUpDownEnable = -1, .pullUpDown = -1, .function = -1, .mux = -1}, .sysfs = {.direction = -1, .pull = -1, .value = -1}},
@@ -131,37 +187,552 @@ static const struct GPIOPin GPIO_N2_PINS[] = {
 };
 
 struct GPIOInfo {
+    int references;
     GPIOAccess access;
+    GPIOBackend backend;
 
     struct GPIORegisters {
         int file;
         volatile uint32_t *memory;
+        int locks[GPIO_REGISTERS_N2_MEMORY_SIZE / sizeof(uint32_t)];
     } registers;
 
+    // the words shared by the pins of each bank, resolved once for the masks
+    struct GPIOBank {
+        int set;
+        int function;
+        int input;
+    } banks[GPIO_REGISTERS_N2_BANK_COUNT];
+    int bankCount;
+
     struct GPIOSysfs {
         int export;
         int unexport;
     } sysfs;
 
+    struct GPIOCdev {
+        int chip;
+        // the lines read or changed together by the masks, moved from their own requests to
+        // group requests in the order of their pins, a free group having no request
+        struct GPIOCdevGroup {
+            int request;
+            uint64_t pins;
+        } groups[GPIO_CDEV_GROUP_COUNT];
+        uint64_t groupPins; // the pins of all the groups
+        // guards the requests of the lines, which the group takes over
+        pthread_mutex_t lock;
+    } cdev;
+
+    // a single thread reads the events of a line into the queue of its pin, the other ones waiting
+    // for that pin wait for the condition
+    struct GPIOEvents {
+        pthread_mutex_t lock;
+        pthread_cond_t condition;
+    } events;
+
+    struct GPIOShadow {
+        BOOL enabled;
+        uint32_t words[GPIO_REGISTERS_N2_MEMORY_SIZE / sizeof(uint32_t)];
+    } shadow;
+
+    struct GPIOSimulator {
+        GPIOSimulatorWriteCallback callback;
+        void *context;
+    } simulator;
+
     struct GPIOPin pins[64];
 };
 
+// The character device access requests each exported line on its own, so exporting or unexporting
+// a pin never releases the lines of the other pins. The request of a line is reconfigured in place
+// when the mode, the bias or the edge of its pin changes.
+//
+// The lines first read or changed together by GPIOInfoReadMask or GPIOInfoWriteMask are moved to
+// a group request, so that one ioctl reads or changes all of them. A line can not move from one
+// request to another, thus the lines a mask reaches later form a new group, and the existing
+// groups are never requested again. A grouped line is reconfigured in place through the per-line
+// attributes of its group. The kernel reports the edges of a request on its own file, thus the
+// lines reporting edges leave their group, whose other lines get their own requests back, as
+// they do when one of its pins is unexported.
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+static int GPIOCdevOpenChip(void) {
+    const char *path = getenv(GPIO_CDEV_CHIP_VARIABLE);
+    if (path && *path)
+        return open(path, O_RDWR | O_CLOEXEC);
+
+    for (int index = 0 ; index < GPIO_CDEV_CHIP_COUNT ; index++) {
+        char buf[64] = "";
+        sprintf(buf, GPIO_CDEV_CHIP, index);
+
+        int chip = open(buf, O_RDWR | O_CLOEXEC);
+        if (chip == -1)
+            continue;
+
+        struct gpiochip_info chipInfo;
+        memset(&chipInfo, 0x0, sizeof(chipInfo));
+        if (ioctl(chip, GPIO_GET_CHIPINFO_IOCTL, &chipInfo) == 0 &&
+            strstr(chipInfo.label, GPIO_CDEV_CHIP_LABEL))
+            return chip;
+
+        close(chip);
+    }
+
+    return -1;
+}
 
-GPIOInfoRef GPIOInfoAlloc(void) {
-    GPIOInfoRef info = malloc(sizeof(struct GPIOInfo));
+static int GPIOCdevFindLine(GPIOInfoRef info, const struct GPIOPin *pinInfo) {
+    char name[GPIO_MAX_NAME_SIZE] = "";
+    snprintf(name, sizeof(name), "%s_%d",
+             (GPIO_REGISTERS_N2_GPIOX_SET == pinInfo->registers.set) ? "GPIOX" : "GPIOA",
+             pinInfo->registers.offset);
+
+    struct gpiochip_info chipInfo;
+    memset(&chipInfo, 0x0, sizeof(chipInfo));
+    if (ioctl(info->cdev.chip, GPIO_GET_CHIPINFO_IOCTL, &chipInfo) == 0) {
+        for (unsigned int line = 0 ; line < chipInfo.lines ; line++) {
+            struct gpio_v2_line_info lineInfo;
+            memset(&lineInfo, 0x0, sizeof(lineInfo));
+            lineInfo.offset = line;
+
+            if (ioctl(info->cdev.chip, GPIO_V2_GET_LINEINFO_IOCTL, &lineInfo) == 0 &&
+                strcmp(lineInfo.name, name) == 0)
+                return (int)line;
+        }
+    }
 
-    info->access = GPIOAccessNone;
+    return pinInfo->number - GPIO_CDEV_N2_BASE;
+}
 
-    info->registers.file = -1;
-    info->registers.memory = NULL;
+static uint64_t GPIOCdevGetFlags(const struct GPIOPin *pinInfo) {
+    switch (pinInfo->mode) {
+        case GPIOPinModeOutput:
+            return GPIO_V2_LINE_FLAG_OUTPUT | pinInfo->cdev.bias;
+
+        case GPIOPinModeOpenDrain:
+            return GPIO_V2_LINE_FLAG_OUTPUT | GPIO_V2_LINE_FLAG_OPEN_DRAIN | pinInfo->cdev.bias;
+
+        default:
+            break;
+    }
+
+    uint64_t flags = GPIO_V2_LINE_FLAG_INPUT | pinInfo->cdev.bias;
+    if (GPIOEdgeRising == pinInfo->edge || GPIOEdgeBoth == pinInfo->edge)
+        flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+    if (GPIOEdgeFalling == pinInfo->edge || GPIOEdgeBoth == pinInfo->edge)
+        flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+
+    return flags;
+}
+
+static void GPIOCdevGetConfig(const struct GPIOPin *pinInfo, struct gpio_v2_line_config *config) {
+    memset(config, 0x0, sizeof(*config));
+    config->flags = GPIOCdevGetFlags(pinInfo);
+
+    if (config->flags & GPIO_V2_LINE_FLAG_OUTPUT) {
+        config->attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        config->attrs[0].attr.values = pinInfo->cdev.value ? 0x1 : 0x0;
+        config->attrs[0].mask = 0x1;
+        config->num_attrs = 1;
+    }
+}
+
+// must be called with the cdev lock held
+static BOOL GPIOCdevRequest(GPIOInfoRef info, struct GPIOPin *pinInfo) {
+    struct gpio_v2_line_request request;
+    memset(&request, 0x0, sizeof(request));
+
+    request.offsets[0] = (uint32_t)pinInfo->cdev.line;
+    request.num_lines = 1;
+    strcpy(request.consumer, GPIO_CDEV_CONSUMER);
+    GPIOCdevGetConfig(pinInfo, &request.config);
+
+    if (ioctl(info->cdev.chip, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+        LOG_ERROR("Unable to request the gpio line %d", pinInfo->cdev.line);
+        return FALSE;
+    }
+
+    pinInfo->cdev.request = request.fd;
+    return TRUE;
+}
+
+// must be called with the cdev lock held
+static void GPIOCdevRelease(struct GPIOPin *pinInfo) {
+    if (pinInfo->cdev.request != -1) {
+        close(pinInfo->cdev.request);
+        pinInfo->cdev.request = -1;
+    }
+}
+
+// Must be called with the cdev lock held. Closes one group, whose lines get their own requests
+// back but the ones of 'excluded'.
+static void GPIOCdevUngroup(GPIOInfoRef info, int group, uint64_t excluded) {
+    struct GPIOCdevGroup *groupInfo = &info->cdev.groups[group];
+    if (groupInfo->request == -1)
+        return;
+
+    close(groupInfo->request);
+    groupInfo->request = -1;
+
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        if (!(groupInfo->pins & (0x1ull << pin)))
+            continue;
+
+        info->pins[pin].cdev.group = -1;
+        if (!(excluded & (0x1ull << pin)))
+            GPIOCdevRequest(info, &info->pins[pin]);
+    }
+
+    info->cdev.groupPins &= ~groupInfo->pins;
+    groupInfo->pins = 0x0;
+}
+
+// Lines sharing the same flags are grouped in one attribute, the last attribute being kept for
+// the values of the outputs.
+static BOOL GPIOCdevGetGroupConfig(GPIOInfoRef info, uint64_t pins,
+                                   struct gpio_v2_line_config *config) {
+    uint64_t outputs = 0x0;
+    uint64_t values = 0x0;
+    int index = 0;
+
+    memset(config, 0x0, sizeof(*config));
+    config->flags = GPIO_V2_LINE_FLAG_INPUT;
+
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        if (!(pins & (0x1ull << pin)))
+            continue;
+
+        const struct GPIOPin *pinInfo = &info->pins[pin];
+        uint64_t bit = 0x1ull << index++;
+        uint64_t flags = GPIOCdevGetFlags(pinInfo);
+
+        if (flags & GPIO_V2_LINE_FLAG_OUTPUT) {
+            outputs |= bit;
+            if (pinInfo->cdev.value)
+                values |= bit;
+        }
+
+        unsigned int attribute = 0;
+        while (attribute < config->num_attrs && config->attrs[attribute].attr.flags != flags)
+            attribute++;
+
+        if (attribute == config->num_attrs) {
+            if (attribute == GPIO_V2_LINE_NUM_ATTRS_MAX - 1)
+                return FALSE;
+
+            config->attrs[attribute].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+            config->attrs[attribute].attr.flags = flags;
+            config->num_attrs++;
+        }
+
+        config->attrs[attribute].mask |= bit;
+    }
+
+    if (outputs) {
+        struct gpio_v2_line_config_attribute *attribute = &config->attrs[config->num_attrs++];
+        attribute->attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        attribute->attr.values = values;
+        attribute->mask = outputs;
+    }
+
+    return TRUE;
+}
+
+// Must be called with the cdev lock held. Moves the ungrouped lines of 'pins' to a new group, a
+// line being held by one request at a time. Returns FALSE if they keep their own requests.
+static BOOL GPIOCdevGroup(GPIOInfoRef info, uint64_t pins) {
+    pins &= ~info->cdev.groupPins;
+
+    // a single line is as fast on its own request
+    if (__builtin_popcountll(pins) < 2)
+        return FALSE;
+
+    int group = 0;
+    while (group < GPIO_CDEV_GROUP_COUNT && info->cdev.groups[group].request != -1)
+        group++;
+
+    if (group == GPIO_CDEV_GROUP_COUNT)
+        return FALSE;
+
+    struct gpio_v2_line_request request;
+    memset(&request, 0x0, sizeof(request));
+
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        if (pins & (0x1ull << pin))
+            request.offsets[request.num_lines++] = (uint32_t)info->pins[pin].cdev.line;
+    }
+
+    strcpy(request.consumer, GPIO_CDEV_CONSUMER);
+    if (!GPIOCdevGetGroupConfig(info, pins, &request.config))
+        return FALSE;
+
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        if (pins & (0x1ull << pin))
+            GPIOCdevRelease(&info->pins[pin]);
+    }
+
+    if (ioctl(info->cdev.chip, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+        LOG_ERROR("Unable to request %u gpio lines", request.num_lines);
+
+        for (int pin = 0 ; pin < 64 ; pin++) {
+            if (pins & (0x1ull << pin))
+                GPIOCdevRequest(info, &info->pins[pin]);
+        }
+
+        return FALSE;
+    }
+
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        if (pins & (0x1ull << pin))
+            info->pins[pin].cdev.group = group;
+    }
+
+    info->cdev.groups[group] = (struct GPIOCdevGroup){ .request = request.fd, .pins = pins };
+    info->cdev.groupPins |= pins;
+    return TRUE;
+}
+
+// must be called with the cdev lock held, returns the request holding the line of one pin and the
+// bit of the line in this request
+static int GPIOCdevGetRequest(GPIOInfoRef info, int pin, uint64_t *bit) {
+    const struct GPIOPin *pinInfo = &info->pins[pin];
+
+    if (pinInfo->cdev.group != -1) {
+        const struct GPIOCdevGroup *groupInfo = &info->cdev.groups[pinInfo->cdev.group];
+        *bit = 0x1ull << __builtin_popcountll(groupInfo->pins & ((0x1ull << pin) - 1));
+        return groupInfo->request;
+    }
+
+    *bit = 0x1;
+    return pinInfo->cdev.request;
+}
+
+static BOOL GPIOCdevConfigure(GPIOInfoRef info, int pin) {
+    struct GPIOPin *pinInfo = &info->pins[pin];
+    struct gpio_v2_line_config config;
+    BOOL configured = FALSE;
+
+    pthread_mutex_lock(&info->cdev.lock);
+
+    // the group is reconfigured with the attributes of all its lines, unless the line reports
+    // edges or its flags do not fit
+    int group = pinInfo->cdev.group;
+    if (group != -1) {
+        if (GPIOEdgeNone == pinInfo->edge &&
+            GPIOCdevGetGroupConfig(info, info->cdev.groups[group].pins, &config))
+            configured = ioctl(info->cdev.groups[group].request, GPIO_V2_LINE_SET_CONFIG_IOCTL,
+                               &config) == 0;
+
+        if (!configured)
+            GPIOCdevUngroup(info, group, 0x0);
+    }
+
+    if (!configured) {
+        GPIOCdevGetConfig(pinInfo, &config);
+        configured = pinInfo->cdev.request != -1 &&
+                ioctl(pinInfo->cdev.request, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config) == 0;
+    }
+
+    pthread_mutex_unlock(&info->cdev.lock);
+
+    if (!configured)
+        LOG_ERROR("Unable to configure the gpio line %d", pinInfo->cdev.line);
+
+    return configured;
+}
+
+static void GPIOCdevSetValue(GPIOInfoRef info, int pin, int value) {
+    uint64_t bit;
+
+    pthread_mutex_lock(&info->cdev.lock);
+
+    int request = GPIOCdevGetRequest(info, pin, &bit);
+    struct gpio_v2_line_values values = { .bits = value ? bit : 0x0, .mask = bit };
+    if (request != -1)
+        ioctl(request, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+
+    pthread_mutex_unlock(&info->cdev.lock);
+}
+
+static uint64_t GPIOCdevGetBias(GPIOPinPull pull) {
+    switch (pull) {
+        case GPIOPinPullDown:
+            return GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN;
+
+        case GPIOPinPullUp:
+            return GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+
+        default:
+            return GPIO_V2_LINE_FLAG_BIAS_DISABLED;
+    }
+}
+
+static int GPIOCdevGetValue(GPIOInfoRef info, int pin) {
+    uint64_t bit;
+
+    pthread_mutex_lock(&info->cdev.lock);
+
+    int request = GPIOCdevGetRequest(info, pin, &bit);
+    struct gpio_v2_line_values values = { .bits = 0x0, .mask = bit };
+    BOOL read = request != -1 && ioctl(request, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == 0;
+
+    pthread_mutex_unlock(&info->cdev.lock);
+
+    if (!read)
+        return -1;
+
+    return (values.bits & bit) ? GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW;
+}
+
+// the lines of the pins without edges are grouped, the other ones are read or changed one by one
+static uint64_t GPIOCdevGetGroupedPins(GPIOInfoRef info, uint64_t mask) {
+    uint64_t pins = 0x0;
+
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        const struct GPIOPin *pinInfo = &info->pins[pin];
+        if ((mask & (0x1ull << pin)) && GPIOEdgeNone == pinInfo->edge &&
+            (pinInfo->cdev.group != -1 || pinInfo->cdev.request != -1))
+            pins |= (0x1ull << pin);
+    }
+
+    GPIOCdevGroup(info, pins);
+    return pins & info->cdev.groupPins;
+}
+
+static void GPIOCdevWriteMask(GPIOInfoRef info, uint64_t mask, uint64_t values) {
+    pthread_mutex_lock(&info->cdev.lock);
+
+    uint64_t grouped = GPIOCdevGetGroupedPins(info, mask);
+    struct gpio_v2_line_values lines[GPIO_CDEV_GROUP_COUNT];
+    memset(lines, 0x0, sizeof(lines));
+
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        if (!(mask & (0x1ull << pin)))
+            continue;
+
+        struct GPIOPin *pinInfo = &info->pins[pin];
+        int value = (values & (0x1ull << pin)) ? GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW;
+        uint64_t bit;
+        int request = GPIOCdevGetRequest(info, pin, &bit);
+
+        // the values of the inputs can not be set, which would fail the whole group
+        if (GPIOPinModeInput == pinInfo->mode || request == -1)
+            continue;
+
+        pinInfo->cdev.value = value;
+        if (grouped & (0x1ull << pin)) {
+            lines[pinInfo->cdev.group].mask |= bit;
+            if (value)
+                lines[pinInfo->cdev.group].bits |= bit;
+        } else {
+            struct gpio_v2_line_values line = { .bits = value ? bit : 0x0, .mask = bit };
+            ioctl(request, GPIO_V2_LINE_SET_VALUES_IOCTL, &line);
+        }
+    }
+
+    for (int group = 0 ; group < GPIO_CDEV_GROUP_COUNT ; group++) {
+        if (lines[group].mask)
+            ioctl(info->cdev.groups[group].request, GPIO_V2_LINE_SET_VALUES_IOCTL, &lines[group]);
+    }
+
+    pthread_mutex_unlock(&info->cdev.lock);
+}
+
+static uint64_t GPIOCdevReadMask(GPIOInfoRef info, uint64_t mask) {
+    uint64_t values = 0x0;
+
+    pthread_mutex_lock(&info->cdev.lock);
+
+    uint64_t grouped = GPIOCdevGetGroupedPins(info, mask);
+    struct gpio_v2_line_values lines[GPIO_CDEV_GROUP_COUNT];
+    memset(lines, 0x0, sizeof(lines));
+
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        uint64_t bit;
+        if ((grouped & (0x1ull << pin)) && GPIOCdevGetRequest(info, pin, &bit) != -1)
+            lines[info->pins[pin].cdev.group].mask |= bit;
+    }
+
+    for (int group = 0 ; group < GPIO_CDEV_GROUP_COUNT ; group++) {
+        if (lines[group].mask && ioctl(info->cdev.groups[group].request,
+                                       GPIO_V2_LINE_GET_VALUES_IOCTL, &lines[group]) < 0)
+            lines[group].bits = 0x0;
+    }
+
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        if (!(mask & (0x1ull << pin)))
+            continue;
+
+        uint64_t bit;
+        int request = GPIOCdevGetRequest(info, pin, &bit);
+        if (request == -1)
+            continue;
+
+        if (grouped & (0x1ull << pin)) {
+            if (lines[info->pins[pin].cdev.group].bits & bit)
+                values |= (0x1ull << pin);
+            continue;
+        }
+
+        struct gpio_v2_line_values line = { .bits = 0x0, .mask = bit };
+        if (ioctl(request, GPIO_V2_LINE_GET_VALUES_IOCTL, &line) == 0 && (line.bits & bit))
+            values |= (0x1ull << pin);
+    }
+
+    pthread_mutex_unlock(&info->cdev.lock);
+    return values;
+}
+#else
+static int GPIOCdevOpenChip(void) {
+    return -1;
+}
+
+static int GPIOCdevFindLine(GPIOInfoRef info, const struct GPIOPin *pinInfo) {
+    return -1;
+}
+
+static BOOL GPIOCdevRequest(GPIOInfoRef info, struct GPIOPin *pinInfo) {
+    return FALSE;
+}
+
+static void GPIOCdevRelease(struct GPIOPin *pinInfo) {
+}
+
+static void GPIOCdevUngroup(GPIOInfoRef info, int group, uint64_t excluded) {
+}
+
+static BOOL GPIOCdevConfigure(GPIOInfoRef info, int pin) {
+    return FALSE;
+}
+
+static void GPIOCdevSetValue(GPIOInfoRef info, int pin, int value) {
+}
+
+static uint64_t GPIOCdevGetBias(GPIOPinPull pull) {
+    return 0x0;
+}
+
+static int GPIOCdevGetValue(GPIOInfoRef info, int pin) {
+    return -1;
+}
+
+static void GPIOCdevWriteMask(GPIOInfoRef info, uint64_t mask, uint64_t values) {
+}
 
+static uint64_t GPIOCdevReadMask(GPIOInfoRef info, uint64_t mask) {
+    return 0x0;
+}
+#endif
+
+static void GPIOInfoMapDevice(GPIOInfoRef info) {
     if (!getuid())
         info->registers.file = open(GPIO_REGISTERS_MEMORY, O_RDWR | O_SYNC | O_CLOEXEC);
     else if (access(GPIO_REGISTERS_GPIO_MEMORY, 0) == 0)
         info->registers.file = open (GPIO_REGISTERS_GPIO_MEMORY, O_RDWR | O_SYNC | O_CLOEXEC);
 
     if (info->registers.file >= 0) {
-#if defined(__aarch64__)
+        // off_t has 64 bits on aarch64, and on the other C libraries with _FILE_OFFSET_BITS=64
+#if defined(__aarch64__) || !defined(__BIONIC__)
         void *memory = mmap(0, GPIO_REGISTERS_N2_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, info->registers.file, GPIO_REGISTERS_N2_BASE);
 #else
         void *memory = mmap64(0, GPIO_REGISTERS_N2_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, info->registers.file, (off64_t)GPIO_REGISTERS_N2_BASE);
@@ -178,17 +749,179 @@ GPIOInfoRef GPIOInfoAlloc(void) {
     info->sysfs.export = open(GPIO_SYSFS_ROOT "/export", O_WRONLY);
     info->sysfs.unexport = open(GPIO_SYSFS_ROOT "/unexport", O_WRONLY);
 
+    info->cdev.chip = GPIOCdevOpenChip();
+}
+
+// The simulated block is a file shared with another process when one is named by the
+// GPIO_SIMULATED_REGISTERS variable, otherwise anonymous memory.
+static void GPIOInfoMapSimulated(GPIOInfoRef info) {
+    const char *path = getenv(GPIO_SIMULATED_REGISTERS_VARIABLE);
+    void *memory = MAP_FAILED;
+
+    if (path && *path) {
+        info->registers.file = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (info->registers.file < 0) {
+            LOG_ERROR("Unable to open the simulated registers %s", path);
+            return;
+        }
+
+        if (ftruncate(info->registers.file, GPIO_REGISTERS_N2_MEMORY_SIZE) == 0)
+            memory = mmap(0, GPIO_REGISTERS_N2_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          info->registers.file, 0);
+    } else {
+        memory = mmap(0, GPIO_REGISTERS_N2_MEMORY_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    }
+
+    if (memory == MAP_FAILED) {
+        LOG_ERROR("Unable to map the simulated registers");
+        if (info->registers.file != -1) {
+            close(info->registers.file);
+            info->registers.file = -1;
+        }
+    } else {
+        info->registers.memory = memory;
+    }
+}
+
+// Returns the index of the bank of one pin, which is added to the banks of the GPIOInfo if needed.
+static int GPIOInfoFindBank(GPIOInfoRef info, const struct GPIOPinRegisters *registers) {
+    if (registers->set < 0)
+        return -1;
+
+    for (int bank = 0 ; bank < info->bankCount ; bank++) {
+        if (info->banks[bank].set == registers->set)
+            return bank;
+    }
+
+    if (GPIO_REGISTERS_N2_BANK_COUNT == info->bankCount)
+        return -1;
+
+    info->banks[info->bankCount] = (struct GPIOBank){
+            .set = registers->set,
+            .function = registers->function,
+            .input = registers->input
+    };
+    return info->bankCount++;
+}
+
+GPIOInfoRef GPIOInfoAllocWithBackend(GPIOBackend backend) {
+    GPIOInfoRef info = malloc(sizeof(struct GPIOInfo));
+
+    info->references = 1;
+    info->access = GPIOAccessNone;
+    info->backend = backend;
+
+    info->registers.file = -1;
+    info->registers.memory = NULL;
+    memset(info->registers.locks, 0x0, sizeof(info->registers.locks));
+
+    info->sysfs.export = -1;
+    info->sysfs.unexport = -1;
+
+    info->cdev.chip = -1;
+    for (int group = 0 ; group < GPIO_CDEV_GROUP_COUNT ; group++)
+        info->cdev.groups[group] = (struct GPIOCdevGroup){ .request = -1, .pins = 0x0 };
+    info->cdev.groupPins = 0x0;
+    pthread_mutex_init(&info->cdev.lock, NULL);
+
+    info->shadow.enabled = FALSE;
+
+    info->simulator.callback = NULL;
+    info->simulator.context = NULL;
+
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&info->events.condition, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_mutex_init(&info->events.lock, NULL);
+
+    if (GPIOBackendSimulated == backend)
+        GPIOInfoMapSimulated(info);
+    else
+        GPIOInfoMapDevice(info);
+
     if (info->registers.memory)
         info->access = GPIOAccessRegisters;
+    else if (info->cdev.chip != -1)
+        info->access = GPIOAccessCdev;
     else if (info->sysfs.export != -1)
         info->access = GPIOAccessSysfs;
     
     memcpy(info->pins, GPIO_N2_PINS, sizeof(GPIO_N2_PINS));
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        info->pins[pin].cdev = (struct GPIOPinCdev){ .line = -1, .request = -1, .group = -1,
+                                                      .bias = 0x0 };
+        info->pins[pin].handle.output = -1;
+    }
+
+    info->bankCount = 0;
+    for (int pin = 0 ; pin < 64 ; pin++)
+        info->pins[pin].bank = GPIOInfoFindBank(info, &info->pins[pin].registers);
+
+    return info;
+}
+
+GPIOInfoRef GPIOInfoAlloc(void) {
+    const char *backend = getenv(GPIO_BACKEND_VARIABLE);
+    if (backend && strcmp(backend, GPIO_BACKEND_SIMULATED) == 0)
+        return GPIOInfoAllocWithBackend(GPIOBackendSimulated);
+
+    return GPIOInfoAllocWithBackend(GPIOBackendDevice);
+}
+
+void GPIOInfoSetSimulatorCallback(GPIOInfoRef info, GPIOSimulatorWriteCallback callback,
+                                  void *context) {
+    info->simulator.callback = callback;
+    info->simulator.context = context;
+}
+
+void GPIOInfoNotifyWrite(GPIOInfoRef info, volatile uint32_t *word, uint32_t value) {
+    if (info->simulator.callback)
+        info->simulator.callback(info, (int)(word - info->registers.memory), value,
+                                 info->simulator.context);
+}
+
+volatile uint32_t *GPIOInfoGetRegisters(GPIOInfoRef info) {
+    return info->registers.memory;
+}
+
+GPIOBackend GPIOInfoGetBackend(GPIOInfoRef info) {
+    return info->backend;
+}
 
+void GPIORegisterLockContended(int *lock) {
+    // the holder may run on another CPU and release the lock shortly
+    for (int spin = 0 ; spin < GPIO_REGISTER_LOCK_SPINS ; spin++) {
+        int expected = 0;
+        if (!__atomic_load_n(lock, __ATOMIC_RELAXED) &&
+            __atomic_compare_exchange_n(lock, &expected, 1, FALSE, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED))
+            return;
+
+        DELAY_CPU_RELAX();
+    }
+
+    // the lock is marked as having waiters, so that its release wakes one of them up
+    while (__atomic_exchange_n(lock, 2, __ATOMIC_ACQUIRE))
+        syscall(SYS_futex, lock, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+}
+
+void GPIORegisterWake(int *lock) {
+    syscall(SYS_futex, lock, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+GPIOInfoRef GPIOInfoRetain(GPIOInfoRef info) {
+    __atomic_fetch_add(&info->references, 1, __ATOMIC_RELAXED);
     return info;
 }
 
 void GPIOInfoFree(GPIOInfoRef info) {
+    // the releases of the other references happen before the resources are destroyed
+    if (__atomic_sub_fetch(&info->references, 1, __ATOMIC_ACQ_REL) > 0)
+        return;
+
     if (info->registers.memory)
         munmap(info->registers.memory, GPIO_REGISTERS_N2_MEMORY_SIZE);
 
@@ -201,6 +934,19 @@ void GPIOInfoFree(GPIOInfoRef info) {
     if (info->sysfs.unexport != -1)
         close(info->sysfs.unexport);
 
+    for (int group = 0 ; group < GPIO_CDEV_GROUP_COUNT ; group++) {
+        if (info->cdev.groups[group].request != -1)
+            close(info->cdev.groups[group].request);
+    }
+
+    for (int pin = 0 ; pin < 64 ; pin++)
+        GPIOCdevRelease(&info->pins[pin]);
+
+    if (info->cdev.chip != -1)
+        close(info->cdev.chip);
+
+    pthread_mutex_destroy(&info->cdev.lock);
+
     for (int pin = 0 ; pin < 64 ; pin++) {
         struct GPIOPin *pinInfo = &info->pins[pin];
         if (pinInfo->sysfs.direction != -1)
@@ -213,6 +959,9 @@ void GPIOInfoFree(GPIOInfoRef info) {
             close(pinInfo->sysfs.value);
     }
 
+    pthread_cond_destroy(&info->events.condition);
+    pthread_mutex_destroy(&info->events.lock);
+
     free(info);
 }
 
@@ -234,11 +983,103 @@ void GPIOInfoSetAccess(GPIOInfoRef info, GPIOAccess access) {
 
             break;
 
+        case GPIOAccessCdev:
+            if (info->cdev.chip == -1)
+                return;
+
+            break;
+
         default:
             break;
     }
 
-    info->access = access;
+    info->access = access;
+}
+
+BOOL GPIOInfoUsesShadow(GPIOInfoRef info) {
+    return info->shadow.enabled;
+}
+
+BOOL GPIOInfoSetUsesShadow(GPIOInfoRef info, BOOL shadow) {
+    if (shadow && !info->registers.memory)
+        return FALSE;
+
+    __atomic_store_n(&info->shadow.enabled, shadow, __ATOMIC_SEQ_CST);
+    if (!shadow)
+        return TRUE;
+
+    // the handles would write behind the shadow, and GPIOInfoGetPinHandle checks the shadow after
+    // marking a pin, thus one of them sees the other
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        if (__atomic_load_n(&info->pins[pin].handed, __ATOMIC_SEQ_CST)) {
+            LOG_ERROR("The handle of pin %d is in use, the registers can not be shadowed", pin);
+            __atomic_store_n(&info->shadow.enabled, FALSE, __ATOMIC_SEQ_CST);
+            return FALSE;
+        }
+    }
+
+    GPIOInfoSyncShadow(info);
+    return TRUE;
+}
+
+void GPIOInfoSyncShadow(GPIOInfoRef info) {
+    if (!info->shadow.enabled)
+        return;
+
+    // only the words used by the pin map are read, the others may not be backed by a register
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        const struct GPIOPinRegisters *registers = &GPIO_N2_PINS[pin].registers;
+        if (registers->set < 0)
+            continue;
+
+        const int indexes[] = {
+                registers->set,
+                registers->function,
+                registers->pullUpDownEnable,
+                registers->pullUpDown,
+                registers->mux
+        };
+
+        for (int index = 0 ; index < 5 ; index++) {
+            int *lock = &info->registers.locks[indexes[index]];
+
+            GPIORegisterLock(lock);
+            info->shadow.words[indexes[index]] = info->registers.memory[indexes[index]];
+            GPIORegisterUnlock(lock);
+        }
+    }
+}
+
+// Changes the bits of one register word selected by 'mask', holding the lock of this word. When
+// the shadow copy is used, the word is stored without any read of the device and only if its value
+// changes.
+static inline void GPIOInfoWriteRegister(GPIOInfoRef info, int index, uint32_t mask,
+                                         uint32_t bits) {
+    volatile uint32_t *word = &info->registers.memory[index];
+    int *lock = &info->registers.locks[index];
+
+    BOOL written = TRUE;
+    uint32_t value;
+
+    GPIORegisterLock(lock);
+
+    if (!info->shadow.enabled) {
+        value = (*word & ~mask) | bits;
+        *word = value;
+    } else {
+        value = (info->shadow.words[index] & ~mask) | bits;
+        if (value != info->shadow.words[index]) {
+            info->shadow.words[index] = value;
+            *word = value;
+        } else {
+            written = FALSE;
+        }
+    }
+
+    GPIORegisterUnlock(lock);
+
+    if (written && info->simulator.callback)
+        info->simulator.callback(info, index, value, info->simulator.context);
 }
 
 void GPIOInfoExport(GPIOInfoRef info, int pin) {
@@ -278,9 +1119,52 @@ void GPIOInfoExport(GPIOInfoRef info, int pin) {
 
             sprintf(buf, GPIO_SYSFS_ROOT "/gpio%d/value", pinInfo->number);
             pinInfo->sysfs.value = open(buf, O_RDWR);
+
+            pinInfo->access = info->access;
             break;
         }
 
+        case GPIOAccessCdev:
+            if (pinInfo->registers.set < 0)
+                return;
+
+            pinInfo->cdev.line = GPIOCdevFindLine(info, pinInfo);
+            if (pinInfo->cdev.line < 0)
+                return;
+
+            pinInfo->cdev.bias = 0x0;
+            pinInfo->cdev.value = GPIO_PIN_VALUE_LOW;
+
+            pthread_mutex_lock(&info->cdev.lock);
+            if (GPIOCdevRequest(info, pinInfo))
+                pinInfo->access = info->access;
+            pthread_mutex_unlock(&info->cdev.lock);
+            break;
+
+        case GPIOAccessRegisters:
+            pinInfo->access = info->access;
+
+            if (pinInfo->registers.set < 0)
+                break;
+
+            pinInfo->handle = (struct GPIOPinHandle){
+                .words = {
+                    {
+                        .set = &info->registers.memory[pinInfo->registers.set],
+                        .lock = &info->registers.locks[pinInfo->registers.set]
+                    },
+                    {
+                        .set = &info->registers.memory[pinInfo->registers.function],
+                        .lock = &info->registers.locks[pinInfo->registers.function]
+                    }
+                },
+                .input = &info->registers.memory[pinInfo->registers.input],
+                .mask = (1 << pinInfo->registers.offset),
+                .simulated = (GPIOBackendSimulated == info->backend) ? info : NULL
+            };
+            __atomic_store_n(&pinInfo->handle.output, 0, __ATOMIC_RELEASE);
+            break;
+
         default:
             pinInfo->access = info->access;
             break;
@@ -304,15 +1188,39 @@ void GPIOInfoUnexport(GPIOInfoRef info, int pin) {
             if (pinInfo->sysfs.value != -1)
                 close(pinInfo->sysfs.value);
 
+            pinInfo->sysfs = (struct GPIOPinSysfs){ .direction = -1, .pull = -1, .value = -1 };
+
             char buf[64] = "";
             sprintf(buf, "%d\n", pinInfo->number);
 
             write(info->sysfs.unexport, buf, strlen(buf));
+            pinInfo->access = GPIOAccessNone;
+            pinInfo->mode = GPIOPinModeInput;
+            pinInfo->edge = GPIOEdgeNone;
             break;
         }
 
+        case GPIOAccessCdev:
+            pinInfo->access = GPIOAccessNone;
+            pinInfo->mode = GPIOPinModeInput;
+            pinInfo->edge = GPIOEdgeNone;
+            pinInfo->events.count = 0;
+
+            pthread_mutex_lock(&info->cdev.lock);
+            if (pinInfo->cdev.group != -1)
+                GPIOCdevUngroup(info, pinInfo->cdev.group, 0x1ull << pin);
+            GPIOCdevRelease(pinInfo);
+            pthread_mutex_unlock(&info->cdev.lock);
+            break;
+
         default:
             pinInfo->access = GPIOAccessNone;
+            pinInfo->mode = GPIOPinModeInput;
+            // the calls in flight on the handle still find its words, the Pin objects retaining
+            // the controller
+            __atomic_store_n(&pinInfo->handle.output, -1, __ATOMIC_RELAXED);
+            __atomic_store_n(&pinInfo->handle.input, NULL, __ATOMIC_RELAXED);
+            pinInfo->handed = FALSE;
             break;
     }
 }
@@ -325,65 +1233,107 @@ void GPIOInfoUnexportAll(GPIOInfoRef info) {
 const char *GPIO_PIN_MODE_INPUT = "in";
 const char *GPIO_PIN_MODE_OUTPUT = "out";
 
-#define GPIO_SELECT() info->registers.memory[pinInfo->registers.mux] &= ~(0xF << pinInfo->registers.target)
-#define GPIO_ENABLE_REGISTER(name) info->registers.memory[pinInfo->registers.name] |= (1 << pinInfo->registers.offset)
-#define GPIO_DISABLE_REGISTER(name) info->registers.memory[pinInfo->registers.name] &= ~(1 << pinInfo->registers.offset)
+#define GPIO_SELECT() GPIOInfoWriteRegister(info, pinInfo->registers.mux, 0xF << pinInfo->registers.target, 0x0)
+#define GPIO_ENABLE_REGISTER(name) GPIOInfoWriteRegister(info, pinInfo->registers.name, 1 << pinInfo->registers.offset, 1 << pinInfo->registers.offset)
+#define GPIO_DISABLE_REGISTER(name) GPIOInfoWriteRegister(info, pinInfo->registers.name, 1 << pinInfo->registers.offset, 0x0)
 #define GPIO_READ_REGISTER(name) (info->registers.memory[pinInfo->registers.name] & (1 << pinInfo->registers.offset))
 
-void GPIOInfoSetMode(GPIOInfoRef info, int pin, const char *mode) {
+// an open-drain pin starts released, then its direction is switched between "low" and "in"
+static const char *GPIO_SYSFS_PIN_MODES[] = { "in\n", "out\n", "in\n" };
+static const char *GPIO_SYSFS_OPEN_DRAIN_VALUES[] = { "low\n", "in\n" };
+
+void GPIOInfoSetPinMode(GPIOInfoRef info, int pin, GPIOPinMode mode) {
     struct GPIOPin *pinInfo = &info->pins[pin];
 
-    BOOL pullOff = FALSE;
     switch (pinInfo->access) {
         case GPIOAccessRegisters:
             GPIO_SELECT();
 
-            if (strcmp(GPIO_PIN_MODE_INPUT, mode) == 0) {
-                pullOff = TRUE;
-                GPIO_ENABLE_REGISTER(function);
-            } else if (strcmp(GPIO_PIN_MODE_OUTPUT, mode) == 0) {
+            if (GPIOPinModeOutput == mode) {
                 GPIO_DISABLE_REGISTER(function);
+            } else {
+                GPIO_ENABLE_REGISTER(function);
+
+                // the latch is preloaded once, then only the direction is toggled
+                if (GPIOPinModeOpenDrain == mode)
+                    GPIO_DISABLE_REGISTER(set);
             }
+
+            if (pinInfo->handle.output != -1)
+                __atomic_store_n(&pinInfo->handle.output, (GPIOPinModeOpenDrain == mode) ? 1 : 0,
+                                 __ATOMIC_RELAXED);
             break;
 
         case GPIOAccessSysfs:
             if (pinInfo->sysfs.direction == -1)
                 return;
 
-            if (strcmp(GPIO_PIN_MODE_INPUT, mode) == 0)
-                pullOff = TRUE;
+            write(pinInfo->sysfs.direction,
+                  GPIO_SYSFS_PIN_MODES[mode],
+                  strlen(GPIO_SYSFS_PIN_MODES[mode]));
+            break;
+
+        case GPIOAccessCdev:
+            pinInfo->mode = mode;
 
-            char buf[64] = "";
-            sprintf(buf, "%s\n", mode);
+            // an open-drain line starts released
+            if (GPIOPinModeOpenDrain == mode)
+                pinInfo->cdev.value = GPIO_PIN_VALUE_HIGH;
 
-            write(pinInfo->sysfs.direction, buf, strlen(buf));
-            break;
+            // the bias is part of the line configuration, thus one ioctl changes both
+            if (GPIOPinModeOutput != mode)
+                pinInfo->cdev.bias = GPIOCdevGetBias(GPIOPinPullOff);
+
+            GPIOCdevConfigure(info, pin);
+            return;
 
         default:
-            break;
+            return;
     }
 
-    if (pullOff)
-        GPIOInfoSetPullState(info, pin, GPIO_PIN_PULL_OFF);
+    pinInfo->mode = mode;
+
+    if (GPIOPinModeOutput != mode)
+        GPIOInfoSetPinPull(info, pin, GPIOPinPullOff);
+}
+
+BOOL GPIOInfoSetPinFunction(GPIOInfoRef info, int pin, int function) {
+    struct GPIOPin *pinInfo = &info->pins[pin];
+
+    if (GPIOAccessRegisters != pinInfo->access || pinInfo->registers.mux < 0)
+        return FALSE;
+
+    GPIOInfoWriteRegister(info, pinInfo->registers.mux, 0xF << pinInfo->registers.target,
+                          (function & 0xF) << pinInfo->registers.target);
+    return TRUE;
+}
+
+void GPIOInfoSetMode(GPIOInfoRef info, int pin, const char *mode) {
+    if (strcmp(GPIO_PIN_MODE_INPUT, mode) == 0)
+        GPIOInfoSetPinMode(info, pin, GPIOPinModeInput);
+    else if (strcmp(GPIO_PIN_MODE_OUTPUT, mode) == 0)
+        GPIOInfoSetPinMode(info, pin, GPIOPinModeOutput);
 }
 
 const char *GPIO_PIN_PULL_DOWN = "down";
 const char *GPIO_PIN_PULL_UP = "up";
 const char *GPIO_PIN_PULL_OFF = "disable";
 
-void GPIOInfoSetPullState(GPIOInfoRef info, int pin, const char *state) {
+static const char *GPIO_SYSFS_PIN_PULLS[] = { "disable\n", "down\n", "up\n" };
+
+void GPIOInfoSetPinPull(GPIOInfoRef info, int pin, GPIOPinPull pull) {
     struct GPIOPin *pinInfo = &info->pins[pin];
 
     switch (pinInfo->access) {
         case GPIOAccessRegisters:
-            if (strcmp(GPIO_PIN_PULL_OFF, state) == 0) {
+            if (GPIOPinPullOff == pull) {
                 GPIO_DISABLE_REGISTER(pullUpDownEnable);
             } else {
                 GPIO_ENABLE_REGISTER(pullUpDownEnable);
 
-                if (strcmp(GPIO_PIN_PULL_DOWN, state) == 0)
+                if (GPIOPinPullDown == pull)
                     GPIO_DISABLE_REGISTER(pullUpDown);
-                else if (strcmp(GPIO_PIN_PULL_UP, state) == 0)
+                else
                     GPIO_ENABLE_REGISTER(pullUpDown);
             }
             break;
@@ -392,10 +1342,14 @@ void GPIOInfoSetPullState(GPIOInfoRef info, int pin, const char *state) {
             if (pinInfo->sysfs.pull == -1)
                 return;
 
-            char buf[64] = "";
-            sprintf(buf, "%s\n", state);
+            write(pinInfo->sysfs.pull,
+                  GPIO_SYSFS_PIN_PULLS[pull],
+                  strlen(GPIO_SYSFS_PIN_PULLS[pull]));
+            break;
 
-            write(pinInfo->sysfs.pull, buf, strlen(buf));
+        case GPIOAccessCdev:
+            pinInfo->cdev.bias = GPIOCdevGetBias(pull);
+            GPIOCdevConfigure(info, pin);
             break;
 
         default:
@@ -403,18 +1357,42 @@ void GPIOInfoSetPullState(GPIOInfoRef info, int pin, const char *state) {
     }
 }
 
+void GPIOInfoSetPullState(GPIOInfoRef info, int pin, const char *state) {
+    if (strcmp(GPIO_PIN_PULL_OFF, state) == 0)
+        GPIOInfoSetPinPull(info, pin, GPIOPinPullOff);
+    else if (strcmp(GPIO_PIN_PULL_DOWN, state) == 0)
+        GPIOInfoSetPinPull(info, pin, GPIOPinPullDown);
+    else if (strcmp(GPIO_PIN_PULL_UP, state) == 0)
+        GPIOInfoSetPinPull(info, pin, GPIOPinPullUp);
+}
+
 void GPIOInfoSetValue(GPIOInfoRef info, int pin, int value) {
     struct GPIOPin *pinInfo = &info->pins[pin];
 
     switch (pinInfo->access) {
         case GPIOAccessRegisters:
-            if (value)
+            if (GPIOPinModeOpenDrain == pinInfo->mode) {
+                if (value)
+                    GPIO_ENABLE_REGISTER(function);
+                else
+                    GPIO_DISABLE_REGISTER(function);
+            } else if (value) {
                 GPIO_ENABLE_REGISTER(set);
-            else
+            } else {
                 GPIO_DISABLE_REGISTER(set);
+            }
             break;
 
         case GPIOAccessSysfs:
+            if (GPIOPinModeOpenDrain == pinInfo->mode) {
+                if (pinInfo->sysfs.direction == -1)
+                    return;
+
+                const char *direction = GPIO_SYSFS_OPEN_DRAIN_VALUES[value ? 1 : 0];
+                write(pinInfo->sysfs.direction, direction, strlen(direction));
+                break;
+            }
+
             if (pinInfo->sysfs.value == -1)
                 return;
 
@@ -424,6 +1402,11 @@ void GPIOInfoSetValue(GPIOInfoRef info, int pin, int value) {
             write(pinInfo->sysfs.value, buf, strlen(buf));
             break;
 
+        case GPIOAccessCdev:
+            pinInfo->cdev.value = value ? GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW;
+            GPIOCdevSetValue(info, pin, value);
+            break;
+
         default:
             break;
     }
@@ -451,6 +1434,9 @@ int GPIOInfoGetValue(GPIOInfoRef info, int pin) {
 
             return (value == '0') ? GPIO_PIN_VALUE_LOW : GPIO_PIN_VALUE_HIGH;
 
+        case GPIOAccessCdev:
+            return GPIOCdevGetValue(info, pin);
+
         default:
             break;
     }
@@ -458,49 +1444,387 @@ int GPIOInfoGetValue(GPIOInfoRef info, int pin) {
     return -1;
 }
 
-JNIEXPORT void JNICALL
-Java_com_cdoapps_gpio_GPIO_onResume(JNIEnv * env, jobject thiz) {
-    GPIOInfoRef info = (GPIOInfoRef)Java_java_lang_Object_getReserved(env, thiz);
-    if (info)
-        GPIOInfoFree(info);
+GPIOPinHandleRef GPIOInfoGetPinHandle(GPIOInfoRef info, int pin) {
+    struct GPIOPin *pinInfo = &info->pins[pin];
+
+    if (GPIOAccessRegisters != pinInfo->access || pinInfo->handle.output == -1)
+        return NULL;
+
+#ifndef GPIO_SIMULATOR_WRITES
+    // the writes through the handle would bypass the callback
+    if (info->simulator.callback)
+        return NULL;
+#endif
+
+    BOOL handed = __atomic_exchange_n(&pinInfo->handed, TRUE, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&info->shadow.enabled, __ATOMIC_SEQ_CST)) {
+        if (!handed)
+            __atomic_store_n(&pinInfo->handed, FALSE, __ATOMIC_SEQ_CST);
+        return NULL;
+    }
+
+    return &pinInfo->handle;
+}
+
+volatile uint32_t *GPIOInfoGetPinInput(GPIOInfoRef info, int pin, uint32_t *mask) {
+    struct GPIOPin *pinInfo = &info->pins[pin];
+
+    if (GPIOAccessRegisters != pinInfo->access || pinInfo->registers.input < 0)
+        return NULL;
+
+    if (mask)
+        *mask = (1 << pinInfo->registers.offset);
+
+    return &info->registers.memory[pinInfo->registers.input];
+}
+
+int GPIOInfoAddInputWord(GPIOInfoRef info, struct GPIOInputWord *words, int *count, int pin,
+                         uint32_t *mask) {
+    uint32_t pinMask = 0x0;
+    volatile uint32_t *word = GPIOInfoGetPinInput(info, pin, &pinMask);
+    if (!word)
+        return -1;
+
+    int index = 0;
+    while (index < *count && words[index].word != word)
+        index++;
+
+    if (index == *count)
+        words[(*count)++] = (struct GPIOInputWord){ .word = word, .mask = 0x0, .previous = 0x0 };
+
+    words[index].mask |= pinMask;
+    if (mask)
+        *mask = pinMask;
+
+    return index;
+}
+
+void GPIOInfoWriteMask(GPIOInfoRef info, uint64_t mask, uint64_t values) {
+    // the bits of the output words, then of the direction words which drive the open-drain pins
+    uint32_t masks[2][GPIO_REGISTERS_N2_BANK_COUNT] = {{ 0x0 }};
+    uint32_t bits[2][GPIO_REGISTERS_N2_BANK_COUNT] = {{ 0x0 }};
+    uint64_t lines = 0x0;
+
+    for (uint64_t pins = mask ; pins ; pins &= pins - 1) {
+        int pin = __builtin_ctzll(pins);
+        struct GPIOPin *pinInfo = &info->pins[pin];
+        BOOL value = (values & (0x1ull << pin)) ? TRUE : FALSE;
+
+        // the lines of the character device are changed at once
+        if (GPIOAccessCdev == pinInfo->access) {
+            lines |= (0x1ull << pin);
+            continue;
+        }
+
+        if (GPIOAccessRegisters != pinInfo->access) {
+            GPIOInfoSetValue(info, pin, value ? GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW);
+            continue;
+        }
+
+        if (pinInfo->bank < 0)
+            continue;
+
+        // an open-drain pin is released by a high bit in its direction word
+        int word = (GPIOPinModeOpenDrain == pinInfo->mode) ? 1 : 0;
+        masks[word][pinInfo->bank] |= (1 << pinInfo->registers.offset);
+        if (value)
+            bits[word][pinInfo->bank] |= (1 << pinInfo->registers.offset);
+    }
+
+    for (int bank = 0 ; bank < info->bankCount ; bank++) {
+        if (masks[0][bank])
+            GPIOInfoWriteRegister(info, info->banks[bank].set, masks[0][bank], bits[0][bank]);
+        if (masks[1][bank])
+            GPIOInfoWriteRegister(info, info->banks[bank].function, masks[1][bank], bits[1][bank]);
+    }
+
+    if (lines)
+        GPIOCdevWriteMask(info, lines, values);
+}
+
+uint64_t GPIOInfoReadMask(GPIOInfoRef info, uint64_t mask) {
+    uint32_t words[GPIO_REGISTERS_N2_BANK_COUNT];
+    unsigned int sampled = 0x0;
+    uint64_t values = 0x0;
+    uint64_t lines = 0x0;
+
+    for (uint64_t pins = mask ; pins ; pins &= pins - 1) {
+        int pin = __builtin_ctzll(pins);
+        struct GPIOPin *pinInfo = &info->pins[pin];
+
+        // the lines of the character device are read at once
+        if (GPIOAccessCdev == pinInfo->access) {
+            lines |= (0x1ull << pin);
+            continue;
+        }
+
+        if (GPIOAccessRegisters != pinInfo->access) {
+            if (GPIOInfoGetValue(info, pin) == GPIO_PIN_VALUE_HIGH)
+                values |= (0x1ull << pin);
+            continue;
+        }
+
+        if (pinInfo->bank < 0)
+            continue;
+
+        // the first pin of a bank samples its whole input word
+        if (!(sampled & (0x1u << pinInfo->bank))) {
+            words[pinInfo->bank] = info->registers.memory[info->banks[pinInfo->bank].input];
+            sampled |= (0x1u << pinInfo->bank);
+        }
+
+        if (words[pinInfo->bank] & (1 << pinInfo->registers.offset))
+            values |= (0x1ull << pin);
+    }
+
+    if (lines)
+        values |= GPIOCdevReadMask(info, lines);
+
+    return values;
+}
+
+static const char *GPIO_SYSFS_PIN_EDGES[] = { "none\n", "rising\n", "falling\n", "both\n" };
+
+// must be called with the events lock held
+static int GPIOPinPopEvents(struct GPIOPin *pinInfo, struct GPIOEdgeEvent *events, int count) {
+    int popped = 0;
+
+    while (popped < count && pinInfo->events.count) {
+        events[popped++] = pinInfo->events.queue[pinInfo->events.first];
+        pinInfo->events.first = (pinInfo->events.first + 1) % GPIO_EDGE_QUEUE_SIZE;
+        pinInfo->events.count--;
+    }
+
+    return popped;
+}
+
+// must be called with the events lock held, the oldest event is dropped on overflow
+static void GPIOPinPushEvent(struct GPIOPin *pinInfo, struct GPIOEdgeEvent event) {
+    if (GPIO_EDGE_QUEUE_SIZE == pinInfo->events.count) {
+        pinInfo->events.first = (pinInfo->events.first + 1) % GPIO_EDGE_QUEUE_SIZE;
+        pinInfo->events.count--;
+    }
+
+    int last = (pinInfo->events.first + pinInfo->events.count) % GPIO_EDGE_QUEUE_SIZE;
+    pinInfo->events.queue[last] = event;
+    pinInfo->events.count++;
+}
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+static int GPIOCdevReadEvents(GPIOInfoRef info, struct GPIOPin *pinInfo, long long timeout) {
+    struct pollfd descriptor = { .fd = pinInfo->cdev.request, .events = POLLIN };
+    struct timespec time = DelayGetTimespec(timeout);
+
+    int result = ppoll(&descriptor, 1, (timeout < 0) ? NULL : &time, NULL);
+    if (result <= 0)
+        return result;
+
+    struct gpio_v2_line_event lineEvents[GPIO_EDGE_QUEUE_SIZE];
+    ssize_t size = read(pinInfo->cdev.request, lineEvents, sizeof(lineEvents));
+    if (size < 0)
+        return -1;
+
+    pthread_mutex_lock(&info->events.lock);
+
+    for (int index = 0 ; index < size / (ssize_t)sizeof(lineEvents[0]) ; index++) {
+        GPIOPinPushEvent(pinInfo, (struct GPIOEdgeEvent){
+            .timestamp = (long long)lineEvents[index].timestamp_ns,
+            .value = (GPIO_V2_LINE_EVENT_RISING_EDGE == lineEvents[index].id) ?
+                    GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW
+        });
+    }
+
+    pthread_mutex_unlock(&info->events.lock);
+    return 1;
+}
+#else
+static int GPIOCdevReadEvents(GPIOInfoRef info, struct GPIOPin *pinInfo, long long timeout) {
+    return -1;
+}
+#endif
+
+static int GPIOCdevWaitForEdges(GPIOInfoRef info, struct GPIOPin *pinInfo,
+                                struct GPIOEdgeEvent *events, int count, long long timeout) {
+    long long deadline = (timeout < 0) ? -1 : DelayGetTime() + timeout;
+    int result = 0;
+
+    pthread_mutex_lock(&info->events.lock);
+
+    while (!(result = GPIOPinPopEvents(pinInfo, events, count))) {
+        long long remaining = (deadline < 0) ? -1 : deadline - DelayGetTime();
+        if (deadline >= 0 && remaining <= 0)
+            break;
+
+        if (pinInfo->events.reading) {
+            if (deadline < 0) {
+                pthread_cond_wait(&info->events.condition, &info->events.lock);
+            } else {
+                struct timespec time = DelayGetTimespec(deadline);
+                pthread_cond_timedwait(&info->events.condition, &info->events.lock, &time);
+            }
+            continue;
+        }
+
+        pinInfo->events.reading = TRUE;
+        pthread_mutex_unlock(&info->events.lock);
+
+        int status = GPIOCdevReadEvents(info, pinInfo, remaining);
+
+        pthread_mutex_lock(&info->events.lock);
+        pinInfo->events.reading = FALSE;
+        pthread_cond_broadcast(&info->events.condition);
+
+        if (status < 0) {
+            result = -1;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&info->events.lock);
+    return result;
+}
+
+static int GPIOSysfsWaitForEdges(struct GPIOPin *pinInfo, struct GPIOEdgeEvent *events,
+                                 long long timeout) {
+    struct pollfd descriptor = { .fd = pinInfo->sysfs.value, .events = POLLPRI | POLLERR };
+    struct timespec time = DelayGetTimespec(timeout);
+
+    int result = ppoll(&descriptor, 1, (timeout < 0) ? NULL : &time, NULL);
+    if (result <= 0)
+        return result;
+
+    long long timestamp = DelayGetTime();
+
+    // reading the value also acknowledges the edge
+    char value = 0x0;
+    lseek(pinInfo->sysfs.value, 0, SEEK_SET);
+    if (read(pinInfo->sysfs.value, &value, 1) < 0)
+        return -1;
+
+    events[0] = (struct GPIOEdgeEvent){
+        .timestamp = timestamp,
+        .value = (value == '0') ? GPIO_PIN_VALUE_LOW : GPIO_PIN_VALUE_HIGH
+    };
+    return 1;
+}
+
+BOOL GPIOInfoSetPinEdge(GPIOInfoRef info, int pin, GPIOEdge edge) {
+    struct GPIOPin *pinInfo = &info->pins[pin];
+
+    switch (pinInfo->access) {
+        case GPIOAccessSysfs: {
+            if (pinInfo->sysfs.value == -1)
+                return FALSE;
+
+            char buf[64] = "";
+            sprintf(buf, GPIO_SYSFS_ROOT "/gpio%d/edge", pinInfo->number);
+
+            int file = open(buf, O_WRONLY);
+            if (file == -1)
+                return FALSE;
+
+            ssize_t size = write(file, GPIO_SYSFS_PIN_EDGES[edge],
+                                 strlen(GPIO_SYSFS_PIN_EDGES[edge]));
+            close(file);
+
+            if (size < 0)
+                return FALSE;
+
+            // the pending edge is acknowledged, otherwise the first wait would not block
+            char value = 0x0;
+            lseek(pinInfo->sysfs.value, 0, SEEK_SET);
+            read(pinInfo->sysfs.value, &value, 1);
+
+            pinInfo->edge = edge;
+            return TRUE;
+        }
+
+        case GPIOAccessCdev: {
+            if (GPIOPinModeInput != pinInfo->mode)
+                return FALSE;
+
+            GPIOEdge previousEdge = pinInfo->edge;
+            pinInfo->edge = edge;
+
+            if (!GPIOCdevConfigure(info, pin)) {
+                pinInfo->edge = previousEdge;
+                return FALSE;
+            }
+
+            pthread_mutex_lock(&info->events.lock);
+            pinInfo->events.count = 0;
+            pthread_mutex_unlock(&info->events.lock);
+            return TRUE;
+        }
+
+        default:
+            return FALSE;
+    }
+}
+
+GPIOEdge GPIOInfoGetPinEdge(GPIOInfoRef info, int pin) {
+    return info->pins[pin].edge;
+}
+
+int GPIOInfoWaitForEdges(GPIOInfoRef info, int pin, struct GPIOEdgeEvent *events, int count,
+                         long long timeout) {
+    struct GPIOPin *pinInfo = &info->pins[pin];
+
+    if (GPIOEdgeNone == pinInfo->edge || count <= 0)
+        return -1;
+
+    switch (pinInfo->access) {
+        case GPIOAccessSysfs:
+            return GPIOSysfsWaitForEdges(pinInfo, events, timeout);
+
+        case GPIOAccessCdev:
+            return GPIOCdevWaitForEdges(info, pinInfo, events, count, timeout);
 
-    Java_java_lang_Object_setReserved(env, thiz, (jlong)GPIOInfoAlloc());
+        default:
+            return -1;
+    }
 }
 
+// GPIO.onResume pauses the previous instance first, which frees it
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_GPIO_nativeResume(JNIEnv * env, jobject thiz) {
+    if (!Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz))
+        Java_com_cdoapps_gpio_GPIO_setReserved(env, thiz, (jlong)GPIOInfoAlloc());
+}
 
 JNIEXPORT void JNICALL
-Java_com_cdoapps_gpio_GPIO_onPause(JNIEnv * env, jobject thiz) {
-    GPIOInfoRef info = (GPIOInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+Java_com_cdoapps_gpio_GPIO_nativePause(JNIEnv * env, jobject thiz) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
     if (info) {
         GPIOInfoFree(info);
-        Java_java_lang_Object_setReserved(env, thiz, 0l);
+        Java_com_cdoapps_gpio_GPIO_setReserved(env, thiz, 0l);
     }
 }
 
 JNIEXPORT void JNICALL
 Java_com_cdoapps_gpio_GPIO_export(JNIEnv * env, jobject thiz, jint pin) {
-    GPIOInfoRef info = (GPIOInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
     if (info)
         GPIOInfoExport(info, pin);
 }
 
 JNIEXPORT void JNICALL
-Java_com_cdoapps_gpio_GPIO_unexport(JNIEnv * env, jobject thiz, jint pin) {
-    GPIOInfoRef info = (GPIOInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+Java_com_cdoapps_gpio_GPIO_nativeUnexport(JNIEnv * env, jobject thiz, jint pin) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
     if (info)
         GPIOInfoUnexport(info, pin);
 }
 
 JNIEXPORT void JNICALL
-Java_com_cdoapps_gpio_GPIO_unexportAll(JNIEnv * env, jobject thiz) {
-    GPIOInfoRef info = (GPIOInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+Java_com_cdoapps_gpio_GPIO_nativeUnexportAll(JNIEnv * env, jobject thiz) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
     if (info)
         GPIOInfoUnexportAll(info);
 }
 
 JNIEXPORT jboolean JNICALL
 Java_com_cdoapps_gpio_GPIO_usesLegacyLibrary(JNIEnv *env, jobject thiz) {
-    GPIOInfoRef info = (GPIOInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
     if (info)
         return (GPIOAccessSysfs == GPIOInfoGetAccess(info)) ? JNI_TRUE : JNI_FALSE;
     return JNI_FALSE;
@@ -508,14 +1832,38 @@ Java_com_cdoapps_gpio_GPIO_usesLegacyLibrary(JNIEnv *env, jobject thiz) {
 
 JNIEXPORT void JNICALL
 Java_com_cdoapps_gpio_GPIO_setUsesLegacyLibrary(JNIEnv *env, jobject thiz, jboolean legacy) {
-    GPIOInfoRef info = (GPIOInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
     if (info)
         GPIOInfoSetAccess(info, (legacy == JNI_TRUE) ? GPIOAccessSysfs : GPIOAccessRegisters);
 }
 
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_GPIO_usesShadowRegisters(JNIEnv *env, jobject thiz) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
+    if (info)
+        return GPIOInfoUsesShadow(info) ? JNI_TRUE : JNI_FALSE;
+    return JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_GPIO_setUsesShadowRegisters(JNIEnv *env, jobject thiz, jboolean shadow) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
+    if (info && GPIOInfoSetUsesShadow(info, (shadow == JNI_TRUE) ? TRUE : FALSE))
+        return JNI_TRUE;
+    return JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_GPIO_syncShadowRegisters(JNIEnv *env, jobject thiz) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
+    if (info)
+        GPIOInfoSyncShadow(info);
+}
+
 JNIEXPORT void JNICALL
-Java_com_cdoapps_gpio_GPIO_setMode(JNIEnv * env, jobject thiz, jint pin, jstring mode) {
-    GPIOInfoRef info = (GPIOInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+Java_com_cdoapps_gpio_GPIO_setMode__ILjava_lang_String_2(JNIEnv * env, jobject thiz, jint pin,
+                                                         jstring mode) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
     if (info) {
         const char *utf8Mode = (*env)->GetStringUTFChars(env, mode, NULL);
         GPIOInfoSetMode(info, pin, utf8Mode);
@@ -524,8 +1872,16 @@ Java_com_cdoapps_gpio_GPIO_setMode(JNIEnv * env, jobject thiz, jint pin, jstring
 }
 
 JNIEXPORT void JNICALL
-Java_com_cdoapps_gpio_GPIO_setPullState(JNIEnv * env, jobject thiz, jint pin, jstring state) {
-    GPIOInfoRef info = (GPIOInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+Java_com_cdoapps_gpio_GPIO_setMode__II(JNIEnv * env, jobject thiz, jint pin, jint mode) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
+    if (info && mode >= GPIOPinModeInput && mode <= GPIOPinModeOpenDrain)
+        GPIOInfoSetPinMode(info, pin, (GPIOPinMode)mode);
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_GPIO_setPullState__ILjava_lang_String_2(JNIEnv * env, jobject thiz,
+                                                              jint pin, jstring state) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
     if (info) {
         const char *utf8State = (*env)->GetStringUTFChars(env, state, NULL);
         GPIOInfoSetPullState(info, pin, utf8State);
@@ -534,17 +1890,183 @@ Java_com_cdoapps_gpio_GPIO_setPullState(JNIEnv * env, jobject thiz, jint pin, js
 }
 
 JNIEXPORT void JNICALL
-Java_com_cdoapps_gpio_GPIO_setValue(JNIEnv * env, jobject thiz, jint pin, jint value) {
-    GPIOInfoRef info = (GPIOInfoRef)Java_java_lang_Object_getReserved(env, thiz);
-    if (info)
-        GPIOInfoSetValue(info, pin, value);
+Java_com_cdoapps_gpio_GPIO_setPullState__II(JNIEnv * env, jobject thiz, jint pin, jint state) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
+    if (info && state >= GPIOPinPullOff && state <= GPIOPinPullUp)
+        GPIOInfoSetPinPull(info, pin, (GPIOPinPull)state);
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_cdoapps_gpio_GPIO_nativeGetPin(JNIEnv *env, jobject thiz, jint pin) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
+    if (!info)
+        return NULL;
+
+    GPIOPinHandleRef handle = GPIOInfoGetPinHandle(info, pin);
+    if (!handle)
+        return NULL;
+
+    // the pin keeps the storage of its handle until it is garbage collected
+    jobject result = (*env)->NewObject(env,
+                                       JAVA_BINDINGS.gpioPin.clazz,
+                                       JAVA_BINDINGS.gpioPin.constructor,
+                                       (jlong)GPIOInfoRetain(info));
+    if (!result) {
+        GPIOInfoFree(info);
+        return NULL;
+    }
+
+    Java_com_cdoapps_gpio_GPIO_00024Pin_setReserved(env, result, (jlong)handle);
+
+    return result;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_GPIO_setEdge(JNIEnv *env, jobject thiz, jint pin, jint edge) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
+    if (info && edge >= GPIOEdgeNone && edge <= GPIOEdgeBoth &&
+        GPIOInfoSetPinEdge(info, pin, (GPIOEdge)edge))
+        return JNI_TRUE;
+
+    return JNI_FALSE;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_cdoapps_gpio_GPIO_waitForEdge(JNIEnv *env, jobject thiz, jint pin, jint edge,
+                                       jlong timeout) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
+    if (!info || edge <= GPIOEdgeNone || edge > GPIOEdgeBoth)
+        return -1;
+
+    if (GPIOInfoGetPinEdge(info, pin) != (GPIOEdge)edge &&
+        !GPIOInfoSetPinEdge(info, pin, (GPIOEdge)edge))
+        return -1;
+
+    struct GPIOEdgeEvent event;
+    if (GPIOInfoWaitForEdges(info, pin, &event, 1, timeout) != 1)
+        return -1;
+
+    return event.timestamp;
 }
 
 JNIEXPORT jint JNICALL
-Java_com_cdoapps_gpio_GPIO_getValue(JNIEnv *env, jobject thiz, jint pin) {
-    GPIOInfoRef info = (GPIOInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+Java_com_cdoapps_gpio_GPIO_waitForEdges(JNIEnv *env, jobject thiz, jint pin,
+                                        jlongArray timestamps, jintArray values, jlong timeout) {
+    GPIOInfoRef info = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, thiz);
+    if (!info)
+        return -1;
+
+    struct GPIOEdgeEvent events[GPIO_EDGE_QUEUE_SIZE];
+    int count = (*env)->GetArrayLength(env, timestamps);
+    if ((*env)->GetArrayLength(env, values) < count)
+        count = (*env)->GetArrayLength(env, values);
+    if (count > GPIO_EDGE_QUEUE_SIZE)
+        count = GPIO_EDGE_QUEUE_SIZE;
+
+    count = GPIOInfoWaitForEdges(info, pin, events, count, timeout);
+
+    for (int index = 0 ; index < count ; index++) {
+        jlong timestamp = events[index].timestamp;
+        jint value = events[index].value;
+
+        (*env)->SetLongArrayRegion(env, timestamps, index, 1, &timestamp);
+        (*env)->SetIntArrayRegion(env, values, index, 1, &value);
+    }
+
+    return count;
+}
+
+// The following methods are registered by JNI_OnLoad. Those which may block, on a system call, a
+// mutex or a contended register lock, are regular natives, which the runtime suspends for the
+// garbage collector. Only the read of a pin handle, a single load from the mapped registers, is
+// annotated with @CriticalNative: on Android 8.0 and later, its critical version receives neither
+// a JNIEnv nor a jclass.
+
+static void
+Java_com_cdoapps_gpio_GPIO_nativeSetValue(JNIEnv * env, jclass clazz, jlong info, jint pin,
+                                          jint value) {
+    if (info)
+        GPIOInfoSetValue((GPIOInfoRef)info, pin, value);
+}
+
+static jint
+Java_com_cdoapps_gpio_GPIO_nativeGetValue(JNIEnv * env, jclass clazz, jlong info, jint pin) {
+    if (info)
+        return GPIOInfoGetValue((GPIOInfoRef)info, pin);
+
+    return -1;
+}
+
+static void
+Java_com_cdoapps_gpio_GPIO_nativeWritePins(JNIEnv * env, jclass clazz, jlong info, jlong mask,
+                                           jlong values) {
     if (info)
-        return GPIOInfoGetValue(info, pin);
+        GPIOInfoWriteMask((GPIOInfoRef)info, (uint64_t)mask, (uint64_t)values);
+}
+
+static jlong
+Java_com_cdoapps_gpio_GPIO_nativeReadPins(JNIEnv * env, jclass clazz, jlong info, jlong mask) {
+    if (info)
+        return (jlong)GPIOInfoReadMask((GPIOInfoRef)info, (uint64_t)mask);
+
+    return 0l;
+}
+
+// The handle of an unexported pin stays in the GPIOInfo retained by its Pin, without output word
+// nor input word. Each of them is loaded once, since an unexport may clear it at any time.
+static void
+Java_com_cdoapps_gpio_GPIO_00024Pin_nativeSetValue(JNIEnv * env, jclass clazz, jlong handle,
+                                                   jint value) {
+    int output = handle ? GPIOPinHandleGetOutput((GPIOPinHandleRef)handle) : -1;
+    if (output != -1)
+        GPIOPinHandleSetOutputValue((GPIOPinHandleRef)handle, output, value);
+}
+
+static jint
+Java_com_cdoapps_gpio_GPIO_00024Pin_criticalGetValue(jlong handle) {
+    volatile uint32_t *input = handle ?
+            __atomic_load_n(&((GPIOPinHandleRef)handle)->input, __ATOMIC_RELAXED) : NULL;
+    if (input)
+        return (*input & ((GPIOPinHandleRef)handle)->mask) ? GPIO_PIN_VALUE_HIGH :
+                GPIO_PIN_VALUE_LOW;
 
     return -1;
-}
\ No newline at end of file
+}
+
+static jint
+Java_com_cdoapps_gpio_GPIO_00024Pin_nativeGetValue(JNIEnv * env, jclass clazz, jlong handle) {
+    return Java_com_cdoapps_gpio_GPIO_00024Pin_criticalGetValue(handle);
+}
+
+static void
+Java_com_cdoapps_gpio_GPIO_00024Pin_nativeRelease(JNIEnv * env, jclass clazz, jlong info) {
+    if (info)
+        GPIOInfoFree((GPIOInfoRef)info);
+}
+
+BOOL Java_com_cdoapps_gpio_GPIO_registerNatives(JNIEnv *env, BOOL critical) {
+    const JNINativeMethod methods[] = {
+            {"nativeSetValue", "(JII)V", (void *)Java_com_cdoapps_gpio_GPIO_nativeSetValue},
+            {"nativeGetValue", "(JI)I", (void *)Java_com_cdoapps_gpio_GPIO_nativeGetValue},
+            {"nativeWritePins", "(JJJ)V", (void *)Java_com_cdoapps_gpio_GPIO_nativeWritePins},
+            {"nativeReadPins", "(JJ)J", (void *)Java_com_cdoapps_gpio_GPIO_nativeReadPins}
+    };
+
+    const JNINativeMethod pinMethods[] = {
+            {"nativeSetValue", "(JI)V", (void *)Java_com_cdoapps_gpio_GPIO_00024Pin_nativeSetValue},
+            {"nativeGetValue", "(J)I", critical ?
+                    (void *)Java_com_cdoapps_gpio_GPIO_00024Pin_criticalGetValue :
+                    (void *)Java_com_cdoapps_gpio_GPIO_00024Pin_nativeGetValue},
+            {"nativeRelease", "(J)V", (void *)Java_com_cdoapps_gpio_GPIO_00024Pin_nativeRelease}
+    };
+
+    jclass clazz = (*env)->FindClass(env, "com/cdoapps/gpio/GPIO");
+    if (!clazz || (*env)->RegisterNatives(env, clazz, methods, 4) != JNI_OK)
+        return FALSE;
+    (*env)->DeleteLocalRef(env, clazz);
+
+    if ((*env)->RegisterNatives(env, JAVA_BINDINGS.gpioPin.clazz, pinMethods, 3) != JNI_OK)
+        return FALSE;
+
+    return TRUE;
+}
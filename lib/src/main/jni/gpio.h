@@ -15,24 +15,75 @@
 #ifndef GPIO_GPIO_H
 #define GPIO_GPIO_H
 
+#include <stdint.h>
+
 /**
  * The {@code GPIOInfo} struct provides control over Odroid-N2 gpio pins.
  *
+ * The values of different pins may be changed and read from many threads at once, the updates of
+ * a register word being serialized per word. Exporting, unexporting and configuring one pin must
+ * not race with any other access to that pin.
+ *
  * Wiki:
  * <a href="https://wiki.odroid.com/odroid-n2/odroid-n2">Hardkernel Odroid-N2</a>
  */
 typedef struct GPIOInfo *GPIOInfoRef;
 
+/**
+ * The {@code GPIOBackend} enum represents where the registers of a GPIO controller live.
+ */
+typedef enum {
+    /**
+     * The registers of the Odroid-N2, mapped from '/dev/mem' or '/dev/gpiomem', with a fallback
+     * to the GPIO character device ('/dev/gpiochipN'), then to 'sysfs'.
+     *
+     * The character device is the chip labelled "periphs", or the one named by the
+     * 'GPIO_CDEV_CHIP' environment variable (e.g. a 'gpio-sim' chip). Its lines are found by
+     * name ("GPIOX_3"), or by their sysfs number when they have none.
+     */
+    GPIOBackendDevice,
+
+    /**
+     * A 4 KiB block of shared memory laid out like the registers of the Odroid-N2, which lets the
+     * controller run on any Linux host. Nothing drives the input words but a simulated peripheral
+     * (see {@code GPIOInfoSetSimulatorCallback}).
+     */
+    GPIOBackendSimulated
+} GPIOBackend;
+
 /**
  * Returns a {@code GPIOInfo} object which represents a GPIO controller for the Odroid-N2.
  *
+ * The backend is {@code GPIOBackendDevice} unless the 'GPIO_BACKEND' environment variable is
+ * "simulated". The simulated registers are shared through the file named by the
+ * 'GPIO_SIMULATED_REGISTERS' environment variable, if any.
+ *
  * @return a {@code GPIOInfo} object which represents a GPIO controller for the Odroid-N2.
  */
 GPIOInfoRef GPIOInfoAlloc(void);
 /**
- * Destroys the resources associated to a GPIO controller.
+ * Returns a {@code GPIOInfo} object which represents a GPIO controller for the Odroid-N2, using
+ * a given backend.
+ *
+ * @param backend where the registers of the controller live.
+ * @return a {@code GPIOInfo} object which represents a GPIO controller for the Odroid-N2.
+ */
+GPIOInfoRef GPIOInfoAllocWithBackend(GPIOBackend backend);
+/**
+ * Adds a reference to a GPIO controller, so that it is not destroyed before the reference is
+ * released with {@code GPIOInfoFree}. The objects which keep pin handles, register words or a
+ * {@code GPIOInfo} pointer after they are created (the engines of the library) hold one.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @return {@code info}.
+ */
+GPIOInfoRef GPIOInfoRetain(GPIOInfoRef info);
+/**
+ * Releases a reference to a GPIO controller, returned by {@code GPIOInfoAlloc} or added by
+ * {@code GPIOInfoRetain}. The resources associated to it are destroyed with the last reference,
+ * thus the registers stay mapped while an engine still uses them.
  *
- * @param info a {@code GPIOInfo} object representing the GPIO controller to destroy.
+ * @param info a {@code GPIOInfo} object representing the GPIO controller to release.
  */
 void GPIOInfoFree(GPIOInfoRef info);
 
@@ -57,6 +108,88 @@ void GPIOInfoUnexport(GPIOInfoRef info, int pin);
  */
 void GPIOInfoUnexportAll(GPIOInfoRef info);
 
+/**
+ * Checks whether a shadow copy of the registers is used.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @return {@code TRUE} if the output, direction, pull and mux registers are shadowed.
+ */
+BOOL GPIOInfoUsesShadow(GPIOInfoRef info);
+/**
+ * Sets whether a shadow copy of the registers is used.
+ *
+ * The mapped registers are uncached, thus changing one bit costs a device read before the write.
+ * With a shadow copy, the output, direction, pull and mux words are changed in memory and stored
+ * once, without any read, and the writes which would not change a word are skipped. Input words
+ * are always read from the device.
+ *
+ * The shadow copy is synchronized when enabled. While it is used, {@code GPIOInfoGetPinHandle}
+ * returns {@code NULL} since the handles would bypass it. For the same reason, it is not enabled
+ * while a handle returned before may be in use: the pins of the handles (e.g. of a 1-Wire bus or
+ * a {@code GPIO.Pin}) must be unexported first. It has no effect on 'sysfs' access.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param shadow if {@code TRUE}, will use a shadow copy of the registers.
+ * @return {@code TRUE} on success, {@code FALSE} if the registers are not mapped or if a pin handle
+ *         was returned since its pin was exported.
+ */
+BOOL GPIOInfoSetUsesShadow(GPIOInfoRef info, BOOL shadow);
+/**
+ * Reloads the shadow copy of the registers from the device.
+ *
+ * This must be called after the registers were changed by another process or through a pin
+ * handle, otherwise the next writes would restore stale bits.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ */
+void GPIOInfoSyncShadow(GPIOInfoRef info);
+
+/**
+ * A function called after each write of a register word, to let a simulated peripheral react.
+ *
+ * It may change the input words through {@code GPIOInfoGetRegisters}, but must not call back any
+ * function changing the registers of {@code info}.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param index the index of the 32-bit register word which was written.
+ * @param value the new value of the register word.
+ * @param context the pointer given to {@code GPIOInfoSetSimulatorCallback}.
+ */
+typedef void (*GPIOSimulatorWriteCallback)(GPIOInfoRef info, int index, uint32_t value,
+                                           void *context);
+
+/**
+ * Sets the function called after each write of a register word.
+ *
+ * The writes through the pin handles and {@code GPIOWordWrite} are only reported by the builds
+ * defining {@code GPIO_SIMULATOR_WRITES}, like the host build, so that the device build keeps
+ * this hook out of its hot paths. The other builds refuse the pin handles while a callback is
+ * set. It should be set before the pins are configured.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param callback the function to call, or {@code NULL}.
+ * @param context a pointer given back to {@code callback}.
+ */
+void GPIOInfoSetSimulatorCallback(GPIOInfoRef info, GPIOSimulatorWriteCallback callback,
+                                  void *context);
+/**
+ * Returns the register words of a GPIO controller, laid out like the registers of the Odroid-N2.
+ *
+ * A simulated peripheral drives its inputs by changing the input words.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @return the register words, or {@code NULL} if they are not mapped.
+ */
+volatile uint32_t *GPIOInfoGetRegisters(GPIOInfoRef info);
+/**
+ * Returns where the registers of a GPIO controller live, so that the other register blocks of the
+ * SoC (e.g. PWM) are mapped from the same backend.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @return the backend given to {@code GPIOInfoAllocWithBackend}.
+ */
+GPIOBackend GPIOInfoGetBackend(GPIOInfoRef info);
+
 /**
  * "in"
  * One may call {@code GPIOInfoSetMode} with this value to use one pin as an input.
@@ -71,18 +204,62 @@ extern const char *GPIO_PIN_MODE_OUTPUT;
 /**
  * Changes the communication mode of one pin.
  *
+ * This is a wrapper of {@code GPIOInfoSetPinMode} kept for the string based API.
+ *
  * @param info a {@code GPIOInfo} object representing the GPIO controller.
  * @param pin the WiringPi address of the pin.
  * @param mode should be either {@code GPIO_PIN_MODE_INPUT} or {@code GPIO_PIN_MODE_OUTPUT}.
  */
 void GPIOInfoSetMode(GPIOInfoRef info, int pin, const char *mode);
 
+/**
+ * The {@code GPIOPinMode} enum represents the communication mode of one pin.
+ */
+typedef enum {
+    /**
+     * The pin is used as an input.
+     */
+    GPIOPinModeInput,
+
+    /**
+     * The pin is used as an output.
+     */
+    GPIOPinModeOutput,
+
+    /**
+     * The pin emulates an open-drain output: its output latch is preloaded low, then
+     * {@code GPIO_PIN_VALUE_LOW} drives the line by enabling the output and
+     * {@code GPIO_PIN_VALUE_HIGH} releases it by disabling the output, letting a pull up resistor
+     * raise the line. Each change is a single toggle of the direction register.
+     */
+    GPIOPinModeOpenDrain
+} GPIOPinMode;
+
+/**
+ * Changes the communication mode of one pin.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param pin the WiringPi address of the pin.
+ * @param mode the new communication mode of {@code pin}.
+ */
+void GPIOInfoSetPinMode(GPIOInfoRef info, int pin, GPIOPinMode mode);
+/**
+ * Routes one pin to a peripheral of the SoC by changing its mux, {@code 0} being the GPIO function
+ * selected by {@code GPIOInfoSetPinMode}.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param pin the WiringPi address of the pin, which must be exported in register mode.
+ * @param function the alternate function of {@code pin}, from {@code 0} to {@code 15}.
+ * @return {@code TRUE} on success.
+ */
+BOOL GPIOInfoSetPinFunction(GPIOInfoRef info, int pin, int function);
+
 /**
  * "down"
  * One may call {@code GPIOInfoSetPullState} with this value to use one pin with an internal pull
  * down resistor.
  */
-const char *GPIO_PIN_PULL_DOWN;
+extern const char *GPIO_PIN_PULL_DOWN;
 /**
  * "up"
  * One may call {@code GPIOInfoSetPullState} with this value to use one pin with an internal pull up
@@ -95,8 +272,47 @@ extern const char *GPIO_PIN_PULL_UP;
  */
 extern const char *GPIO_PIN_PULL_OFF;
 
+/**
+ * Changes the internal resistor state of one pin.
+ *
+ * This is a wrapper of {@code GPIOInfoSetPinPull} kept for the string based API.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param pin the WiringPi address of the pin.
+ * @param state should be either {@code GPIO_PIN_PULL_DOWN}, {@code GPIO_PIN_PULL_UP} or
+ *              {@code GPIO_PIN_PULL_OFF}.
+ */
 void GPIOInfoSetPullState(GPIOInfoRef info, int pin, const char *state);
 
+/**
+ * The {@code GPIOPinPull} enum represents the internal resistor state of one pin.
+ */
+typedef enum {
+    /**
+     * The pin is floating.
+     */
+    GPIOPinPullOff,
+
+    /**
+     * The pin uses an internal pull down resistor.
+     */
+    GPIOPinPullDown,
+
+    /**
+     * The pin uses an internal pull up resistor.
+     */
+    GPIOPinPullUp
+} GPIOPinPull;
+
+/**
+ * Changes the internal resistor state of one pin.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param pin the WiringPi address of the pin.
+ * @param pull the new internal resistor state of {@code pin}.
+ */
+void GPIOInfoSetPinPull(GPIOInfoRef info, int pin, GPIOPinPull pull);
+
 /**
  * The value returned for a pin connected to GND.
  */
@@ -123,4 +339,430 @@ void GPIOInfoSetValue(GPIOInfoRef info, int pin, int value);
  */
 int GPIOInfoGetValue(GPIOInfoRef info, int pin);
 
+/**
+ * Changes the values of many pins at once.
+ *
+ * The pins sharing the same register word are updated with a single read-modify-write, thus they
+ * switch in the same cycle. With the character device, the ungrouped lines are moved to a group
+ * request on the first call, then the lines of each group are changed with a single ioctl.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param mask a bit mask of the WiringPi addresses of the pins to change.
+ * @param values a bit mask of the new values, bit {@code n} being the value of pin {@code n}.
+ */
+void GPIOInfoWriteMask(GPIOInfoRef info, uint64_t mask, uint64_t values);
+/**
+ * Returns the values of many pins at once.
+ *
+ * The pins sharing the same register word are sampled with a single read. With the character
+ * device, the ungrouped lines are moved to a group request on the first call, then the lines of
+ * each group are read with a single ioctl.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param mask a bit mask of the WiringPi addresses of the pins to read.
+ * @return a bit mask of the values, bit {@code n} being the value of pin {@code n}.
+ */
+uint64_t GPIOInfoReadMask(GPIOInfoRef info, uint64_t mask);
+
+/**
+ * The {@code GPIOEdge} enum represents the transitions of one input pin which are reported.
+ */
+typedef enum {
+    /**
+     * No transition is reported.
+     */
+    GPIOEdgeNone,
+
+    /**
+     * The transitions from {@code GPIO_PIN_VALUE_LOW} to {@code GPIO_PIN_VALUE_HIGH} are reported.
+     */
+    GPIOEdgeRising,
+
+    /**
+     * The transitions from {@code GPIO_PIN_VALUE_HIGH} to {@code GPIO_PIN_VALUE_LOW} are reported.
+     */
+    GPIOEdgeFalling,
+
+    /**
+     * All the transitions are reported.
+     */
+    GPIOEdgeBoth
+} GPIOEdge;
+
+/**
+ * The {@code GPIOEdgeEvent} struct represents one transition of an input pin.
+ */
+struct GPIOEdgeEvent {
+    /**
+     * The time of the transition, in nanoseconds of {@code CLOCK_MONOTONIC}.
+     */
+    long long timestamp;
+
+    /**
+     * The value of the pin after the transition.
+     */
+    int value;
+};
+
+/**
+ * Changes the transitions of one input pin which are reported.
+ *
+ * Edges are detected by the kernel, thus they need the character device or the 'sysfs' access.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param pin the WiringPi address of the pin.
+ * @param edge the transitions to report.
+ * @return {@code TRUE} on success, {@code FALSE} if the access of {@code pin} cannot detect edges.
+ */
+BOOL GPIOInfoSetPinEdge(GPIOInfoRef info, int pin, GPIOEdge edge);
+/**
+ * Returns the transitions of one input pin which are reported.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param pin the WiringPi address of the pin.
+ * @return the transitions of {@code pin} which are reported.
+ */
+GPIOEdge GPIOInfoGetPinEdge(GPIOInfoRef info, int pin);
+/**
+ * Blocks until one input pin reports transitions, without any polling of its value.
+ *
+ * With the character device access, the kernel queues the events, thus many of them may be
+ * returned at once. With the 'sysfs' access, the value which follows one transition is read
+ * after the wake up, and a single event is returned.
+ *
+ * The edges of the pins must not be changed, nor the pins exported or unexported, while a thread
+ * is waiting.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param pin the WiringPi address of the pin.
+ * @param events the events which are filled, oldest first.
+ * @param count the maximum number of events to return.
+ * @param timeout the maximum time to wait in nanoseconds, or a negative value to wait forever.
+ * @return the number of events returned, {@code 0} on timeout or {@code -1} on error.
+ */
+int GPIOInfoWaitForEdges(GPIOInfoRef info, int pin, struct GPIOEdgeEvent *events, int count,
+                         long long timeout);
+
+/**
+ * Waits for a register lock held by another thread: see {@code GPIORegisterLock}.
+ *
+ * @param lock the lock of the register word.
+ */
+void GPIORegisterLockContended(int *lock);
+/**
+ * Wakes up one thread sleeping in {@code GPIORegisterLockContended}.
+ *
+ * @param lock the lock of the register word.
+ */
+void GPIORegisterWake(int *lock);
+
+/**
+ * Waits for the lock guarding one register word. Each word has its own lock, thus pins of
+ * different banks never wait for each other.
+ *
+ * The mapped registers are device memory on which exclusive accesses are not guaranteed to work,
+ * thus the lock lives in normal memory and guards a plain read-modify-write of the register.
+ *
+ * The lock is {@code 0} when free, {@code 1} when held and {@code 2} when held with waiters. A
+ * waiter spins shortly, then sleeps on a futex: the holder may be a thread of a lower priority
+ * preempted on the same CPU, which a spinning {@code SCHED_FIFO} thread would never let run.
+ *
+ * @param lock the lock of the register word.
+ */
+static inline void GPIORegisterLock(int *lock) {
+    int expected = 0;
+    if (!__atomic_compare_exchange_n(lock, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        GPIORegisterLockContended(lock);
+}
+/**
+ * Releases the lock guarding one register word.
+ *
+ * @param lock the lock of the register word.
+ */
+static inline void GPIORegisterUnlock(int *lock) {
+    if (__atomic_exchange_n(lock, 0, __ATOMIC_RELEASE) == 2)
+        GPIORegisterWake(lock);
+}
+
+/**
+ * The {@code GPIORegisterWord} struct represents one register word written under its lock.
+ */
+struct GPIORegisterWord {
+    volatile uint32_t *set;
+    int *lock;
+};
+
+/**
+ * The {@code GPIOPinHandle} struct gives a direct access to the registers of one pin exported in
+ * register mode. Its fields are resolved once by {@code GPIOInfoExport} and should be considered
+ * private.
+ *
+ * The value of a pin is written to its output latch, or to its direction in
+ * {@code GPIOPinModeOpenDrain}. A mode change or an unexport only stores the index of the word
+ * written, thus a concurrent write never pairs a word with the lock of another one.
+ */
+struct GPIOPinHandle {
+    struct GPIORegisterWord words[2]; // the output latch, then the direction
+    int output; // the index of the word written in words, -1 once unexported
+    volatile uint32_t *input; // NULL once unexported
+    uint32_t mask;
+    GPIOInfoRef simulated; // the controller told about the writes, NULL on the device
+};
+typedef const struct GPIOPinHandle *GPIOPinHandleRef;
+
+/**
+ * Calls the simulator callback of a controller, if any, after a write through a pin handle.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param word the register word which was written.
+ * @param value the new value of {@code word}.
+ */
+void GPIOInfoNotifyWrite(GPIOInfoRef info, volatile uint32_t *word, uint32_t value);
+
+/**
+ * Reports a write through a pin handle or a {@code GPIOWordWrite} to the simulator callback, in the
+ * builds defining {@code GPIO_SIMULATOR_WRITES} only.
+ *
+ * @param simulated the controller of the simulated backend, or {@code NULL} on the device.
+ * @param word the register word which was written.
+ * @param value the new value of {@code word}.
+ */
+static inline void GPIOSimulatorNotifyWrite(GPIOInfoRef simulated, volatile uint32_t *word,
+                                            uint32_t value) {
+#ifdef GPIO_SIMULATOR_WRITES
+    if (simulated)
+        GPIOInfoNotifyWrite(simulated, word, value);
+#else
+    (void)simulated;
+    (void)word;
+    (void)value;
+#endif
+}
+
+/**
+ * Returns a handle used to change and read one pin without any lookup.
+ *
+ * The handle remains valid until {@code pin} is unexported or {@code info} is destroyed. Its
+ * storage lives as long as {@code info}, thus a caller racing with an unexport loads its output
+ * once with {@code GPIOPinHandleGetOutput}, and finds {@code -1} once the pin is unexported. No
+ * handle is given while a shadow copy of the registers is used. It follows the mode of
+ * {@code pin}, thus the values of a pin in {@code GPIOPinModeOpenDrain} are changed through its
+ * direction.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param pin the WiringPi address of the pin.
+ * @return a handle on {@code pin}, or {@code NULL} if it is not exported in register mode, if the
+ *         registers are shadowed or if a simulator callback is set in a build which does not
+ *         report the writes of the handles.
+ */
+GPIOPinHandleRef GPIOInfoGetPinHandle(GPIOInfoRef info, int pin);
+/**
+ * Returns the input register word of one pin exported in register mode, to sample it along with
+ * the other pins of its bank.
+ *
+ * Unlike {@code GPIOInfoGetPinHandle}, this is available whatever the shadow copy and simulator
+ * settings since the input words are never written.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param pin the WiringPi address of the pin.
+ * @param mask if not {@code NULL}, set the bit of {@code pin} in the word on return.
+ * @return the input word of {@code pin}, or {@code NULL} if it is not exported in register mode.
+ */
+volatile uint32_t *GPIOInfoGetPinInput(GPIOInfoRef info, int pin, uint32_t *mask);
+
+/**
+ * The {@code GPIOInputWord} struct groups the sampled pins sharing one input register word, so
+ * that each word is read once per sample.
+ */
+struct GPIOInputWord {
+    volatile uint32_t *word;
+    uint32_t mask;
+    uint32_t previous; // the bits of the last sample
+};
+
+/**
+ * Adds one pin exported in register mode to the input words it is sampled with.
+ *
+ * @param info a {@code GPIOInfo} object representing the GPIO controller.
+ * @param words the input words, large enough for one more word.
+ * @param count the number of words, increased on return if the word of {@code pin} had none.
+ * @param pin the WiringPi address of the pin.
+ * @param mask if not {@code NULL}, set the bit of {@code pin} in its word on return.
+ * @return the index of the word of {@code pin} in {@code words}, or {@code -1} if it is not
+ *         exported in register mode.
+ */
+int GPIOInfoAddInputWord(GPIOInfoRef info, struct GPIOInputWord *words, int *count, int pin,
+                         uint32_t *mask);
+
+/**
+ * Reads the input words one after the other, so that they are sampled as close as possible.
+ *
+ * @param words the input words.
+ * @param count the number of words.
+ * @param values the bits of the pins of each word on return.
+ */
+static inline void GPIOInputWordRead(const struct GPIOInputWord *words, int count,
+                                     uint32_t *values) {
+    for (int index = 0 ; index < count ; index++)
+        values[index] = *words[index].word & words[index].mask;
+}
+/**
+ * Reads the input words like {@code GPIOInputWordRead}, then keeps the values as the previous
+ * ones of the next sample.
+ *
+ * @param words the input words.
+ * @param count the number of words.
+ * @param values the bits of the pins of each word on return.
+ * @return {@code 1} if any word changed since the previous sample, or {@code 0}.
+ */
+static inline int GPIOInputWordSample(struct GPIOInputWord *words, int count, uint32_t *values) {
+    int changed = 0;
+
+    GPIOInputWordRead(words, count, values);
+    for (int index = 0 ; index < count ; index++) {
+        if (values[index] != words[index].previous) {
+            words[index].previous = values[index];
+            changed = 1;
+        }
+    }
+
+    return changed;
+}
+
+/**
+ * Returns the index of the word written by the setters of one pin, loaded once so that the
+ * callers racing with an unexport check it before using it.
+ *
+ * @param handle a handle returned by {@code GPIOInfoGetPinHandle}.
+ * @return the index of the word in the words of {@code handle}, or {@code -1} once the pin is
+ *         unexported.
+ */
+static inline int GPIOPinHandleGetOutput(GPIOPinHandleRef handle) {
+    return __atomic_load_n(&handle->output, __ATOMIC_RELAXED);
+}
+/**
+ * Returns the register word written by the setters of one pin.
+ *
+ * @param handle a handle returned by {@code GPIOInfoGetPinHandle}, of a pin still exported.
+ * @return the output latch of the pin, or its direction in {@code GPIOPinModeOpenDrain}.
+ */
+static inline const struct GPIORegisterWord *GPIOPinHandleGetWord(GPIOPinHandleRef handle) {
+    return &handle->words[GPIOPinHandleGetOutput(handle)];
+}
+/**
+ * Changes the value of one pin through one word of its handle.
+ *
+ * The write is a read-modify-write under the lock of the word rather than a single store: the
+ * registers have no set and clear words, and the other pins of the bank share the word with
+ * {@code GPIOInfoSetValue}, the word writes and their own handles. The lock is most of the cost.
+ *
+ * @param handle a handle returned by {@code GPIOInfoGetPinHandle}.
+ * @param output an index returned by {@code GPIOPinHandleGetOutput}, other than {@code -1}.
+ * @param value should be either {@code GPIO_PIN_VALUE_LOW} or {@code GPIO_PIN_VALUE_HIGH}.
+ */
+static inline void GPIOPinHandleSetOutputValue(GPIOPinHandleRef handle, int output, int value) {
+    const struct GPIORegisterWord *word = &handle->words[output];
+    uint32_t bits = -(uint32_t)(value != 0) & handle->mask;
+
+    GPIORegisterLock(word->lock);
+    uint32_t written = (*word->set & ~handle->mask) | bits;
+    *word->set = written;
+    GPIORegisterUnlock(word->lock);
+
+    GPIOSimulatorNotifyWrite(handle->simulated, word->set, written);
+}
+/**
+ * Changes the value of one pin.
+ *
+ * @param handle a handle returned by {@code GPIOInfoGetPinHandle}.
+ * @param value should be either {@code GPIO_PIN_VALUE_LOW} or {@code GPIO_PIN_VALUE_HIGH}.
+ */
+static inline void GPIOPinHandleSetValue(GPIOPinHandleRef handle, int value) {
+    GPIOPinHandleSetOutputValue(handle, GPIOPinHandleGetOutput(handle), value);
+}
+/**
+ * Changes the value of one pin to {@code GPIO_PIN_VALUE_HIGH}.
+ *
+ * @param handle a handle returned by {@code GPIOInfoGetPinHandle}.
+ */
+static inline void GPIOPinHandleSetHigh(GPIOPinHandleRef handle) {
+    GPIOPinHandleSetValue(handle, GPIO_PIN_VALUE_HIGH);
+}
+/**
+ * Changes the value of one pin to {@code GPIO_PIN_VALUE_LOW}.
+ *
+ * @param handle a handle returned by {@code GPIOInfoGetPinHandle}.
+ */
+static inline void GPIOPinHandleSetLow(GPIOPinHandleRef handle) {
+    GPIOPinHandleSetValue(handle, GPIO_PIN_VALUE_LOW);
+}
+/**
+ * Returns the value of one pin.
+ *
+ * @param handle a handle returned by {@code GPIOInfoGetPinHandle}.
+ * @return either {@code GPIO_PIN_VALUE_LOW} or {@code GPIO_PIN_VALUE_HIGH}.
+ */
+static inline int GPIOPinHandleGetValue(GPIOPinHandleRef handle) {
+    return (*handle->input & handle->mask) != 0;
+}
+
+/**
+ * The {@code GPIOWordWrite} struct accumulates the changes of many pins sharing one register word,
+ * so that they are applied with a single read-modify-write.
+ */
+struct GPIOWordWrite {
+    volatile uint32_t *set;
+    int *lock;
+    GPIOInfoRef simulated;
+    uint32_t mask;
+    uint32_t bits;
+};
+
+/**
+ * Adds the change of one pin to the writes of its register word.
+ *
+ * @param writes the writes, one per register word.
+ * @param count the number of writes, increased on return if the word of {@code handle} had none.
+ * @param handle a handle returned by {@code GPIOInfoGetPinHandle}.
+ * @param value should be either {@code GPIO_PIN_VALUE_LOW} or {@code GPIO_PIN_VALUE_HIGH}.
+ */
+static inline void GPIOWordWriteAdd(struct GPIOWordWrite *writes, int *count,
+                                    GPIOPinHandleRef handle, int value) {
+    const struct GPIORegisterWord *word = GPIOPinHandleGetWord(handle);
+    int index = 0;
+    while (index < *count && writes[index].set != word->set)
+        index++;
+
+    if (index == *count)
+        writes[(*count)++] = (struct GPIOWordWrite){
+                .set = word->set,
+                .lock = word->lock,
+                .simulated = handle->simulated,
+                .mask = 0x0,
+                .bits = 0x0
+        };
+
+    writes[index].mask |= handle->mask;
+    if (value)
+        writes[index].bits |= handle->mask;
+    else
+        writes[index].bits &= ~handle->mask;
+}
+/**
+ * Applies the writes of many register words.
+ *
+ * @param writes the writes, one per register word.
+ * @param count the number of writes.
+ */
+static inline void GPIOWordWriteApply(const struct GPIOWordWrite *writes, int count) {
+    for (int index = 0 ; index < count ; index++) {
+        GPIORegisterLock(writes[index].lock);
+        uint32_t value = (*writes[index].set & ~writes[index].mask) | writes[index].bits;
+        *writes[index].set = value;
+        GPIORegisterUnlock(writes[index].lock);
+
+        GPIOSimulatorNotifyWrite(writes[index].simulated, writes[index].set, value);
+    }
+}
+
 #endif //GPIO_GPIO_H
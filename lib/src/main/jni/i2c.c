@@ -0,0 +1,432 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common.h"
+#include "bindings.h"
+#include "delay.h"
+#include "i2c.h"
+
+#include <stdlib.h>
+
+// the maximum rise time of SCL in fast mode, after which a low clock is stretched by a slave
+#define I2C_RISE_TIME 300
+// SMBus gives up after 25 ms of clock stretching
+#define I2C_STRETCH_TIMEOUT 25000000LL
+// a slave holding SDA releases it after at most 9 clock pulses
+#define I2C_RECOVERY_PULSES 9
+
+struct I2CInfo {
+    GPIOInfoRef gpioInfo;
+    int sdaPin;
+    int sclPin;
+    GPIOPinHandleRef sda; // the pins driving the bus, if they can be accessed directly
+    GPIOPinHandleRef scl;
+
+    long long halfPeriod;
+    long long deadline;
+
+    long long cycles;
+    long long elapsed;
+    long long stretchCount;
+
+    BOOL realtime;
+    struct RealtimeOptions realtimeOptions;
+    struct RealtimeSession shared; // the memory lock and the latency request of the options
+};
+
+I2CInfoRef I2CInfoCreate(GPIOInfoRef gpioInfo, int sdaPin, int sclPin, int frequency) {
+    I2CInfoRef info = calloc(1, sizeof(struct I2CInfo));
+
+    info->gpioInfo = GPIOInfoRetain(gpioInfo);
+    info->sdaPin = sdaPin;
+    info->sclPin = sclPin;
+    info->halfPeriod = 500000000LL / ((frequency > 0) ? frequency : 100000);
+
+    GPIOInfoExport(gpioInfo, sdaPin);
+    GPIOInfoExport(gpioInfo, sclPin);
+
+    // the pins are released with a change of their direction, so that they are never driven high
+    // against a slave pulling the bus down
+    GPIOInfoSetPinMode(gpioInfo, sdaPin, GPIOPinModeOpenDrain);
+    GPIOInfoSetPinMode(gpioInfo, sclPin, GPIOPinModeOpenDrain);
+    GPIOInfoSetValue(gpioInfo, sdaPin, GPIO_PIN_VALUE_HIGH);
+    GPIOInfoSetValue(gpioInfo, sclPin, GPIO_PIN_VALUE_HIGH);
+
+    info->sda = GPIOInfoGetPinHandle(gpioInfo, sdaPin);
+    info->scl = GPIOInfoGetPinHandle(gpioInfo, sclPin);
+    if (!info->sda || !info->scl)
+        LOG_WARN("The I2C pins are not in register mode, the bus will be slow");
+
+    return info;
+}
+
+void I2CInfoFree(I2CInfoRef info) {
+    GPIOInfoUnexport(info->gpioInfo, info->sdaPin);
+    GPIOInfoUnexport(info->gpioInfo, info->sclPin);
+    RealtimeSessionExit(&info->shared);
+    GPIOInfoFree(info->gpioInfo);
+    free(info);
+}
+
+void I2CInfoSetRealtime(I2CInfoRef info, const struct RealtimeOptions *options) {
+    // the memory is locked once for all the transfers rather than around each of them
+    RealtimeSessionExit(&info->shared);
+    info->realtime = options ? TRUE : FALSE;
+    if (options) {
+        info->realtimeOptions = *options;
+        RealtimeSessionHold(&info->shared, options);
+    }
+}
+
+static inline void I2CInfoDrive(I2CInfoRef info, GPIOPinHandleRef handle, int pin, int value) {
+    if (handle)
+        GPIOPinHandleSetValue(handle, value);
+    else
+        GPIOInfoSetValue(info->gpioInfo, pin, value);
+}
+
+static inline int I2CInfoSample(I2CInfoRef info, GPIOPinHandleRef handle, int pin) {
+    if (handle)
+        return GPIOPinHandleGetValue(handle);
+
+    return GPIOInfoGetValue(info->gpioInfo, pin);
+}
+
+static inline void I2CInfoSetSDA(I2CInfoRef info, int value) {
+    I2CInfoDrive(info, info->sda, info->sdaPin, value);
+}
+
+static inline int I2CInfoGetSDA(I2CInfoRef info) {
+    return I2CInfoSample(info, info->sda, info->sdaPin);
+}
+
+static inline void I2CInfoPullSCL(I2CInfoRef info) {
+    I2CInfoDrive(info, info->scl, info->sclPin, GPIO_PIN_VALUE_LOW);
+}
+
+static inline void I2CInfoWait(I2CInfoRef info) {
+    DelayUntilNext(&info->deadline, info->halfPeriod);
+}
+
+// Releases SCL and waits until it is actually high. A slave holding it low longer than the rise
+// time is stretching the clock: the high phase then starts when it is released.
+static BOOL I2CInfoReleaseSCL(I2CInfoRef info) {
+    I2CInfoDrive(info, info->scl, info->sclPin, GPIO_PIN_VALUE_HIGH);
+    info->cycles++;
+
+    if (I2CInfoSample(info, info->scl, info->sclPin) != GPIO_PIN_VALUE_LOW)
+        return TRUE;
+
+    long long released = DelayGetTime();
+    long long time = released;
+    while (I2CInfoSample(info, info->scl, info->sclPin) == GPIO_PIN_VALUE_LOW) {
+        time = DelayGetTime();
+        if (time - released > I2C_STRETCH_TIMEOUT)
+            return FALSE;
+    }
+
+    if (time - released > I2C_RISE_TIME) {
+        info->stretchCount++;
+        if (time > info->deadline)
+            info->deadline = time;
+    }
+
+    return TRUE;
+}
+
+static BOOL I2CInfoWriteBit(I2CInfoRef info, int bit) {
+    I2CInfoSetSDA(info, bit);
+    I2CInfoWait(info);
+
+    if (!I2CInfoReleaseSCL(info))
+        return FALSE;
+    I2CInfoWait(info);
+
+    I2CInfoPullSCL(info);
+    return TRUE;
+}
+
+static BOOL I2CInfoReadBit(I2CInfoRef info, int *bit) {
+    I2CInfoSetSDA(info, GPIO_PIN_VALUE_HIGH);
+    I2CInfoWait(info);
+
+    if (!I2CInfoReleaseSCL(info))
+        return FALSE;
+    I2CInfoWait(info);
+
+    // the data is sampled at the end of the high phase
+    *bit = I2CInfoGetSDA(info);
+    I2CInfoPullSCL(info);
+    return TRUE;
+}
+
+static I2CStatus I2CInfoWriteByte(I2CInfoRef info, uint8_t value, BOOL *ack) {
+    for (int position = 7 ; position >= 0 ; position--) {
+        if (!I2CInfoWriteBit(info, (value >> position) & 0x1))
+            return I2CStatusTimeout;
+    }
+
+    int bit;
+    if (!I2CInfoReadBit(info, &bit))
+        return I2CStatusTimeout;
+
+    *ack = (bit == GPIO_PIN_VALUE_LOW) ? TRUE : FALSE;
+    return I2CStatusOk;
+}
+
+static I2CStatus I2CInfoReadByte(I2CInfoRef info, uint8_t *value, BOOL ack) {
+    uint8_t byte = 0x0;
+
+    for (int position = 7 ; position >= 0 ; position--) {
+        int bit;
+        if (!I2CInfoReadBit(info, &bit))
+            return I2CStatusTimeout;
+
+        byte |= (uint8_t)(bit << position);
+    }
+
+    // the last byte is not acknowledged, so that the slave releases SDA for the stop condition
+    if (!I2CInfoWriteBit(info, ack ? GPIO_PIN_VALUE_LOW : GPIO_PIN_VALUE_HIGH))
+        return I2CStatusTimeout;
+
+    *value = byte;
+    return I2CStatusOk;
+}
+
+// A slave reset in the middle of a read may still hold SDA low: it is clocked until it releases
+// the bus.
+static BOOL I2CInfoRecover(I2CInfoRef info) {
+    for (int pulse = 0 ; pulse < I2C_RECOVERY_PULSES ; pulse++) {
+        if (I2CInfoGetSDA(info) != GPIO_PIN_VALUE_LOW)
+            return TRUE;
+
+        I2CInfoPullSCL(info);
+        I2CInfoWait(info);
+        if (!I2CInfoReleaseSCL(info))
+            return FALSE;
+        I2CInfoWait(info);
+    }
+
+    return (I2CInfoGetSDA(info) != GPIO_PIN_VALUE_LOW) ? TRUE : FALSE;
+}
+
+static BOOL I2CInfoStart(I2CInfoRef info) {
+    // SDA falls while SCL is high
+    I2CInfoSetSDA(info, GPIO_PIN_VALUE_LOW);
+    I2CInfoWait(info);
+
+    I2CInfoPullSCL(info);
+    return TRUE;
+}
+
+static BOOL I2CInfoRepeatedStart(I2CInfoRef info) {
+    I2CInfoSetSDA(info, GPIO_PIN_VALUE_HIGH);
+    I2CInfoWait(info);
+
+    if (!I2CInfoReleaseSCL(info))
+        return FALSE;
+    I2CInfoWait(info);
+
+    return I2CInfoStart(info);
+}
+
+static void I2CInfoStop(I2CInfoRef info) {
+    // SDA rises while SCL is high
+    I2CInfoSetSDA(info, GPIO_PIN_VALUE_LOW);
+    I2CInfoWait(info);
+
+    I2CInfoReleaseSCL(info);
+    I2CInfoWait(info);
+
+    I2CInfoSetSDA(info, GPIO_PIN_VALUE_HIGH);
+    I2CInfoWait(info);
+}
+
+static I2CStatus I2CInfoSendAddress(I2CInfoRef info, int address, BOOL read) {
+    BOOL ack = FALSE;
+    I2CStatus status = I2CInfoWriteByte(info, (uint8_t)((address << 1) | (read ? 0x1 : 0x0)), &ack);
+    if (status != I2CStatusOk)
+        return status;
+
+    return ack ? I2CStatusOk : I2CStatusAddressNack;
+}
+
+static I2CStatus I2CInfoRun(I2CInfoRef info, int address, const uint8_t *writeBuffer,
+                            int writeCount, uint8_t *readBuffer, int readCount) {
+    I2CStatus status;
+
+    if (writeCount > 0) {
+        status = I2CInfoSendAddress(info, address, FALSE);
+        if (status != I2CStatusOk)
+            return status;
+
+        for (int index = 0 ; index < writeCount ; index++) {
+            BOOL ack = FALSE;
+            status = I2CInfoWriteByte(info, writeBuffer[index], &ack);
+            if (status != I2CStatusOk)
+                return status;
+            if (!ack)
+                return I2CStatusDataNack;
+        }
+
+        if (readCount > 0 && !I2CInfoRepeatedStart(info))
+            return I2CStatusTimeout;
+    }
+
+    if (readCount > 0) {
+        status = I2CInfoSendAddress(info, address, TRUE);
+        if (status != I2CStatusOk)
+            return status;
+
+        for (int index = 0 ; index < readCount ; index++) {
+            BOOL ack = (index < readCount - 1) ? TRUE : FALSE;
+            status = I2CInfoReadByte(info, &readBuffer[index], ack);
+            if (status != I2CStatusOk)
+                return status;
+        }
+    }
+
+    return I2CStatusOk;
+}
+
+I2CStatus I2CInfoTransfer(I2CInfoRef info, int address, const uint8_t *writeBuffer, int writeCount,
+                          uint8_t *readBuffer, int readCount) {
+    info->cycles = 0;
+    info->elapsed = 0;
+    if (writeCount <= 0 && readCount <= 0)
+        return I2CStatusOk;
+
+    struct RealtimeSession session = { .active = FALSE };
+    if (info->realtime)
+        RealtimeSessionEnter(&session, &info->realtimeOptions);
+
+    long long start = DelayGetTime();
+    info->deadline = start;
+
+    I2CStatus status = I2CStatusBusy;
+    I2CInfoSetSDA(info, GPIO_PIN_VALUE_HIGH);
+    if (I2CInfoReleaseSCL(info) && I2CInfoRecover(info)) {
+        info->cycles = 0;
+        I2CInfoWait(info);
+
+        if (I2CInfoStart(info))
+            status = I2CInfoRun(info, address, writeBuffer, writeCount, readBuffer, readCount);
+
+        I2CInfoStop(info);
+        info->elapsed = DelayGetTime() - start;
+    } else {
+        LOG_ERROR("The I2C bus is held low");
+    }
+
+    RealtimeSessionExit(&session);
+    return status;
+}
+
+double I2CInfoGetFrequency(I2CInfoRef info) {
+    if (info->elapsed <= 0)
+        return 0.0;
+
+    return (double)info->cycles * 1e9 / (double)info->elapsed;
+}
+
+long long I2CInfoGetStretchCount(I2CInfoRef info) {
+    return info->stretchCount;
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_I2C_configure(JNIEnv * env, jobject thiz, jobject gpio, jint sdaPin,
+                                    jint sclPin, jint frequencyHz) {
+    I2CInfoRef info = (I2CInfoRef)Java_com_cdoapps_gpio_I2C_getReserved(env, thiz);
+    if (info)
+        I2CInfoFree(info);
+
+    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, gpio);
+    info = gpioInfo ? I2CInfoCreate(gpioInfo, sdaPin, sclPin, frequencyHz) : NULL;
+
+    Java_com_cdoapps_gpio_I2C_setReserved(env, thiz, (jlong)info);
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_I2C_setRealtime(JNIEnv * env, jobject thiz, jint cpu, jint priority,
+                                      jboolean lockMemory, jboolean holdLatency) {
+    I2CInfoRef info = (I2CInfoRef)Java_com_cdoapps_gpio_I2C_getReserved(env, thiz);
+    if (!info)
+        return;
+
+    struct RealtimeOptions options = {
+        .cpu = cpu,
+        .priority = priority,
+        .lockMemory = lockMemory ? TRUE : FALSE,
+        .holdLatency = holdLatency ? TRUE : FALSE
+    };
+
+    BOOL enabled = (cpu != -1 || priority > 0 || lockMemory || holdLatency) ? TRUE : FALSE;
+    I2CInfoSetRealtime(info, enabled ? &options : NULL);
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_I2C_destroy(JNIEnv * env, jobject thiz) {
+    I2CInfoRef info = (I2CInfoRef)Java_com_cdoapps_gpio_I2C_getReserved(env, thiz);
+    if (info) {
+        I2CInfoFree(info);
+        Java_com_cdoapps_gpio_I2C_setReserved(env, thiz, 0l);
+    }
+}
+
+JNIEXPORT jint JNICALL
+Java_com_cdoapps_gpio_I2C_transfer(JNIEnv * env, jobject thiz, jint address,
+                                   jbyteArray writeArray, jbyteArray readArray) {
+    I2CInfoRef info = (I2CInfoRef)Java_com_cdoapps_gpio_I2C_getReserved(env, thiz);
+    if (!info)
+        return I2CStatusBusy;
+
+    int writeCount = writeArray ? (*env)->GetArrayLength(env, writeArray) : 0;
+    int readCount = readArray ? (*env)->GetArrayLength(env, readArray) : 0;
+
+    // the arrays are copied instead of being pinned, since the transfer may last long enough to
+    // stall the garbage collector
+    uint8_t *buffer = malloc((size_t)(writeCount + readCount) + 1);
+    if (!buffer)
+        return I2CStatusBusy;
+
+    if (writeCount > 0)
+        (*env)->GetByteArrayRegion(env, writeArray, 0, writeCount, (jbyte *)buffer);
+
+    I2CStatus status = I2CInfoTransfer(info, address, buffer, writeCount, buffer + writeCount,
+                                       readCount);
+
+    if (readCount > 0 && status == I2CStatusOk)
+        (*env)->SetByteArrayRegion(env, readArray, 0, readCount, (jbyte *)(buffer + writeCount));
+    free(buffer);
+
+    return status;
+}
+
+JNIEXPORT jdouble JNICALL
+Java_com_cdoapps_gpio_I2C_getFrequency(JNIEnv * env, jobject thiz) {
+    I2CInfoRef info = (I2CInfoRef)Java_com_cdoapps_gpio_I2C_getReserved(env, thiz);
+    if (!info)
+        return 0.0;
+
+    return I2CInfoGetFrequency(info);
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_cdoapps_gpio_I2C_getStretchCount(JNIEnv * env, jobject thiz) {
+    I2CInfoRef info = (I2CInfoRef)Java_com_cdoapps_gpio_I2C_getReserved(env, thiz);
+    if (!info)
+        return 0;
+
+    return I2CInfoGetStretchCount(info);
+}
@@ -0,0 +1,128 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GPIO_I2C_H
+#define GPIO_I2C_H
+
+#include "gpio.h"
+#include "realtime.h"
+
+#include <stdint.h>
+
+/**
+ * The {@code I2CInfo} struct represents an I2C bus mastered over two pins of a {@code GPIOInfo}
+ * instance, SDA and SCL.
+ *
+ * Both pins are driven as open-drain outputs: they are pulled down by switching them to outputs
+ * and released by switching them back to inputs, the high level coming from the pull-up
+ * resistors of the bus. The pins should be exported in register mode ('mmap') to reach the
+ * standard (100 kHz) and fast (400 kHz) modes.
+ *
+ * This implementation uses bit banging and spinning, thus it may produce high CPU load. Since the
+ * master drives the clock, a preemption only slows the transfer down. It supports a single master,
+ * thus the arbitration is not handled.
+ *
+ * Specification:
+ * <a href="https://www.nxp.com/docs/en/user-guide/UM10204.pdf">I2C-bus specification</a>
+ */
+typedef struct I2CInfo *I2CInfoRef;
+
+/**
+ * The {@code I2CStatus} enum represents the result of a transfer.
+ */
+typedef enum {
+    /**
+     * All the bytes were transferred.
+     */
+    I2CStatusOk,
+    /**
+     * SDA was held low before the transfer and could not be released by clocking SCL.
+     */
+    I2CStatusBusy,
+    /**
+     * No slave acknowledged the address.
+     */
+    I2CStatusAddressNack,
+    /**
+     * The slave did not acknowledge one of the written bytes.
+     */
+    I2CStatusDataNack,
+    /**
+     * A slave stretched the clock longer than the timeout.
+     */
+    I2CStatusTimeout
+} I2CStatus;
+
+/**
+ * Returns a {@code I2CInfo} object representing an I2C bus mastered over two pins.
+ *
+ * @param gpioInfo a {@code GPIOInfo} instance used to initialize and communicate with the I2C bus.
+ * @param sdaPin the WiringPi address of the pin which will be exported for the data line.
+ * @param sclPin the WiringPi address of the pin which will be exported for the clock line.
+ * @param frequency the target frequency of the clock in Hz.
+ * @return a {@code I2CInfo} object representing an I2C bus mastered over two pins.
+ */
+I2CInfoRef I2CInfoCreate(GPIOInfoRef gpioInfo, int sdaPin, int sclPin, int frequency);
+/**
+ * Destroys the resources associated to an I2C bus.
+ *
+ * @param info a {@code I2CInfo} object representing the I2C bus to destroy.
+ */
+void I2CInfoFree(I2CInfoRef info);
+
+/**
+ * Sets the real-time session entered by the calling thread during each transfer.
+ *
+ * The memory lock and the latency request of {@code options} are held until the options change
+ * or the bus is destroyed, rather than around each transfer.
+ *
+ * @param info a {@code I2CInfo} object representing the I2C bus.
+ * @param options the changes applied to the thread during each transfer, or {@code NULL} to run
+ *                the transfers unchanged.
+ */
+void I2CInfoSetRealtime(I2CInfoRef info, const struct RealtimeOptions *options);
+
+/**
+ * Writes bytes to one slave, then reads bytes from it after a repeated start, in a single
+ * transaction ended by a stop condition.
+ *
+ * @param info a {@code I2CInfo} object representing the I2C bus.
+ * @param address the 7-bit address of the slave.
+ * @param writeBuffer the bytes to write.
+ * @param writeCount the number of bytes to write, or {@code 0} to only read.
+ * @param readBuffer receives the bytes read.
+ * @param readCount the number of bytes to read, or {@code 0} to only write.
+ * @return {@code I2CStatusOk} on success.
+ */
+I2CStatus I2CInfoTransfer(I2CInfoRef info, int address, const uint8_t *writeBuffer, int writeCount,
+                          uint8_t *readBuffer, int readCount);
+
+/**
+ * Returns the frequency achieved by the clock during the last transfer, from the start condition
+ * to the stop condition.
+ *
+ * @param info a {@code I2CInfo} object representing the I2C bus.
+ * @return the average frequency of the clock in Hz, or {@code 0} if nothing was transferred.
+ */
+double I2CInfoGetFrequency(I2CInfoRef info);
+/**
+ * Returns the number of clock pulses which were stretched by the slaves since the creation of the
+ * bus.
+ *
+ * @param info a {@code I2CInfo} object representing the I2C bus.
+ * @return the number of clock pulses which were stretched.
+ */
+long long I2CInfoGetStretchCount(I2CInfoRef info);
+
+#endif //GPIO_I2C_H
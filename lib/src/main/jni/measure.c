@@ -0,0 +1,265 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common.h"
+#include "bindings.h"
+#include "measure.h"
+#include "delay.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+
+// the number of periods which are kept, bounding the sliding windows
+#define MEASURE_PERIOD_COUNT 4096
+// the longest wait for edges, bounding the delay before the thread notices it is stopped
+#define MEASURE_EDGES_TIMEOUT 100000000ll
+
+struct MeasurePeriod {
+    long long end;
+    long long period;
+    long long width;
+};
+
+struct MeasureInfo {
+    GPIOInfoRef gpioInfo;
+    int pin;
+    MeasureSource source;
+    long long period;
+
+    volatile uint32_t *input;
+    uint32_t mask;
+
+    // private to the thread
+    long long lastRise;
+    long long lastFall;
+
+    pthread_mutex_t lock;
+    struct MeasurePeriod periods[MEASURE_PERIOD_COUNT];
+    int first;
+    int count;
+
+    BOOL running;
+    pthread_t thread;
+};
+
+static void MeasureInfoAddEdge(MeasureInfoRef info, long long timestamp, int value) {
+    if (GPIO_PIN_VALUE_LOW == value) {
+        info->lastFall = timestamp;
+        return;
+    }
+
+    // a period is complete when a falling edge was seen since the previous rising one
+    if (info->lastRise >= 0 && info->lastFall > info->lastRise) {
+        pthread_mutex_lock(&info->lock);
+
+        if (MEASURE_PERIOD_COUNT == info->count) {
+            info->first = (info->first + 1) % MEASURE_PERIOD_COUNT;
+            info->count--;
+        }
+
+        int last = (info->first + info->count) % MEASURE_PERIOD_COUNT;
+        info->periods[last] = (struct MeasurePeriod){
+                .end = timestamp,
+                .period = timestamp - info->lastRise,
+                .width = info->lastFall - info->lastRise
+        };
+        info->count++;
+
+        pthread_mutex_unlock(&info->lock);
+    }
+
+    info->lastRise = timestamp;
+}
+
+static void MeasureInfoPoll(MeasureInfoRef info) {
+    int value = (*info->input & info->mask) ? GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW;
+    long long deadline = DelayGetTime();
+
+    while (__atomic_load_n(&info->running, __ATOMIC_ACQUIRE)) {
+        DelayUntilNextSample(&deadline, info->period);
+
+        int sample = (*info->input & info->mask) ? GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW;
+        if (sample == value)
+            continue;
+
+        value = sample;
+        MeasureInfoAddEdge(info, DelayGetTime(), value);
+    }
+}
+
+static void MeasureInfoWaitForEdges(MeasureInfoRef info) {
+    struct GPIOEdgeEvent events[16];
+
+    while (__atomic_load_n(&info->running, __ATOMIC_ACQUIRE)) {
+        int count = GPIOInfoWaitForEdges(info->gpioInfo, info->pin, events, 16,
+                                         MEASURE_EDGES_TIMEOUT);
+        if (count < 0)
+            break;
+
+        for (int index = 0 ; index < count ; index++)
+            MeasureInfoAddEdge(info, events[index].timestamp, events[index].value);
+    }
+}
+
+static void *MeasureInfoRun(void *argument) {
+    MeasureInfoRef info = argument;
+
+    if (MeasureSourcePolling == info->source)
+        MeasureInfoPoll(info);
+    else
+        MeasureInfoWaitForEdges(info);
+
+    return NULL;
+}
+
+MeasureInfoRef MeasureInfoCreate(GPIOInfoRef gpioInfo, int pin, MeasureSource source, int rate) {
+    if (pin < 0 || pin >= 64)
+        return NULL;
+
+    MeasureInfoRef info = calloc(1, sizeof(struct MeasureInfo));
+    info->gpioInfo = gpioInfo;
+    info->pin = pin;
+    info->source = source;
+    info->lastRise = -1;
+    info->lastFall = -1;
+
+    if (MeasureSourcePolling == source) {
+        info->input = GPIOInfoGetPinInput(gpioInfo, pin, &info->mask);
+        if (!info->input || rate <= 0) {
+            LOG_ERROR("Unable to poll pin %d", pin);
+            free(info);
+            return NULL;
+        }
+
+        info->period = 1000000000ll / rate;
+    } else if (GPIOInfoGetPinEdge(gpioInfo, pin) != GPIOEdgeNone) {
+        // the events would be shared with the edge listener or the other waiting thread
+        LOG_ERROR("The edges of pin %d are already reported", pin);
+        free(info);
+        return NULL;
+    } else if (!GPIOInfoSetPinEdge(gpioInfo, pin, GPIOEdgeBoth)) {
+        LOG_ERROR("Unable to get the edges of pin %d", pin);
+        free(info);
+        return NULL;
+    }
+
+    pthread_mutex_init(&info->lock, NULL);
+    GPIOInfoRetain(gpioInfo);
+
+    info->running = TRUE;
+    if (pthread_create(&info->thread, NULL, MeasureInfoRun, info) != 0) {
+        LOG_ERROR("Unable to start the measure thread");
+        if (MeasureSourceEdges == source)
+            GPIOInfoSetPinEdge(gpioInfo, pin, GPIOEdgeNone);
+        pthread_mutex_destroy(&info->lock);
+        GPIOInfoFree(gpioInfo);
+        free(info);
+        return NULL;
+    }
+
+    return info;
+}
+
+void MeasureInfoFree(MeasureInfoRef info) {
+    __atomic_store_n(&info->running, FALSE, __ATOMIC_RELEASE);
+    pthread_join(info->thread, NULL);
+
+    if (MeasureSourceEdges == info->source)
+        GPIOInfoSetPinEdge(info->gpioInfo, info->pin, GPIOEdgeNone);
+
+    pthread_mutex_destroy(&info->lock);
+    GPIOInfoFree(info->gpioInfo);
+    free(info);
+}
+
+void MeasureInfoGetStatistics(MeasureInfoRef info, long long window,
+                              struct MeasureStatistics *statistics) {
+    long long start = DelayGetTime() - window;
+    *statistics = (struct MeasureStatistics){ .count = 0 };
+
+    pthread_mutex_lock(&info->lock);
+
+    // the periods are walked from the newest one
+    for (int index = info->count - 1 ; index >= 0 ; index--) {
+        const struct MeasurePeriod *period =
+                &info->periods[(info->first + index) % MEASURE_PERIOD_COUNT];
+        if (period->end < start)
+            break;
+
+        if (!statistics->count || period->period < statistics->periodMinimum)
+            statistics->periodMinimum = period->period;
+        if (!statistics->count || period->period > statistics->periodMaximum)
+            statistics->periodMaximum = period->period;
+        if (!statistics->count || period->width < statistics->widthMinimum)
+            statistics->widthMinimum = period->width;
+        if (!statistics->count || period->width > statistics->widthMaximum)
+            statistics->widthMaximum = period->width;
+
+        statistics->periodSum += period->period;
+        statistics->widthSum += period->width;
+        statistics->count++;
+    }
+
+    pthread_mutex_unlock(&info->lock);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_Measurement_start(JNIEnv *env, jobject thiz, jobject gpio, jint pin,
+                                        jint source, jint rate) {
+    MeasureInfoRef info = (MeasureInfoRef)Java_com_cdoapps_gpio_Measurement_getReserved(env, thiz);
+    if (info)
+        MeasureInfoFree(info);
+
+    Java_com_cdoapps_gpio_Measurement_setReserved(env, thiz, 0l);
+
+    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, gpio);
+    if (!gpioInfo)
+        return JNI_FALSE;
+
+    info = MeasureInfoCreate(gpioInfo, pin, (MeasureSource)source, rate);
+    if (!info)
+        return JNI_FALSE;
+
+    Java_com_cdoapps_gpio_Measurement_setReserved(env, thiz, (jlong)info);
+    return JNI_TRUE;
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Measurement_stop(JNIEnv *env, jobject thiz) {
+    MeasureInfoRef info = (MeasureInfoRef)Java_com_cdoapps_gpio_Measurement_getReserved(env, thiz);
+    if (info) {
+        MeasureInfoFree(info);
+        Java_com_cdoapps_gpio_Measurement_setReserved(env, thiz, 0l);
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Measurement_nativeGetStatistics(JNIEnv *env, jobject thiz, jlong window,
+                                                      jlongArray values) {
+    MeasureInfoRef info = (MeasureInfoRef)Java_com_cdoapps_gpio_Measurement_getReserved(env, thiz);
+    struct MeasureStatistics statistics = { .count = 0 };
+    if (info)
+        MeasureInfoGetStatistics(info, window, &statistics);
+
+    jlong result[] = {
+            statistics.count,
+            statistics.periodMinimum,
+            statistics.periodMaximum,
+            statistics.periodSum,
+            statistics.widthMinimum,
+            statistics.widthMaximum,
+            statistics.widthSum
+    };
+    (*env)->SetLongArrayRegion(env, values, 0, 7, result);
+}
@@ -0,0 +1,90 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GPIO_MEASURE_H
+#define GPIO_MEASURE_H
+
+#include "gpio.h"
+
+/**
+ * The {@code MeasureSource} enum represents how the edges of a measured pin are timestamped.
+ */
+typedef enum {
+    /**
+     * The input register of the pin is polled at a fixed rate, which requires register access.
+     * The resolution of the timestamps is the polling period, and the thread spins between the
+     * samples below {@code DELAY_SPIN_PERIOD}.
+     */
+    MeasureSourcePolling,
+
+    /**
+     * The edges are reported by the kernel, which requires the character device or 'sysfs'
+     * access, and a pin whose edges are not reported yet. The thread sleeps between the edges.
+     */
+    MeasureSourceEdges
+} MeasureSource;
+
+/**
+ * The {@code MeasureStatistics} struct aggregates the periods of a signal which ended within a
+ * window of time. A period starts with a rising edge, and its width is the duration of its high
+ * state. The durations are in nanoseconds, and the other fields are {@code 0} when {@code count}
+ * is {@code 0}.
+ */
+struct MeasureStatistics {
+    int count;
+
+    long long periodMinimum;
+    long long periodMaximum;
+    long long periodSum;
+
+    long long widthMinimum;
+    long long widthMaximum;
+    long long widthSum;
+};
+
+/**
+ * The {@code MeasureInfo} struct represents a thread timestamping the edges of one input pin to
+ * measure the period, pulse width, frequency and duty cycle of its signal.
+ */
+typedef struct MeasureInfo *MeasureInfoRef;
+
+/**
+ * Returns a {@code MeasureInfo} object measuring one pin, and starts its thread.
+ *
+ * @param gpioInfo a {@code GPIOInfo} object representing the GPIO controller.
+ * @param pin the WiringPi address of the pin, which must be exported as an input.
+ * @param source how the edges of the pin are timestamped.
+ * @param rate the polling rate in Hz for {@code MeasureSourcePolling}.
+ * @return a {@code MeasureInfo} object, or {@code NULL} if {@code source} is not available for
+ *         {@code pin}.
+ */
+MeasureInfoRef MeasureInfoCreate(GPIOInfoRef gpioInfo, int pin, MeasureSource source, int rate);
+/**
+ * Stops the thread of a measurement and destroys the resources associated to it.
+ *
+ * @param info a {@code MeasureInfo} object representing the measurement to destroy.
+ */
+void MeasureInfoFree(MeasureInfoRef info);
+
+/**
+ * Aggregates the last periods of the measured signal.
+ *
+ * @param info a {@code MeasureInfo} object representing the measurement.
+ * @param window the duration in nanoseconds before now in which the periods must have ended.
+ * @param statistics receives the statistics of the periods.
+ */
+void MeasureInfoGetStatistics(MeasureInfoRef info, long long window,
+                              struct MeasureStatistics *statistics);
+
+#endif //GPIO_MEASURE_H
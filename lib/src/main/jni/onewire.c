@@ -19,14 +19,34 @@
 // https://www.analog.com/en/technical-articles/1wire-communication-through-software.html
 
 #include "common.h"
+#include "bindings.h"
+#include "delay.h"
 #include "onewire.h"
 
 #include <stdlib.h>
+#include <unistd.h>
+
+// the longest low state of a zero in microseconds, beyond which the slaves may see a reset
+#define ONEWIRE_ZERO_LOW_LIMIT 120
 
 struct OneWireInfo {
     GPIOInfoRef gpioInfo;
     int inputPin;
     int outputPin;
+    GPIOPinHandleRef handle; // the pin driving the bus, if it can be accessed directly
+
+    // the clock of the current transaction, started by each reset, and the offset in nanoseconds
+    // at which the recovery of the last slot is over
+    struct DelayTimeline timeline;
+    long long next;
+    BOOL late; // a slot of the transaction was held low past the sample of the slaves
+
+    BOOL realtime;
+    struct RealtimeOptions realtimeOptions;
+    struct RealtimeSession session;
+    struct RealtimeSession shared; // the memory lock and the latency request of the options
+    int transactionDepth;
+    pid_t owner; // the thread which entered the session, which is the only one able to leave it
 
     struct OneWireDelays {
         int a; // Write 1 bit/Read bit: drive bus low delay
@@ -42,99 +62,208 @@ struct OneWireInfo {
     } delays;
 };
 
-OneWireInfoRef OneWireInfoCreate(GPIOInfoRef gpioInfo, int pin) {
+// fills the fields shared by both buses, without configuring any pin
+static OneWireInfoRef OneWireInfoAlloc(GPIOInfoRef gpioInfo, int inputPin, int outputPin) {
     OneWireInfoRef info = malloc(sizeof(struct OneWireInfo));
 
-    info->gpioInfo = gpioInfo;
-    info->inputPin = pin;
-    info->outputPin = -1;
+    info->gpioInfo = GPIOInfoRetain(gpioInfo);
+    info->inputPin = inputPin;
+    info->outputPin = outputPin;
+    info->handle = NULL;
+    // the edges of the slots are scheduled on the timeline, thus the latency of the pins does not
+    // lengthen the slots and the recoveries of 'b' and 'f' keep a 5 us margin over the minimum
+    // 60 us slot and 1 us recovery of the specification
     info->delays = (struct OneWireDelays){
         .a = 6,
-        .b = 64,
+        .b = 59,
         .c = 60,
         .d = 10,
         .e = 9,
-        .f = 55,
+        .f = 50,
         .g = 0,
         .h = 480,
         .i = 70,
         .j = 410
     };
+    DelayTimelineStart(&info->timeline);
+    info->next = 0;
+    info->late = FALSE;
+    info->realtime = FALSE;
+    info->session.active = FALSE;
+    info->shared.active = FALSE;
+    info->transactionDepth = 0;
+    info->owner = 0;
+
+    return info;
+}
+
+OneWireInfoRef OneWireInfoCreate(GPIOInfoRef gpioInfo, int pin) {
+    OneWireInfoRef info = OneWireInfoAlloc(gpioInfo, pin, -1);
 
     GPIOInfoExport(gpioInfo, pin);
 
+    // the single pin is driven as an open-drain output, which pulls the bus down and releases it
+    // with a single change of its direction
+    GPIOInfoSetPinMode(gpioInfo, pin, GPIOPinModeOpenDrain);
+    info->handle = GPIOInfoGetPinHandle(gpioInfo, pin);
+
     return info;
 }
 
 OneWireInfoRef OneWireInfoCreateBuffered(GPIOInfoRef gpioInfo, int inputPin, int outputPin) {
-    OneWireInfoRef info = OneWireInfoCreate(gpioInfo, inputPin);
+    OneWireInfoRef info = OneWireInfoAlloc(gpioInfo, inputPin, outputPin);
 
-    info->outputPin = outputPin;
+    GPIOInfoExport(gpioInfo, inputPin);
     GPIOInfoExport(gpioInfo, outputPin);
 
-    GPIOInfoSetMode(info->gpioInfo, inputPin, GPIO_PIN_MODE_INPUT);
-    GPIOInfoSetMode(info->gpioInfo, outputPin, GPIO_PIN_MODE_OUTPUT);
+    // only the output is driven, thus the input never takes a handle
+    GPIOInfoSetPinMode(gpioInfo, inputPin, GPIOPinModeInput);
+    GPIOInfoSetPinMode(gpioInfo, outputPin, GPIOPinModeOutput);
+    info->handle = GPIOInfoGetPinHandle(gpioInfo, outputPin);
 
     return info;
 }
 
+// the session restores the thread which called RealtimeSessionEnter, thus another thread leaves
+// it active rather than applying its saved state to itself
+static void OneWireInfoExitSession(OneWireInfoRef info) {
+    if (!info->session.active)
+        return;
+
+    if (info->owner != gettid()) {
+        LOG_WARN("The real-time session of thread %d can only be left by that thread",
+                 (int)info->owner);
+        return;
+    }
+
+    RealtimeSessionExit(&info->session);
+}
+
 void OneWireInfoFree(OneWireInfoRef info) {
+    if (info->transactionDepth > 0)
+        OneWireInfoExitSession(info);
     GPIOInfoUnexport(info->gpioInfo, info->inputPin);
     if (info->outputPin != -1)
         GPIOInfoUnexport(info->gpioInfo, info->outputPin);
+    RealtimeSessionExit(&info->shared);
+    GPIOInfoFree(info->gpioInfo);
     free(info);
 }
 
-#include "delay.h"
-void OneWireInfoPullUp(OneWireInfoRef info) {
-    if (info->outputPin == -1) {
-        GPIOInfoSetMode(info->gpioInfo, info->inputPin, GPIO_PIN_MODE_INPUT);
-    } else {
-        GPIOInfoSetValue(info->gpioInfo, info->outputPin, GPIO_PIN_VALUE_LOW);
+void OneWireInfoSetRealtime(OneWireInfoRef info, const struct RealtimeOptions *options) {
+    // the memory is locked once for all the transactions rather than around each of them
+    RealtimeSessionExit(&info->shared);
+    info->realtime = options ? TRUE : FALSE;
+    if (options) {
+        info->realtimeOptions = *options;
+        RealtimeSessionHold(&info->shared, options);
     }
 }
 
+void OneWireInfoBeginTransaction(OneWireInfoRef info) {
+    if (info->transactionDepth++ == 0 && info->realtime) {
+        info->owner = gettid();
+        RealtimeSessionEnter(&info->session, &info->realtimeOptions);
+    }
+}
+
+void OneWireInfoEndTransaction(OneWireInfoRef info) {
+    if (info->transactionDepth > 0 && --info->transactionDepth == 0)
+        OneWireInfoExitSession(info);
+}
+
+static inline void OneWireInfoDrive(OneWireInfoRef info, int value) {
+    if (info->handle)
+        GPIOPinHandleSetValue(info->handle, value);
+    else if (info->outputPin == -1)
+        GPIOInfoSetValue(info->gpioInfo, info->inputPin, value);
+    else
+        GPIOInfoSetValue(info->gpioInfo, info->outputPin, value);
+}
+
+// The buffered output is inverted: driving it high pulls the bus down.
+
+void OneWireInfoPullUp(OneWireInfoRef info) {
+    OneWireInfoDrive(info, (info->outputPin == -1) ? GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW);
+}
+
 void OneWireInfoPullDown(OneWireInfoRef info) {
-    if (info->outputPin == -1) {
-        GPIOInfoSetMode(info->gpioInfo, info->inputPin, GPIO_PIN_MODE_OUTPUT);
-        GPIOInfoSetValue(info->gpioInfo, info->inputPin, GPIO_PIN_VALUE_LOW);
-    } else {
-        GPIOInfoSetValue(info->gpioInfo, info->outputPin, GPIO_PIN_VALUE_HIGH);
+    OneWireInfoDrive(info, (info->outputPin == -1) ? GPIO_PIN_VALUE_LOW : GPIO_PIN_VALUE_HIGH);
+}
+
+static inline void OneWireInfoWaitUntil(OneWireInfoRef info, long long offset) {
+    DelayTimelineWaitUntil(&info->timeline, offset);
+}
+
+// Waits for the recovery of the previous slot, then pulls the bus down to start a new slot. The
+// edges of the slot are scheduled from the returned offset: the end of the recovery, or now if it
+// is already over. A write may last several microseconds without direct access to the pin, and
+// the thread may be preempted before any write, thus the slot starts once it is done.
+static long long OneWireInfoBeginSlot(OneWireInfoRef info) {
+    long long start = DelayTimelineGetOffset(&info->timeline);
+    if (start < info->next) {
+        OneWireInfoWaitUntil(info, info->next);
+        start = info->next;
     }
+
+    OneWireInfoPullDown(info);
+
+    long long offset = DelayTimelineGetOffset(&info->timeline);
+    if (offset > start)
+        start = offset;
+
+    return start;
 }
 
 BOOL OneWireInfoReset(OneWireInfoRef info) {
-    OneWireInfoPullUp(info);
-    DelayMicro(info->delays.g);
+    OneWireInfoWaitUntil(info, info->next);
 
-    OneWireInfoPullDown(info);
+    // each reset starts the clock of a new transaction
+    DelayTimelineStart(&info->timeline);
+    info->next = 0;
+    info->late = FALSE;
+
+    OneWireInfoPullUp(info);
+    info->next += 1000ll * info->delays.g;
 
-    struct timespec time = { .tv_sec = 0, .tv_nsec = info->delays.h * 1000 };
-    nanosleep(&time, NULL);
+    // the long waits of the reset sleep for most of their duration, then spin for the rest
+    long long start = OneWireInfoBeginSlot(info);
+    OneWireInfoWaitUntil(info, start + 1000ll * info->delays.h);
 
     OneWireInfoPullUp(info);
-    DelayMicro(info->delays.i);
+    OneWireInfoWaitUntil(info, start + 1000ll * (info->delays.h + info->delays.i));
 
-    if (GPIOInfoGetValue(info->gpioInfo, info->inputPin) == GPIO_PIN_VALUE_LOW) {
-        DelayMicro(info->delays.j);
-        return TRUE;
-    }
+    BOOL presence = (GPIOInfoGetValue(info->gpioInfo, info->inputPin) == GPIO_PIN_VALUE_LOW);
+    info->next = start + 1000ll * (info->delays.h + info->delays.i + info->delays.j);
 
-    return FALSE;
+    return presence;
 }
 
+BOOL OneWireInfoIsLate(OneWireInfoRef info) {
+    return info->late;
+}
+
+// A slave samples a one or drives a zero from the fall of the slot to 'a' + 'e', thus a one or a
+// read released later, e.g. because the thread was preempted, is taken for a zero. A zero longer
+// than the 120 us of the specification may be taken for a reset.
+static inline void OneWireInfoCheckRelease(OneWireInfoRef info, long long start, int low) {
+    if (DelayTimelineGetOffset(&info->timeline) > start + 1000ll * low)
+        info->late = TRUE;
+}
 
 void OneWireInfoWriteBit(OneWireInfoRef info, BOOL bit) {
-    OneWireInfoPullDown(info);
+    long long start = OneWireInfoBeginSlot(info);
 
     if (bit) {
-        DelayMicro(info->delays.a);
+        OneWireInfoWaitUntil(info, start + 1000ll * info->delays.a);
         OneWireInfoPullUp(info);
-        DelayMicro(info->delays.b);
+        OneWireInfoCheckRelease(info, start, info->delays.a + info->delays.e);
+        info->next = start + 1000ll * (info->delays.a + info->delays.b);
     } else {
-        DelayMicro(info->delays.c);
+        OneWireInfoWaitUntil(info, start + 1000ll * info->delays.c);
         OneWireInfoPullUp(info);
-        DelayMicro(info->delays.d);
+        OneWireInfoCheckRelease(info, start, ONEWIRE_ZERO_LOW_LIMIT);
+        info->next = start + 1000ll * (info->delays.c + info->delays.d);
     }
 }
 
@@ -145,14 +274,15 @@ void OneWireInfoWriteByte(OneWireInfoRef info, unsigned char value) {
 
 
 BOOL OneWireInfoReadBit(OneWireInfoRef info) {
-    OneWireInfoPullDown(info);
+    long long start = OneWireInfoBeginSlot(info);
 
-    DelayMicro(info->delays.a);
+    OneWireInfoWaitUntil(info, start + 1000ll * info->delays.a);
     OneWireInfoPullUp(info);
-    DelayMicro(info->delays.e);
+    OneWireInfoCheckRelease(info, start, info->delays.a + info->delays.e);
+    OneWireInfoWaitUntil(info, start + 1000ll * (info->delays.a + info->delays.e));
 
     BOOL bit = (GPIOInfoGetValue(info->gpioInfo, info->inputPin) != GPIO_PIN_VALUE_LOW);
-    DelayMicro(info->delays.f);
+    info->next = start + 1000ll * (info->delays.a + info->delays.e + info->delays.f);
 
     return bit;
 }
@@ -171,74 +301,122 @@ unsigned char OneWireInfoReadByte(OneWireInfoRef info) {
 JNIEXPORT void JNICALL
 Java_com_cdoapps_gpio_OneWire_configure(JNIEnv * env, jobject thiz, jobject gpio,
                                         jint pin) {
-    OneWireInfoRef info = (OneWireInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+    OneWireInfoRef info = (OneWireInfoRef)Java_com_cdoapps_gpio_OneWire_getReserved(env, thiz);
     if (info)
         OneWireInfoFree(info);
 
-    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_java_lang_Object_getReserved(env, gpio);
-    Java_java_lang_Object_setReserved(env, thiz, (jlong)OneWireInfoCreate(gpioInfo, pin));
+    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, gpio);
+    Java_com_cdoapps_gpio_OneWire_setReserved(env, thiz, (jlong)OneWireInfoCreate(gpioInfo, pin));
 }
 
 JNIEXPORT void JNICALL
 Java_com_cdoapps_gpio_OneWire_configureBuffered(JNIEnv * env, jobject thiz,
                                                 jobject gpio, jint inputPin, jint outputPin) {
-    OneWireInfoRef info = (OneWireInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+    OneWireInfoRef info = (OneWireInfoRef)Java_com_cdoapps_gpio_OneWire_getReserved(env, thiz);
     if (info)
         OneWireInfoFree(info);
 
-    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_java_lang_Object_getReserved(env, gpio);
-    Java_java_lang_Object_setReserved(env, thiz, (jlong)OneWireInfoCreateBuffered(gpioInfo,
+    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, gpio);
+    Java_com_cdoapps_gpio_OneWire_setReserved(env, thiz, (jlong)OneWireInfoCreateBuffered(gpioInfo,
                                                                                   inputPin,
                                                                                   outputPin));
 }
 
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_OneWire_setRealtime(JNIEnv * env, jobject thiz, jint cpu, jint priority,
+                                          jboolean lockMemory, jboolean holdLatency) {
+    OneWireInfoRef info = (OneWireInfoRef)Java_com_cdoapps_gpio_OneWire_getReserved(env, thiz);
+    if (!info)
+        return;
+
+    struct RealtimeOptions options = {
+        .cpu = cpu,
+        .priority = priority,
+        .lockMemory = lockMemory ? TRUE : FALSE,
+        .holdLatency = holdLatency ? TRUE : FALSE
+    };
+
+    BOOL enabled = (cpu != -1 || priority > 0 || lockMemory || holdLatency) ? TRUE : FALSE;
+    OneWireInfoSetRealtime(info, enabled ? &options : NULL);
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_OneWire_beginTransaction(JNIEnv * env, jobject thiz) {
+    OneWireInfoRef info = (OneWireInfoRef)Java_com_cdoapps_gpio_OneWire_getReserved(env, thiz);
+    if (info)
+        OneWireInfoBeginTransaction(info);
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_OneWire_endTransaction(JNIEnv * env, jobject thiz) {
+    OneWireInfoRef info = (OneWireInfoRef)Java_com_cdoapps_gpio_OneWire_getReserved(env, thiz);
+    if (info)
+        OneWireInfoEndTransaction(info);
+}
 
 JNIEXPORT void JNICALL
 Java_com_cdoapps_gpio_OneWire_destroy(JNIEnv * env, jobject thiz) {
-    OneWireInfoRef info = (OneWireInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+    OneWireInfoRef info = (OneWireInfoRef)Java_com_cdoapps_gpio_OneWire_getReserved(env, thiz);
     if (info) {
         OneWireInfoFree(info);
-        Java_java_lang_Object_setReserved(env, thiz, 0l);
+        Java_com_cdoapps_gpio_OneWire_setReserved(env, thiz, 0l);
     }
 }
 
-JNIEXPORT jboolean JNICALL
-Java_com_cdoapps_gpio_OneWire_reset(JNIEnv * env, jobject thiz) {
-    OneWireInfoRef info = (OneWireInfoRef)Java_java_lang_Object_getReserved(env, thiz);
-    if (info && OneWireInfoReset(info))
+// The following methods are registered by JNI_OnLoad. The slots wait for the bus and may sleep
+// until their deadline, thus they are all regular natives.
+
+static jboolean
+Java_com_cdoapps_gpio_OneWire_nativeReset(JNIEnv * env, jclass clazz, jlong info) {
+    if (info && OneWireInfoReset((OneWireInfoRef)info))
         return JNI_TRUE;
 
     return JNI_FALSE;
 }
 
-JNIEXPORT void JNICALL
-Java_com_cdoapps_gpio_OneWire_writeBit(JNIEnv * env, jobject thiz, jboolean bit) {
-    OneWireInfoRef info = (OneWireInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+static void
+Java_com_cdoapps_gpio_OneWire_nativeWriteBit(JNIEnv * env, jclass clazz, jlong info,
+                                             jboolean bit) {
     if (info)
-        OneWireInfoWriteBit(info, bit ? TRUE : FALSE);
+        OneWireInfoWriteBit((OneWireInfoRef)info, bit ? TRUE : FALSE);
 }
 
-JNIEXPORT void JNICALL
-Java_com_cdoapps_gpio_OneWire_writeByte(JNIEnv * env, jobject thiz, jbyte value) {
-    OneWireInfoRef info = (OneWireInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+static void
+Java_com_cdoapps_gpio_OneWire_nativeWriteByte(JNIEnv * env, jclass clazz, jlong info,
+                                              jbyte value) {
     if (info)
-        OneWireInfoWriteByte(info, (unsigned char)value);
+        OneWireInfoWriteByte((OneWireInfoRef)info, (unsigned char)value);
 }
 
-JNIEXPORT jboolean JNICALL
-Java_com_cdoapps_gpio_OneWire_readBit(JNIEnv * env, jobject thiz) {
-    OneWireInfoRef info = (OneWireInfoRef)Java_java_lang_Object_getReserved(env, thiz);
-    if (info && OneWireInfoReadBit(info))
+static jboolean
+Java_com_cdoapps_gpio_OneWire_nativeReadBit(JNIEnv * env, jclass clazz, jlong info) {
+    if (info && OneWireInfoReadBit((OneWireInfoRef)info))
         return JNI_TRUE;
 
     return JNI_FALSE;
 }
 
-JNIEXPORT jbyte JNICALL
-Java_com_cdoapps_gpio_OneWire_readByte(JNIEnv * env, jobject thiz) {
-    OneWireInfoRef info = (OneWireInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+static jbyte
+Java_com_cdoapps_gpio_OneWire_nativeReadByte(JNIEnv * env, jclass clazz, jlong info) {
     if (info)
-        return OneWireInfoReadByte(info);
+        return OneWireInfoReadByte((OneWireInfoRef)info);
 
     return 0x0;
-}
\ No newline at end of file
+}
+
+BOOL Java_com_cdoapps_gpio_OneWire_registerNatives(JNIEnv *env) {
+    const JNINativeMethod methods[] = {
+            {"nativeReset", "(J)Z", (void *)Java_com_cdoapps_gpio_OneWire_nativeReset},
+            {"nativeWriteBit", "(JZ)V", (void *)Java_com_cdoapps_gpio_OneWire_nativeWriteBit},
+            {"nativeWriteByte", "(JB)V", (void *)Java_com_cdoapps_gpio_OneWire_nativeWriteByte},
+            {"nativeReadBit", "(J)Z", (void *)Java_com_cdoapps_gpio_OneWire_nativeReadBit},
+            {"nativeReadByte", "(J)B", (void *)Java_com_cdoapps_gpio_OneWire_nativeReadByte}
+    };
+
+    jclass clazz = (*env)->FindClass(env, "com/cdoapps/gpio/OneWire");
+    if (!clazz || (*env)->RegisterNatives(env, clazz, methods, 5) != JNI_OK)
+        return FALSE;
+    (*env)->DeleteLocalRef(env, clazz);
+
+    return TRUE;
+}
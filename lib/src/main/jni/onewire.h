@@ -16,6 +16,7 @@
 #define GPIO_ONEWIRE_H
 
 #include "gpio.h"
+#include "realtime.h"
 
 /**
  * The {@code OneWireInfo} struct represents a 1-Wire bus communicating over one pin of a
@@ -54,12 +55,40 @@ OneWireInfoRef OneWireInfoCreate(GPIOInfoRef gpioInfo, int pin);
  */
 OneWireInfoRef OneWireInfoCreateBuffered(GPIOInfoRef gpioInfo, int inputPin, int outputPin);
 /**
- * Destroys the resources associated to a 1-Wire bus.
+ * Destroys the resources associated to a 1-Wire bus. If a transaction is still open, its real-time
+ * session is only left when called from the thread which started it.
  *
  * @param info a {@code OneWireInfo} object representing the 1-Wire bus to destroy.
  */
 void OneWireInfoFree(OneWireInfoRef info);
 
+/**
+ * Sets the real-time session entered by {@code OneWireInfoBeginTransaction}.
+ *
+ * The memory lock and the latency request of {@code options} are held until the options change
+ * or the bus is destroyed, rather than around each transaction.
+ *
+ * @param info a {@code OneWireInfo} object representing the 1-Wire bus.
+ * @param options the changes applied to the thread during each transaction, or {@code NULL} to run
+ *                the transactions unchanged.
+ */
+void OneWireInfoSetRealtime(OneWireInfoRef info, const struct RealtimeOptions *options);
+/**
+ * Marks the start of a time critical transaction, e.g. from a reset to the last slot of a ROM
+ * search, entering the real-time session of the bus if any. Transactions may be nested, and should
+ * not last longer than a few tens of milliseconds since the thread may not be preempted.
+ *
+ * @param info a {@code OneWireInfo} object representing the 1-Wire bus.
+ */
+void OneWireInfoBeginTransaction(OneWireInfoRef info);
+/**
+ * Marks the end of a transaction started by {@code OneWireInfoBeginTransaction}, restoring the
+ * thread once the outermost transaction is over.
+ *
+ * @param info a {@code OneWireInfo} object representing the 1-Wire bus.
+ */
+void OneWireInfoEndTransaction(OneWireInfoRef info);
+
 /**
  * Resets the 1-Wire bus slave devices and gets them ready for a command.
  *
@@ -67,6 +96,14 @@ void OneWireInfoFree(OneWireInfoRef info);
  * @return {@code TRUE} on success.
  */
 BOOL OneWireInfoReset(OneWireInfoRef info);
+/**
+ * Returns whether a slot was released too late since the last reset, e.g. because the thread was
+ * preempted, in which case the slaves may have exchanged zeros instead of ones or seen a reset.
+ *
+ * @param info a {@code OneWireInfo} object representing the 1-Wire bus.
+ * @return {@code TRUE} if the bits exchanged since the last reset may be corrupted.
+ */
+BOOL OneWireInfoIsLate(OneWireInfoRef info);
 
 /**
  * Sends one bit to the 1-Wire slaves.
@@ -0,0 +1,250 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common.h"
+#include "bindings.h"
+#include "delay.h"
+#include "parallel.h"
+
+#include <stdlib.h>
+
+struct ParallelInfo {
+    GPIOInfoRef gpioInfo;
+    int pins[PARALLEL_WIDTH + 2]; // the exported pins
+    int pinCount;
+
+    struct GPIOWordWrite data; // the data pins, all in one register word
+    uint32_t low[256];  // the bits of the data word for the low byte of each value
+    uint32_t high[256]; // and for its high byte
+
+    GPIOPinHandleRef strobe;
+    GPIOPinHandleRef latch;
+    int active;
+
+    struct ParallelTimings timings;
+    long long deadline;
+};
+
+static GPIOPinHandleRef ParallelInfoExport(ParallelInfoRef info, int pin, int value) {
+    GPIOInfoExport(info->gpioInfo, pin);
+    info->pins[info->pinCount++] = pin;
+
+    GPIOInfoSetPinMode(info->gpioInfo, pin, GPIOPinModeOutput);
+    GPIOInfoSetValue(info->gpioInfo, pin, value);
+
+    GPIOPinHandleRef handle = GPIOInfoGetPinHandle(info->gpioInfo, pin);
+    if (!handle)
+        LOG_ERROR("Parallel bus pin %d is not available in register mode", pin);
+
+    return handle;
+}
+
+ParallelInfoRef ParallelInfoCreate(GPIOInfoRef gpioInfo, const int *dataPins, int width,
+                                   int strobePin, int latchPin, BOOL activeHigh) {
+    if (width <= 0 || width > PARALLEL_WIDTH)
+        return NULL;
+
+    ParallelInfoRef info = calloc(1, sizeof(struct ParallelInfo));
+    if (!info)
+        return NULL;
+
+    info->gpioInfo = GPIOInfoRetain(gpioInfo);
+    info->active = activeHigh ? GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW;
+    info->timings = (struct ParallelTimings){
+        .setup = 200,
+        .pulse = 500,
+        .hold = 100
+    };
+
+    uint32_t pinMasks[PARALLEL_WIDTH] = { 0 };
+    int wordCount = 0;
+    for (int bit = 0 ; bit < width ; bit++) {
+        GPIOPinHandleRef handle = ParallelInfoExport(info, dataPins[bit], GPIO_PIN_VALUE_LOW);
+        if (!handle)
+            goto error;
+
+        if (wordCount == 1 && GPIOPinHandleGetWord(handle)->set != info->data.set) {
+            LOG_ERROR("Parallel bus data pins must share a register word");
+            goto error;
+        }
+
+        GPIOWordWriteAdd(&info->data, &wordCount, handle, GPIO_PIN_VALUE_LOW);
+        pinMasks[bit] = handle->mask;
+    }
+
+    // the bits of the pins above the width are 0, thus their entries are empty
+    for (int value = 0 ; value < 256 ; value++) {
+        for (int bit = 0 ; bit < 8 ; bit++) {
+            if (value & (0x1 << bit)) {
+                info->low[value] |= pinMasks[bit];
+                info->high[value] |= pinMasks[bit + 8];
+            }
+        }
+    }
+
+    info->strobe = ParallelInfoExport(info, strobePin, !info->active);
+    if (!info->strobe)
+        goto error;
+
+    if (latchPin >= 0) {
+        info->latch = ParallelInfoExport(info, latchPin, !info->active);
+        if (!info->latch)
+            goto error;
+    }
+
+    return info;
+
+error:
+    ParallelInfoFree(info);
+    return NULL;
+}
+
+void ParallelInfoFree(ParallelInfoRef info) {
+    for (int index = 0 ; index < info->pinCount ; index++)
+        GPIOInfoUnexport(info->gpioInfo, info->pins[index]);
+    GPIOInfoFree(info->gpioInfo);
+    free(info);
+}
+
+void ParallelInfoSetTimings(ParallelInfoRef info, struct ParallelTimings timings) {
+    info->timings = timings;
+}
+
+static inline void ParallelInfoWait(ParallelInfoRef info, long long duration) {
+    DelayUntilNext(&info->deadline, duration);
+}
+
+static inline void ParallelInfoPulse(ParallelInfoRef info, GPIOPinHandleRef handle) {
+    GPIOPinHandleSetValue(handle, info->active);
+    ParallelInfoWait(info, info->timings.pulse);
+
+    GPIOPinHandleSetValue(handle, !info->active);
+    ParallelInfoWait(info, info->timings.hold);
+}
+
+static inline void ParallelInfoStrobe(ParallelInfoRef info, uint32_t bits) {
+    info->data.bits = bits;
+    GPIOWordWriteApply(&info->data, 1);
+    ParallelInfoWait(info, info->timings.setup);
+
+    ParallelInfoPulse(info, info->strobe);
+}
+
+void ParallelInfoWriteBytes(ParallelInfoRef info, const uint8_t *values, int count) {
+    info->deadline = DelayGetTime();
+
+    for (int index = 0 ; index < count ; index++)
+        ParallelInfoStrobe(info, info->low[values[index]]);
+
+    if (info->latch && count > 0)
+        ParallelInfoPulse(info, info->latch);
+}
+
+void ParallelInfoWriteWords(ParallelInfoRef info, const uint16_t *values, int count) {
+    info->deadline = DelayGetTime();
+
+    for (int index = 0 ; index < count ; index++)
+        ParallelInfoStrobe(info, info->low[values[index] & 0xff] | info->high[values[index] >> 8]);
+
+    if (info->latch && count > 0)
+        ParallelInfoPulse(info, info->latch);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_ParallelBus_configure(JNIEnv * env, jobject thiz, jobject gpio,
+                                            jintArray dataPins, jint strobePin, jint latchPin,
+                                            jboolean activeHigh) {
+    ParallelInfoRef info = (ParallelInfoRef)Java_com_cdoapps_gpio_ParallelBus_getReserved(env,
+                                                                                         thiz);
+    if (info)
+        ParallelInfoFree(info);
+
+    Java_com_cdoapps_gpio_ParallelBus_setReserved(env, thiz, 0l);
+
+    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, gpio);
+    int width = dataPins ? (*env)->GetArrayLength(env, dataPins) : 0;
+    if (!gpioInfo || width <= 0 || width > PARALLEL_WIDTH)
+        return JNI_FALSE;
+
+    jint pins[PARALLEL_WIDTH];
+    (*env)->GetIntArrayRegion(env, dataPins, 0, width, pins);
+
+    info = ParallelInfoCreate(gpioInfo, pins, width, strobePin, latchPin,
+                              activeHigh ? TRUE : FALSE);
+    if (!info)
+        return JNI_FALSE;
+
+    Java_com_cdoapps_gpio_ParallelBus_setReserved(env, thiz, (jlong)info);
+    return JNI_TRUE;
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_ParallelBus_destroy(JNIEnv * env, jobject thiz) {
+    ParallelInfoRef info = (ParallelInfoRef)Java_com_cdoapps_gpio_ParallelBus_getReserved(env,
+                                                                                         thiz);
+    if (info) {
+        ParallelInfoFree(info);
+        Java_com_cdoapps_gpio_ParallelBus_setReserved(env, thiz, 0l);
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_ParallelBus_setTimings(JNIEnv * env, jobject thiz, jlong setupNs,
+                                             jlong pulseNs, jlong holdNs) {
+    ParallelInfoRef info = (ParallelInfoRef)Java_com_cdoapps_gpio_ParallelBus_getReserved(env,
+                                                                                         thiz);
+    if (info) {
+        ParallelInfoSetTimings(info, (struct ParallelTimings){
+                .setup = setupNs,
+                .pulse = pulseNs,
+                .hold = holdNs
+        });
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_ParallelBus_nativeWriteBytes(JNIEnv * env, jobject thiz, jbyteArray array,
+                                                   jint offset, jint count) {
+    ParallelInfoRef info = (ParallelInfoRef)Java_com_cdoapps_gpio_ParallelBus_getReserved(env,
+                                                                                         thiz);
+    if (!info || count <= 0)
+        return;
+
+    uint8_t *values = malloc((size_t)count);
+    if (!values)
+        return;
+
+    (*env)->GetByteArrayRegion(env, array, offset, count, (jbyte *)values);
+    if (!(*env)->ExceptionCheck(env))
+        ParallelInfoWriteBytes(info, values, count);
+    free(values);
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_ParallelBus_nativeWriteWords(JNIEnv * env, jobject thiz, jshortArray array,
+                                                   jint offset, jint count) {
+    ParallelInfoRef info = (ParallelInfoRef)Java_com_cdoapps_gpio_ParallelBus_getReserved(env,
+                                                                                         thiz);
+    if (!info || count <= 0)
+        return;
+
+    uint16_t *values = malloc((size_t)count * sizeof(uint16_t));
+    if (!values)
+        return;
+
+    (*env)->GetShortArrayRegion(env, array, offset, count, (jshort *)values);
+    if (!(*env)->ExceptionCheck(env))
+        ParallelInfoWriteWords(info, values, count);
+    free(values);
+}
@@ -0,0 +1,95 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GPIO_PARALLEL_H
+#define GPIO_PARALLEL_H
+
+#include "gpio.h"
+
+#include <stdint.h>
+
+/**
+ * The maximum number of data pins of a {@code ParallelInfo} object.
+ */
+#define PARALLEL_WIDTH 16
+
+/**
+ * The {@code ParallelTimings} struct holds the durations in nanoseconds around each strobe pulse.
+ */
+struct ParallelTimings {
+    long long setup; // from the data change to the strobe assertion
+    long long pulse; // the width of the strobe and latch pulses
+    long long hold;  // from the strobe release to the next data change
+};
+
+/**
+ * The {@code ParallelInfo} struct represents a parallel bus of up to 16 data pins sharing one
+ * register word of a {@code GPIOInfo} instance exported in register mode ('mmap'), plus a strobe
+ * pulsed after each value and an optional latch pulsed after each block, e.g. the E line of a
+ * character LCD or the WR and LDAC lines of a parallel DAC.
+ *
+ * Each value is mapped to the bits of the data word through precomputed tables, thus it is written
+ * with a single store whatever the order of the pins.
+ */
+typedef struct ParallelInfo *ParallelInfoRef;
+
+/**
+ * Returns a {@code ParallelInfo} object representing a parallel bus.
+ *
+ * @param gpioInfo a {@code GPIOInfo} instance used to initialize and drive the bus.
+ * @param dataPins the WiringPi addresses of the pins which will be exported for the data, the pin
+ *                 {@code n} carrying the bit {@code n} of each value.
+ * @param width the number of data pins, up to {@code PARALLEL_WIDTH}.
+ * @param strobePin the WiringPi address of the pin which will be exported for the strobe.
+ * @param latchPin the WiringPi address of the pin which will be exported for the latch, or
+ *                 {@code -1}.
+ * @param activeHigh if {@code TRUE}, the strobe and latch pulses are high, otherwise they are low.
+ * @return a {@code ParallelInfo} object, or {@code NULL} if one of the pins is not available in
+ *         register mode or if the data pins do not share a register word.
+ */
+ParallelInfoRef ParallelInfoCreate(GPIOInfoRef gpioInfo, const int *dataPins, int width,
+                                   int strobePin, int latchPin, BOOL activeHigh);
+/**
+ * Destroys the resources associated to a parallel bus.
+ *
+ * @param info a {@code ParallelInfo} object representing the bus to destroy.
+ */
+void ParallelInfoFree(ParallelInfoRef info);
+
+/**
+ * Changes the durations around each strobe pulse.
+ *
+ * @param info a {@code ParallelInfo} object representing the bus.
+ * @param timings the new durations.
+ */
+void ParallelInfoSetTimings(ParallelInfoRef info, struct ParallelTimings timings);
+
+/**
+ * Writes a block of bytes, strobing each of them, then pulses the latch.
+ *
+ * @param info a {@code ParallelInfo} object representing the bus.
+ * @param values the bytes to write, the bits above the width of the bus being ignored.
+ * @param count the number of bytes.
+ */
+void ParallelInfoWriteBytes(ParallelInfoRef info, const uint8_t *values, int count);
+/**
+ * Writes a block of values wider than a byte, strobing each of them, then pulses the latch.
+ *
+ * @param info a {@code ParallelInfo} object representing the bus.
+ * @param values the values to write, the bits above the width of the bus being ignored.
+ * @param count the number of values.
+ */
+void ParallelInfoWriteWords(ParallelInfoRef info, const uint16_t *values, int count);
+
+#endif //GPIO_PARALLEL_H
@@ -0,0 +1,291 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common.h"
+#include "bindings.h"
+#include "pwm.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define PWM_REGISTERS_N2_BASE 0xffd19000
+#define PWM_REGISTERS_N2_MEMORY_SIZE 0x3000
+#define PWM_REGISTERS_MEMORY "/dev/mem"
+#define PWM_SIMULATED_REGISTERS_VARIABLE "GPIO_SIMULATED_PWM_REGISTERS"
+
+#define PWM_CLOCK_FREQUENCY 24000000ll
+#define PWM_MAXIMUM_DIVIDER 128
+#define PWM_MAXIMUM_COUNT 0xFFFF
+
+// word offsets of the registers in one controller block
+#define PWM_DUTY_CYCLE(channel) (channel)
+#define PWM_MISC 2
+
+// fields of the misc register, the ones of the second channel being shifted
+#define PWM_MISC_ENABLE(channel) (0x1 << (channel))
+#define PWM_MISC_CLOCK_SELECT(channel) (0x3 << (4 + 2 * (channel)))
+#define PWM_MISC_CLOCK_DIVIDER_SHIFT(channel) (8 + 8 * (channel))
+#define PWM_MISC_CLOCK_DIVIDER(channel) (0x7F << PWM_MISC_CLOCK_DIVIDER_SHIFT(channel))
+#define PWM_MISC_CLOCK_ENABLE(channel) (0x1 << (15 + 8 * (channel)))
+
+struct PwmChannel {
+    int pin;
+    int function;
+    // word index of the controller block, from PWM_REGISTERS_N2_BASE
+    int block;
+    // 0 for the first channel of the block (A, C, E), 1 for the second one (B, D, F)
+    int channel;
+};
+
+static const struct PwmChannel PWM_N2_CHANNELS[] = {
+        // PWM_E on GPIOX_16
+        {.pin = 1, .function = 1, .block = 0x0000 / 4, .channel = 0},
+        // PWM_F on GPIOX_7
+        {.pin = 3, .function = 1, .block = 0x0000 / 4, .channel = 1},
+        // PWM_C on GPIOX_5
+        {.pin = 23, .function = 4, .block = 0x1000 / 4, .channel = 0},
+        // PWM_D on GPIOX_6
+        {.pin = 24, .function = 4, .block = 0x1000 / 4, .channel = 1},
+};
+
+#define PWM_N2_CHANNEL_COUNT (int)(sizeof(PWM_N2_CHANNELS) / sizeof(PWM_N2_CHANNELS[0]))
+
+struct PwmInfo {
+    GPIOInfoRef gpioInfo;
+
+    int file;
+    volatile uint32_t *memory;
+    // the misc register of a block is shared by its two channels
+    int locks[3];
+
+    BOOL enabled[PWM_N2_CHANNEL_COUNT];
+};
+
+static const struct PwmChannel *PwmFindChannel(int pin) {
+    for (int index = 0 ; index < PWM_N2_CHANNEL_COUNT ; index++) {
+        if (PWM_N2_CHANNELS[index].pin == pin)
+            return &PWM_N2_CHANNELS[index];
+    }
+
+    return NULL;
+}
+
+static void PwmInfoMap(PwmInfoRef info) {
+    void *memory = MAP_FAILED;
+
+    if (GPIOBackendSimulated == GPIOInfoGetBackend(info->gpioInfo)) {
+        const char *path = getenv(PWM_SIMULATED_REGISTERS_VARIABLE);
+        if (path && *path) {
+            info->file = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+            if (info->file >= 0 && ftruncate(info->file, PWM_REGISTERS_N2_MEMORY_SIZE) == 0)
+                memory = mmap(0, PWM_REGISTERS_N2_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                              info->file, 0);
+        } else {
+            memory = mmap(0, PWM_REGISTERS_N2_MEMORY_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        }
+    } else if (!getuid()) {
+        info->file = open(PWM_REGISTERS_MEMORY, O_RDWR | O_SYNC | O_CLOEXEC);
+        if (info->file >= 0) {
+#if defined(__aarch64__) || !defined(__BIONIC__)
+            memory = mmap(0, PWM_REGISTERS_N2_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          info->file, PWM_REGISTERS_N2_BASE);
+#else
+            memory = mmap64(0, PWM_REGISTERS_N2_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            info->file, (off64_t)PWM_REGISTERS_N2_BASE);
+#endif
+        }
+    }
+
+    if (memory == MAP_FAILED) {
+        if (info->file >= 0) {
+            close(info->file);
+            info->file = -1;
+        }
+    } else {
+        info->memory = memory;
+    }
+}
+
+PwmInfoRef PwmInfoCreate(GPIOInfoRef gpioInfo) {
+    PwmInfoRef info = calloc(1, sizeof(struct PwmInfo));
+    info->gpioInfo = GPIOInfoRetain(gpioInfo);
+    info->file = -1;
+    info->memory = NULL;
+
+    PwmInfoMap(info);
+    if (!info->memory) {
+        LOG_ERROR("Unable to map the PWM registers");
+        GPIOInfoFree(gpioInfo);
+        free(info);
+        return NULL;
+    }
+
+    return info;
+}
+
+void PwmInfoFree(PwmInfoRef info) {
+    for (int index = 0 ; index < PWM_N2_CHANNEL_COUNT ; index++) {
+        if (info->enabled[index])
+            PwmInfoStop(info, PWM_N2_CHANNELS[index].pin);
+    }
+
+    munmap((void *)info->memory, PWM_REGISTERS_N2_MEMORY_SIZE);
+    if (info->file >= 0)
+        close(info->file);
+
+    GPIOInfoFree(info->gpioInfo);
+    free(info);
+}
+
+BOOL PwmInfoIsSupported(int pin) {
+    return PwmFindChannel(pin) ? TRUE : FALSE;
+}
+
+static void PwmInfoWriteMisc(PwmInfoRef info, const struct PwmChannel *channel, uint32_t mask,
+                             uint32_t bits) {
+    struct GPIOWordWrite write = {
+            .set = &info->memory[channel->block + PWM_MISC],
+            .lock = &info->locks[channel->block / (0x1000 / 4)],
+            .mask = mask,
+            .bits = bits
+    };
+
+    GPIOWordWriteApply(&write, 1);
+}
+
+BOOL PwmInfoSet(PwmInfoRef info, int pin, long long period, long long high) {
+    const struct PwmChannel *channel = PwmFindChannel(pin);
+    if (!channel || period <= 0)
+        return FALSE;
+
+    if (period > 1000000000ll) {
+        LOG_ERROR("The PWM period %lld ns is too long", period);
+        return FALSE;
+    }
+
+    if (high < 0)
+        high = 0;
+    if (high > period)
+        high = period;
+
+    // the smallest divider gives the finest resolution
+    long long ticks = PWM_CLOCK_FREQUENCY * period / 1000000000ll;
+    int divider = (int)((ticks + PWM_MAXIMUM_COUNT - 1) / PWM_MAXIMUM_COUNT);
+    if (divider < 1)
+        divider = 1;
+    if (divider > PWM_MAXIMUM_DIVIDER) {
+        LOG_ERROR("The PWM period %lld ns is too long", period);
+        return FALSE;
+    }
+
+    long long count = ticks / divider;
+    long long highCount = (count * high + period / 2) / period;
+    if (count < 2) {
+        LOG_ERROR("The PWM period %lld ns is too short", period);
+        return FALSE;
+    }
+
+    // a channel always toggles, thus the constant levels are driven by the GPIO function
+    if (highCount <= 0 || highCount >= count) {
+        PwmInfoStop(info, pin);
+        GPIOInfoSetValue(info->gpioInfo, pin, (highCount > 0) ?
+                GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW);
+        return TRUE;
+    }
+
+    // the controller counts one more tick than the values of each state
+    info->memory[channel->block + PWM_DUTY_CYCLE(channel->channel)] =
+            (uint32_t)(highCount - 1) << 16 | (uint32_t)(count - highCount - 1);
+
+    PwmInfoWriteMisc(info, channel,
+                     PWM_MISC_ENABLE(channel->channel) |
+                     PWM_MISC_CLOCK_SELECT(channel->channel) |
+                     PWM_MISC_CLOCK_DIVIDER(channel->channel) |
+                     PWM_MISC_CLOCK_ENABLE(channel->channel),
+                     PWM_MISC_ENABLE(channel->channel) |
+                     (divider - 1) << PWM_MISC_CLOCK_DIVIDER_SHIFT(channel->channel) |
+                     PWM_MISC_CLOCK_ENABLE(channel->channel));
+
+    if (!GPIOInfoSetPinFunction(info->gpioInfo, pin, channel->function)) {
+        PwmInfoStop(info, pin);
+        return FALSE;
+    }
+
+    info->enabled[channel - PWM_N2_CHANNELS] = TRUE;
+    return TRUE;
+}
+
+void PwmInfoStop(PwmInfoRef info, int pin) {
+    const struct PwmChannel *channel = PwmFindChannel(pin);
+    if (!channel)
+        return;
+
+    PwmInfoWriteMisc(info, channel,
+                     PWM_MISC_ENABLE(channel->channel) | PWM_MISC_CLOCK_ENABLE(channel->channel),
+                     0x0);
+    info->enabled[channel - PWM_N2_CHANNELS] = FALSE;
+
+    // switching back to the GPIO function
+    GPIOInfoSetPinMode(info->gpioInfo, pin, GPIOPinModeOutput);
+    GPIOInfoSetValue(info->gpioInfo, pin, GPIO_PIN_VALUE_LOW);
+}
+
+volatile uint32_t *PwmInfoGetRegisters(PwmInfoRef info) {
+    return info->memory;
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Pwm_configure(JNIEnv *env, jobject thiz, jobject gpio) {
+    PwmInfoRef info = (PwmInfoRef)Java_com_cdoapps_gpio_Pwm_getReserved(env, thiz);
+    if (info)
+        PwmInfoFree(info);
+
+    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, gpio);
+    info = gpioInfo ? PwmInfoCreate(gpioInfo) : NULL;
+
+    Java_com_cdoapps_gpio_Pwm_setReserved(env, thiz, (jlong)info);
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Pwm_destroy(JNIEnv *env, jobject thiz) {
+    PwmInfoRef info = (PwmInfoRef)Java_com_cdoapps_gpio_Pwm_getReserved(env, thiz);
+    if (info) {
+        PwmInfoFree(info);
+        Java_com_cdoapps_gpio_Pwm_setReserved(env, thiz, 0l);
+    }
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_Pwm_isSupported(JNIEnv *env, jclass clazz, jint pin) {
+    return PwmInfoIsSupported(pin) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_Pwm_set(JNIEnv *env, jobject thiz, jint pin, jlong period, jlong high) {
+    PwmInfoRef info = (PwmInfoRef)Java_com_cdoapps_gpio_Pwm_getReserved(env, thiz);
+    if (info && PwmInfoSet(info, pin, period, high))
+        return JNI_TRUE;
+
+    return JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Pwm_stop(JNIEnv *env, jobject thiz, jint pin) {
+    PwmInfoRef info = (PwmInfoRef)Java_com_cdoapps_gpio_Pwm_getReserved(env, thiz);
+    if (info)
+        PwmInfoStop(info, pin);
+}
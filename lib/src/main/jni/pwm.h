@@ -0,0 +1,85 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GPIO_PWM_H
+#define GPIO_PWM_H
+
+#include "gpio.h"
+
+/**
+ * The {@code PwmInfo} struct provides control over the PWM controllers of the Odroid-N2 (Amlogic
+ * S922X), which generate the signals in hardware without any CPU load.
+ *
+ * Four pins of the 40-pin header can be routed to a PWM channel: WiringPi 1 (PWM_E),
+ * 3 (PWM_F), 23 (PWM_C) and 24 (PWM_D). The channels are clocked by the 24 MHz crystal.
+ *
+ * With {@code GPIOBackendSimulated}, the registers are a block of memory laid out like the ones
+ * of the SoC, shared through the file named by the 'GPIO_SIMULATED_PWM_REGISTERS' environment
+ * variable, if any.
+ */
+typedef struct PwmInfo *PwmInfoRef;
+
+/**
+ * Returns a {@code PwmInfo} object mapping the PWM registers from the backend of a GPIO
+ * controller. The device registers are only available to root, through '/dev/mem'.
+ *
+ * @param gpioInfo a {@code GPIOInfo} object representing the GPIO controller of the pins.
+ * @return a {@code PwmInfo} object, or {@code NULL} if the registers can not be mapped.
+ */
+PwmInfoRef PwmInfoCreate(GPIOInfoRef gpioInfo);
+/**
+ * Stops the channels enabled by a {@code PwmInfo} object and destroys the resources associated
+ * to it.
+ *
+ * @param info a {@code PwmInfo} object representing the PWM controllers.
+ */
+void PwmInfoFree(PwmInfoRef info);
+
+/**
+ * Checks whether one pin can be routed to a PWM channel.
+ *
+ * @param pin the WiringPi address of the pin.
+ * @return {@code TRUE} if {@code pin} has a PWM function.
+ */
+BOOL PwmInfoIsSupported(int pin);
+
+/**
+ * Generates a signal on one pin. The signals with a duty cycle of 0% or 100% are generated by
+ * driving the pin as a GPIO output, which the PWM channels can not do.
+ *
+ * @param info a {@code PwmInfo} object representing the PWM controllers.
+ * @param pin the WiringPi address of the pin, which must be exported in register mode.
+ * @param period the period of the signal in nanoseconds, from 84 ns to about 349 ms.
+ * @param high the duration of the high state in each period in nanoseconds.
+ * @return {@code TRUE} on success.
+ */
+BOOL PwmInfoSet(PwmInfoRef info, int pin, long long period, long long high);
+/**
+ * Stops the signal of one pin, which is switched back to a low GPIO output.
+ *
+ * @param info a {@code PwmInfo} object representing the PWM controllers.
+ * @param pin the WiringPi address of the pin.
+ */
+void PwmInfoStop(PwmInfoRef info, int pin);
+
+/**
+ * Returns the register words of the PWM controllers, from PWM_EF to PWM_AB, each one starting on
+ * a 4 KiB page.
+ *
+ * @param info a {@code PwmInfo} object representing the PWM controllers.
+ * @return the register words.
+ */
+volatile uint32_t *PwmInfoGetRegisters(PwmInfoRef info);
+
+#endif //GPIO_PWM_H
@@ -0,0 +1,221 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common.h"
+#include "realtime.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// the size of the stack touched once the memory is locked, so that the transactions do not fault
+#define REALTIME_STACK_PREFAULT (64 * 1024)
+
+#define REALTIME_WARNING_AFFINITY 0x1
+#define REALTIME_WARNING_POLICY 0x2
+#define REALTIME_WARNING_MEMORY 0x4
+#define REALTIME_WARNING_LATENCY 0x8
+
+static pthread_mutex_t REALTIME_MUTEX = PTHREAD_MUTEX_INITIALIZER;
+static int REALTIME_MEMORY_COUNT = 0;
+static int REALTIME_LATENCY_COUNT = 0;
+static int REALTIME_LATENCY_DESCRIPTOR = -1;
+static int REALTIME_WARNINGS = 0x0;
+
+// Sessions may be entered around each transaction, thus each failure is only logged once.
+static BOOL RealtimeShouldWarn(int warning) {
+    return (__atomic_fetch_or(&REALTIME_WARNINGS, warning, __ATOMIC_RELAXED) & warning) ? FALSE :
+                                                                                          TRUE;
+}
+
+static int RealtimeGetIsolatedCPU(void) {
+    int cpu = -1;
+
+    FILE *file = fopen("/sys/devices/system/cpu/isolated", "r");
+    if (file) {
+        if (fscanf(file, "%d", &cpu) != 1)
+            cpu = -1;
+        fclose(file);
+    }
+
+    if (cpu < 0) {
+        cpu_set_t cpus;
+        if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+            for (int index = 0 ; index < CPU_SETSIZE ; index++) {
+                if (CPU_ISSET(index, &cpus))
+                    cpu = index;
+            }
+        }
+    }
+
+    return cpu;
+}
+
+static __attribute__((noinline)) void RealtimePrefaultStack(void) {
+    unsigned char stack[REALTIME_STACK_PREFAULT];
+    memset(stack, 0x0, sizeof(stack));
+
+    // keeps the compiler from discarding the writes
+    __asm__ volatile("" :: "r"(stack) : "memory");
+}
+
+static BOOL RealtimeLockMemory(void) {
+    BOOL result = TRUE;
+
+    pthread_mutex_lock(&REALTIME_MUTEX);
+    if (REALTIME_MEMORY_COUNT == 0 && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        if (RealtimeShouldWarn(REALTIME_WARNING_MEMORY))
+            LOG_WARN("Unable to lock the memory: %s", strerror(errno));
+        result = FALSE;
+    } else {
+        REALTIME_MEMORY_COUNT++;
+    }
+    pthread_mutex_unlock(&REALTIME_MUTEX);
+
+    return result;
+}
+
+static void RealtimeUnlockMemory(void) {
+    pthread_mutex_lock(&REALTIME_MUTEX);
+    if (--REALTIME_MEMORY_COUNT == 0)
+        munlockall();
+    pthread_mutex_unlock(&REALTIME_MUTEX);
+}
+
+static BOOL RealtimeHoldLatency(void) {
+    BOOL result = TRUE;
+
+    pthread_mutex_lock(&REALTIME_MUTEX);
+    if (REALTIME_LATENCY_COUNT == 0) {
+        // the request holds as long as the file stays open
+        int32_t latency = 0;
+        int descriptor = open("/dev/cpu_dma_latency", O_WRONLY | O_CLOEXEC);
+        if (descriptor < 0 || write(descriptor, &latency, sizeof(latency)) != sizeof(latency)) {
+            if (RealtimeShouldWarn(REALTIME_WARNING_LATENCY))
+                LOG_WARN("Unable to hold the CPU DMA latency: %s", strerror(errno));
+            if (descriptor >= 0)
+                close(descriptor);
+            result = FALSE;
+        } else {
+            REALTIME_LATENCY_DESCRIPTOR = descriptor;
+        }
+    }
+
+    if (result)
+        REALTIME_LATENCY_COUNT++;
+    pthread_mutex_unlock(&REALTIME_MUTEX);
+
+    return result;
+}
+
+static void RealtimeReleaseLatency(void) {
+    pthread_mutex_lock(&REALTIME_MUTEX);
+    if (--REALTIME_LATENCY_COUNT == 0) {
+        close(REALTIME_LATENCY_DESCRIPTOR);
+        REALTIME_LATENCY_DESCRIPTOR = -1;
+    }
+    pthread_mutex_unlock(&REALTIME_MUTEX);
+}
+
+BOOL RealtimeSessionEnter(struct RealtimeSession *session, const struct RealtimeOptions *options) {
+    BOOL result = TRUE;
+
+    *session = (struct RealtimeSession){ .active = TRUE };
+
+    // the memory is locked first, so that the stack is prefaulted before the policy changes
+    if (options->lockMemory) {
+        session->memoryLocked = RealtimeLockMemory();
+        if (!session->memoryLocked)
+            result = FALSE;
+
+        RealtimePrefaultStack();
+    }
+
+    if (options->holdLatency) {
+        session->latencyHeld = RealtimeHoldLatency();
+        if (!session->latencyHeld)
+            result = FALSE;
+    }
+
+    int cpu = (options->cpu == REALTIME_CPU_ISOLATED) ? RealtimeGetIsolatedCPU() : options->cpu;
+    if (cpu >= 0 && sched_getaffinity(0, sizeof(session->affinity), &session->affinity) == 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) == 0) {
+            session->affinitySaved = TRUE;
+        } else {
+            if (RealtimeShouldWarn(REALTIME_WARNING_AFFINITY))
+                LOG_WARN("Unable to pin the thread to CPU %d: %s", cpu, strerror(errno));
+            result = FALSE;
+        }
+    }
+
+    if (options->priority > 0 &&
+        pthread_getschedparam(pthread_self(), &session->policy, &session->parameters) == 0) {
+        struct sched_param parameters = { .sched_priority = options->priority };
+
+        int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+        if (error == 0) {
+            session->policySaved = TRUE;
+        } else {
+            if (RealtimeShouldWarn(REALTIME_WARNING_POLICY))
+                LOG_WARN("Unable to use SCHED_FIFO with priority %d: %s",
+                         options->priority,
+                         strerror(error));
+            result = FALSE;
+        }
+    }
+
+    return result;
+}
+
+BOOL RealtimeSessionHold(struct RealtimeSession *session, const struct RealtimeOptions *options) {
+    struct RealtimeOptions shared = {
+        .cpu = -1,
+        .priority = 0,
+        .lockMemory = options->lockMemory,
+        .holdLatency = options->holdLatency
+    };
+
+    return RealtimeSessionEnter(session, &shared);
+}
+
+void RealtimeSessionExit(struct RealtimeSession *session) {
+    if (!session->active)
+        return;
+
+    // the policy is restored first, so that the thread does not keep a real-time priority on a
+    // CPU it no longer owns
+    if (session->policySaved)
+        pthread_setschedparam(pthread_self(), session->policy, &session->parameters);
+
+    if (session->affinitySaved)
+        sched_setaffinity(0, sizeof(session->affinity), &session->affinity);
+
+    if (session->latencyHeld)
+        RealtimeReleaseLatency();
+
+    if (session->memoryLocked)
+        RealtimeUnlockMemory();
+
+    session->active = FALSE;
+}
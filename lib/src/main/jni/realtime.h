@@ -0,0 +1,89 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GPIO_REALTIME_H
+#define GPIO_REALTIME_H
+
+#include "common.h"
+
+#include <sched.h>
+
+/**
+ * One may set {@code RealtimeOptions.cpu} to this value to pin the thread to the first CPU isolated
+ * from the scheduler ({@code isolcpus}), or else to the last CPU it may run on, which is a big
+ * core on the Odroid-N2.
+ */
+#define REALTIME_CPU_ISOLATED -2
+
+/**
+ * The {@code RealtimeOptions} struct tells which changes a {@code RealtimeSession} applies.
+ */
+struct RealtimeOptions {
+    int cpu;          // the index of a CPU, REALTIME_CPU_ISOLATED, or -1 to keep the affinity
+    int priority;     // the SCHED_FIFO priority from 1 to 99, or 0 to keep the policy
+    BOOL lockMemory;  // lock the memory of the process with mlockall and prefault the stack
+    BOOL holdLatency; // hold /dev/cpu_dma_latency at 0 so that the CPUs do not enter deep idle
+};
+
+/**
+ * The {@code RealtimeSession} struct saves the state of the calling thread, so that it is restored
+ * once a time critical transaction is over. Its fields should be considered private.
+ */
+struct RealtimeSession {
+    BOOL active;
+
+    BOOL affinitySaved;
+    cpu_set_t affinity;
+
+    BOOL policySaved;
+    int policy;
+    struct sched_param parameters;
+
+    BOOL memoryLocked;
+    BOOL latencyHeld;
+};
+
+/**
+ * Enters a real-time session on the calling thread.
+ *
+ * Each change which is not permitted, e.g. without the {@code CAP_SYS_NICE} or
+ * {@code CAP_IPC_LOCK} capabilities or without access to {@code /dev/cpu_dma_latency}, is skipped
+ * and logged once. The memory lock and the latency request are shared by the sessions of the
+ * process, and released when the last of them exits.
+ *
+ * @param session the session, which must not be active.
+ * @param options the changes to apply.
+ * @return {@code TRUE} if all the changes were applied.
+ */
+BOOL RealtimeSessionEnter(struct RealtimeSession *session, const struct RealtimeOptions *options);
+/**
+ * Enters a session holding only the changes of {@code options} shared by the process, i.e. the
+ * memory lock and the latency request, e.g. as long as a bus is configured. The sessions entered
+ * with the same options around each transaction then only count them, rather than locking and
+ * unlocking the memory of the whole process each time.
+ *
+ * @param session the session, which must not be active, and may be exited by any thread.
+ * @param options the changes whose shared part is applied.
+ * @return {@code TRUE} if all the changes were applied.
+ */
+BOOL RealtimeSessionHold(struct RealtimeSession *session, const struct RealtimeOptions *options);
+/**
+ * Exits a real-time session, restoring the affinity and the policy of the calling thread, which
+ * must be the one which entered it unless the session was entered by {@code RealtimeSessionHold}.
+ *
+ * @param session the session, nothing is done if it is not active.
+ */
+void RealtimeSessionExit(struct RealtimeSession *session);
+
+#endif //GPIO_REALTIME_H
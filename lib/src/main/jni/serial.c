@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "common.h"
+#include "bindings.h"
 #include "serial.h"
 
 #include <errno.h>
@@ -148,100 +149,28 @@ static inline speed_t SerialInfoBaudRateToSpeed(int baudRate) {
 }
 
 static inline SerialDataBits SerialInfoDataBitsFromJava(JNIEnv *env, jobject dataBits) {
-    jclass clazz = (*env)->FindClass(env, "com/cdoapps/gpio/Serial$DataBits");
-
-    if (dataBits == (*env)->GetStaticObjectField(env,
-                                                 clazz,
-                                                 (*env)->GetStaticFieldID(
-                                                         env,
-                                                         clazz,
-                                                         "Five",
-                                                         "Lcom/cdoapps/gpio/Serial$DataBits;")))
-        return SerialDataBitsFive;
-
-    if (dataBits == (*env)->GetStaticObjectField(env,
-                                                 clazz,
-                                                 (*env)->GetStaticFieldID(
-                                                         env,
-                                                         clazz,
-                                                         "Six",
-                                                         "Lcom/cdoapps/gpio/Serial$DataBits;")))
-        return SerialDataBitsSix;
-
-    if (dataBits == (*env)->GetStaticObjectField(env,
-                                                 clazz,
-                                                 (*env)->GetStaticFieldID(
-                                                         env,
-                                                         clazz,
-                                                         "Seven",
-                                                         "Lcom/cdoapps/gpio/Serial$DataBits;")))
-        return SerialDataBitsSeven;
-
-    if (dataBits == (*env)->GetStaticObjectField(env,
-                                                 clazz,
-                                                 (*env)->GetStaticFieldID(
-                                                         env,
-                                                         clazz,
-                                                         "Height",
-                                                         "Lcom/cdoapps/gpio/Serial$DataBits;")))
-        return SerialDataBitsHeight;
+    for (int index = SerialDataBitsFive ; index <= SerialDataBitsHeight ; index++) {
+        if ((*env)->IsSameObject(env, dataBits, JAVA_BINDINGS.serial.dataBits[index]))
+            return (SerialDataBits)index;
+    }
 
     return (SerialDataBits)-1;
 }
 
 static inline SerialParity SerialInfoParityFromJava(JNIEnv *env, jobject parity) {
-    jclass clazz = (*env)->FindClass(env, "com/cdoapps/gpio/Serial$Parity");
-
-    if (parity == (*env)->GetStaticObjectField(env,
-                                                 clazz,
-                                                 (*env)->GetStaticFieldID(
-                                                         env,
-                                                         clazz,
-                                                         "None",
-                                                         "Lcom/cdoapps/gpio/Serial$Parity;")))
-        return SerialParityNone;
-
-    if (parity == (*env)->GetStaticObjectField(env,
-                                               clazz,
-                                               (*env)->GetStaticFieldID(
-                                                       env,
-                                                       clazz,
-                                                       "Even",
-                                                       "Lcom/cdoapps/gpio/Serial$Parity;")))
-        return SerialParityEven;
-
-    if (parity == (*env)->GetStaticObjectField(env,
-                                               clazz,
-                                               (*env)->GetStaticFieldID(
-                                                       env,
-                                                       clazz,
-                                                       "Odd",
-                                                       "Lcom/cdoapps/gpio/Serial$Parity;")))
-        return SerialParityOdd;
+    for (int index = SerialParityNone ; index <= SerialParityEven ; index++) {
+        if ((*env)->IsSameObject(env, parity, JAVA_BINDINGS.serial.parities[index]))
+            return (SerialParity)index;
+    }
 
     return (SerialParity)-1;
 }
 
 static inline SerialStopBits SerialInfoStopBitsFromJava(JNIEnv *env, jobject stopBits) {
-    jclass clazz = (*env)->FindClass(env, "com/cdoapps/gpio/Serial$StopBits");
-
-    if (stopBits == (*env)->GetStaticObjectField(env,
-                                                 clazz,
-                                                 (*env)->GetStaticFieldID(
-                                                         env,
-                                                         clazz,
-                                                         "One",
-                                                         "Lcom/cdoapps/gpio/Serial$StopBits;")))
-        return SerialStopBitsOne;
-
-    if (stopBits == (*env)->GetStaticObjectField(env,
-                                                 clazz,
-                                                 (*env)->GetStaticFieldID(
-                                                         env,
-                                                         clazz,
-                                                         "Two",
-                                                         "Lcom/cdoapps/gpio/Serial$StopBits;")))
-        return SerialStopBitsTwo;
+    for (int index = SerialStopBitsOne ; index <= SerialStopBitsTwo ; index++) {
+        if ((*env)->IsSameObject(env, stopBits, JAVA_BINDINGS.serial.stopBits[index]))
+            return (SerialStopBits)index;
+    }
 
     return (SerialStopBits)-1;
 }
@@ -336,35 +265,17 @@ int SerialInfoRead(SerialInfoRef info, char *buffer, int size) {
 
 static inline jstring
 Java_com_cdoapps_gpio_Serial_getPath(JNIEnv * env, jobject thiz) {
-    jclass clazz = (*env)->GetObjectClass(env, thiz);
-    jfieldID pathID = (*env)->GetFieldID(env, clazz, "path", "Ljava/lang/String;");
-    if (!pathID)
-        return NULL;
-
-    return (*env)->GetObjectField(env, thiz, pathID);
+    return (*env)->GetObjectField(env, thiz, JAVA_BINDINGS.serial.path);
 }
 
 static inline void
 Java_com_cdoapps_gpio_Serial_setInputStream(JNIEnv * env, jobject thiz, jobject inputStream) {
-    jclass clazz = (*env)->GetObjectClass(env, thiz);
-    jfieldID inputStreamID = (*env)->GetFieldID(env, clazz, "inputStream", "Ljava/io/InputStream;");
-    if (!inputStreamID)
-        return;
-
-    (*env)->SetObjectField(env, thiz, inputStreamID, inputStream);
+    (*env)->SetObjectField(env, thiz, JAVA_BINDINGS.serial.inputStream, inputStream);
 }
 
 static inline void
 Java_com_cdoapps_gpio_Serial_setOutputStream(JNIEnv * env, jobject thiz, jobject outputStream) {
-    jclass clazz = (*env)->GetObjectClass(env, thiz);
-    jfieldID outputStreamID = (*env)->GetFieldID(env,
-                                                 clazz,
-                                                 "outputStream",
-                                                 "Ljava/io/OutputStream;");
-    if (!outputStreamID)
-        return;
-
-    (*env)->SetObjectField(env, thiz, outputStreamID, outputStream);
+    (*env)->SetObjectField(env, thiz, JAVA_BINDINGS.serial.outputStream, outputStream);
 }
 
 
@@ -372,7 +283,7 @@ JNIEXPORT void JNICALL
 Java_com_cdoapps_gpio_Serial_configure(JNIEnv * env, jobject thiz, jint baudRate,
                                        jobject dataBits, jobject parity,
                                        jobject stopBits) {
-    SerialInfoRef info = (SerialInfoRef )Java_java_lang_Object_getReserved(env, thiz);
+    SerialInfoRef info = (SerialInfoRef )Java_com_cdoapps_gpio_Serial_getReserved(env, thiz);
 
     SerialDataBits serialDataBits = SerialInfoDataBitsFromJava(env, dataBits);
     SerialParity serialParity = SerialInfoParityFromJava(env, parity);
@@ -397,52 +308,32 @@ Java_com_cdoapps_gpio_Serial_configure(JNIEnv * env, jobject thiz, jint baudRate
                             serialStopBits);
     (*env)->ReleaseStringUTFChars(env, path, utf8Path);
 
-    Java_java_lang_Object_setReserved(env, thiz, (jlong)info);
-
-    jclass fileDescriptorClazz = (*env)->FindClass(env, "java/io/FileDescriptor");
-    jmethodID fileDescriptorConstructor = (*env)->GetMethodID(env,
-                                                              fileDescriptorClazz,
-                                                              "<init>",
-                                                              "()V");
-
-    jfieldID descriptorID = (*env)->GetFieldID(env, fileDescriptorClazz, "descriptor", "I");
-    if (!descriptorID)
-        descriptorID = (*env)->GetFieldID(env, fileDescriptorClazz, "fd", "I");
+    Java_com_cdoapps_gpio_Serial_setReserved(env, thiz, (jlong)info);
 
-    if (!descriptorID)
-        return;
-
-    jobject fileDescriptor = (*env)->NewObject(env, fileDescriptorClazz, fileDescriptorConstructor);
-    (*env)->SetIntField(env, fileDescriptor, descriptorID, info->device);
+    struct JavaFileDescriptorBindings *fileDescriptorBindings = &JAVA_BINDINGS.fileDescriptor;
+    jobject fileDescriptor = (*env)->NewObject(env,
+                                               fileDescriptorBindings->clazz,
+                                               fileDescriptorBindings->constructor);
+    (*env)->SetIntField(env, fileDescriptor, fileDescriptorBindings->descriptor, info->device);
 
-    jclass inputStreamClazz = (*env)->FindClass(env, "java/io/FileInputStream");
-    jmethodID inputStreamConstructor = (*env)->GetMethodID(env,
-                                                           inputStreamClazz,
-                                                           "<init>",
-                                                           "(Ljava/io/FileDescriptor;)V");
     jobject inputStream = (*env)->NewObject(env,
-                                            inputStreamClazz,
-                                            inputStreamConstructor,
+                                            JAVA_BINDINGS.fileInputStream.clazz,
+                                            JAVA_BINDINGS.fileInputStream.constructor,
                                             fileDescriptor);
     Java_com_cdoapps_gpio_Serial_setInputStream(env, thiz, inputStream);
 
-    jclass outputStreamClazz = (*env)->FindClass(env, "java/io/FileOutputStream");
-    jmethodID outputStreamConstructor = (*env)->GetMethodID(env,
-                                                           outputStreamClazz,
-                                                           "<init>",
-                                                           "(Ljava/io/FileDescriptor;)V");
     jobject outputStream = (*env)->NewObject(env,
-                                            outputStreamClazz,
-                                            outputStreamConstructor,
-                                            fileDescriptor);
+                                             JAVA_BINDINGS.fileOutputStream.clazz,
+                                             JAVA_BINDINGS.fileOutputStream.constructor,
+                                             fileDescriptor);
     Java_com_cdoapps_gpio_Serial_setOutputStream(env, thiz, outputStream);
 }
 
 JNIEXPORT void JNICALL
 Java_com_cdoapps_gpio_Serial_destroy(JNIEnv * env, jobject thiz) {
-    SerialInfoRef info = (SerialInfoRef )Java_java_lang_Object_getReserved(env, thiz);
+    SerialInfoRef info = (SerialInfoRef )Java_com_cdoapps_gpio_Serial_getReserved(env, thiz);
     if (info) {
         SerialInfoFree(info);
-        Java_java_lang_Object_setReserved(env, thiz, 0l);
+        Java_com_cdoapps_gpio_Serial_setReserved(env, thiz, 0l);
     }
 }
\ No newline at end of file
@@ -0,0 +1,307 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common.h"
+#include "bindings.h"
+#include "softpwm.h"
+#include "delay.h"
+#include "realtime.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+
+// the longest sleep of the thread, bounding the delay before a new channel starts
+#define SOFT_PWM_IDLE_DURATION 1000000ll
+
+struct SoftPwmChannel {
+    // written by SoftPwmInfoSetChannel: the period in the high 32 bits, the high duration in the
+    // low 32 bits
+    uint64_t signal;
+
+    // the following fields are private to the thread
+    GPIOPinHandleRef handle;
+    BOOL scheduled;
+    BOOL high;
+    long long start;
+    long long deadline;
+    uint32_t period;
+    uint32_t duration;
+};
+
+struct SoftPwmInfo {
+    GPIOInfoRef gpioInfo;
+    struct RealtimeOptions realtimeOptions;
+
+    struct SoftPwmChannel channels[64];
+    // bit n is set when the signal of WiringPi pin n changed
+    uint64_t changed;
+
+    // a min-heap of WiringPi addresses ordered by deadline
+    int heap[64];
+    int heapCount;
+
+    BOOL running;
+    pthread_t thread;
+};
+
+static inline long long SoftPwmDeadline(SoftPwmInfoRef info, int index) {
+    return info->channels[info->heap[index]].deadline;
+}
+
+static void SoftPwmHeapSwap(SoftPwmInfoRef info, int first, int second) {
+    int pin = info->heap[first];
+    info->heap[first] = info->heap[second];
+    info->heap[second] = pin;
+}
+
+static void SoftPwmHeapPush(SoftPwmInfoRef info, int pin) {
+    int index = info->heapCount++;
+    info->heap[index] = pin;
+
+    while (index > 0 && SoftPwmDeadline(info, (index - 1) / 2) > SoftPwmDeadline(info, index)) {
+        SoftPwmHeapSwap(info, index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+}
+
+static int SoftPwmHeapPop(SoftPwmInfoRef info) {
+    int pin = info->heap[0];
+    info->heap[0] = info->heap[--info->heapCount];
+
+    int index = 0;
+    while (TRUE) {
+        int smallest = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+
+        if (left < info->heapCount && SoftPwmDeadline(info, left) < SoftPwmDeadline(info, smallest))
+            smallest = left;
+        if (right < info->heapCount &&
+            SoftPwmDeadline(info, right) < SoftPwmDeadline(info, smallest))
+            smallest = right;
+        if (smallest == index)
+            break;
+
+        SoftPwmHeapSwap(info, index, smallest);
+        index = smallest;
+    }
+
+    return pin;
+}
+
+// schedules the channels whose signal changed while they were stopped
+static void SoftPwmInfoStartChannels(SoftPwmInfoRef info, long long now) {
+    uint64_t changed = __atomic_exchange_n(&info->changed, 0x0, __ATOMIC_ACQUIRE);
+
+    for (int pin = 0 ; pin < 64 && changed ; pin++) {
+        struct SoftPwmChannel *channel = &info->channels[pin];
+        if (!(changed & (0x1ull << pin)) || channel->scheduled)
+            continue;
+
+        if (!channel->handle)
+            channel->handle = GPIOInfoGetPinHandle(info->gpioInfo, pin);
+
+        channel->scheduled = TRUE;
+        channel->high = FALSE;
+        channel->start = now;
+        channel->deadline = now;
+        channel->period = 0;
+        SoftPwmHeapPush(info, pin);
+    }
+}
+
+static void *SoftPwmInfoRun(void *argument) {
+    SoftPwmInfoRef info = argument;
+    struct GPIOWordWrite writes[64];
+
+    struct RealtimeSession session;
+    RealtimeSessionEnter(&session, &info->realtimeOptions);
+
+    while (__atomic_load_n(&info->running, __ATOMIC_ACQUIRE)) {
+        long long now = DelayGetTime();
+        SoftPwmInfoStartChannels(info, now);
+
+        if (!info->heapCount) {
+            DelaySleep(SOFT_PWM_IDLE_DURATION);
+            continue;
+        }
+
+        long long deadline = SoftPwmDeadline(info, 0);
+        if (deadline > now) {
+            // the wait ends early when the signal of a channel changes
+            DelayUntilFlagged(deadline, SOFT_PWM_IDLE_DURATION, &info->changed);
+            // a new channel may start before the deadline
+            if (DelayGetTime() < deadline)
+                continue;
+        }
+
+        int writeCount = 0;
+        uint64_t mask = 0x0;
+        uint64_t values = 0x0;
+        int popped[64];
+        int popCount = 0;
+
+        while (info->heapCount && SoftPwmDeadline(info, 0) <= deadline + SOFT_PWM_COALESCE_WINDOW) {
+            int pin = SoftPwmHeapPop(info);
+            struct SoftPwmChannel *channel = &info->channels[pin];
+            BOOL high = FALSE;
+
+            if (channel->high) {
+                // end of the high state
+                channel->high = FALSE;
+                channel->deadline = channel->start + channel->period;
+            } else {
+                // start of a period, the signal is only updated here
+                uint64_t signal = __atomic_load_n(&channel->signal, __ATOMIC_RELAXED);
+                if (channel->period)
+                    channel->start += channel->period;
+                channel->period = (uint32_t)(signal >> 32);
+                channel->duration = (uint32_t)signal;
+
+                if (!channel->period) {
+                    channel->scheduled = FALSE;
+                } else if (channel->duration >= channel->period) {
+                    high = TRUE;
+                    channel->deadline = channel->start + channel->period;
+                } else if (channel->duration) {
+                    high = TRUE;
+                    channel->high = TRUE;
+                    channel->deadline = channel->start + channel->duration;
+                } else {
+                    channel->deadline = channel->start + channel->period;
+                }
+            }
+
+            if (channel->handle) {
+                GPIOWordWriteAdd(writes, &writeCount, channel->handle, high);
+            } else {
+                mask |= (0x1ull << pin);
+                if (high)
+                    values |= (0x1ull << pin);
+            }
+
+            if (channel->scheduled)
+                popped[popCount++] = pin;
+        }
+
+        // the next edges are only pushed now, or a short pulse would be overwritten in this batch
+        for (int index = 0 ; index < popCount ; index++)
+            SoftPwmHeapPush(info, popped[index]);
+
+        GPIOWordWriteApply(writes, writeCount);
+
+        if (mask)
+            GPIOInfoWriteMask(info->gpioInfo, mask, values);
+    }
+
+    // the channels are left low
+    uint64_t mask = 0x0;
+    for (int index = 0 ; index < info->heapCount ; index++)
+        mask |= (0x1ull << info->heap[index]);
+    GPIOInfoWriteMask(info->gpioInfo, mask, 0x0);
+
+    RealtimeSessionExit(&session);
+    return NULL;
+}
+
+SoftPwmInfoRef SoftPwmInfoCreate(GPIOInfoRef gpioInfo, const struct RealtimeOptions *options) {
+    SoftPwmInfoRef info = calloc(1, sizeof(struct SoftPwmInfo));
+    info->gpioInfo = GPIOInfoRetain(gpioInfo);
+    info->realtimeOptions = *options;
+    info->running = TRUE;
+
+    if (pthread_create(&info->thread, NULL, SoftPwmInfoRun, info) != 0) {
+        LOG_ERROR("Unable to start the soft PWM thread");
+        GPIOInfoFree(gpioInfo);
+        free(info);
+        return NULL;
+    }
+
+    return info;
+}
+
+void SoftPwmInfoFree(SoftPwmInfoRef info) {
+    __atomic_store_n(&info->running, FALSE, __ATOMIC_RELEASE);
+    pthread_join(info->thread, NULL);
+
+    GPIOInfoFree(info->gpioInfo);
+    free(info);
+}
+
+void SoftPwmInfoSetChannel(SoftPwmInfoRef info, int pin, uint32_t period, uint32_t high) {
+    if (pin < 0 || pin >= 64)
+        return;
+
+    uint64_t signal = ((uint64_t)period << 32) | high;
+    __atomic_store_n(&info->channels[pin].signal, signal, __ATOMIC_RELAXED);
+    __atomic_fetch_or(&info->changed, 0x1ull << pin, __ATOMIC_RELEASE);
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_SoftPwm_configure(JNIEnv *env, jobject thiz, jobject gpio, jint cpu,
+                                        jint priority, jboolean lockMemory, jboolean holdLatency) {
+    SoftPwmInfoRef info = (SoftPwmInfoRef)Java_com_cdoapps_gpio_SoftPwm_getReserved(env, thiz);
+    if (info)
+        SoftPwmInfoFree(info);
+
+    struct RealtimeOptions options = {
+        .cpu = cpu,
+        .priority = priority,
+        .lockMemory = lockMemory ? TRUE : FALSE,
+        .holdLatency = holdLatency ? TRUE : FALSE
+    };
+
+    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, gpio);
+    info = gpioInfo ? SoftPwmInfoCreate(gpioInfo, &options) : NULL;
+
+    Java_com_cdoapps_gpio_SoftPwm_setReserved(env, thiz, (jlong)info);
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_SoftPwm_destroy(JNIEnv *env, jobject thiz) {
+    SoftPwmInfoRef info = (SoftPwmInfoRef)Java_com_cdoapps_gpio_SoftPwm_getReserved(env, thiz);
+    if (info) {
+        SoftPwmInfoFree(info);
+        Java_com_cdoapps_gpio_SoftPwm_setReserved(env, thiz, 0l);
+    }
+}
+
+// The following methods are registered by JNI_OnLoad.
+
+static void
+Java_com_cdoapps_gpio_SoftPwm_criticalSetChannel(jlong info, jint pin, jint period, jint high) {
+    if (info)
+        SoftPwmInfoSetChannel((SoftPwmInfoRef)info, pin, (uint32_t)period, (uint32_t)high);
+}
+
+static void
+Java_com_cdoapps_gpio_SoftPwm_nativeSetChannel(JNIEnv * env, jclass clazz, jlong info, jint pin,
+                                               jint period, jint high) {
+    Java_com_cdoapps_gpio_SoftPwm_criticalSetChannel(info, pin, period, high);
+}
+
+BOOL Java_com_cdoapps_gpio_SoftPwm_registerNatives(JNIEnv *env, BOOL critical) {
+    const JNINativeMethod methods[] = {
+            {"nativeSetChannel", "(JIII)V", critical ?
+                    (void *)Java_com_cdoapps_gpio_SoftPwm_criticalSetChannel :
+                    (void *)Java_com_cdoapps_gpio_SoftPwm_nativeSetChannel}
+    };
+
+    jclass clazz = (*env)->FindClass(env, "com/cdoapps/gpio/SoftPwm");
+    if (!clazz || (*env)->RegisterNatives(env, clazz, methods, 1) != JNI_OK)
+        return FALSE;
+    (*env)->DeleteLocalRef(env, clazz);
+
+    return TRUE;
+}
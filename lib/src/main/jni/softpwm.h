@@ -0,0 +1,65 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GPIO_SOFTPWM_H
+#define GPIO_SOFTPWM_H
+
+#include "gpio.h"
+#include "realtime.h"
+
+/**
+ * The {@code SoftPwmInfo} struct represents a thread generating software PWM on many output pins.
+ *
+ * The next edges of the channels are kept in a min-heap, and the edges falling within
+ * {@code SOFT_PWM_COALESCE_WINDOW} nanoseconds of each other are applied with one write per
+ * register word. A channel changes at most once per write, thus a pulse shorter than the window
+ * lasts until the next write instead of being dropped.
+ */
+typedef struct SoftPwmInfo *SoftPwmInfoRef;
+
+/**
+ * The edges of channels which are closer than this duration in nanoseconds are written at once.
+ */
+#define SOFT_PWM_COALESCE_WINDOW 2000ll
+
+/**
+ * Returns a {@code SoftPwmInfo} object without any channel, and starts its thread.
+ *
+ * @param gpioInfo a {@code GPIOInfo} object representing the GPIO controller.
+ * @param options the real-time session of the thread, entered when it starts and left when it
+ *                stops.
+ * @return a {@code SoftPwmInfo} object, or {@code NULL} on error.
+ */
+SoftPwmInfoRef SoftPwmInfoCreate(GPIOInfoRef gpioInfo, const struct RealtimeOptions *options);
+/**
+ * Stops the thread of a PWM generator, drives its channels low and destroys the resources
+ * associated to it.
+ *
+ * @param info a {@code SoftPwmInfo} object representing the PWM generator to destroy.
+ */
+void SoftPwmInfoFree(SoftPwmInfoRef info);
+
+/**
+ * Changes the signal of one channel, without any lock. The new signal starts with the next period
+ * of the channel, thus no truncated pulse is generated.
+ *
+ * @param info a {@code SoftPwmInfo} object representing the PWM generator.
+ * @param pin the WiringPi address of the pin, which must be exported as an output.
+ * @param period the period of the signal in nanoseconds, up to {@code UINT32_MAX}, or {@code 0} to
+ *               stop the channel and drive it low.
+ * @param high the duration of the high state in each period in nanoseconds.
+ */
+void SoftPwmInfoSetChannel(SoftPwmInfoRef info, int pin, uint32_t period, uint32_t high);
+
+#endif //GPIO_SOFTPWM_H
@@ -0,0 +1,316 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common.h"
+#include "bindings.h"
+#include "delay.h"
+#include "spi.h"
+
+#include <stdlib.h>
+
+struct SPIInfo {
+    GPIOInfoRef gpioInfo;
+    int pins[SPI_LANE_COUNT + 3]; // the exported pins
+    int pinCount;
+
+    int laneCount;
+    BOOL phase; // CPHA: the data is sampled on the trailing edges of the clock
+
+    struct GPIOWordWrite data;
+    uint32_t dataMask;
+    uint32_t lanes[1 << SPI_LANE_COUNT]; // the bits of the data word for each group of bits
+
+    struct GPIOWordWrite clock;
+    uint32_t clockMask;
+    uint32_t clockIdle;
+    uint32_t clockActive;
+    BOOL shared; // SCLK shares the word of the lanes
+
+    GPIOPinHandleRef input;
+    GPIOPinHandleRef select;
+
+    long long halfPeriod;
+    long long deadline;
+
+    long long cycles;
+    long long elapsed;
+};
+
+static BOOL SPIInfoExport(SPIInfoRef info, int pin, GPIOPinMode mode, int value,
+                          GPIOPinHandleRef *handle) {
+    GPIOInfoExport(info->gpioInfo, pin);
+    info->pins[info->pinCount++] = pin;
+
+    GPIOInfoSetPinMode(info->gpioInfo, pin, mode);
+    if (mode == GPIOPinModeOutput)
+        GPIOInfoSetValue(info->gpioInfo, pin, value);
+
+    *handle = GPIOInfoGetPinHandle(info->gpioInfo, pin);
+    if (!*handle) {
+        LOG_ERROR("SPI pin %d is not available in register mode", pin);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+SPIInfoRef SPIInfoCreate(GPIOInfoRef gpioInfo, int clockPin, const int *dataPins, int laneCount,
+                         int inputPin, int selectPin, int mode, int frequency) {
+    if ((laneCount != 1 && laneCount != 2 && laneCount != 4) || mode < 0 || mode > 3)
+        return NULL;
+
+    if (laneCount > 1 && inputPin >= 0) {
+        LOG_ERROR("SPI with %d output lanes is write only", laneCount);
+        return NULL;
+    }
+
+    SPIInfoRef info = calloc(1, sizeof(struct SPIInfo));
+    if (!info)
+        return NULL;
+
+    info->gpioInfo = GPIOInfoRetain(gpioInfo);
+    info->laneCount = laneCount;
+    info->phase = (mode & 0x1) ? TRUE : FALSE;
+    info->halfPeriod = (frequency > 0) ? 500000000LL / frequency : 0;
+
+    int polarity = (mode & 0x2) ? GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW;
+
+    GPIOPinHandleRef handle;
+    if (!SPIInfoExport(info, clockPin, GPIOPinModeOutput, polarity, &handle))
+        goto error;
+
+    int wordCount = 0;
+    GPIOWordWriteAdd(&info->clock, &wordCount, handle, polarity);
+    info->clockMask = handle->mask;
+    info->clockIdle = polarity ? handle->mask : 0x0;
+    info->clockActive = polarity ? 0x0 : handle->mask;
+
+    uint32_t laneMasks[SPI_LANE_COUNT];
+    wordCount = 0;
+    for (int lane = 0 ; lane < laneCount ; lane++) {
+        if (!SPIInfoExport(info, dataPins[lane], GPIOPinModeOutput, GPIO_PIN_VALUE_LOW, &handle))
+            goto error;
+
+        if (wordCount == 1 && GPIOPinHandleGetWord(handle)->set != info->data.set) {
+            LOG_ERROR("SPI lanes must share a register word");
+            goto error;
+        }
+
+        GPIOWordWriteAdd(&info->data, &wordCount, handle, GPIO_PIN_VALUE_LOW);
+        laneMasks[lane] = handle->mask;
+        info->dataMask |= handle->mask;
+    }
+
+    for (int value = 0 ; value < (1 << laneCount) ; value++) {
+        for (int lane = 0 ; lane < laneCount ; lane++) {
+            if (value & (0x1 << lane))
+                info->lanes[value] |= laneMasks[lane];
+        }
+    }
+    info->shared = (info->clock.set == info->data.set) ? TRUE : FALSE;
+
+    if (inputPin >= 0 &&
+        !SPIInfoExport(info, inputPin, GPIOPinModeInput, GPIO_PIN_VALUE_LOW, &info->input))
+        goto error;
+
+    if (selectPin >= 0 &&
+        !SPIInfoExport(info, selectPin, GPIOPinModeOutput, GPIO_PIN_VALUE_HIGH, &info->select))
+        goto error;
+
+    return info;
+
+error:
+    SPIInfoFree(info);
+    return NULL;
+}
+
+void SPIInfoFree(SPIInfoRef info) {
+    for (int index = 0 ; index < info->pinCount ; index++)
+        GPIOInfoUnexport(info->gpioInfo, info->pins[index]);
+    GPIOInfoFree(info->gpioInfo);
+    free(info);
+}
+
+static inline void SPIWordStore(const struct GPIOWordWrite *word, uint32_t mask, uint32_t bits) {
+    struct GPIOWordWrite write = *word;
+    write.mask = mask;
+    write.bits = bits;
+
+    GPIOWordWriteApply(&write, 1);
+}
+
+// Changes the clock and, unless group is negative, the lanes. The lanes change on the shifting
+// edges, thus they are written after the clock when they live in another word.
+static inline void SPIInfoClock(SPIInfoRef info, uint32_t clock, int group) {
+    if (group < 0) {
+        SPIWordStore(&info->clock, info->clockMask, clock);
+    } else if (info->shared) {
+        SPIWordStore(&info->data, info->dataMask | info->clockMask, info->lanes[group] | clock);
+    } else {
+        SPIWordStore(&info->clock, info->clockMask, clock);
+        SPIWordStore(&info->data, info->dataMask, info->lanes[group]);
+    }
+}
+
+static inline void SPIInfoWait(SPIInfoRef info) {
+    DelayUntilNext(&info->deadline, info->halfPeriod);
+}
+
+static inline int SPIInfoGetGroup(SPIInfoRef info, const uint8_t *writeBuffer, int index) {
+    int steps = 8 / info->laneCount;
+    if (!writeBuffer)
+        return 0;
+
+    int shift = 8 - info->laneCount * (index % steps + 1);
+    return (writeBuffer[index / steps] >> shift) & ((1 << info->laneCount) - 1);
+}
+
+BOOL SPIInfoTransfer(SPIInfoRef info, const uint8_t *writeBuffer, uint8_t *readBuffer, int count) {
+    info->cycles = 0;
+    info->elapsed = 0;
+    if (readBuffer && !info->input)
+        return FALSE;
+    if (count <= 0)
+        return TRUE;
+
+    BOOL reads = readBuffer ? TRUE : FALSE;
+    int total = count * 8 / info->laneCount;
+    uint8_t byte = 0x0;
+
+    info->deadline = DelayGetTime();
+    if (info->select) {
+        GPIOPinHandleSetLow(info->select);
+        SPIInfoWait(info);
+    }
+
+    long long start = DelayGetTime();
+
+    // without CPHA, the first bits are shifted out before the first edge
+    if (!info->phase) {
+        SPIInfoClock(info, info->clockIdle, SPIInfoGetGroup(info, writeBuffer, 0));
+        SPIInfoWait(info);
+    }
+
+    for (int index = 0 ; index < total ; index++) {
+        if (info->phase) {
+            SPIInfoClock(info, info->clockActive, SPIInfoGetGroup(info, writeBuffer, index));
+            SPIInfoWait(info);
+        }
+
+        // the data is sampled right before the sampling edge, after a whole half period of setup
+        if (reads) {
+            byte = (uint8_t)((byte << 1) | GPIOPinHandleGetValue(info->input));
+            if ((index & 0x7) == 0x7)
+                readBuffer[index >> 3] = byte;
+        }
+
+        if (info->phase) {
+            SPIInfoClock(info, info->clockIdle, -1);
+        } else {
+            SPIInfoClock(info, info->clockActive, -1);
+            SPIInfoWait(info);
+
+            int next = (index + 1 < total) ? SPIInfoGetGroup(info, writeBuffer, index + 1) : -1;
+            SPIInfoClock(info, info->clockIdle, next);
+        }
+        SPIInfoWait(info);
+    }
+
+    info->cycles = total;
+    info->elapsed = DelayGetTime() - start;
+
+    if (info->select)
+        GPIOPinHandleSetHigh(info->select);
+
+    return TRUE;
+}
+
+double SPIInfoGetFrequency(SPIInfoRef info) {
+    if (info->elapsed <= 0)
+        return 0.0;
+
+    return (double)info->cycles * 1e9 / (double)info->elapsed;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_SPI_configure(JNIEnv * env, jobject thiz, jobject gpio, jint clockPin,
+                                    jintArray dataPins, jint inputPin, jint selectPin, jint mode,
+                                    jint frequencyHz) {
+    SPIInfoRef info = (SPIInfoRef)Java_com_cdoapps_gpio_SPI_getReserved(env, thiz);
+    if (info)
+        SPIInfoFree(info);
+
+    Java_com_cdoapps_gpio_SPI_setReserved(env, thiz, 0l);
+
+    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, gpio);
+    int laneCount = dataPins ? (*env)->GetArrayLength(env, dataPins) : 0;
+    if (!gpioInfo || laneCount <= 0 || laneCount > SPI_LANE_COUNT)
+        return JNI_FALSE;
+
+    jint pins[SPI_LANE_COUNT];
+    (*env)->GetIntArrayRegion(env, dataPins, 0, laneCount, pins);
+
+    info = SPIInfoCreate(gpioInfo, clockPin, pins, laneCount, inputPin, selectPin, mode,
+                         frequencyHz);
+    if (!info)
+        return JNI_FALSE;
+
+    Java_com_cdoapps_gpio_SPI_setReserved(env, thiz, (jlong)info);
+    return JNI_TRUE;
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_SPI_destroy(JNIEnv * env, jobject thiz) {
+    SPIInfoRef info = (SPIInfoRef)Java_com_cdoapps_gpio_SPI_getReserved(env, thiz);
+    if (info) {
+        SPIInfoFree(info);
+        Java_com_cdoapps_gpio_SPI_setReserved(env, thiz, 0l);
+    }
+}
+
+static uint8_t *SPIGetBuffer(JNIEnv * env, jobject buffer, jint offset, jint count) {
+    if (!buffer)
+        return NULL;
+
+    uint8_t *address = (*env)->GetDirectBufferAddress(env, buffer);
+    if (!address || offset < 0 || offset + count > (*env)->GetDirectBufferCapacity(env, buffer))
+        return NULL;
+
+    return address + offset;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_SPI_nativeTransfer(JNIEnv * env, jobject thiz, jobject writeBuffer,
+                                         jint writeOffset, jobject readBuffer, jint readOffset,
+                                         jint count) {
+    SPIInfoRef info = (SPIInfoRef)Java_com_cdoapps_gpio_SPI_getReserved(env, thiz);
+    if (!info || count < 0)
+        return JNI_FALSE;
+
+    uint8_t *write = SPIGetBuffer(env, writeBuffer, writeOffset, count);
+    uint8_t *read = SPIGetBuffer(env, readBuffer, readOffset, count);
+    if ((writeBuffer && !write) || (readBuffer && !read))
+        return JNI_FALSE;
+
+    return SPIInfoTransfer(info, write, read, count) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jdouble JNICALL
+Java_com_cdoapps_gpio_SPI_getFrequency(JNIEnv * env, jobject thiz) {
+    SPIInfoRef info = (SPIInfoRef)Java_com_cdoapps_gpio_SPI_getReserved(env, thiz);
+    if (!info)
+        return 0.0;
+
+    return SPIInfoGetFrequency(info);
+}
@@ -0,0 +1,89 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GPIO_SPI_H
+#define GPIO_SPI_H
+
+#include "gpio.h"
+
+#include <stdint.h>
+
+/**
+ * The maximum number of data output lanes of a {@code SPIInfo} object.
+ */
+#define SPI_LANE_COUNT 4
+
+/**
+ * The {@code SPIInfo} struct represents an SPI bus mastered over pins of a {@code GPIOInfo}
+ * instance exported in register mode ('mmap'): SCLK, one to four data output lanes (MOSI), an
+ * optional MISO and an optional CS.
+ *
+ * With several output lanes (dual or quad output), each clock cycle shifts out 2 or 4 bits with a
+ * single store, thus the lanes must share one register word. Such a bus is write only: MISO
+ * requires a single lane. When SCLK shares the word of the lanes as well, each edge of the
+ * clock and the new data are written by the same store.
+ *
+ * This implementation uses bit banging and spinning, thus it may produce high CPU load.
+ */
+typedef struct SPIInfo *SPIInfoRef;
+
+/**
+ * Returns a {@code SPIInfo} object representing an SPI bus mastered over several pins.
+ *
+ * @param gpioInfo a {@code GPIOInfo} instance used to initialize and communicate with the SPI bus.
+ * @param clockPin the WiringPi address of the pin which will be exported for SCLK.
+ * @param dataPins the WiringPi addresses of the pins which will be exported for the output lanes,
+ *                 the lane {@code n} shifting out the bit {@code n} of each group of bits.
+ * @param laneCount the number of output lanes, either {@code 1}, {@code 2} or {@code 4}.
+ * @param inputPin the WiringPi address of the pin which will be exported for MISO, or {@code -1}.
+ * @param selectPin the WiringPi address of the pin which will be exported for the active low CS,
+ *                  or {@code -1}.
+ * @param mode the SPI mode, from {@code 0} to {@code 3}: bit 1 is the clock polarity (CPOL) and bit
+ *             0 the clock phase (CPHA).
+ * @param frequency the target frequency of the clock in Hz, or {@code 0} to run as fast as
+ *                  possible.
+ * @return a {@code SPIInfo} object representing an SPI bus, or {@code NULL} if one of the pins is
+ *         not available in register mode, if the lanes do not share a register word or if there
+ *         are several lanes and a MISO.
+ */
+SPIInfoRef SPIInfoCreate(GPIOInfoRef gpioInfo, int clockPin, const int *dataPins, int laneCount,
+                         int inputPin, int selectPin, int mode, int frequency);
+/**
+ * Destroys the resources associated to an SPI bus.
+ *
+ * @param info a {@code SPIInfo} object representing the SPI bus to destroy.
+ */
+void SPIInfoFree(SPIInfoRef info);
+
+/**
+ * Shifts out a block of bytes, most significant bit first, while shifting in as many bytes from
+ * MISO. CS is asserted during the whole block.
+ *
+ * @param info a {@code SPIInfo} object representing the SPI bus.
+ * @param writeBuffer the bytes to write, or {@code NULL} to write zeros.
+ * @param readBuffer receives the bytes read, or {@code NULL}.
+ * @param count the number of bytes to transfer.
+ * @return {@code TRUE} on success, {@code FALSE} if {@code readBuffer} is set without a MISO.
+ */
+BOOL SPIInfoTransfer(SPIInfoRef info, const uint8_t *writeBuffer, uint8_t *readBuffer, int count);
+
+/**
+ * Returns the frequency achieved by the clock during the last transfer.
+ *
+ * @param info a {@code SPIInfo} object representing the SPI bus.
+ * @return the average frequency of the clock in Hz, or {@code 0} if nothing was transferred.
+ */
+double SPIInfoGetFrequency(SPIInfoRef info);
+
+#endif //GPIO_SPI_H
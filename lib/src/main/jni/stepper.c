@@ -0,0 +1,562 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common.h"
+#include "bindings.h"
+#include "stepper.h"
+#include "delay.h"
+#include "realtime.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+// the longest sleep of the thread, bounding the delay before a queued move starts
+#define STEPPER_IDLE_DURATION 1000000ll
+// the delay between a change of direction and the next STEP pulse
+#define STEPPER_DIRECTION_SETUP 5000ll
+
+struct StepperMove {
+    struct StepperMove *next;
+    int direction;
+    int count;
+    // the velocities in steps per second, and the acceleration in steps per second squared
+    double entry;
+    double exit;
+    double velocity;
+    double acceleration;
+    // the times of the steps in nanoseconds since the start of the move
+    long long times[];
+};
+
+struct StepperAxis {
+    int stepPin;
+    int directionPin;
+    long long pulseWidth;
+    GPIOPinHandleRef stepHandle;
+    GPIOPinHandleRef directionHandle;
+
+    // the queue is shared with the producers, the running move is private to the thread
+    pthread_mutex_t lock;
+    struct StepperMove *first;
+    struct StepperMove *last;
+    unsigned int generation; // changed with the queue
+    int pending;
+    BOOL stopping;
+
+    struct StepperMove *move;
+    int step;
+    long long start;
+    long long end;
+
+    long long position;
+};
+
+struct StepperInfo {
+    GPIOInfoRef gpioInfo;
+    struct RealtimeOptions realtimeOptions;
+
+    struct StepperAxis axes[STEPPER_AXIS_COUNT];
+    // bit n is set when moves were queued or dropped on axis n
+    uint64_t changed;
+
+    BOOL running;
+    pthread_t thread;
+};
+
+// Computes the step times of a move, which accelerates from its entry velocity up to its maximum
+// velocity, cruises, then decelerates down to its exit velocity.
+static void StepperMovePlan(struct StepperMove *move) {
+    int count = move->count;
+    double entry = move->entry;
+    double exit = move->exit;
+    double velocity = move->velocity;
+    double acceleration = move->acceleration;
+
+    // the profile is a triangle when the maximum velocity can not be reached
+    double accelerationSteps = (velocity * velocity - entry * entry) / (2.0 * acceleration);
+    double decelerationSteps = (velocity * velocity - exit * exit) / (2.0 * acceleration);
+    if (accelerationSteps + decelerationSteps > count) {
+        velocity = sqrt((2.0 * acceleration * count + entry * entry + exit * exit) / 2.0);
+        accelerationSteps = (velocity * velocity - entry * entry) / (2.0 * acceleration);
+        decelerationSteps = count - accelerationSteps;
+    }
+
+    double accelerationTime = (velocity - entry) / acceleration;
+    double duration = accelerationTime + (velocity - exit) / acceleration +
+            (count - accelerationSteps - decelerationSteps) / velocity;
+
+    for (int step = 1 ; step <= count ; step++) {
+        double time;
+        if (step <= accelerationSteps)
+            time = (sqrt(entry * entry + 2.0 * acceleration * step) - entry) / acceleration;
+        else if (step < count - decelerationSteps)
+            time = accelerationTime + (step - accelerationSteps) / velocity;
+        else
+            time = duration - (sqrt(exit * exit + 2.0 * acceleration * (count - step)) - exit) /
+                    acceleration;
+
+        move->times[step - 1] = (long long)(time * 1e9);
+    }
+}
+
+static struct StepperMove *StepperMoveCreate(int direction, int count, double entry, double exit,
+                                             double velocity, double acceleration) {
+    struct StepperMove *move = malloc(sizeof(struct StepperMove) + sizeof(long long) * count);
+    if (!move)
+        return NULL;
+
+    move->next = NULL;
+    move->direction = direction;
+    move->count = count;
+    move->entry = entry;
+    move->exit = exit;
+    move->velocity = velocity;
+    move->acceleration = acceleration;
+
+    StepperMovePlan(move);
+    return move;
+}
+
+// Returns the highest velocity at which a move may follow the previous one without stopping: both
+// must allow it, the previous move must reach it from its entry velocity and the next one must be
+// able to stop from it.
+static double StepperMoveGetJunction(const struct StepperMove *previous, int count,
+                                     double velocity, double acceleration) {
+    double junction = fmin(previous->velocity, velocity);
+    junction = fmin(junction, sqrt(previous->entry * previous->entry +
+                                   2.0 * previous->acceleration * previous->count));
+    return fmin(junction, sqrt(2.0 * acceleration * count));
+}
+
+static void StepperMoveFreeAll(struct StepperMove *move) {
+    while (move) {
+        struct StepperMove *next = move->next;
+        free(move);
+        move = next;
+    }
+}
+
+static inline void StepperInfoWritePin(struct GPIOWordWrite *writes, int *count, uint64_t *mask,
+                                       uint64_t *values, GPIOPinHandleRef handle, int pin,
+                                       int value) {
+    if (handle) {
+        GPIOWordWriteAdd(writes, count, handle, value);
+        return;
+    }
+
+    *mask |= (0x1ull << pin);
+    if (value)
+        *values |= (0x1ull << pin);
+    else
+        *values &= ~(0x1ull << pin);
+}
+
+static inline void StepperInfoFlush(StepperInfoRef info, const struct GPIOWordWrite *writes,
+                                    int count, uint64_t mask, uint64_t values) {
+    GPIOWordWriteApply(writes, count);
+
+    if (mask)
+        GPIOInfoWriteMask(info->gpioInfo, mask, values);
+}
+
+// starts the next queued move of the idle axes, returns TRUE if a direction changed
+static BOOL StepperInfoStartMoves(StepperInfoRef info, long long now) {
+    uint64_t changed = __atomic_exchange_n(&info->changed, 0x0, __ATOMIC_ACQUIRE);
+    struct GPIOWordWrite writes[STEPPER_AXIS_COUNT];
+    int count = 0;
+    uint64_t mask = 0x0;
+    uint64_t values = 0x0;
+
+    for (int index = 0 ; index < STEPPER_AXIS_COUNT ; index++) {
+        struct StepperAxis *axis = &info->axes[index];
+        if (!(changed & (0x1ull << index)) &&
+            (axis->move || !__atomic_load_n(&axis->first, __ATOMIC_RELAXED)))
+            continue;
+
+        pthread_mutex_lock(&axis->lock);
+
+        if (axis->stopping && axis->move) {
+            free(axis->move);
+            axis->move = NULL;
+            axis->pending--;
+        }
+        axis->stopping = FALSE;
+
+        if (!axis->move && axis->first) {
+            axis->move = axis->first;
+            axis->first = axis->move->next;
+            if (!axis->first)
+                axis->last = NULL;
+            axis->generation++;
+
+            // the move continues the previous one without any gap
+            axis->step = 0;
+            axis->start = (axis->end > now) ? axis->end : now;
+
+            StepperInfoWritePin(writes, &count, &mask, &values, axis->directionHandle,
+                                axis->directionPin, axis->move->direction);
+        }
+
+        pthread_mutex_unlock(&axis->lock);
+    }
+
+    StepperInfoFlush(info, writes, count, mask, values);
+    return (count || mask) ? TRUE : FALSE;
+}
+
+static long long StepperInfoNextDeadline(StepperInfoRef info) {
+    long long deadline = -1;
+
+    for (int index = 0 ; index < STEPPER_AXIS_COUNT ; index++) {
+        const struct StepperAxis *axis = &info->axes[index];
+        if (!axis->move)
+            continue;
+
+        long long time = axis->start + axis->move->times[axis->step];
+        if (deadline < 0 || time < deadline)
+            deadline = time;
+    }
+
+    return deadline;
+}
+
+static void *StepperInfoRun(void *argument) {
+    StepperInfoRef info = argument;
+    struct GPIOWordWrite writes[STEPPER_AXIS_COUNT];
+
+    struct RealtimeSession session;
+    RealtimeSessionEnter(&session, &info->realtimeOptions);
+
+    while (__atomic_load_n(&info->running, __ATOMIC_ACQUIRE)) {
+        long long now = DelayGetTime();
+        if (StepperInfoStartMoves(info, now))
+            now += STEPPER_DIRECTION_SETUP;
+
+        long long deadline = StepperInfoNextDeadline(info);
+        if (deadline < 0) {
+            DelaySleep(STEPPER_IDLE_DURATION);
+            continue;
+        }
+
+        if (deadline < now)
+            deadline = now;
+
+        // the wait ends early when moves are queued or dropped
+        DelayUntilFlagged(deadline, STEPPER_IDLE_DURATION, &info->changed);
+        if (DelayGetTime() < deadline)
+            continue;
+
+        // the rising edges of the axes which are due
+        int count = 0;
+        uint64_t mask = 0x0;
+        uint64_t values = 0x0;
+        uint32_t stepping = 0x0;
+        long long pulseWidth = 0;
+
+        for (int index = 0 ; index < STEPPER_AXIS_COUNT ; index++) {
+            struct StepperAxis *axis = &info->axes[index];
+            if (!axis->move ||
+                axis->start + axis->move->times[axis->step] > deadline + STEPPER_COALESCE_WINDOW)
+                continue;
+
+            StepperInfoWritePin(writes, &count, &mask, &values, axis->stepHandle,
+                                axis->stepPin, GPIO_PIN_VALUE_HIGH);
+            stepping |= (0x1u << index);
+            if (axis->pulseWidth > pulseWidth)
+                pulseWidth = axis->pulseWidth;
+        }
+
+        StepperInfoFlush(info, writes, count, mask, values);
+        long long pulseEnd = DelayGetTime() + pulseWidth;
+
+        count = 0;
+        mask = 0x0;
+        values = 0x0;
+
+        for (int index = 0 ; index < STEPPER_AXIS_COUNT ; index++) {
+            struct StepperAxis *axis = &info->axes[index];
+            if (!(stepping & (0x1u << index)))
+                continue;
+
+            StepperInfoWritePin(writes, &count, &mask, &values, axis->stepHandle,
+                                axis->stepPin, GPIO_PIN_VALUE_LOW);
+
+            __atomic_add_fetch(&axis->position,
+                               (GPIO_PIN_VALUE_HIGH == axis->move->direction) ? 1 : -1,
+                               __ATOMIC_RELAXED);
+
+            if (++axis->step == axis->move->count) {
+                axis->end = axis->start + axis->move->times[axis->move->count - 1];
+
+                pthread_mutex_lock(&axis->lock);
+                free(axis->move);
+                axis->move = NULL;
+                axis->pending--;
+                pthread_mutex_unlock(&axis->lock);
+            }
+        }
+
+        DelayUntil(pulseEnd);
+        StepperInfoFlush(info, writes, count, mask, values);
+    }
+
+    RealtimeSessionExit(&session);
+    return NULL;
+}
+
+StepperInfoRef StepperInfoCreate(GPIOInfoRef gpioInfo, int cpu, int priority) {
+    StepperInfoRef info = calloc(1, sizeof(struct StepperInfo));
+    info->gpioInfo = GPIOInfoRetain(gpioInfo);
+    info->realtimeOptions = (struct RealtimeOptions){ .cpu = cpu, .priority = priority };
+
+    for (int index = 0 ; index < STEPPER_AXIS_COUNT ; index++) {
+        info->axes[index].stepPin = -1;
+        info->axes[index].directionPin = -1;
+        pthread_mutex_init(&info->axes[index].lock, NULL);
+    }
+
+    info->running = TRUE;
+    if (pthread_create(&info->thread, NULL, StepperInfoRun, info) != 0) {
+        LOG_ERROR("Unable to start the stepper thread");
+        for (int index = 0 ; index < STEPPER_AXIS_COUNT ; index++)
+            pthread_mutex_destroy(&info->axes[index].lock);
+        GPIOInfoFree(gpioInfo);
+        free(info);
+        return NULL;
+    }
+
+    return info;
+}
+
+void StepperInfoFree(StepperInfoRef info) {
+    __atomic_store_n(&info->running, FALSE, __ATOMIC_RELEASE);
+    pthread_join(info->thread, NULL);
+
+    for (int index = 0 ; index < STEPPER_AXIS_COUNT ; index++) {
+        struct StepperAxis *axis = &info->axes[index];
+        free(axis->move);
+        StepperMoveFreeAll(axis->first);
+        pthread_mutex_destroy(&axis->lock);
+    }
+
+    GPIOInfoFree(info->gpioInfo);
+    free(info);
+}
+
+BOOL StepperInfoSetAxis(StepperInfoRef info, int axis, int stepPin, int directionPin,
+                        long long pulseWidth) {
+    if (axis < 0 || axis >= STEPPER_AXIS_COUNT || stepPin < 0 || stepPin >= 64 ||
+        directionPin < 0 || directionPin >= 64)
+        return FALSE;
+
+    struct StepperAxis *axisInfo = &info->axes[axis];
+    pthread_mutex_lock(&axisInfo->lock);
+
+    BOOL idle = (!axisInfo->pending) ? TRUE : FALSE;
+    if (idle) {
+        axisInfo->stepPin = stepPin;
+        axisInfo->directionPin = directionPin;
+        axisInfo->pulseWidth = pulseWidth;
+        axisInfo->stepHandle = GPIOInfoGetPinHandle(info->gpioInfo, stepPin);
+        axisInfo->directionHandle = GPIOInfoGetPinHandle(info->gpioInfo, directionPin);
+    }
+
+    pthread_mutex_unlock(&axisInfo->lock);
+    return idle;
+}
+
+BOOL StepperInfoQueueMove(StepperInfoRef info, int axis, int steps, double velocity,
+                          double acceleration) {
+    if (axis < 0 || axis >= STEPPER_AXIS_COUNT || info->axes[axis].stepPin < 0 || !steps ||
+        steps < -STEPPER_MOVE_MAX_STEPS || steps > STEPPER_MOVE_MAX_STEPS || velocity <= 0.0 ||
+        acceleration <= 0.0)
+        return FALSE;
+
+    struct StepperAxis *axisInfo = &info->axes[axis];
+    int direction = (steps < 0) ? GPIO_PIN_VALUE_LOW : GPIO_PIN_VALUE_HIGH;
+    int count = abs(steps);
+
+    // The profiles are computed out of the thread and out of the lock. A move following a queued
+    // one in the same direction starts at the junction velocity, down to which the queued one is
+    // planned again, unless the thread started it meanwhile.
+    struct StepperMove *move = NULL;
+    struct StepperMove *replaced = NULL;
+    for (;;) {
+        pthread_mutex_lock(&axisInfo->lock);
+        unsigned int generation = axisInfo->generation;
+        struct StepperMove *last = axisInfo->last;
+        struct StepperMove previous = { .direction = -1 };
+        if (last)
+            previous = *last;
+        pthread_mutex_unlock(&axisInfo->lock);
+
+        double junction = 0.0;
+        if (previous.direction == direction)
+            junction = StepperMoveGetJunction(&previous, count, velocity, acceleration);
+
+        move = StepperMoveCreate(direction, count, junction, 0.0, velocity, acceleration);
+        struct StepperMove *replacement = (junction > 0.0) ?
+                StepperMoveCreate(direction, previous.count, previous.entry, junction,
+                                  previous.velocity, previous.acceleration) : NULL;
+        if (!move || (junction > 0.0 && !replacement)) {
+            LOG_ERROR("Unable to allocate a move of %d steps", steps);
+            free(move);
+            free(replacement);
+            return FALSE;
+        }
+
+        pthread_mutex_lock(&axisInfo->lock);
+        if (generation == axisInfo->generation) {
+            if (replacement) {
+                struct StepperMove **link = &axisInfo->first;
+                while (*link != last)
+                    link = &(*link)->next;
+
+                *link = replacement;
+                axisInfo->last = replacement;
+                replaced = last;
+            }
+
+            if (axisInfo->last)
+                axisInfo->last->next = move;
+            else
+                axisInfo->first = move;
+            axisInfo->last = move;
+            axisInfo->generation++;
+            axisInfo->pending++;
+
+            pthread_mutex_unlock(&axisInfo->lock);
+            break;
+        }
+        pthread_mutex_unlock(&axisInfo->lock);
+
+        free(move);
+        free(replacement);
+    }
+
+    free(replaced);
+
+    __atomic_fetch_or(&info->changed, 0x1ull << axis, __ATOMIC_RELEASE);
+    return TRUE;
+}
+
+void StepperInfoStop(StepperInfoRef info, int axis) {
+    if (axis < 0 || axis >= STEPPER_AXIS_COUNT)
+        return;
+
+    struct StepperAxis *axisInfo = &info->axes[axis];
+    pthread_mutex_lock(&axisInfo->lock);
+
+    struct StepperMove *moves = axisInfo->first;
+    while (axisInfo->first) {
+        axisInfo->first = axisInfo->first->next;
+        axisInfo->pending--;
+    }
+    axisInfo->last = NULL;
+    axisInfo->generation++;
+    // the running move is dropped by the thread
+    axisInfo->stopping = TRUE;
+
+    pthread_mutex_unlock(&axisInfo->lock);
+
+    StepperMoveFreeAll(moves);
+    __atomic_fetch_or(&info->changed, 0x1ull << axis, __ATOMIC_RELEASE);
+}
+
+long long StepperInfoGetPosition(StepperInfoRef info, int axis) {
+    if (axis < 0 || axis >= STEPPER_AXIS_COUNT)
+        return 0;
+
+    return __atomic_load_n(&info->axes[axis].position, __ATOMIC_RELAXED);
+}
+
+int StepperInfoGetPendingMoves(StepperInfoRef info, int axis) {
+    if (axis < 0 || axis >= STEPPER_AXIS_COUNT)
+        return 0;
+
+    struct StepperAxis *axisInfo = &info->axes[axis];
+    pthread_mutex_lock(&axisInfo->lock);
+    int pending = axisInfo->pending;
+    pthread_mutex_unlock(&axisInfo->lock);
+
+    return pending;
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Stepper_configure(JNIEnv *env, jobject thiz, jobject gpio, jint cpu,
+                                        jint priority) {
+    StepperInfoRef info = (StepperInfoRef)Java_com_cdoapps_gpio_Stepper_getReserved(env, thiz);
+    if (info)
+        StepperInfoFree(info);
+
+    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, gpio);
+    info = gpioInfo ? StepperInfoCreate(gpioInfo, cpu, priority) : NULL;
+
+    Java_com_cdoapps_gpio_Stepper_setReserved(env, thiz, (jlong)info);
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Stepper_destroy(JNIEnv *env, jobject thiz) {
+    StepperInfoRef info = (StepperInfoRef)Java_com_cdoapps_gpio_Stepper_getReserved(env, thiz);
+    if (info) {
+        StepperInfoFree(info);
+        Java_com_cdoapps_gpio_Stepper_setReserved(env, thiz, 0l);
+    }
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_Stepper_setAxis(JNIEnv *env, jobject thiz, jint axis, jint stepPin,
+                                      jint directionPin, jlong pulseWidth) {
+    StepperInfoRef info = (StepperInfoRef)Java_com_cdoapps_gpio_Stepper_getReserved(env, thiz);
+    if (info && StepperInfoSetAxis(info, axis, stepPin, directionPin, pulseWidth))
+        return JNI_TRUE;
+
+    return JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_Stepper_move(JNIEnv *env, jobject thiz, jint axis, jint steps,
+                                   jdouble velocity, jdouble acceleration) {
+    StepperInfoRef info = (StepperInfoRef)Java_com_cdoapps_gpio_Stepper_getReserved(env, thiz);
+    if (info && StepperInfoQueueMove(info, axis, steps, velocity, acceleration))
+        return JNI_TRUE;
+
+    return JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Stepper_stop(JNIEnv *env, jobject thiz, jint axis) {
+    StepperInfoRef info = (StepperInfoRef)Java_com_cdoapps_gpio_Stepper_getReserved(env, thiz);
+    if (info)
+        StepperInfoStop(info, axis);
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_cdoapps_gpio_Stepper_getPosition(JNIEnv *env, jobject thiz, jint axis) {
+    StepperInfoRef info = (StepperInfoRef)Java_com_cdoapps_gpio_Stepper_getReserved(env, thiz);
+    if (info)
+        return StepperInfoGetPosition(info, axis);
+
+    return 0l;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_cdoapps_gpio_Stepper_getPendingMoves(JNIEnv *env, jobject thiz, jint axis) {
+    StepperInfoRef info = (StepperInfoRef)Java_com_cdoapps_gpio_Stepper_getReserved(env, thiz);
+    if (info)
+        return StepperInfoGetPendingMoves(info, axis);
+
+    return 0;
+}
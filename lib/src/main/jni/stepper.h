@@ -0,0 +1,125 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GPIO_STEPPER_H
+#define GPIO_STEPPER_H
+
+#include "gpio.h"
+
+/**
+ * The maximum number of axes of a {@code StepperInfo} object.
+ */
+#define STEPPER_AXIS_COUNT 8
+
+/**
+ * The {@code StepperInfo} struct represents a motion engine driving STEP/DIR stepper drivers from
+ * a real-time thread.
+ *
+ * Each axis has a queue of moves whose step times follow a trapezoidal velocity profile, computed
+ * when the move is queued. The consecutive moves of an axis in the same direction are chained
+ * without stopping, as long as the next one is queued before the previous one starts. The next
+ * move of an axis starts as soon as the previous one ends, and
+ * the STEP pulses of the axes which fall within {@code STEPPER_COALESCE_WINDOW} nanoseconds are
+ * written together, with one write per register word.
+ */
+typedef struct StepperInfo *StepperInfoRef;
+
+/**
+ * The STEP pulses of axes which are closer than this duration in nanoseconds are written at once.
+ */
+#define STEPPER_COALESCE_WINDOW 2000ll
+
+/**
+ * The maximum number of steps of one move, whose step times are stored in 8 bytes each. Longer
+ * distances are queued as several moves.
+ */
+#define STEPPER_MOVE_MAX_STEPS (1 << 22)
+
+/**
+ * Returns a {@code StepperInfo} object without any axis, and starts its thread.
+ *
+ * @param gpioInfo a {@code GPIOInfo} object representing the GPIO controller.
+ * @param cpu the index of the CPU running the thread, {@code REALTIME_CPU_ISOLATED}, or {@code -1}
+ *            to let the scheduler choose.
+ * @param priority the {@code SCHED_FIFO} priority of the thread, or {@code 0} to use the default
+ *                 policy.
+ * @return a {@code StepperInfo} object, or {@code NULL} on error.
+ */
+StepperInfoRef StepperInfoCreate(GPIOInfoRef gpioInfo, int cpu, int priority);
+/**
+ * Stops the thread of a motion engine, drops the queued moves and destroys the resources
+ * associated to it.
+ *
+ * @param info a {@code StepperInfo} object representing the motion engine to destroy.
+ */
+void StepperInfoFree(StepperInfoRef info);
+
+/**
+ * Binds one axis to the pins of its driver. It must be called before any move of the axis is
+ * queued.
+ *
+ * @param info a {@code StepperInfo} object representing the motion engine.
+ * @param axis the index of the axis, lower than {@code STEPPER_AXIS_COUNT}.
+ * @param stepPin the WiringPi address of the STEP pin, which must be exported as an output.
+ * @param directionPin the WiringPi address of the DIR pin, which must be exported as an output.
+ * @param pulseWidth the duration of the STEP pulses in nanoseconds.
+ * @return {@code TRUE} on success.
+ */
+BOOL StepperInfoSetAxis(StepperInfoRef info, int axis, int stepPin, int directionPin,
+                        long long pulseWidth);
+
+/**
+ * Queues a move of one axis, which accelerates from rest up to a maximum velocity, cruises, then
+ * decelerates back to rest.
+ *
+ * When the last queued move of the axis goes in the same direction, the move rather starts at the
+ * highest velocity both moves allow, and that move is planned again to end at it. The running move
+ * is never planned again, thus it always ends at rest.
+ *
+ * @param info a {@code StepperInfo} object representing the motion engine.
+ * @param axis the index of the axis.
+ * @param steps the number of steps, negative to move backward (DIR low), at most
+ *              {@code STEPPER_MOVE_MAX_STEPS} in absolute value.
+ * @param velocity the maximum velocity in steps per second.
+ * @param acceleration the acceleration and deceleration in steps per second squared.
+ * @return {@code TRUE} if the move was queued.
+ */
+BOOL StepperInfoQueueMove(StepperInfoRef info, int axis, int steps, double velocity,
+                          double acceleration);
+/**
+ * Stops one axis at once and drops its queued moves.
+ *
+ * @param info a {@code StepperInfo} object representing the motion engine.
+ * @param axis the index of the axis.
+ */
+void StepperInfoStop(StepperInfoRef info, int axis);
+
+/**
+ * Returns the position of one axis.
+ *
+ * @param info a {@code StepperInfo} object representing the motion engine.
+ * @param axis the index of the axis.
+ * @return the number of steps emitted forward minus the ones emitted backward.
+ */
+long long StepperInfoGetPosition(StepperInfoRef info, int axis);
+/**
+ * Returns the number of moves of one axis which are queued or running.
+ *
+ * @param info a {@code StepperInfo} object representing the motion engine.
+ * @param axis the index of the axis.
+ * @return the number of moves which are not finished.
+ */
+int StepperInfoGetPendingMoves(StepperInfoRef info, int axis);
+
+#endif //GPIO_STEPPER_H
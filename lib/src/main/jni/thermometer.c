@@ -16,6 +16,7 @@
 // https://github.com/danjperron/BitBangingDS18B20
 
 #include "common.h"
+#include "bindings.h"
 #include "thermometer.h"
 
 #include <stdlib.h>
@@ -135,7 +136,12 @@ void ThermometerInfoList(OneWireInfoRef oneWireInfo, StackRef stack) {
         unsigned long long rom = previousRom;
         int position = previousPosition;
 
-        switch (ThermometerInfoSearch(oneWireInfo, &rom, &position)) {
+        // a search pass lasts about 15 ms, a preemption in one of its slots would fail it
+        OneWireInfoBeginTransaction(oneWireInfo);
+        int result = ThermometerInfoSearch(oneWireInfo, &rom, &position);
+        OneWireInfoEndTransaction(oneWireInfo);
+
+        switch (result) {
             case THERMOMETER_SEARCH_RESULT_LEAF:
                 retry = 10;
                 break;
@@ -232,11 +238,15 @@ void ThermometerInfoSelect(ThermometerInfoRef info) {
 #define THERMOMETER_CONVERT_T_COMMAND 0x44
 
 void ThermometerInfoConvertAll(OneWireInfoRef oneWireInfo, BOOL parasiticPowerMode) {
-    if (!OneWireInfoReset(oneWireInfo))
+    OneWireInfoBeginTransaction(oneWireInfo);
+    if (!OneWireInfoReset(oneWireInfo)) {
+        OneWireInfoEndTransaction(oneWireInfo);
         return;
+    }
 
     OneWireInfoWriteByte(oneWireInfo, THERMOMETER_SKIP_ROM_COMMAND);
     OneWireInfoWriteByte(oneWireInfo, THERMOMETER_CONVERT_T_COMMAND);
+    OneWireInfoEndTransaction(oneWireInfo);
 
     if (parasiticPowerMode) {
         struct timespec time = { .tv_sec = 1, .tv_nsec = 0 };
@@ -250,11 +260,15 @@ void ThermometerInfoConvertAll(OneWireInfoRef oneWireInfo, BOOL parasiticPowerMo
 }
 
 void ThermometerInfoConvert(ThermometerInfoRef info) {
-    if (!OneWireInfoReset(info->oneWireInfo))
+    OneWireInfoBeginTransaction(info->oneWireInfo);
+    if (!OneWireInfoReset(info->oneWireInfo)) {
+        OneWireInfoEndTransaction(info->oneWireInfo);
         return;
+    }
 
     ThermometerInfoSelect(info);
     OneWireInfoWriteByte(info->oneWireInfo, THERMOMETER_CONVERT_T_COMMAND);
+    OneWireInfoEndTransaction(info->oneWireInfo);
 
     struct timespec time = { .tv_sec = 1, .tv_nsec = 0 };
     nanosleep(&time, NULL);
@@ -270,14 +284,34 @@ void ThermometerInfoReadScratchpad(ThermometerInfoRef info, unsigned char *scrat
         scratchpad[position] = OneWireInfoReadByte(info->oneWireInfo);
 }
 
-float ThermometerInfoGetTemperature(ThermometerInfoRef info) {
-    if (!OneWireInfoReset(info->oneWireInfo))
-        return HUGE_VALF;
+// a reading whose slots were released too late is read again, rather than failing its CRC
+#define THERMOMETER_READ_ATTEMPTS 3
 
-    unsigned char scratchpad[] = { 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 };
-    ThermometerInfoReadScratchpad(info, scratchpad);
+static BOOL ThermometerInfoReadCheckedScratchpad(ThermometerInfoRef info,
+                                                 unsigned char *scratchpad) {
+    for (int attempt = 0 ; attempt < THERMOMETER_READ_ATTEMPTS ; attempt++) {
+        OneWireInfoBeginTransaction(info->oneWireInfo);
+        if (!OneWireInfoReset(info->oneWireInfo)) {
+            OneWireInfoEndTransaction(info->oneWireInfo);
+            return FALSE;
+        }
 
-    if (!ThermometerInfoCheckCRC(scratchpad, 9))
+        memset(scratchpad, 0x0, 9);
+        ThermometerInfoReadScratchpad(info, scratchpad);
+        OneWireInfoEndTransaction(info->oneWireInfo);
+
+        if (ThermometerInfoCheckCRC(scratchpad, 9))
+            return TRUE;
+        if (!OneWireInfoIsLate(info->oneWireInfo))
+            return FALSE;
+    }
+
+    return FALSE;
+}
+
+float ThermometerInfoGetTemperature(ThermometerInfoRef info) {
+    unsigned char scratchpad[9];
+    if (!ThermometerInfoReadCheckedScratchpad(info, scratchpad))
         return HUGE_VALF;
 
     float value = 0.f;
@@ -318,37 +352,38 @@ float ThermometerInfoGetTemperature(ThermometerInfoRef info) {
 #define THERMOMETER_READ_POWER_SUPPLY_COMMAND 0xB4
 
 BOOL ThermometerInfoReadPowerSupply(ThermometerInfoRef info) {
-    if (!OneWireInfoReset(info->oneWireInfo))
+    OneWireInfoBeginTransaction(info->oneWireInfo);
+    if (!OneWireInfoReset(info->oneWireInfo)) {
+        OneWireInfoEndTransaction(info->oneWireInfo);
         return TRUE;
+    }
 
     ThermometerInfoSelect(info);
     OneWireInfoWriteByte(info->oneWireInfo, THERMOMETER_READ_POWER_SUPPLY_COMMAND);
 
     info->parasiticPowerMode = OneWireInfoReadBit(info->oneWireInfo) ? FALSE : TRUE;
+    OneWireInfoEndTransaction(info->oneWireInfo);
     return info->parasiticPowerMode;
 }
 
 JNIEXPORT jobject JNICALL
 Java_com_cdoapps_gpio_Thermometer_listAll(JNIEnv *env, jclass clazz, jobject bus) {
     StackRef stack = StackCreate(FALSE);
-    OneWireInfoRef oneWireInfo = (OneWireInfoRef)Java_java_lang_Object_getReserved(env, bus);
+    OneWireInfoRef oneWireInfo = (OneWireInfoRef)Java_com_cdoapps_gpio_OneWire_getReserved(
+            env, bus);
     if (!oneWireInfo)
         return NULL;
 
     ThermometerInfoList(oneWireInfo, stack);
 
-    jclass listClazz = (*env)->FindClass(env, "java/util/ArrayList");
-    jmethodID listConstructor = (*env)->GetMethodID(env, listClazz, "<init>", "()V");
-    jobject list = (*env)->NewObject(env, listClazz, listConstructor);
-
-    jmethodID add = (*env)->GetMethodID(env, listClazz, "add", "(Ljava/lang/Object;)Z");
-    jmethodID thermometerConstructor = (*env)->GetMethodID(env, clazz, "<init>", "()V");
+    struct JavaArrayListBindings *arrayList = &JAVA_BINDINGS.arrayList;
+    jobject list = (*env)->NewObject(env, arrayList->clazz, arrayList->constructor);
 
     ThermometerInfoRef info = NULL;
     while ((info = StackPop(stack))) {
-        jobject thiz = (*env)->NewObject(env, clazz, thermometerConstructor);
-        (*env)->CallBooleanMethod(env, list, add, thiz);
-        Java_java_lang_Object_setReserved(env, thiz, (jlong)info);
+        jobject thiz = (*env)->NewObject(env, clazz, JAVA_BINDINGS.thermometer.constructor);
+        (*env)->CallBooleanMethod(env, list, arrayList->add, thiz);
+        Java_com_cdoapps_gpio_Thermometer_setReserved(env, thiz, (jlong)info);
     }
 
     StackFree(stack);
@@ -358,16 +393,18 @@ Java_com_cdoapps_gpio_Thermometer_listAll(JNIEnv *env, jclass clazz, jobject bus
 
 JNIEXPORT void JNICALL
 Java_com_cdoapps_gpio_Thermometer_destroy(JNIEnv * env, jobject thiz) {
-    ThermometerInfoRef info = (ThermometerInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+    ThermometerInfoRef info = (ThermometerInfoRef)Java_com_cdoapps_gpio_Thermometer_getReserved(
+            env, thiz);
     if (info) {
         ThermometerInfoFree(info);
-        Java_java_lang_Object_setReserved(env, thiz, 0l);
+        Java_com_cdoapps_gpio_Thermometer_setReserved(env, thiz, 0l);
     }
 }
 
 JNIEXPORT jbyteArray JNICALL
 Java_com_cdoapps_gpio_Thermometer_serialize(JNIEnv * env, jobject thiz) {
-    ThermometerInfoRef info = (ThermometerInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+    ThermometerInfoRef info = (ThermometerInfoRef)Java_com_cdoapps_gpio_Thermometer_getReserved(
+            env, thiz);
     if (!info)
         return NULL;
 
@@ -384,7 +421,8 @@ Java_com_cdoapps_gpio_Thermometer_serialize(JNIEnv * env, jobject thiz) {
 JNIEXPORT jobject JNICALL
 Java_com_cdoapps_gpio_Thermometer_deserializeAll(JNIEnv *env, jclass clazz,
                                                  jobject bus, jbyteArray data) {
-    OneWireInfoRef oneWireInfo = (OneWireInfoRef)Java_java_lang_Object_getReserved(env, bus);
+    OneWireInfoRef oneWireInfo = (OneWireInfoRef)Java_com_cdoapps_gpio_OneWire_getReserved(
+            env, bus);
     if (!oneWireInfo)
         return NULL;
 
@@ -394,25 +432,21 @@ Java_com_cdoapps_gpio_Thermometer_deserializeAll(JNIEnv *env, jclass clazz,
     if ((length % elementLength) != 0)
         return NULL;
 
-    jclass listClazz = (*env)->FindClass(env, "java/util/ArrayList");
-    jmethodID listConstructor = (*env)->GetMethodID(env, listClazz, "<init>", "()V");
-    jobject list = (*env)->NewObject(env, listClazz, listConstructor);
-
-    jmethodID add = (*env)->GetMethodID(env, listClazz, "add", "(Ljava/lang/Object;)Z");
-    jmethodID thermometerConstructor = (*env)->GetMethodID(env, clazz, "<init>", "()V");
+    struct JavaArrayListBindings *arrayList = &JAVA_BINDINGS.arrayList;
+    jobject list = (*env)->NewObject(env, arrayList->clazz, arrayList->constructor);
 
     jint offset = 0;
     jbyte *elements = (*env)->GetByteArrayElements(env, data, NULL);
     while (offset < length) {
-        jobject thiz = (*env)->NewObject(env, clazz, thermometerConstructor);
-        (*env)->CallBooleanMethod(env, list, add, thiz);
+        jobject thiz = (*env)->NewObject(env, clazz, JAVA_BINDINGS.thermometer.constructor);
+        (*env)->CallBooleanMethod(env, list, arrayList->add, thiz);
 
         ThermometerInfoRef info = malloc(sizeof(struct ThermometerInfo));
         memcpy(info, &elements[offset], elementLength);
         info->oneWireInfo = oneWireInfo;
         offset += elementLength;
 
-        Java_java_lang_Object_setReserved(env, thiz, (jlong)info);
+        Java_com_cdoapps_gpio_Thermometer_setReserved(env, thiz, (jlong)info);
     }
     (*env)->ReleaseByteArrayElements(env, data, elements, 0);
 
@@ -422,12 +456,11 @@ Java_com_cdoapps_gpio_Thermometer_deserializeAll(JNIEnv *env, jclass clazz,
 JNIEXPORT jobject JNICALL
 Java_com_cdoapps_gpio_Thermometer_deserialize(JNIEnv *env, jclass clazz,
                                               jobject bus, jbyteArray data) {
-    OneWireInfoRef oneWireInfo = (OneWireInfoRef)Java_java_lang_Object_getReserved(env, bus);
+    OneWireInfoRef oneWireInfo = (OneWireInfoRef)Java_com_cdoapps_gpio_OneWire_getReserved(
+            env, bus);
     if (!oneWireInfo)
         return NULL;
 
-    jmethodID thermometerConstructor = (*env)->GetMethodID(env, clazz, "<init>", "()V");
-
     jsize length = (*env)->GetArrayLength(env, data);
     jsize elementLength = sizeof(struct ThermometerInfo);
 
@@ -435,13 +468,13 @@ Java_com_cdoapps_gpio_Thermometer_deserialize(JNIEnv *env, jclass clazz,
         return NULL;
 
     jbyte *elements = (*env)->GetByteArrayElements(env, data, NULL);
-    jobject thiz = (*env)->NewObject(env, clazz, thermometerConstructor);
+    jobject thiz = (*env)->NewObject(env, clazz, JAVA_BINDINGS.thermometer.constructor);
 
     ThermometerInfoRef info = malloc(sizeof(struct ThermometerInfo));
     memcpy(info, elements, elementLength);
     info->oneWireInfo = oneWireInfo;
 
-    Java_java_lang_Object_setReserved(env, thiz, (jlong)info);
+    Java_com_cdoapps_gpio_Thermometer_setReserved(env, thiz, (jlong)info);
 
     (*env)->ReleaseByteArrayElements(env, data, elements, 0);
 
@@ -450,7 +483,8 @@ Java_com_cdoapps_gpio_Thermometer_deserialize(JNIEnv *env, jclass clazz,
 
 JNIEXPORT jstring JNICALL
 Java_com_cdoapps_gpio_Thermometer_getRom(JNIEnv *env, jobject thiz) {
-    ThermometerInfoRef info = (ThermometerInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+    ThermometerInfoRef info = (ThermometerInfoRef)Java_com_cdoapps_gpio_Thermometer_getReserved(
+            env, thiz);
     if (info)
         return (*env)->NewStringUTF(env, ThermometerInfoGetRom(info));
 
@@ -459,32 +493,15 @@ Java_com_cdoapps_gpio_Thermometer_getRom(JNIEnv *env, jobject thiz) {
 
 JNIEXPORT jobject JNICALL
 Java_com_cdoapps_gpio_Thermometer_getFamily(JNIEnv *env, jobject thiz) {
-    ThermometerInfoRef info = (ThermometerInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+    ThermometerInfoRef info = (ThermometerInfoRef)Java_com_cdoapps_gpio_Thermometer_getReserved(
+            env, thiz);
     if (!info)
         return NULL;
 
-    jclass clazz = (*env)->FindClass(env, "com/cdoapps/gpio/Thermometer$Family");
-
     switch (ThermometerInfoGetFamily(info)) {
-        case ThermometerFamilyDS18S20: {
-            jfieldID fieldID = (*env)->GetStaticFieldID(
-                    env,
-                    clazz ,
-                    "DS18S20",
-                    "Lcom/cdoapps/gpio/Thermometer$Family;");
-
-            return (*env)->GetStaticObjectField(env, clazz, fieldID);
-        }
-
-        case ThermometerFamilyDS18B20: {
-            jfieldID fieldID = (*env)->GetStaticFieldID(
-                    env,
-                    clazz ,
-                    "DS18B20",
-                    "Lcom/cdoapps/gpio/Thermometer$Family;");
-
-            return (*env)->GetStaticObjectField(env, clazz, fieldID);
-        }
+        case ThermometerFamilyDS18S20:
+        case ThermometerFamilyDS18B20:
+            return JAVA_BINDINGS.thermometer.families[ThermometerInfoGetFamily(info)];
 
         default:
             break;
@@ -495,7 +512,8 @@ Java_com_cdoapps_gpio_Thermometer_getFamily(JNIEnv *env, jobject thiz) {
 
 JNIEXPORT jboolean JNICALL
 Java_com_cdoapps_gpio_Thermometer_usesParasiticPowerMode(JNIEnv *env, jobject thiz) {
-    ThermometerInfoRef info = (ThermometerInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+    ThermometerInfoRef info = (ThermometerInfoRef)Java_com_cdoapps_gpio_Thermometer_getReserved(
+            env, thiz);
     if (info && ThermometerInfoUsesParasiticPowerMode(info))
         return JNI_TRUE;
 
@@ -504,21 +522,24 @@ Java_com_cdoapps_gpio_Thermometer_usesParasiticPowerMode(JNIEnv *env, jobject th
 
 JNIEXPORT void JNICALL Java_com_cdoapps_gpio_Thermometer_convert__Lcom_cdoapps_gpio_OneWire_2Z(
         JNIEnv * env, jclass clazz, jobject bus, jboolean parasiticPowerMode) {
-    OneWireInfoRef oneWireInfo = (OneWireInfoRef)Java_java_lang_Object_getReserved(env, bus);
+    OneWireInfoRef oneWireInfo = (OneWireInfoRef)Java_com_cdoapps_gpio_OneWire_getReserved(
+            env, bus);
     if (oneWireInfo)
         ThermometerInfoConvertAll(oneWireInfo, parasiticPowerMode);
 }
 
 JNIEXPORT void JNICALL
 Java_com_cdoapps_gpio_Thermometer_convert__(JNIEnv * env, jobject thiz) {
-    ThermometerInfoRef info = (ThermometerInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+    ThermometerInfoRef info = (ThermometerInfoRef)Java_com_cdoapps_gpio_Thermometer_getReserved(
+            env, thiz);
     if (info)
         ThermometerInfoConvert(info);
 }
 
 JNIEXPORT jfloat JNICALL
 Java_com_cdoapps_gpio_Thermometer_getTemperature(JNIEnv *env, jobject thiz) {
-    ThermometerInfoRef info = (ThermometerInfoRef)Java_java_lang_Object_getReserved(env, thiz);
+    ThermometerInfoRef info = (ThermometerInfoRef)Java_com_cdoapps_gpio_Thermometer_getReserved(
+            env, thiz);
     if (info)
         return (jfloat)ThermometerInfoGetTemperature(info);
 
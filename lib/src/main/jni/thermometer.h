@@ -125,9 +125,11 @@ void ThermometerInfoConvert(ThermometerInfoRef info);
  * Returns the temperature measured by this thermometer.
  *
  * One may call this function after issuing a conversion by calling {@code ThermometerInfoConvertAll}.
+ * The scratchpad is read again, up to 3 times, while its CRC fails after a slot released too late
+ * (see {@code OneWireInfoIsLate}).
  *
  * @param info a {@code ThermometerInfo} object representing the thermometer.
- * @return the temperature measured by this thermometer.
+ * @return the temperature measured by this thermometer, or {@code HUGE_VALF} on failure.
  */
 float ThermometerInfoGetTemperature(ThermometerInfoRef info);
 
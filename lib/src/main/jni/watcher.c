@@ -0,0 +1,347 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common.h"
+#include "bindings.h"
+#include "watcher.h"
+#include "delay.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#define WATCHER_QUEUE_SIZE 256
+
+struct WatcherPin {
+    int pin;
+    int bank;
+    uint32_t mask;
+    long long debounce;
+
+    int value;
+    // a value which differs from the reported one and is being debounced
+    BOOL pending;
+    int pendingValue;
+    long long pendingTime;
+};
+
+struct WatcherInfo {
+    GPIOInfoRef gpioInfo;
+    struct GPIOInputWord banks[32];
+    int bankCount;
+    struct WatcherPin pins[32];
+    int pinCount;
+    // WiringPi address -> index in pins, or -1
+    int indexes[64];
+
+    long long period;
+
+    struct {
+        pthread_mutex_t lock;
+        pthread_cond_t condition;
+        struct WatcherEvent queue[WATCHER_QUEUE_SIZE];
+        int first;
+        int count;
+        // set by WatcherInfoFree, which waits for the blocked waiters to leave
+        BOOL stopped;
+        int waiters;
+    } events;
+
+    BOOL running;
+    pthread_t thread;
+};
+
+// must be called with the events lock held, the oldest event is dropped on overflow
+static void WatcherInfoPushEvent(WatcherInfoRef info, struct WatcherEvent event) {
+    if (WATCHER_QUEUE_SIZE == info->events.count) {
+        info->events.first = (info->events.first + 1) % WATCHER_QUEUE_SIZE;
+        info->events.count--;
+    }
+
+    int last = (info->events.first + info->events.count) % WATCHER_QUEUE_SIZE;
+    info->events.queue[last] = event;
+    info->events.count++;
+}
+
+static void WatcherInfoSample(WatcherInfoRef info, BOOL *pending) {
+    uint32_t words[32];
+    BOOL changed = GPIOInputWordSample(info->banks, info->bankCount, words) ? TRUE : FALSE;
+
+    // nothing to do while idle: no pin changed and no value is being debounced
+    if (!changed && !*pending)
+        return;
+
+    long long now = DelayGetTime();
+    BOOL locked = FALSE;
+    *pending = FALSE;
+
+    for (int index = 0 ; index < info->pinCount ; index++) {
+        struct WatcherPin *pinInfo = &info->pins[index];
+        int value = (words[pinInfo->bank] & pinInfo->mask) ?
+                GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW;
+
+        if (value == pinInfo->value) {
+            pinInfo->pending = FALSE;
+            continue;
+        }
+
+        if (!pinInfo->pending || value != pinInfo->pendingValue) {
+            pinInfo->pending = TRUE;
+            pinInfo->pendingValue = value;
+            pinInfo->pendingTime = now;
+        }
+
+        if (now - pinInfo->pendingTime < __atomic_load_n(&pinInfo->debounce, __ATOMIC_RELAXED)) {
+            *pending = TRUE;
+            continue;
+        }
+
+        if (!locked) {
+            pthread_mutex_lock(&info->events.lock);
+            locked = TRUE;
+        }
+
+        WatcherInfoPushEvent(info, (struct WatcherEvent){
+            .timestamp = pinInfo->pendingTime,
+            .pin = pinInfo->pin,
+            .value = value
+        });
+        pinInfo->value = value;
+        pinInfo->pending = FALSE;
+    }
+
+    // the changes of one sample are delivered as one batch
+    if (locked) {
+        pthread_cond_broadcast(&info->events.condition);
+        pthread_mutex_unlock(&info->events.lock);
+    }
+}
+
+static void *WatcherInfoRun(void *argument) {
+    WatcherInfoRef info = argument;
+    BOOL pending = FALSE;
+    long long deadline = DelayGetTime();
+
+    while (__atomic_load_n(&info->running, __ATOMIC_ACQUIRE)) {
+        deadline += info->period;
+
+        DelaySleepUntil(deadline);
+
+        WatcherInfoSample(info, &pending);
+    }
+
+    return NULL;
+}
+
+WatcherInfoRef WatcherInfoCreate(GPIOInfoRef gpioInfo, uint64_t mask, int rate,
+                                 long long debounce) {
+    if (rate <= 0)
+        return NULL;
+
+    WatcherInfoRef info = malloc(sizeof(struct WatcherInfo));
+
+    info->bankCount = 0;
+    info->pinCount = 0;
+
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        info->indexes[pin] = -1;
+
+        uint32_t pinMask = 0x0;
+        int bank = -1;
+        if (pin >= 32 || !(mask & (0x1ull << pin)) ||
+            (bank = GPIOInfoAddInputWord(gpioInfo, info->banks, &info->bankCount, pin,
+                                         &pinMask)) < 0)
+            continue;
+
+        info->indexes[pin] = info->pinCount;
+        info->pins[info->pinCount++] = (struct WatcherPin){
+            .pin = pin,
+            .bank = bank,
+            .mask = pinMask,
+            .debounce = debounce,
+            .pending = FALSE
+        };
+    }
+
+    if (!info->pinCount) {
+        LOG_ERROR("None of the watched pins is exported in register mode");
+        free(info);
+        return NULL;
+    }
+
+    // the first sample gives the initial values
+    uint32_t words[32];
+    GPIOInputWordSample(info->banks, info->bankCount, words);
+
+    for (int index = 0 ; index < info->pinCount ; index++) {
+        struct WatcherPin *pinInfo = &info->pins[index];
+        pinInfo->value = (info->banks[pinInfo->bank].previous & pinInfo->mask) ?
+                GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW;
+    }
+
+    info->period = 1000000000ll / rate;
+    info->events.first = 0;
+    info->events.count = 0;
+    info->events.stopped = FALSE;
+    info->events.waiters = 0;
+
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&info->events.condition, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_mutex_init(&info->events.lock, NULL);
+    info->gpioInfo = GPIOInfoRetain(gpioInfo);
+
+    info->running = TRUE;
+    if (pthread_create(&info->thread, NULL, WatcherInfoRun, info) != 0) {
+        LOG_ERROR("Unable to start the watcher thread");
+        pthread_cond_destroy(&info->events.condition);
+        pthread_mutex_destroy(&info->events.lock);
+        GPIOInfoFree(gpioInfo);
+        free(info);
+        return NULL;
+    }
+
+    return info;
+}
+
+void WatcherInfoFree(WatcherInfoRef info) {
+    __atomic_store_n(&info->running, FALSE, __ATOMIC_RELEASE);
+    pthread_join(info->thread, NULL);
+
+    // the waiters are woken up, and the lock and the condition only destroyed once they left
+    pthread_mutex_lock(&info->events.lock);
+    info->events.stopped = TRUE;
+    pthread_cond_broadcast(&info->events.condition);
+    while (info->events.waiters)
+        pthread_cond_wait(&info->events.condition, &info->events.lock);
+    pthread_mutex_unlock(&info->events.lock);
+
+    pthread_cond_destroy(&info->events.condition);
+    pthread_mutex_destroy(&info->events.lock);
+    GPIOInfoFree(info->gpioInfo);
+    free(info);
+}
+
+void WatcherInfoSetDebounce(WatcherInfoRef info, int pin, long long debounce) {
+    if (pin < 0 || pin >= 64 || info->indexes[pin] < 0)
+        return;
+
+    __atomic_store_n(&info->pins[info->indexes[pin]].debounce, debounce, __ATOMIC_RELAXED);
+}
+
+int WatcherInfoWait(WatcherInfoRef info, struct WatcherEvent *events, int count,
+                    long long timeout) {
+    long long deadline = (timeout < 0) ? -1 : DelayGetTime() + timeout;
+    int popped = 0;
+
+    pthread_mutex_lock(&info->events.lock);
+    info->events.waiters++;
+
+    while (!info->events.count && !info->events.stopped) {
+        if (deadline < 0) {
+            pthread_cond_wait(&info->events.condition, &info->events.lock);
+            continue;
+        }
+
+        if (DelayGetTime() >= deadline)
+            break;
+
+        struct timespec date = DelayGetTimespec(deadline);
+        pthread_cond_timedwait(&info->events.condition, &info->events.lock, &date);
+    }
+
+    while (popped < count && info->events.count && !info->events.stopped) {
+        events[popped++] = info->events.queue[info->events.first];
+        info->events.first = (info->events.first + 1) % WATCHER_QUEUE_SIZE;
+        info->events.count--;
+    }
+
+    BOOL stopped = info->events.stopped;
+    if (--info->events.waiters == 0 && stopped)
+        pthread_cond_broadcast(&info->events.condition);
+
+    pthread_mutex_unlock(&info->events.lock);
+    return stopped ? -1 : popped;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_Watcher_start(JNIEnv *env, jobject thiz, jobject gpio, jlong mask,
+                                    jint rate, jlong debounce) {
+    WatcherInfoRef info = (WatcherInfoRef)Java_com_cdoapps_gpio_Watcher_getReserved(env, thiz);
+    if (info)
+        WatcherInfoFree(info);
+
+    Java_com_cdoapps_gpio_Watcher_setReserved(env, thiz, 0l);
+
+    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, gpio);
+    if (!gpioInfo)
+        return JNI_FALSE;
+
+    info = WatcherInfoCreate(gpioInfo, (uint64_t)mask, rate, debounce);
+    if (!info)
+        return JNI_FALSE;
+
+    Java_com_cdoapps_gpio_Watcher_setReserved(env, thiz, (jlong)info);
+    return JNI_TRUE;
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Watcher_nativeStop(JNIEnv *env, jobject thiz) {
+    WatcherInfoRef info = (WatcherInfoRef)Java_com_cdoapps_gpio_Watcher_getReserved(env, thiz);
+    if (info) {
+        WatcherInfoFree(info);
+        Java_com_cdoapps_gpio_Watcher_setReserved(env, thiz, 0l);
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Watcher_setDebounce(JNIEnv *env, jobject thiz, jint pin,
+                                          jlong debounce) {
+    WatcherInfoRef info = (WatcherInfoRef)Java_com_cdoapps_gpio_Watcher_getReserved(env, thiz);
+    if (info)
+        WatcherInfoSetDebounce(info, pin, debounce);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_cdoapps_gpio_Watcher_waitForChanges(JNIEnv *env, jobject thiz, jlongArray timestamps,
+                                             jintArray pins, jintArray values, jlong timeout) {
+    WatcherInfoRef info = (WatcherInfoRef)Java_com_cdoapps_gpio_Watcher_getReserved(env, thiz);
+    if (!info)
+        return -1;
+
+    struct WatcherEvent events[WATCHER_QUEUE_SIZE];
+    int count = (*env)->GetArrayLength(env, timestamps);
+    if ((*env)->GetArrayLength(env, pins) < count)
+        count = (*env)->GetArrayLength(env, pins);
+    if ((*env)->GetArrayLength(env, values) < count)
+        count = (*env)->GetArrayLength(env, values);
+    if (count > WATCHER_QUEUE_SIZE)
+        count = WATCHER_QUEUE_SIZE;
+
+    count = WatcherInfoWait(info, events, count, timeout);
+
+    for (int index = 0 ; index < count ; index++) {
+        jlong timestamp = events[index].timestamp;
+        jint pin = events[index].pin;
+        jint value = events[index].value;
+
+        (*env)->SetLongArrayRegion(env, timestamps, index, 1, &timestamp);
+        (*env)->SetIntArrayRegion(env, pins, index, 1, &pin);
+        (*env)->SetIntArrayRegion(env, values, index, 1, &value);
+    }
+
+    return count;
+}
@@ -0,0 +1,93 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GPIO_WATCHER_H
+#define GPIO_WATCHER_H
+
+#include "gpio.h"
+
+/**
+ * The {@code WatcherEvent} struct represents a debounced change of the value of one pin.
+ */
+struct WatcherEvent {
+    /**
+     * The time at which the new value was first sampled, in nanoseconds of
+     * {@code CLOCK_MONOTONIC}.
+     */
+    long long timestamp;
+    /**
+     * The WiringPi address of the pin.
+     */
+    int pin;
+    /**
+     * The new value of the pin, either {@code GPIO_PIN_VALUE_LOW} or {@code GPIO_PIN_VALUE_HIGH}.
+     */
+    int value;
+};
+
+/**
+ * The {@code WatcherInfo} struct represents a thread polling the input registers of many pins and
+ * queuing their debounced changes, for the pins in register mode which have no kernel interrupts.
+ *
+ * The input words are compared as a whole with the previous sample, so that the cost of an idle
+ * poll does not depend on the number of pins.
+ */
+typedef struct WatcherInfo *WatcherInfoRef;
+
+/**
+ * Returns a {@code WatcherInfo} object polling many pins, and starts its thread. The values of the
+ * pins when the thread starts are not reported.
+ *
+ * @param gpioInfo a {@code GPIOInfo} object representing the GPIO controller.
+ * @param mask a bit mask of the WiringPi addresses of the pins to watch, which must be exported
+ *             in register mode.
+ * @param rate the polling rate in Hz.
+ * @param debounce the initial debounce window of every pin in nanoseconds.
+ * @return a {@code WatcherInfo} object, or {@code NULL} on error.
+ */
+WatcherInfoRef WatcherInfoCreate(GPIOInfoRef gpioInfo, uint64_t mask, int rate,
+                                 long long debounce);
+/**
+ * Stops the thread of a watcher and destroys the resources associated to it. The threads waiting
+ * for its events are woken up first, and the resources destroyed once they all returned.
+ *
+ * @param info a {@code WatcherInfo} object representing the watcher to destroy.
+ */
+void WatcherInfoFree(WatcherInfoRef info);
+
+/**
+ * Changes the debounce window of one pin: a new value is only reported once it has been sampled
+ * continuously for this duration.
+ *
+ * @param info a {@code WatcherInfo} object representing the watcher.
+ * @param pin the WiringPi address of the pin.
+ * @param debounce the debounce window in nanoseconds, or {@code 0} to report every change.
+ */
+void WatcherInfoSetDebounce(WatcherInfoRef info, int pin, long long debounce);
+
+/**
+ * Blocks until changes are queued, then returns as many of them as possible. The oldest changes
+ * are dropped if they are not consumed fast enough.
+ *
+ * @param info a {@code WatcherInfo} object representing the watcher.
+ * @param events receives the changes, oldest first.
+ * @param count the capacity of {@code events}.
+ * @param timeout the maximum time to wait in nanoseconds, or a negative value to wait forever.
+ * @return the number of changes returned, {@code 0} on timeout, or {@code -1} once the watcher
+ *         is being destroyed.
+ */
+int WatcherInfoWait(WatcherInfoRef info, struct WatcherEvent *events, int count,
+                    long long timeout);
+
+#endif //GPIO_WATCHER_H
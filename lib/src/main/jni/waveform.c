@@ -0,0 +1,242 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "common.h"
+#include "bindings.h"
+#include "waveform.h"
+#include "delay.h"
+#include "realtime.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+
+struct WaveformStep {
+    long long offset;
+    // the writes of the step, or none if the pins are changed through GPIOInfoWriteMask
+    int first;
+    int count;
+    uint64_t mask;
+    uint64_t values;
+};
+
+struct WaveformInfo {
+    GPIOInfoRef gpioInfo;
+
+    struct WaveformStep *steps;
+    int stepCount;
+    struct GPIOWordWrite *writes;
+    int writeCount;
+};
+
+struct WaveformPlayback {
+    WaveformInfoRef info;
+    struct RealtimeOptions realtimeOptions;
+    long long *lateness;
+};
+
+// returns FALSE if one of the pins has no handle
+static BOOL WaveformInfoCompileStep(WaveformInfoRef info, struct WaveformStep *step) {
+    step->first = info->writeCount;
+    step->count = 0;
+
+    for (int pin = 0 ; pin < 64 ; pin++) {
+        if (!(step->mask & (0x1ull << pin)))
+            continue;
+
+        GPIOPinHandleRef handle = GPIOInfoGetPinHandle(info->gpioInfo, pin);
+        if (!handle) {
+            step->count = 0;
+            return FALSE;
+        }
+
+        int value = (step->values & (0x1ull << pin)) ? GPIO_PIN_VALUE_HIGH : GPIO_PIN_VALUE_LOW;
+        GPIOWordWriteAdd(&info->writes[step->first], &step->count, handle, value);
+    }
+
+    info->writeCount += step->count;
+    return TRUE;
+}
+
+WaveformInfoRef WaveformInfoCreate(GPIOInfoRef gpioInfo, const long long *timeline, int count) {
+    for (int index = 1 ; index < count ; index++) {
+        if (timeline[3 * index] < timeline[3 * (index - 1)]) {
+            LOG_ERROR("The transitions of the waveform are not sorted");
+            return NULL;
+        }
+    }
+
+    WaveformInfoRef info = malloc(sizeof(struct WaveformInfo));
+    info->gpioInfo = GPIOInfoRetain(gpioInfo);
+    info->steps = malloc(sizeof(struct WaveformStep) * (count ? count : 1));
+    info->stepCount = count;
+    info->writeCount = 0;
+
+    // a step writes at most one word per pin
+    size_t maximumCount = 1;
+    for (int index = 0 ; index < count ; index++)
+        maximumCount += __builtin_popcountll((uint64_t)timeline[3 * index + 1]);
+    info->writes = malloc(sizeof(struct GPIOWordWrite) * maximumCount);
+
+    for (int index = 0 ; index < count ; index++) {
+        struct WaveformStep *step = &info->steps[index];
+        step->offset = timeline[3 * index];
+        step->mask = (uint64_t)timeline[3 * index + 1];
+        step->values = (uint64_t)timeline[3 * index + 2];
+
+        WaveformInfoCompileStep(info, step);
+    }
+
+    int writeCount = info->writeCount ? info->writeCount : 1;
+    info->writes = realloc(info->writes, sizeof(struct GPIOWordWrite) * writeCount);
+    return info;
+}
+
+void WaveformInfoFree(WaveformInfoRef info) {
+    free(info->writes);
+    free(info->steps);
+    GPIOInfoFree(info->gpioInfo);
+    free(info);
+}
+
+static void *WaveformInfoRun(void *argument) {
+    struct WaveformPlayback *playback = argument;
+    WaveformInfoRef info = playback->info;
+
+    struct RealtimeSession session;
+    RealtimeSessionEnter(&session, &playback->realtimeOptions);
+
+    long long start = DelayGetTime();
+
+    for (int index = 0 ; index < info->stepCount ; index++) {
+        const struct WaveformStep *step = &info->steps[index];
+        long long deadline = start + step->offset;
+
+        DelayUntil(deadline);
+
+        if (step->count)
+            GPIOWordWriteApply(&info->writes[step->first], step->count);
+        else if (step->mask)
+            GPIOInfoWriteMask(info->gpioInfo, step->mask, step->values);
+
+        playback->lateness[index] = DelayGetTime() - deadline;
+    }
+
+    RealtimeSessionExit(&session);
+    return NULL;
+}
+
+BOOL WaveformInfoPlay(WaveformInfoRef info, int cpu, int priority, long long *lateness,
+                      struct WaveformStatistics *statistics) {
+    struct WaveformPlayback playback = {
+            .info = info,
+            .realtimeOptions = { .cpu = cpu, .priority = priority },
+            .lateness = lateness
+    };
+
+    if (!lateness)
+        playback.lateness = malloc(sizeof(long long) * (info->stepCount ? info->stepCount : 1));
+
+    // the playback does not change the scheduling of the calling thread
+    pthread_t thread;
+    BOOL result = (pthread_create(&thread, NULL, WaveformInfoRun, &playback) == 0) ? TRUE : FALSE;
+    if (result) {
+        pthread_join(thread, NULL);
+    } else {
+        LOG_ERROR("Unable to start the waveform thread");
+    }
+
+    if (result && statistics) {
+        *statistics = (struct WaveformStatistics){ .count = info->stepCount };
+
+        long long sum = 0;
+        for (int index = 0 ; index < info->stepCount ; index++) {
+            long long value = playback.lateness[index];
+            if (!index || value < statistics->minimum)
+                statistics->minimum = value;
+            if (!index || value > statistics->maximum)
+                statistics->maximum = value;
+            sum += value;
+        }
+
+        if (info->stepCount)
+            statistics->mean = sum / info->stepCount;
+    }
+
+    if (!lateness)
+        free(playback.lateness);
+
+    return result;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_Waveform_compile(JNIEnv *env, jobject thiz, jobject gpio,
+                                       jlongArray timeline, jint count) {
+    WaveformInfoRef info = (WaveformInfoRef)Java_com_cdoapps_gpio_Waveform_getReserved(env, thiz);
+    if (info)
+        WaveformInfoFree(info);
+
+    Java_com_cdoapps_gpio_Waveform_setReserved(env, thiz, 0l);
+
+    GPIOInfoRef gpioInfo = (GPIOInfoRef)Java_com_cdoapps_gpio_GPIO_getReserved(env, gpio);
+    if (!gpioInfo || count < 0 || (*env)->GetArrayLength(env, timeline) < 3 * count)
+        return JNI_FALSE;
+
+    jlong *elements = (*env)->GetLongArrayElements(env, timeline, NULL);
+    if (!elements)
+        return JNI_FALSE;
+
+    info = WaveformInfoCreate(gpioInfo, (const long long *)elements, count);
+    (*env)->ReleaseLongArrayElements(env, timeline, elements, JNI_ABORT);
+    if (!info)
+        return JNI_FALSE;
+
+    Java_com_cdoapps_gpio_Waveform_setReserved(env, thiz, (jlong)info);
+    return JNI_TRUE;
+}
+
+JNIEXPORT void JNICALL
+Java_com_cdoapps_gpio_Waveform_destroy(JNIEnv *env, jobject thiz) {
+    WaveformInfoRef info = (WaveformInfoRef)Java_com_cdoapps_gpio_Waveform_getReserved(env, thiz);
+    if (info) {
+        WaveformInfoFree(info);
+        Java_com_cdoapps_gpio_Waveform_setReserved(env, thiz, 0l);
+    }
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_cdoapps_gpio_Waveform_nativePlay(JNIEnv *env, jobject thiz, jint cpu, jint priority,
+                                          jlongArray lateness, jlongArray statistics) {
+    WaveformInfoRef info = (WaveformInfoRef)Java_com_cdoapps_gpio_Waveform_getReserved(env, thiz);
+    if (!info)
+        return JNI_FALSE;
+
+    int count = (*env)->GetArrayLength(env, lateness);
+    if (count > info->stepCount)
+        count = info->stepCount;
+
+    long long *values = malloc(sizeof(long long) * (info->stepCount ? info->stepCount : 1));
+    struct WaveformStatistics result;
+
+    if (!WaveformInfoPlay(info, cpu, priority, values, &result)) {
+        free(values);
+        return JNI_FALSE;
+    }
+
+    (*env)->SetLongArrayRegion(env, lateness, 0, count, (const jlong *)values);
+    free(values);
+
+    jlong summary[] = { result.count, result.minimum, result.maximum, result.mean };
+    (*env)->SetLongArrayRegion(env, statistics, 0, 4, summary);
+    return JNI_TRUE;
+}
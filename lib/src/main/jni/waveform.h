@@ -0,0 +1,73 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GPIO_WAVEFORM_H
+#define GPIO_WAVEFORM_H
+
+#include "gpio.h"
+
+/**
+ * The {@code WaveformStatistics} struct holds the lateness of the transitions of one playback,
+ * i.e. the durations between their deadlines and the ends of their register writes.
+ */
+struct WaveformStatistics {
+    int count;
+    long long minimum;
+    long long maximum;
+    long long mean;
+};
+
+/**
+ * The {@code WaveformInfo} struct represents a timeline of transitions compiled for the pins of a
+ * GPIO controller, which can be replayed with absolute deadlines.
+ */
+typedef struct WaveformInfo *WaveformInfoRef;
+
+/**
+ * Returns a {@code WaveformInfo} object compiling a timeline.
+ *
+ * The timeline is a flat array of triplets: the offset of the transition in nanoseconds since the
+ * start of the playback, then the WiringPi addresses of the pins to change and their values as bit
+ * masks. The registers of the pins exported in register mode are resolved once, the other pins
+ * being changed through {@code GPIOInfoWriteMask}.
+ *
+ * @param gpioInfo a {@code GPIOInfo} object representing the GPIO controller.
+ * @param timeline the triplets of the transitions, sorted by offset.
+ * @param count the number of transitions.
+ * @return a {@code WaveformInfo} object, or {@code NULL} if the offsets are not sorted.
+ */
+WaveformInfoRef WaveformInfoCreate(GPIOInfoRef gpioInfo, const long long *timeline, int count);
+/**
+ * Destroys the resources associated to a compiled timeline.
+ *
+ * @param info a {@code WaveformInfo} object representing the timeline to destroy.
+ */
+void WaveformInfoFree(WaveformInfoRef info);
+
+/**
+ * Replays a timeline on a new thread, pinned to one CPU with the {@code SCHED_FIFO} policy, and
+ * waits for its end. The pins must remain exported during the playback.
+ *
+ * @param info a {@code WaveformInfo} object representing the timeline.
+ * @param cpu the index of the CPU, {@code REALTIME_CPU_ISOLATED}, or {@code -1} to leave the
+ *            affinity unchanged.
+ * @param priority the {@code SCHED_FIFO} priority, or {@code 0} to use the default policy.
+ * @param lateness if not {@code NULL}, receives the lateness in nanoseconds of each transition.
+ * @param statistics if not {@code NULL}, receives the statistics of the lateness.
+ * @return {@code TRUE} if the timeline was replayed.
+ */
+BOOL WaveformInfoPlay(WaveformInfoRef info, int cpu, int priority, long long *lateness,
+                      struct WaveformStatistics *statistics);
+
+#endif //GPIO_WAVEFORM_H
@@ -0,0 +1,34 @@
+// Copyright 2021 CDO Apps
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package dalvik.annotation.optimization;
+
+import java.lang.annotation.ElementType;
+import java.lang.annotation.Retention;
+import java.lang.annotation.RetentionPolicy;
+import java.lang.annotation.Target;
+
+/**
+ * The {@code CriticalNative} annotation tells ART (Android 8.0 and later) that the native method is
+ * called without any {@code JNIEnv} nor {@code jclass} argument and without any thread state
+ * transition. It must be static, only take and return primitive types and never block.
+ *
+ * This declaration mirrors the platform annotation, which is hidden from the SDK the library is
+ * compiled against. The library is only compiled against it, thus it is not packaged: ART finds the
+ * platform class at runtime.
+ */
+@Retention(RetentionPolicy.CLASS)
+@Target(ElementType.METHOD)
+public @interface CriticalNative {
+}